@@ -1,16 +1,83 @@
 """Main benchmark class for ESP32-CAM testing."""
 
+import itertools
 import json
 import os
-import subprocess
+import threading
 import time
+from concurrent.futures import ThreadPoolExecutor
+from datetime import datetime
 from pathlib import Path
-from typing import Any, Dict, List
+from typing import Any, Callable, Dict, List, Optional
 
 import cv2
 
-from .protocols import control, video
-from .utils import config, logging, serial
+from . import reports
+from .protocols import control, mjpeg, recovery, snapshot, video
+from .utils import (
+    config,
+    device,
+    discovery,
+    firmware,
+    fleet,
+    logging,
+    motion,
+    ota,
+    raw_tiles,
+    serial,
+    stats,
+    store,
+)
+
+
+def _ratio(value: float, baseline: float) -> float:
+    """Get value relative to baseline, 0 when there is no baseline."""
+    return value / baseline if baseline else 0
+
+
+def compute_interference(
+    baseline: Dict[str, Dict[str, Any]], concurrent: Dict[str, Dict[str, Any]]
+) -> Dict[str, Any]:
+    """Compare concurrent video and control metrics with their solo baselines.
+
+    Ratios are concurrent / solo, so 1.0 means no interference. FPS ratios
+    below 1.0 show video slowed by control traffic, latency ratios above 1.0
+    show control commands delayed by the video stream.
+
+    Args:
+        baseline: Solo video and control results
+        concurrent: Video and control results measured simultaneously
+
+    Returns:
+        Dictionary with per-metric solo and concurrent values and ratios
+    """
+    solo_video, conc_video = baseline["video"], concurrent["video"]
+    solo_ctrl = baseline["control"]["latency_stats"]
+    conc_ctrl = concurrent["control"]["latency_stats"]
+
+    result = {
+        "video": {
+            "solo_fps": solo_video["avg_fps"],
+            "concurrent_fps": conc_video["avg_fps"],
+            "fps_ratio": _ratio(conc_video["avg_fps"], solo_video["avg_fps"]),
+            "solo_bitrate_mbps": solo_video["bitrate_mbps"],
+            "concurrent_bitrate_mbps": conc_video["bitrate_mbps"],
+            "bitrate_ratio": _ratio(
+                conc_video["bitrate_mbps"], solo_video["bitrate_mbps"]
+            ),
+        },
+        "control": {
+            "solo_success_rate": baseline["control"]["success_rate"],
+            "concurrent_success_rate": concurrent["control"]["success_rate"],
+        },
+    }
+    for name in ("p50", "p95", "p99"):
+        solo = solo_ctrl["percentiles"][name]
+        conc = conc_ctrl["percentiles"][name]
+        result["control"][f"solo_{name}_ms"] = solo
+        result["control"][f"concurrent_{name}_ms"] = conc
+        result["control"][f"{name}_ratio"] = _ratio(conc, solo)
+    return result
 
 
 class ESPCamBenchmark:
@@ -23,15 +90,32 @@ class ESPCamBenchmark:
         self.results_dir = Path("results")
         self.results_dir.mkdir(parents=True, exist_ok=True)
         self.current_test_params = None
+        self._device: Optional[fleet.DeviceHandle] = None
+        self._baselines: Dict[tuple, Dict[str, Any]] = {}
+        self.firmware = firmware.FirmwareCache(
+            self.config.get("firmware_cache_dir", "results/firmware"),
+            jobs=self.config.get("build_jobs"),
+            logger=self.logger,
+        )
+        self.store = store.ResultsStore(
+            self.config.get("results_db", "results/results.db")
+        )
 
     def run_test_combination(
-        self, test_params: Dict[str, Any], skip_build: bool = False
+        self,
+        test_params: Dict[str, Any],
+        skip_build: bool = False,
+        target: Optional[fleet.DeviceHandle] = None,
+        start_barrier: Optional[threading.Barrier] = None,
     ) -> Dict[str, Any]:
         """Run a single test with specified parameters.
 
         Args:
             test_params: Dictionary with test parameters
             skip_build: Whether to skip firmware build and flash
+            target: Board to test, the first board on a serial port if None
+            start_barrier: Barrier passed right before measuring, used to start
+                several boards at once
 
         Returns:
             Dictionary with test results
@@ -42,138 +126,834 @@ class ESPCamBenchmark:
                 "HTTP protocol is not supported in RAW mode. Please use a different video protocol or disable RAW mode."
             )
 
-        self.logger.info("Starting test with parameters: %s", test_params)
-        results = {}
+        target = target or self._default_device()
+        self.logger.info(
+            "Starting test on %s with parameters: %s", target.name, test_params
+        )
 
         # Store current test parameters for build
         self.current_test_params = test_params
 
         if not skip_build:
-            self._build_and_flash()
+            self._build_and_flash(test_params, target)
 
-        # Find ESP32 port
-        port = serial.find_esp_port()
-        if not port:
-            raise RuntimeError("ESP32-CAM not found")
-
-        # Wait for device to initialize and get IP
-        ip_address = serial.wait_for_ip(port)
-        if not ip_address:
-            raise RuntimeError("Failed to get device IP address")
-
-        self.logger.info("Device IP: %s", ip_address)
+        ip_address = self._device_ip(target)
+        self.logger.info("Device %s IP: %s", target.name, ip_address)
 
-        # Run video test if protocol specified
-        if test_params.get("video_protocol"):
-            results["video"] = video.test_video(
-                ip_address,
-                test_params["video_protocol"],
-                test_params["resolution"],
-                test_params["quality"],
-                test_params.get("raw_mode", False),
-                self.config["test_duration"],
-                self.logger,
+        # Select transports at runtime, the firmware contains all of them
+        switch_time = device.select_transport(
+            ip_address,
+            test_params.get("video_protocol"),
+            test_params.get("control_protocol"),
+        )
+        self.logger.info("Transports selected in %.2f s", switch_time)
+        if test_params.get("task_profile"):
+            switch_time = device.select_task_profile(
+                ip_address, test_params["task_profile"]
+            )
+            self.logger.info(
+                "Task profile %s selected in %.2f s",
+                test_params["task_profile"],
+                switch_time,
+            )
+        if test_params.get("net_profile"):
+            switch_time = device.select_net_profile(
+                ip_address, test_params["net_profile"]
+            )
+            self.logger.info(
+                "Network profile %s selected in %.2f s",
+                test_params["net_profile"],
+                switch_time,
+            )
+        camera = {
+            key: test_params[key] for key in reports.CAMERA_PARAMS if key in test_params
+        }
+        if camera:
+            switch_time = device.select_camera(ip_address, **camera)
+            self.logger.info(
+                "Camera buffers %s selected in %.2f s", camera, switch_time
             )
 
-        # Run control test if protocol specified
-        if test_params.get("control_protocol"):
-            results["control"] = control.test_control(
-                ip_address,
-                test_params["control_protocol"],
-                self.config["test_duration"],
-                self.logger,
+        # One /metrics snapshot on each side of the test feeds the counters of
+        # every feature the build has (allocations, hot paths, raw frames,
+        # encoders, motion detector)
+        metrics_before = (
+            device.get_metrics(ip_address)
+            if any(
+                test_params.get(key)
+                for key in (
+                    "alloc_counter",
+                    "profile_hot_paths",
+                    "raw_mode",
+                    "motion_adaptive",
+                )
+            )
+            or test_params.get("jpeg_encoder") == "software"
+            else None
+        )
+        camera_before = device.get_camera(ip_address) if camera else None
+        if start_barrier is not None:
+            start_barrier.wait()
+        results = self._run_repeated(ip_address, test_params)
+        if metrics_before is not None:
+            results.update(
+                reports.metrics_deltas(
+                    metrics_before,
+                    device.get_metrics(ip_address),
+                    self.config.get("alloc_budget", {}),
+                )
+            )
+            self._log_allocs(results.get("allocs"))
+        if test_params.get("jpeg_encoder"):
+            results["jpeg"] = self._jpeg_sample(ip_address)
+        if camera_before:
+            results["camera"] = reports.camera_delta(
+                camera_before, device.get_camera(ip_address)
             )
+        try:
+            results["tasks"] = device.get_tasks(ip_address)
+            results["network"] = device.get_network(ip_address)
+        except (OSError, ValueError) as e:
+            self.logger.debug("Could not read task stats: %s", str(e))
 
         # Save metrics to file
         metrics_dir = Path("results/metrics")
         metrics_dir.mkdir(parents=True, exist_ok=True)
+        device_id = (
+            target.device_id
+            if target.device_id != fleet.UNKNOWN_DEVICE
+            else self.config.get("device_id", store.UNKNOWN)
+        )
         metrics_file = metrics_dir / config.generate_file_name(
-            test_params, "metrics", "json"
+            test_params, "metrics", "json", device_id
         )
 
+        commit, dirty = store.git_commit()
+        corpus = self.config.get("corpus", store.DEFAULT_CORPUS)
         with open(metrics_file, "w", encoding="utf-8") as f:
-            json.dump({"parameters": test_params, "results": results}, f, indent=2)
+            json.dump(
+                {
+                    "parameters": test_params,
+                    "commit": commit,
+                    "dirty": dirty,
+                    "corpus": corpus,
+                    "device_id": device_id,
+                    "device_info": target.info,
+                    "boot": target.boot,
+                    "results": results,
+                },
+                f,
+                indent=2,
+            )
 
         self.logger.info("Metrics saved to: %s", metrics_file)
+        for run in results["runs"]:
+            self.store.add_run(
+                test_params,
+                run,
+                commit=commit,
+                dirty=dirty,
+                corpus=corpus,
+                device_id=device_id,
+                metrics_file=str(metrics_file),
+            )
 
         return results
 
+    def _run_once(self, ip_address: str, test_params: Dict[str, Any]) -> Dict[str, Any]:
+        """Run video and/or control test once."""
+        if (
+            test_params.get("concurrent")
+            and test_params.get("video_protocol")
+            and test_params.get("control_protocol")
+        ):
+            return self._run_concurrent(ip_address, test_params)
+
+        results = {}
+        reconnect_cfg = self.config.get("reconnect", {})
+        with ThreadPoolExecutor(max_workers=1) as executor:
+            # The link drops while the tests run, their streams have to resume
+            drop = (
+                executor.submit(
+                    recovery.test_reconnect,
+                    ip_address,
+                    reconnect_cfg.get("drop_ms", 2000),
+                    reconnect_cfg.get("delay", 3.0),
+                    reconnect_cfg.get("timeout", 30.0),
+                    self.logger,
+                )
+                if reconnect_cfg.get("enabled")
+                else None
+            )
+
+            # Run video test if protocol specified
+            if test_params.get("video_protocol"):
+                results["video"] = self._run_video(ip_address, test_params)
+
+            # Run control test if protocol specified
+            if test_params.get("control_protocol"):
+                results["control"] = self._run_control(ip_address, test_params)
+
+            if drop:
+                results["reconnect"] = drop.result()
+
+        # Snapshot pollers served from the last-frame cache
+        snapshot_cfg = self.config.get("snapshot", {})
+        if snapshot_cfg.get("enabled"):
+            results["snapshot"] = snapshot.test_snapshot(
+                ip_address,
+                self.config["test_duration"],
+                snapshot_cfg.get("pollers", 4),
+                snapshot_cfg.get("wait_ms", 0),
+                self.logger,
+            )
+        return results
+
+    def _run_repeated(
+        self, ip_address: str, test_params: Dict[str, Any]
+    ) -> Dict[str, Any]:
+        """Repeat test runs until the confidence targets are met.
+
+        The warmup of every run is detected from per-second FPS and the device
+        heap polled during the run, and is excluded from the statistics.
+
+        Args:
+            ip_address: Device IP address
+            test_params: Dictionary with test parameters
+
+        Returns:
+            Dictionary with results of every run and their summary
+        """
+        cfg = self.config.get("repetitions", {})
+        min_runs = cfg.get("min_runs", 1)
+        max_runs = max(cfg.get("max_runs", 1), min_runs)
+        confidence = cfg.get("confidence", 0.95)
+        targets = cfg.get("ci_targets", {})
+        warmup_cfg = cfg.get("warmup", {})
+
+        runs = []
+        summary = {}
+        for run_index in range(max_runs):
+            with device.MetricsPoller(ip_address) as poller:
+                run = self._run_once(ip_address, test_params)
+
+            fps = [
+                s["frames"] for s in run.get("video", {}).get("frames_per_second", [])
+            ]
+            # Per-second FPS starts after the skipped first second, align heap to it
+            warmup = stats.detect_warmup(
+                fps, poller.series("free_heap")[1:], **warmup_cfg
+            )
+            stats.apply_warmup(run, warmup["seconds"])
+            run["warmup"] = warmup
+            run["device_metrics"] = poller.samples
+            streams = device.stream_clients(poller.samples)
+            if streams:
+                run["streams"] = streams
+                stalls = sum(client.get("stalls", 0) for client in streams)
+                if stalls:
+                    self.logger.warning(
+                        "Video stalled %d times for %d ms in total",
+                        stalls,
+                        sum(client.get("stall_ms", 0) for client in streams),
+                    )
+            runs.append(run)
+
+            summary = stats.summarize_runs(runs, confidence)
+            self.logger.info(
+                "Run %d/%d: warmup %d s%s, %s",
+                run_index + 1,
+                max_runs,
+                warmup["seconds"],
+                "" if warmup["stable"] else " (no stable window)",
+                ", ".join(
+                    f"{name}={m['value']:.2f} ±{m['rel_halfwidth']:.1%}"
+                    for name, m in summary["metrics"].items()
+                    if name in targets
+                ),
+            )
+            if len(runs) >= min_runs and stats.converged(summary, targets):
+                break
+
+        summary["converged"] = stats.converged(summary, targets)
+        if not summary["converged"]:
+            self.logger.warning("Confidence targets not met after %d runs", len(runs))
+        return {"runs": runs, "summary": summary}
+
+    def _run_video(
+        self, ip_address: str, test_params: Dict[str, Any]
+    ) -> Dict[str, Any]:
+        """Run video test for current device state."""
+        return video.test_video(
+            ip_address,
+            test_params["video_protocol"],
+            test_params["resolution"],
+            test_params["quality"],
+            test_params.get("raw_mode", False),
+            self.config["test_duration"],
+            self.logger,
+            decode_frames=self.config.get("decode_frames", False),
+            viewer=self.config.get("viewer"),
+            use_raw_tiles=bool(test_params.get("raw_tiles")),
+        )
+
+    def _run_control(
+        self, ip_address: str, test_params: Dict[str, Any]
+    ) -> Dict[str, Any]:
+        """Run control test for current device state."""
+        return control.test_control(
+            ip_address,
+            test_params["control_protocol"],
+            self.config["test_duration"],
+            self.logger,
+        )
+
+    def _run_concurrent(
+        self, ip_address: str, test_params: Dict[str, Any]
+    ) -> Dict[str, Any]:
+        """Run video and control tests simultaneously and compare with solo runs.
+
+        Solo baselines are measured with the other transport disabled and are
+        reused for all tests on the same board, firmware variant and protocol.
+
+        Args:
+            ip_address: Device IP address
+            test_params: Dictionary with test parameters
+
+        Returns:
+            Dictionary with concurrent results, solo baselines and interference
+        """
+        video_protocol = test_params["video_protocol"]
+        control_protocol = test_params["control_protocol"]
+        variant = self.firmware.variant_hash(test_params)
+
+        video_key = ("video", ip_address, variant, video_protocol)
+        if video_key not in self._baselines:
+            self.logger.info("Measuring solo video baseline: %s", video_protocol)
+            device.select_transport(ip_address, video_protocol, None)
+            self._baselines[video_key] = self._run_video(ip_address, test_params)
+
+        control_key = ("control", ip_address, variant, control_protocol)
+        if control_key not in self._baselines:
+            self.logger.info("Measuring solo control baseline: %s", control_protocol)
+            device.select_transport(ip_address, None, control_protocol)
+            self._baselines[control_key] = self._run_control(ip_address, test_params)
+
+        self.logger.info(
+            "Running video %s and control %s concurrently",
+            video_protocol,
+            control_protocol,
+        )
+        device.select_transport(ip_address, video_protocol, control_protocol)
+
+        # Both tests start together and keep their own timing
+        barrier = threading.Barrier(2)
+
+        def synchronized(test):
+            barrier.wait()
+            return test(ip_address, test_params)
+
+        with ThreadPoolExecutor(max_workers=2) as executor:
+            video_future = executor.submit(synchronized, self._run_video)
+            control_future = executor.submit(synchronized, self._run_control)
+            concurrent = {
+                "video": video_future.result(),
+                "control": control_future.result(),
+            }
+
+        baseline = {
+            "video": self._baselines[video_key],
+            "control": self._baselines[control_key],
+        }
+        interference = compute_interference(baseline, concurrent)
+        interference["pair"] = f"{video_protocol}+{control_protocol}"
+        self.logger.info(
+            "Interference %s: FPS ratio %.2f, control p50 latency ratio %.2f",
+            interference["pair"],
+            interference["video"]["fps_ratio"],
+            interference["control"]["p50_ratio"],
+        )
+
+        return {**concurrent, "baseline": baseline, "interference": interference}
+
     def run_all_tests(self) -> List[Dict[str, Any]]:
         """Run all test combinations from config.
 
         Returns:
             List of dictionaries with test results
         """
+        combinations = self._generate_test_combinations()
+        self.firmware.build_all(combinations)
+
         results = []
-        for test_params in self._generate_test_combinations():
+        for test_params in combinations:
             try:
                 result = self.run_test_combination(test_params)
                 results.append({"params": test_params, "results": result})
             except Exception as e:
                 self.logger.error("Test failed: %s", str(e))
                 results.append({"params": test_params, "error": str(e)})
-        return results
 
-    def _build_and_flash(self) -> None:
-        """Build and flash firmware."""
-        self.logger.info("Building firmware...")
-        try:
-            # Prepare build flags based on current test parameters
-            build_flags = []
-            if hasattr(self, "current_test_params"):
-                if self.current_test_params.get("video_protocol"):
-                    build_flags.append(
-                        f"-DVIDEO_PROTOCOL={self.current_test_params['video_protocol']}"
-                    )
-                if self.current_test_params.get("control_protocol"):
-                    build_flags.append(
-                        f"-DCONTROL_PROTOCOL={self.current_test_params['control_protocol']}"
-                    )
-                if self.current_test_params.get("resolution"):
-                    build_flags.append(
-                        f"-DCAMERA_RESOLUTION={self.current_test_params['resolution']}"
-                    )
-                if self.current_test_params.get("quality"):
-                    build_flags.append(
-                        f"-DJPEG_QUALITY={self.current_test_params['quality']}"
-                    )
-                # Always set ENABLE_METRICS based on test_params
-                build_flags.append(
-                    f"-DENABLE_METRICS={1 if self.current_test_params.get('metrics') else 0}"
+        for key, name in (("task_profile", "task"), ("net_profile", "network")):
+            if any(r["params"].get(key) for r in results):
+                self._save_report(
+                    f"{name}_profiles",
+                    reports.profile_report(results, key),
+                    reports.profile_lines(name),
                 )
-                build_flags.append(
-                    f"-DRAW_MODE={1 if self.current_test_params.get('raw_mode') else 0}"
+        for wanted, name, report, lines in (
+            (
+                lambda r: r["params"].get("profile_hot_paths"),
+                "hot_paths",
+                reports.hot_path_report,
+                reports.hot_path_lines,
+            ),
+            (
+                lambda r: r.get("results", {}).get("camera"),
+                "camera_buffers",
+                reports.camera_buffer_report,
+                reports.camera_buffer_lines,
+            ),
+            (
+                lambda r: r["params"].get("raw_codec"),
+                "raw_codec",
+                reports.raw_codec_report,
+                reports.raw_codec_lines,
+            ),
+            (
+                lambda r: r["params"].get("raw_format", "rgb565") != "rgb565"
+                or r["params"].get("raw_scale", 1) > 1,
+                "raw_formats",
+                reports.raw_format_report,
+                reports.raw_format_lines,
+            ),
+            (
+                lambda r: r["params"].get("raw_tiles"),
+                "raw_tiles",
+                reports.raw_tile_report,
+                reports.raw_tile_lines,
+            ),
+            (
+                lambda r: r["params"].get("jpeg_encoder") == "software",
+                "jpeg_encoders",
+                reports.jpeg_encoder_report,
+                reports.jpeg_encoder_lines,
+            ),
+            (
+                lambda r: r["params"].get("motion_adaptive"),
+                "motion",
+                reports.motion_report,
+                reports.motion_lines,
+            ),
+        ):
+            if any(wanted(r) for r in results):
+                self._save_report(name, report(results), lines)
+        return results
+
+    def _jpeg_sample(self, ip_address: str) -> Dict[str, Any]:
+        """Read one frame from /capture for its size and estimated quality."""
+        frame = snapshot.SnapshotPoller(ip_address).poll()
+        if not frame:
+            return {}
+        return {"frame_bytes": len(frame), "quality": mjpeg.estimate_quality(frame)}
+
+    def run_motion_replay(self) -> Path:
+        """Replay a corpus with scripted motion through the motion detector.
+
+        The camera cannot be fed recorded frames, the replay runs the port of
+        the firmware detector on a synthetic corpus (motion_replay in the
+        config) with luma and with JPEG signatures.
+
+        Returns:
+            Path of the saved report
+        """
+        cfg = self.config.get("motion_replay", {})
+        detector = motion.MotionConfig(
+            **{
+                key: cfg[key]
+                for key in (
+                    "tile_threshold",
+                    "trigger_tiles",
+                    "min_interval_ms",
+                    "floor_interval_ms",
+                    "hold_ms",
                 )
+                if key in cfg
+            }
+        )
+        frames = list(
+            motion.synthetic_corpus(
+                width=cfg.get("width", 320),
+                height=cfg.get("height", 240),
+                seconds=cfg.get("seconds", 60.0),
+                interval_ms=detector.min_interval_ms,
+                events=cfg.get("events", motion.DEFAULT_EVENTS),
+            )
+        )
+        report = {
+            source: motion.evaluate_replay(
+                frames, detector, source, cfg.get("quality", 80)
+            )
+            for source in ("raw", "jpeg")
+        }
+
+        def log_line(source: str, result: Dict[str, Any]) -> List[str]:
+            return [
+                f"{source} signature: {result['sent']} of {result['frames']} frames "
+                f"sent, {result['bandwidth_saved'] * 100:.0f}% bandwidth saved, "
+                f"{result['missed_events']} events missed, max reaction latency "
+                f"{result['max_latency_ms']} ms"
+            ]
+
+        return self._save_report("motion_replay", report, log_line)
+
+    def run_tile_replay(self) -> Path:
+        """Replay a corpus through the changed-tile coder in every raw format.
+
+        The camera cannot be fed recorded frames, the replay runs the port of
+        the firmware encoder and the host composer on the synthetic corpus of
+        the motion replay (tile_replay in the config).
+
+        Returns:
+            Path of the saved report
+        """
+        cfg = self.config.get("tile_replay", {})
+        coder = raw_tiles.TileConfig(
+            **{
+                key: cfg[key]
+                for key in ("tile_size", "threshold", "refresh_frames", "packet_size")
+                if key in cfg
+            }
+        )
+        frames = list(
+            motion.synthetic_corpus(
+                width=cfg.get("width", 320),
+                height=cfg.get("height", 240),
+                seconds=cfg.get("seconds", 60.0),
+                interval_ms=cfg.get("interval_ms", 100),
+                events=cfg.get("events", motion.DEFAULT_EVENTS),
+            )
+        )
+        link_mbps = cfg.get("link_mbps", 8.0)
+        report = {
+            fmt: raw_tiles.evaluate_replay(frames, coder, fmt, link_mbps)
+            for fmt in cfg.get("formats", raw_tiles.FORMATS)
+        }
+
+        def log_line(fmt: str, result: Dict[str, Any]) -> List[str]:
+            return [
+                f"{fmt}: {result['tile_bytes']:.0f} bytes/frame as tiles vs "
+                f"{result['frame_bytes']:.0f} whole "
+                f"({result['bytes_saved'] * 100:.0f}% saved), "
+                f"{result['tile_fps']:.1f} vs {result['frame_fps']:.1f} raw FPS at "
+                f"{link_mbps} Mbit/s, max tile error {result['max_tile_error']:.2f}"
+            ]
 
-            # Set environment variable with build flags
-            env = os.environ.copy()
-            if build_flags:
-                env["PLATFORMIO_BUILD_FLAGS"] = " ".join(build_flags)
-                self.logger.info("Build flags: %s", env["PLATFORMIO_BUILD_FLAGS"])
+        return self._save_report("tile_replay", report, log_line)
 
-            # Find ESP32 port
+    def _log_allocs(self, allocs: Optional[Dict[str, Any]]) -> None:
+        """Report scopes of a test over their allocation budget."""
+        for scope in (allocs or {}).get("over_budget", []):
+            self.logger.error(
+                "Heap allocations per %s: %.2f (%d in %d)",
+                scope,
+                allocs[scope]["mean"],
+                allocs[scope]["allocs"],
+                allocs[scope]["count"],
+            )
+
+    def _save_report(
+        self,
+        name: str,
+        report: Dict[str, Any],
+        log_line: Callable[[str, Dict[str, Any]], List[str]],
+    ) -> Path:
+        """Save a report to <results_dir>/<name>_<time>.json and log its variants.
+
+        Args:
+            name: Report name, the prefix of the file
+            report: Report by variant
+            log_line: Gives the log lines of one variant of the report
+
+        Returns:
+            Path of the saved report
+        """
+        output_dir = Path(self.config.get("results_dir", "results"))
+        output_dir.mkdir(parents=True, exist_ok=True)
+        output = output_dir / f"{name}_{datetime.now().strftime('%Y%m%d_%H%M%S')}.json"
+        with open(output, "w", encoding="utf-8") as f:
+            json.dump(report, f, indent=2)
+
+        for variant, entry in report.items():
+            for line in log_line(variant, entry):
+                self.logger.info(line)
+        self.logger.info("Report %s saved to %s", name, output)
+        return output
+
+    def _default_device(self) -> fleet.DeviceHandle:
+        """Get the board used when no target is given.
+
+        The first board on a serial port, or the first board that answers
+        discovery when none is connected over USB.
+        """
+        if self._device is None:
             port = serial.find_esp_port()
-            if not port:
-                raise RuntimeError("ESP32-CAM not found")
-
-            # Select build environment based on metrics
-            build_env = (
-                "esp32cam_with_metrics"
-                if self.current_test_params.get("metrics")
-                else "esp32cam"
+            if port:
+                self._device = fleet.DeviceHandle(port=port)
+            else:
+                beacons = discovery.listen(**self._discovery_args())
+                if not beacons:
+                    raise RuntimeError("ESP32-CAM not found")
+                beacon = min(beacons.values(), key=lambda b: b["device_id"])
+                self._device = fleet.DeviceHandle(ip=beacon["ip"])
+                self._device.identify()
+        return self._device
+
+    def _discovery_args(self) -> Dict[str, Any]:
+        discovery_cfg = self.config.get("discovery", {})
+        return {
+            "timeout": discovery_cfg.get("timeout", 3.0),
+            "port": discovery_cfg.get("port", discovery.DISCOVERY_PORT),
+        }
+
+    def _device_ip(self, target: fleet.DeviceHandle) -> str:
+        """Get IP of a board from its discovery beacon, or its serial log."""
+        if target.ip and target.identify():
+            return target.ip
+
+        discovery_cfg = self.config.get("discovery", {})
+        flashed_at = target.boot.pop("flashed_at", None)
+        if discovery_cfg.get("enabled", True) and (
+            target.mac or target.device_id != fleet.UNKNOWN_DEVICE
+        ):
+
+            def booted(beacon: discovery.Beacon) -> bool:
+                # After a flash only beacons of the new boot count
+                fresh = (
+                    flashed_at is None
+                    or beacon["uptime_ms"] <= (time.time() - flashed_at + 2) * 1000
+                )
+                return target.matches(beacon) and fresh
+
+            beacon = discovery.wait_for_beacon(
+                booted,
+                discovery_cfg.get("boot_timeout", 30.0),
+                discovery_cfg.get("port", discovery.DISCOVERY_PORT),
+            )
+            if beacon:
+                target.ip = beacon["ip"]
+                if flashed_at is not None:
+                    target.boot.update(
+                        ready_ms=beacon.get("ready_ms"),
+                        host_ready_s=beacon["received_at"] - flashed_at,
+                    )
+                    self.logger.info(
+                        "Board %s ready %.1f s after flashing (%s ms after boot)",
+                        target.name,
+                        target.boot["host_ready_s"],
+                        target.boot["ready_ms"],
+                    )
+                target.identify()
+                if flashed_at is not None:
+                    self._record_first_frame(target, flashed_at)
+                return target.ip
+            self.logger.warning("No discovery beacon from %s", target.name)
+
+        if not target.port:
+            raise RuntimeError(f"Board {target.name} is not reachable")
+
+        # Wait for device to initialize and get IP
+        target.ip = serial.wait_for_ip(target.port)
+        if not target.ip:
+            raise RuntimeError("Failed to get device IP address")
+        target.identify()
+        if flashed_at is not None:
+            target.boot.update(
+                ready_ms=target.info.get("ready_ms"),
+                host_ready_s=time.time() - flashed_at,
             )
-            self.logger.info("Using build environment: %s", build_env)
-
-            # Build and upload in one command
-            self.logger.info("Building and flashing firmware...")
-            subprocess.run(
-                ["pio", "run", "-e", build_env, "-t", "upload", "--upload-port", port],
-                env=env,
-                check=True,
+            self._record_first_frame(target, flashed_at)
+        return target.ip
+
+    def _record_first_frame(self, target: fleet.DeviceHandle, since: float) -> None:
+        """Record time to first frame after a boot and how WiFi was joined."""
+        timeout = self.config.get("reconnect", {}).get("timeout", 30.0)
+        target.boot["first_frame_s"] = recovery.first_frame_time(
+            target.ip, since, timeout
+        )
+        try:
+            wifi = device.get_wifi(target.ip)
+            target.boot["wifi_connect_ms"] = wifi.get("connect_ms")
+            target.boot["wifi_fast_connect"] = wifi.get("fast_connect")
+        except (OSError, ValueError) as e:
+            self.logger.debug("Could not read WiFi state: %s", str(e))
+        if target.boot["first_frame_s"] is None:
+            self.logger.warning("No frame from %s after boot", target.name)
+            return
+        self.logger.info(
+            "First frame from %s %.1f s after boot (WiFi joined in %s ms)",
+            target.name,
+            target.boot["first_frame_s"],
+            target.boot.get("wifi_connect_ms"),
+        )
+
+    def _build_and_flash(
+        self, test_params: Dict[str, Any], target: fleet.DeviceHandle
+    ) -> None:
+        """Install cached firmware for test parameters, building it if needed.
+
+        Boards with a known IP are updated over OTA, the serial port is only
+        used for the first flash and when OTA fails.
+        """
+        variant = self.firmware.variant_hash(test_params)
+        if target.info.get("build_hash") == variant or (
+            target.port and self.firmware.is_flashed(test_params, target.port)
+        ):
+            self.logger.info("Firmware already on %s", target.name)
+            return
+
+        start_time = time.time()
+        if target.ip and self.config.get("ota", {}).get("enabled", True):
+            try:
+                self._push_ota(test_params, target)
+                return
+            except (ota.OTAError, OSError) as e:
+                if not target.port:
+                    raise RuntimeError(
+                        f"OTA update of {target.name} failed: {str(e)}"
+                    ) from e
+                self.logger.warning(
+                    "OTA update of %s failed, flashing over serial: %s",
+                    target.name,
+                    str(e),
+                )
+
+        if not target.port:
+            self.logger.info(
+                "Board %s has no serial port, using its running firmware", target.name
             )
+            return
 
-        except subprocess.CalledProcessError as e:
-            raise RuntimeError(f"Failed to build/flash firmware: {e}") from e
+        variant = self.firmware.flash(test_params, target.port)
+        # The board reboots, its IP comes from the next beacon
+        target.ip = None
+        target.info = {}
+        target.mac = self.firmware.macs.get(target.port, target.mac)
+        target.boot = {"method": "serial", "flashed_at": time.time()}
+        self.logger.info(
+            "Firmware variant %s ready on %s in %.1f s",
+            variant,
+            target.name,
+            time.time() - start_time,
+        )
+
+    def _push_ota(
+        self, test_params: Dict[str, Any], target: fleet.DeviceHandle
+    ) -> None:
+        """Update a board over OTA and verify the build it runs afterwards."""
+        image = self.firmware.firmware_image(test_params)
+        variant = self.firmware.variant_hash(test_params)
+        ota_cfg = self.config.get("ota", {})
+        # Stop streaming so the upload gets the whole link
+        try:
+            device.select_transport(target.ip, None, None)
+        except (RuntimeError, OSError) as e:
+            self.logger.debug("Could not stop transports: %s", str(e))
+
+        self.logger.info("Pushing firmware variant %s to %s", variant, target.name)
+        result = ota.push_firmware(
+            target.ip,
+            image,
+            variant,
+            chunk_size=ota_cfg.get("chunk_size", 32768),
+            retries=ota_cfg.get("retries", 5),
+            boot_timeout=ota_cfg.get("boot_timeout", 60),
+            logger=self.logger,
+        )
+        target.info = result["info"]
+        target.device_id = target.info.get("device_id", target.device_id)
+        target.boot = {
+            "method": "ota",
+            "ready_ms": target.info.get("ready_ms"),
+            "host_ready_s": result["boot_time"],
+        }
+        self._record_first_frame(target, time.time() - result["boot_time"])
+        self.firmware.mark_flashed(target.port, variant)
+        self.logger.info(
+            "Firmware variant %s ready on %s in %.1f s over OTA",
+            variant,
+            target.name,
+            result["upload_time"] + result["boot_time"],
+        )
+
+    def run_fleet(
+        self,
+        devices: Optional[List[fleet.DeviceHandle]] = None,
+        contention: bool = False,
+    ) -> List[Dict[str, Any]]:
+        """Run all test combinations on several boards in parallel.
+
+        Without contention the matrix is sharded across boards by firmware
+        variant and every board runs its shard. With contention every
+        combination runs on all boards at once, so that they share the
+        channel of one access point.
+
+        Args:
+            devices: Boards to use, discovered if None
+            contention: Run every combination on all boards simultaneously
+
+        Returns:
+            List of dictionaries with test results and board identity
+        """
+        devices = devices or fleet.discover_devices(self.config, self.logger)
+        if not devices:
+            raise RuntimeError("ESP32-CAM not found")
+
+        combinations = self._generate_test_combinations()
+        self.firmware.build_all(combinations)
+
+        def run(test_params, handle, barrier=None):
+            try:
+                result = self.run_test_combination(
+                    test_params, target=handle, start_barrier=barrier
+                )
+                return {
+                    "params": test_params,
+                    "device_id": handle.device_id,
+                    "results": result,
+                }
+            except Exception as e:
+                self.logger.error("Test on %s failed: %s", handle.name, str(e))
+                if barrier is not None:
+                    barrier.abort()
+                return {
+                    "params": test_params,
+                    "device_id": handle.device_id,
+                    "error": str(e),
+                }
+
+        results = []
+        with ThreadPoolExecutor(max_workers=len(devices)) as executor:
+            if contention:
+                for test_params in combinations:
+                    params = {**test_params, "contention": len(devices)}
+                    barrier = threading.Barrier(len(devices))
+                    futures = [
+                        executor.submit(run, params, handle, barrier)
+                        for handle in devices
+                    ]
+                    results.extend(f.result() for f in futures)
+            else:
+                shards = fleet.shard(
+                    combinations, len(devices), self.firmware.variant_hash
+                )
+                futures = [
+                    executor.submit(lambda h, s: [run(p, h) for p in s], handle, part)
+                    for handle, part in zip(devices, shards)
+                ]
+                for future in futures:
+                    results.extend(future.result())
+        return results
 
     def _generate_test_combinations(self) -> List[Dict[str, Any]]:
         """Generate all test combinations from config.
@@ -183,8 +963,9 @@ class ESPCamBenchmark:
         """
         combinations = []
         cfg = self.config["test_combinations"]
+        concurrent = cfg.get("concurrent", False)
 
-        for protocol in cfg["video_protocols"]:
+        for protocol in cfg.get("video_protocols", self.config["video_protocols"]):
             for resolution in cfg["resolutions"]:
                 for quality in cfg["qualities"]:
                     for ctrl_protocol in cfg["control_protocols"]:
@@ -193,16 +974,69 @@ class ESPCamBenchmark:
                             if raw_mode and protocol == "HTTP":
                                 continue
 
-                            combinations.append(
-                                {
-                                    "video_protocol": protocol,
-                                    "resolution": resolution,
-                                    "quality": quality,
-                                    "control_protocol": ctrl_protocol,
-                                    "metrics": True,
-                                    "raw_mode": raw_mode,
-                                }
-                            )
+                            test_params = {
+                                "video_protocol": protocol,
+                                "resolution": resolution,
+                                "quality": quality,
+                                "control_protocol": ctrl_protocol,
+                                "metrics": True,
+                                "raw_mode": raw_mode,
+                                "concurrent": concurrent,
+                            }
+                            if cfg.get("alloc_counter"):
+                                test_params["alloc_counter"] = True
+                            if cfg.get("profile_hot_paths"):
+                                test_params["profile_hot_paths"] = True
+                            # Task and network profiles and frame buffers are
+                            # switched at runtime, one image serves all of them;
+                            # IRAM placement of the hot paths, raw formats,
+                            # downscaling, the raw frame codec, changed
+                            # tiles, the JPEG encoder and the motion-adaptive
+                            # rate are firmware variants
+                            axes = {
+                                "task_profile": cfg.get("task_profiles"),
+                                "net_profile": cfg.get("net_profiles"),
+                                "hot_path_iram": cfg.get("hot_path_iram"),
+                                "raw_format": cfg.get("raw_formats")
+                                if raw_mode
+                                else None,
+                                "raw_scale": cfg.get("raw_scales")
+                                if raw_mode
+                                else None,
+                                "raw_codec": cfg.get("raw_codec") if raw_mode else None,
+                                "raw_tiles": (
+                                    cfg.get("raw_tiles")
+                                    if raw_mode and protocol == "UDP"
+                                    else None
+                                ),
+                                "jpeg_encoder": (
+                                    None if raw_mode else cfg.get("jpeg_encoders")
+                                ),
+                                "motion_adaptive": cfg.get("motion_adaptive"),
+                                "fb_count": cfg.get("fb_counts"),
+                                "fb_location": cfg.get("fb_locations"),
+                                "grab_mode": cfg.get("grab_modes"),
+                            }
+                            for values in itertools.product(
+                                *(axis or [None] for axis in axes.values())
+                            ):
+                                profiles = dict(zip(axes, values))
+                                # The raw frame codec compresses RGB565 only
+                                raw_format = profiles["raw_format"] or "rgb565"
+                                if profiles["raw_codec"] and raw_format != "rgb565":
+                                    continue
+                                # Tiles carry raw pixels, not codec output
+                                if profiles["raw_codec"] and profiles["raw_tiles"]:
+                                    continue
+                                combinations.append(
+                                    dict(
+                                        test_params,
+                                        **{k: v for k, v in profiles.items() if v},
+                                    )
+                                )
+
+        # Group tests by firmware variant so each image is flashed once
+        combinations.sort(key=self.firmware.variant_hash)
         return combinations
 
     def build_firmware(
@@ -4,7 +4,8 @@ import argparse
 import json
 import sys
 
-from . import ESPCamBenchmark
+from . import ESPCamBenchmark, search
+from .utils import store
 
 
 def parse_args():
@@ -43,6 +44,57 @@ def parse_args():
         action="store_true",
         help="Skip firmware build and flash, only run tests",
     )
+    parser.add_argument(
+        "--concurrent",
+        action="store_true",
+        help="Run video and control simultaneously and compare with solo baselines",
+    )
+    parser.add_argument(
+        "--build-jobs", type=int, help="Number of parallel firmware builds"
+    )
+    parser.add_argument(
+        "--build-only",
+        action="store_true",
+        help="Build all firmware variants into the cache without running tests",
+    )
+    parser.add_argument(
+        "--compare",
+        nargs=2,
+        metavar=("BASE", "HEAD"),
+        help="Compare stored results of two git commits and flag regressions",
+    )
+    parser.add_argument(
+        "--ingest",
+        nargs="+",
+        metavar="METRICS_JSON",
+        help="Import metrics JSON files into the results store",
+    )
+    parser.add_argument(
+        "--fleet",
+        action="store_true",
+        help="Run the test matrix on all discovered boards in parallel",
+    )
+    parser.add_argument(
+        "--contention",
+        action="store_true",
+        help="With --fleet, run every test on all boards at once",
+    )
+    parser.add_argument(
+        "--search",
+        action="store_true",
+        help="Search the Pareto frontier instead of running all combinations",
+    )
+    parser.add_argument("--budget", type=int, help="Maximum number of search runs")
+    parser.add_argument(
+        "--motion-replay",
+        action="store_true",
+        help="Replay a corpus with scripted motion through the motion detector",
+    )
+    parser.add_argument(
+        "--tile-replay",
+        action="store_true",
+        help="Replay a corpus through the changed-tile coder of raw frames",
+    )
     return parser.parse_args()
 
 
@@ -50,6 +102,71 @@ def main():
     """Main entry point"""
     args = parse_args()
     benchmark = ESPCamBenchmark()
+    if args.build_jobs:
+        benchmark.firmware.jobs = args.build_jobs
+    if args.concurrent:
+        benchmark.config["test_combinations"]["concurrent"] = True
+
+    if args.ingest:
+        for path in args.ingest:
+            benchmark.store.ingest_file(path)
+        print(f"Ingested {len(args.ingest)} result files")
+        sys.exit(0)
+
+    if args.compare:
+        compare_cfg = benchmark.config.get("compare", {})
+        try:
+            comparisons = benchmark.store.compare(
+                *args.compare,
+                corpus=benchmark.config.get("corpus", store.DEFAULT_CORPUS),
+                alpha=compare_cfg.get("alpha", 0.05),
+                min_effect=compare_cfg.get("min_effect", 0.05),
+            )
+        except ValueError as e:
+            print(f"Error: {str(e)}")
+            sys.exit(1)
+        print(store.format_comparison(comparisons))
+        regressions = sum(
+            stats["status"] == "regression"
+            for comparison in comparisons
+            for stats in comparison["metrics"].values()
+        )
+        print(
+            f"\n{len(comparisons)} parameter sets compared, {regressions} regressions"
+        )
+        sys.exit(1 if regressions else 0)
+
+    if args.motion_replay:
+        output = benchmark.run_motion_replay()
+        print(f"Motion replay report saved to {output}")
+        sys.exit(0)
+
+    if args.tile_replay:
+        output = benchmark.run_tile_replay()
+        print(f"Tile replay report saved to {output}")
+        sys.exit(0)
+
+    if args.search:
+        output = search.run_search(benchmark, args.budget)
+        print(f"Pareto frontier saved to {output}")
+        sys.exit(0)
+
+    if args.fleet:
+        try:
+            results = benchmark.run_fleet(
+                contention=args.contention
+                or benchmark.config.get("fleet", {}).get("contention", False)
+            )
+        except Exception as e:
+            print(f"\nError: {str(e)}")
+            sys.exit(1)
+        failed = sum(1 for r in results if "error" in r)
+        print(f"Fleet run finished: {len(results)} tests, {failed} failed")
+        sys.exit(1 if failed else 0)
+
+    if args.build_only:
+        errors = benchmark.firmware.build_all(benchmark._generate_test_combinations())
+        sys.exit(1 if errors else 0)
 
     if args.single_test:
         if not all([args.video_protocol, args.resolution, args.quality]):
@@ -57,7 +174,8 @@ def main():
             print("  --video-protocol, --resolution, --quality")
             print("Optional parameters:")
             print(
-                "  --control-protocol, --metrics, --raw-mode, --duration, --skip-build"
+                "  --control-protocol, --metrics, --raw-mode, --concurrent,"
+                " --duration, --skip-build"
             )
             sys.exit(1)
 
@@ -72,6 +190,7 @@ def main():
             "quality": args.quality,
             "metrics": args.metrics,
             "raw_mode": args.raw_mode,
+            "concurrent": args.concurrent,
         }
 
         if args.duration:
@@ -24,6 +24,7 @@ def test_control(
     logger.info("Starting control protocol test: protocol=%s", protocol)
     metrics = {
         "latency": [],
+        "latency_offsets_s": [],  # send time of each command since test start
         "success_rate": 0,
         "errors": [],
         "commands_per_second": [],
@@ -93,6 +94,7 @@ def test_control(
                 # Calculate metrics
                 latency = (cmd_end - cmd_start) * 1000  # Convert to ms
                 metrics["latency"].append(latency)
+                metrics["latency_offsets_s"].append(round(cmd_start - start_time, 3))
                 commands_sent += 1
 
                 # Track commands per second
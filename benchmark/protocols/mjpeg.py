@@ -0,0 +1,377 @@
+"""Decode-free MJPEG stream reader for ESP32-CAM benchmark.
+
+Reads the multipart/x-mixed-replace stream straight from the socket,
+timestamps every part on arrival, counts exact wire bytes, validates JPEG
+markers and stores the raw JPEG bytes without transcoding. Decoding is
+optional and runs in a worker pool off the measurement path.
+"""
+
+import socket
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+from dataclasses import dataclass
+from typing import Any, BinaryIO, Dict, List, Optional, Tuple
+from urllib.parse import urlparse
+
+import cv2
+import numpy as np
+
+JPEG_SOI = b"\xff\xd8"
+JPEG_EOI = b"\xff\xd9"
+RECV_SIZE = 64 * 1024
+
+# Luminance quantization table of the JPEG standard (Annex K), quality 50 in IJG terms
+STD_LUMINANCE_SUM = sum(
+    [16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55]
+    + [14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62]
+    + [18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92]
+    + [49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99]
+)
+
+
+@dataclass
+class MJPEGPart:
+    """Single part of the multipart stream."""
+
+    data: bytes
+    start_time: float  # arrival of the first byte of the part
+    end_time: float  # arrival of the last byte of the part
+
+    @property
+    def valid(self) -> bool:
+        """Check that the part is a complete JPEG image."""
+        return self.data[:2] == JPEG_SOI and self.data[-2:] == JPEG_EOI
+
+
+class ChunkedDecoder:
+    """Incremental decoder of HTTP/1.1 chunked transfer encoding."""
+
+    def __init__(self):
+        self._buf = bytearray()
+        self._remaining = 0
+        self._skip_crlf = False
+        self.finished = False
+
+    def feed(self, data: bytes) -> bytes:
+        """Feed raw socket data and return decoded body bytes."""
+        self._buf += data
+        out = bytearray()
+        while self._buf and not self.finished:
+            if self._remaining:
+                take = min(self._remaining, len(self._buf))
+                out += self._buf[:take]
+                del self._buf[:take]
+                self._remaining -= take
+                if not self._remaining:
+                    self._skip_crlf = True
+                continue
+            if self._skip_crlf:
+                if len(self._buf) < 2:
+                    break
+                del self._buf[:2]
+                self._skip_crlf = False
+                continue
+            end = self._buf.find(b"\r\n")
+            if end < 0:
+                break
+            size = int(bytes(self._buf[:end]).split(b";")[0], 16)
+            del self._buf[: end + 2]
+            if size == 0:
+                self.finished = True
+            self._remaining = size
+        return bytes(out)
+
+
+class MultipartParser:
+    """Incremental parser of multipart/x-mixed-replace bodies."""
+
+    def __init__(self, boundary: str):
+        self.boundary = b"--" + boundary.encode()
+        self._buf = bytearray()
+        self._length: Optional[int] = None
+        self._in_body = False
+        self._part_start: Optional[float] = None
+
+    def feed(self, data: bytes, timestamp: float) -> List[MJPEGPart]:
+        """Feed body bytes received at timestamp and return completed parts."""
+        if data and self._part_start is None:
+            self._part_start = timestamp
+        self._buf += data
+
+        parts = []
+        while True:
+            if not self._in_body and not self._parse_headers():
+                break
+            part = self._parse_body(timestamp)
+            if part is None:
+                break
+            parts.append(part)
+            self._part_start = timestamp if self._buf else None
+        return parts
+
+    def _parse_headers(self) -> bool:
+        start = self._buf.find(self.boundary)
+        if start < 0:
+            return False
+        end = self._buf.find(b"\r\n\r\n", start)
+        if end < 0:
+            return False
+
+        self._length = None
+        for line in bytes(self._buf[start:end]).split(b"\r\n")[1:]:
+            name, _, value = line.partition(b":")
+            if name.strip().lower() == b"content-length":
+                self._length = int(value.strip())
+        del self._buf[: end + 4]
+        self._in_body = True
+        return True
+
+    def _parse_body(self, timestamp: float) -> Optional[MJPEGPart]:
+        if self._length is not None:
+            if len(self._buf) < self._length:
+                return None
+            length = self._length
+        else:
+            length = self._buf.find(b"\r\n" + self.boundary)
+            if length < 0:
+                return None
+
+        data = bytes(self._buf[:length])
+        del self._buf[:length]
+        self._in_body = False
+        start = timestamp if self._part_start is None else self._part_start
+        return MJPEGPart(data, start, timestamp)
+
+
+class FrameDecoder:
+    """Decodes JPEG frames in a worker pool without blocking the reader.
+
+    Frames arriving while all workers are busy are not decoded and are
+    counted as skipped, so decoding never slows down the measurement.
+    """
+
+    def __init__(self, workers: int = 2):
+        self._executor = ThreadPoolExecutor(max_workers=workers)
+        self._slots = threading.BoundedSemaphore(workers * 2)
+        self._lock = threading.Lock()
+        self.decoded = 0
+        self.failed = 0
+        self.skipped = 0
+        self.resolutions: Dict[str, int] = {}
+
+    def submit(self, data: bytes) -> None:
+        """Queue frame for decoding if a worker slot is free."""
+        if not self._slots.acquire(blocking=False):
+            self.skipped += 1
+            return
+        self._executor.submit(self._decode, data)
+
+    def _decode(self, data: bytes) -> None:
+        try:
+            frame = cv2.imdecode(np.frombuffer(data, np.uint8), cv2.IMREAD_COLOR)
+            with self._lock:
+                if frame is None:
+                    self.failed += 1
+                else:
+                    self.decoded += 1
+                    key = f"{frame.shape[1]}x{frame.shape[0]}"
+                    self.resolutions[key] = self.resolutions.get(key, 0) + 1
+        finally:
+            self._slots.release()
+
+    def close(self) -> Dict[str, Any]:
+        """Wait for pending frames and return decode statistics."""
+        self._executor.shutdown(wait=True)
+        return {
+            "decoded": self.decoded,
+            "failed": self.failed,
+            "skipped": self.skipped,
+            "resolutions": self.resolutions,
+        }
+
+
+class MJPEGStreamReader:
+    """Reads an MJPEG over HTTP stream part by part."""
+
+    def __init__(self, url: str, timeout: float = 5.0):
+        self.url = urlparse(url)
+        self.timeout = timeout
+        self.wire_bytes = 0
+        self._sock: Optional[socket.socket] = None
+        self._chunked: Optional[ChunkedDecoder] = None
+        self._parser: Optional[MultipartParser] = None
+        self._pending = b""
+
+    def open(self) -> None:
+        """Connect and read HTTP response headers.
+
+        Raises:
+            RuntimeError: If the server does not return a multipart stream
+        """
+        host = self.url.hostname
+        port = self.url.port or 80
+        path = self.url.path or "/"
+        if self.url.query:
+            path += "?" + self.url.query
+
+        self._sock = socket.create_connection((host, port), timeout=self.timeout)
+        self._sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1024 * 1024)
+        self._sock.sendall(
+            f"GET {path} HTTP/1.1\r\nHost: {host}\r\nConnection: keep-alive\r\n\r\n".encode()
+        )
+
+        head = b""
+        while b"\r\n\r\n" not in head:
+            data = self._recv()
+            if not data:
+                raise RuntimeError("Connection closed before response headers")
+            head += data
+        head, _, self._pending = head.partition(b"\r\n\r\n")
+
+        status, headers = _parse_response_head(head)
+        if status != 200:
+            raise RuntimeError(f"Video stream returned HTTP {status}")
+
+        content_type = headers.get("content-type", "")
+        boundary = None
+        for param in content_type.split(";")[1:]:
+            name, _, value = param.strip().partition("=")
+            if name.lower() == "boundary":
+                boundary = value.strip('"')
+        if not content_type.startswith("multipart/") or not boundary:
+            raise RuntimeError(f"Not a multipart stream: {content_type}")
+
+        if headers.get("transfer-encoding", "").lower() == "chunked":
+            self._chunked = ChunkedDecoder()
+        self._parser = MultipartParser(boundary)
+
+    def read_parts(self) -> List[MJPEGPart]:
+        """Block until data arrives and return the parts it completed.
+
+        Returns:
+            List of completed parts, empty if the data did not finish a part
+
+        Raises:
+            ConnectionError: If the stream is closed by the device
+        """
+        if self._pending:
+            data, self._pending = self._pending, b""
+        else:
+            data = self._recv()
+            if not data:
+                raise ConnectionError("Video stream closed")
+        timestamp = time.perf_counter()
+
+        if self._chunked is not None:
+            data = self._chunked.feed(data)
+            if self._chunked.finished:
+                raise ConnectionError("Video stream finished")
+        return self._parser.feed(data, timestamp)
+
+    def close(self) -> None:
+        """Close the connection."""
+        if self._sock is not None:
+            self._sock.close()
+            self._sock = None
+
+    def _recv(self) -> bytes:
+        data = self._sock.recv(RECV_SIZE)
+        self.wire_bytes += len(data)
+        return data
+
+
+def estimate_quality(frame: bytes) -> Optional[float]:
+    """Estimate the IJG quality (1-100) of a JPEG frame from its luminance table.
+
+    The sensor encoder and the software encoder use different quality
+    scales; their quantization tables put both on the same one.
+
+    Args:
+        frame: JPEG frame
+
+    Returns:
+        Estimated quality, None if the frame has no luminance table
+    """
+    pos = 2
+    while pos + 4 <= len(frame) and frame[pos] == 0xFF:
+        marker = frame[pos + 1]
+        length = int.from_bytes(frame[pos + 2 : pos + 4], "big")
+        if marker == 0xDA:  # start of scan, tables come before it
+            break
+        if marker == 0xDB:
+            table = pos + 4
+            while table < pos + 2 + length:
+                precision, table_id = frame[table] >> 4, frame[table] & 0x0F
+                size = 128 if precision else 64
+                if table_id == 0:
+                    values = frame[table + 1 : table + 1 + size]
+                    if precision:
+                        values = [
+                            int.from_bytes(values[i : i + 2], "big")
+                            for i in range(0, size, 2)
+                        ]
+                    scale = sum(values) * 100 / STD_LUMINANCE_SUM
+                    quality = 100 - scale / 2 if scale <= 100 else 5000 / scale
+                    return max(1.0, min(100.0, quality))
+                table += 1 + size
+        pos += 2 + length
+    return None
+
+
+def _parse_response_head(head: bytes) -> Tuple[int, Dict[str, str]]:
+    """Parse HTTP status line and headers."""
+    lines = head.decode("latin-1").split("\r\n")
+    status = int(lines[0].split()[1])
+    headers = {}
+    for line in lines[1:]:
+        name, _, value = line.partition(":")
+        headers[name.strip().lower()] = value.strip()
+    return status, headers
+
+
+def capture_mjpeg(
+    url: str,
+    output: BinaryIO,
+    duration: float,
+    decoder: Optional[FrameDecoder] = None,
+) -> Dict[str, Any]:
+    """Capture an MJPEG stream for the given duration.
+
+    Args:
+        url: Stream URL
+        output: Binary file receiving the raw JPEG bytes
+        duration: Capture duration in seconds
+        decoder: Optional decoder for frames
+
+    Returns:
+        Dictionary with connection time, start time, wire bytes and parts
+    """
+    reader = MJPEGStreamReader(url)
+    connection_start = time.perf_counter()
+    reader.open()
+    start_time = time.perf_counter()
+
+    parts = []
+    try:
+        while (time.perf_counter() - start_time) < duration:
+            for part in reader.read_parts():
+                # Only the arrival metadata is kept in memory
+                parts.append(
+                    (part.start_time, part.end_time, len(part.data), part.valid)
+                )
+                output.write(part.data)
+                if decoder is not None and part.valid:
+                    decoder.submit(part.data)
+    except (ConnectionError, socket.timeout):
+        pass
+    finally:
+        reader.close()
+
+    return {
+        "connection_time": start_time - connection_start,
+        "start_time": start_time,
+        "end_time": time.perf_counter(),
+        "wire_bytes": reader.wire_bytes,
+        "parts": parts,
+    }
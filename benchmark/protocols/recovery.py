@@ -0,0 +1,117 @@
+"""Link recovery measurements for ESP32-CAM benchmark.
+
+Time to first frame is measured on the host, from a reboot or a WiFi link
+drop until /capture returns a frame newer than the last one seen. The device
+keeps its camera and transports through a link drop; viewers connected
+before the drop are looked up in /metrics afterwards to see whether their
+streams resumed.
+"""
+
+import time
+from typing import Any, Dict, Optional, Set, Tuple
+
+import requests
+
+from ..utils import device
+from .snapshot import SnapshotPoller
+
+# Delay between the answer to POST /wifi and the disconnect (WIFI_DROP_DELAY_MS)
+DROP_DELAY_S = 0.2
+
+
+def first_frame_time(
+    ip_address: str, since: float, timeout: float = 30.0, after_frame: int = 0
+) -> Optional[float]:
+    """Wait for the first frame the device serves.
+
+    Args:
+        ip_address: Device IP address
+        since: Start of the measurement (time.time())
+        timeout: Maximum time to wait in seconds
+        after_frame: Only frames with a higher number count, 0 for any frame
+
+    Returns:
+        Seconds from since to the first frame, None if none arrived in time
+    """
+    poller = SnapshotPoller(ip_address, timeout=1.0)
+    if after_frame:
+        poller.etag = f'"{after_frame}"'
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        if poller.poll() is not None:
+            return time.time() - since
+        time.sleep(0.05)
+    return None
+
+
+def latest_frame(ip_address: str) -> int:
+    """Get the number of the newest frame on the device, 0 if there is none."""
+    poller = SnapshotPoller(ip_address)
+    poller.poll()
+    return poller.frames[-1] if poller.frames else 0
+
+
+def active_viewers(ip_address: str) -> Set[Tuple[str, int]]:
+    """Get (transport, id) of the viewers currently listed in /metrics."""
+    try:
+        metrics = device.get_metrics(ip_address)
+    except (requests.RequestException, ValueError):
+        return set()
+    return {(c.get("transport"), c.get("id")) for c in metrics.get("streams", [])}
+
+
+def test_reconnect(
+    ip_address: str, drop_ms: int, delay: float, timeout: float, logger: Any
+) -> Dict[str, Any]:
+    """Drop the WiFi link of the device and measure how it comes back.
+
+    Args:
+        ip_address: Device IP address
+        drop_ms: How long the device stays away from the access point
+        delay: Seconds to wait before the drop, so that streams are running
+        timeout: Maximum time to wait for the first frame after the drop
+        logger: Logger instance
+
+    Returns:
+        Dictionary with the time to the first new frame (from the drop and
+        beyond the requested drop time), the outage and association time
+        reported by the device and the number of viewers that resumed
+    """
+    time.sleep(delay)
+    before = device.get_wifi(ip_address)
+    viewers = active_viewers(ip_address)
+    known_frame = latest_frame(ip_address)
+
+    logger.info("Dropping WiFi link for %d ms", drop_ms)
+    start = time.time()
+    device.drop_wifi(ip_address, drop_ms)
+    first_frame = first_frame_time(ip_address, start, timeout, known_frame)
+    if first_frame is None:
+        logger.warning("No frame within %.0f s after the link drop", timeout)
+        return {"drop_ms": drop_ms, "first_frame_s": None}
+
+    after = device.get_wifi(ip_address)
+    resumed = viewers & active_viewers(ip_address)
+    result = {
+        "drop_ms": drop_ms,
+        "first_frame_s": first_frame,
+        # Part of the time to first frame caused by the device, not by the drop
+        "recovery_s": max(first_frame - DROP_DELAY_S - drop_ms / 1000, 0.0),
+        "outage_ms": after.get("last_outage_ms"),
+        "connect_ms": after.get("connect_ms"),
+        "fast_connect": after.get("fast_connect"),
+        "disconnects": after.get("disconnects", 0) - before.get("disconnects", 0),
+        "viewers": len(viewers),
+        "viewers_resumed": len(resumed),
+    }
+    logger.info(
+        "Reconnected: first frame %.2f s after the drop (%.2f s recovery), "
+        "outage %s ms, %s, %d/%d viewers resumed",
+        result["first_frame_s"],
+        result["recovery_s"],
+        result["outage_ms"],
+        "cached access point" if result["fast_connect"] else "scan",
+        result["viewers_resumed"],
+        result["viewers"],
+    )
+    return result
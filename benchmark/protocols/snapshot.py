@@ -0,0 +1,134 @@
+"""Snapshot polling for ESP32-CAM benchmark.
+
+Several pollers fetch /capture at the same time, each sends the ETag of the
+frame it already has. The device serves all of them from its last-frame
+cache, so the number of distinct frames must not grow with the pollers.
+"""
+
+import statistics
+import threading
+import time
+from typing import Any, Dict, List, Optional
+
+import requests
+
+
+class SnapshotPoller:
+    """Fetches /capture with If-None-Match and optional long poll."""
+
+    def __init__(self, ip_address: str, wait_ms: int = 0, timeout: float = 5.0):
+        self.url = f"http://{ip_address}/capture"
+        self.wait_ms = wait_ms
+        self.timeout = timeout
+        self.etag: Optional[str] = None
+        self.frames: List[int] = []  # frame numbers received
+        self.latencies: List[float] = []
+        self.counts = {"ok": 0, "not_modified": 0, "errors": 0}
+
+    def poll(self) -> Optional[bytes]:
+        """Fetch one snapshot.
+
+        Returns:
+            Frame data, None if the frame did not change or the request failed
+        """
+        headers = {"If-None-Match": self.etag} if self.etag else {}
+        params = {"wait": self.wait_ms} if self.wait_ms else {}
+        start = time.time()
+        try:
+            response = requests.get(
+                self.url,
+                headers=headers,
+                params=params,
+                timeout=self.timeout + self.wait_ms / 1000,
+            )
+        except requests.RequestException:
+            self.counts["errors"] += 1
+            return None
+        self.latencies.append((time.time() - start) * 1000)
+
+        if response.status_code == 304:
+            self.counts["not_modified"] += 1
+            return None
+        if response.status_code != 200:
+            self.counts["errors"] += 1
+            return None
+        self.counts["ok"] += 1
+        self.etag = response.headers.get("ETag", self.etag)
+        if self.etag:
+            self.frames.append(int(self.etag.strip('W/"')))
+        return response.content
+
+
+def test_snapshot(
+    ip_address: str, duration: float, pollers: int, wait_ms: int, logger: Any
+) -> Dict[str, Any]:
+    """Poll snapshots from several clients at once.
+
+    Args:
+        ip_address: Device IP address
+        duration: Test duration in seconds
+        pollers: Number of concurrent pollers
+        wait_ms: Long poll time passed as ?wait=, 0 for plain polling
+        logger: Logger instance
+
+    Returns:
+        Dictionary with response counts, latency and frame statistics
+    """
+    logger.info("Starting snapshot test: pollers=%d, wait=%d ms", pollers, wait_ms)
+    clients = [SnapshotPoller(ip_address, wait_ms) for _ in range(pollers)]
+    deadline = time.time() + duration
+
+    def run(client: SnapshotPoller) -> None:
+        while time.time() < deadline:
+            client.poll()
+
+    threads = [threading.Thread(target=run, args=(c,), daemon=True) for c in clients]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    metrics = summarize(clients, duration)
+    logger.info(
+        "Snapshots: %d frames, %d not modified, %d errors, %d distinct frames (%.1f/s)",
+        metrics["ok"],
+        metrics["not_modified"],
+        metrics["errors"],
+        metrics["distinct_frames"],
+        metrics["distinct_fps"],
+    )
+    return metrics
+
+
+def summarize(clients: List[SnapshotPoller], duration: float) -> Dict[str, Any]:
+    """Combine the counters of all pollers.
+
+    Args:
+        clients: Pollers after the test
+        duration: Test duration in seconds
+
+    Returns:
+        Dictionary with totals, latency percentiles, distinct frames seen by
+        all pollers and frames seen more than once by the same poller
+    """
+    latencies = sorted(ms for c in clients for ms in c.latencies)
+    distinct = {number for c in clients for number in c.frames}
+    metrics: Dict[str, Any] = {
+        name: sum(c.counts[name] for c in clients)
+        for name in ("ok", "not_modified", "errors")
+    }
+    metrics.update(
+        {
+            "pollers": len(clients),
+            "distinct_frames": len(distinct),
+            "distinct_fps": len(distinct) / duration if duration else 0,
+            # The ETag must prevent receiving the same frame twice
+            "repeated_frames": sum(len(c.frames) - len(set(c.frames)) for c in clients),
+            "latency_ms": {
+                "p50": latencies[len(latencies) // 2] if latencies else 0,
+                "p99": latencies[int(len(latencies) * 0.99)] if latencies else 0,
+                "mean": statistics.mean(latencies) if latencies else 0,
+            },
+        }
+    )
+    return metrics
@@ -1,14 +1,22 @@
-"""Video protocol functionality for ESP32-CAM benchmark with real-time stretch."""
+"""Video protocol functionality for ESP32-CAM benchmark."""
 
 import os
+import socket
 import statistics
+import struct
 import time
 from datetime import datetime
 from pathlib import Path
-from typing import Any, Dict
+from typing import Any, Dict, Optional
+from urllib.parse import urlencode
 
 import cv2
 
+from ..utils import raw_tiles
+from . import mjpeg
+
+UDP_VIDEO_PORT = 5000
+
 
 def test_video(
     ip_address: str,
@@ -18,8 +26,17 @@ def test_video(
     raw_mode: bool,
     duration: int,
     logger: Any,
+    *,
+    decode_frames: bool,
+    viewer: Optional[Dict[str, int]],
+    use_raw_tiles: bool,
 ) -> Dict[str, Any]:
-    """Test video streaming with real-time stretch (duplicates frames to preserve real duration).
+    """Test video streaming.
+
+    HTTP MJPEG streams are measured by the decode-free multipart reader, raw
+    frames sent as changed tiles by the tile composer, the other protocols are
+    read through OpenCV with real-time stretch (duplicates frames to preserve
+    real duration).
 
     Args:
         ip_address: Device IP address
@@ -29,6 +46,9 @@ def test_video(
         raw_mode: Whether to use raw mode
         duration: Test duration in seconds
         logger: Logger instance
+        decode_frames: Decode HTTP MJPEG frames in a worker pool (off the measurement path)
+        viewer: Per-viewer limits requested from the device (fps, maxbytes)
+        use_raw_tiles: Raw UDP frames arrive as changed tiles (RAW_TILES firmware)
 
     Returns:
         Dictionary with test results
@@ -37,7 +57,7 @@ def test_video(
     actual_duration = duration + 2
 
     logger.info(
-        "Starting video test (with real-time stretch): protocol=%s, resolution=%s, quality=%d, raw=%s",
+        "Starting video test: protocol=%s, resolution=%s, quality=%d, raw=%s",
         protocol,
         resolution,
         quality,
@@ -58,13 +78,13 @@ def test_video(
 
     # Form URL
     if protocol == "HTTP":
-        url = f"http://{ip_address}/video"
+        url = f"http://{ip_address}/video{viewer_query(viewer)}"
     elif protocol == "RTSP":
         url = f"rtsp://{ip_address}:8554/video"
     elif protocol == "UDP":
         url = f"udp://{ip_address}:5000"
     elif protocol == "WebRTC":
-        url = f"ws://{ip_address}:8080/video"
+        url = f"ws://{ip_address}:8081/video"
     else:
         raise ValueError(f"Unsupported video protocol: {protocol}")
 
@@ -72,16 +92,136 @@ def test_video(
     output_dir = Path("results/video")
     output_dir.mkdir(parents=True, exist_ok=True)
     output_path = output_dir / (
-        f'video_{datetime.now().strftime("%Y%m%d_%H%M%S")}_{protocol}_{resolution}_q{quality}.mp4'
+        f'video_{datetime.now().strftime("%Y%m%d_%H%M%S")}_{protocol}_{resolution}_q{quality}'
+        f'_{ip_address.replace(".", "-")}.mp4'
     )
 
+    if protocol == "HTTP":
+        capture = _capture_mjpeg(
+            url,
+            output_path.with_suffix(".mjpeg"),
+            actual_duration,
+            decode_frames,
+            logger,
+        )
+    elif protocol == "UDP" and use_raw_tiles:
+        capture = _capture_tiles(
+            output_path.with_suffix(".tiles"), actual_duration, logger
+        )
+    else:
+        capture = _capture_opencv(url, output_path, actual_duration, logger)
+
+    metrics["connection_time"] = capture["connection_time"]
+    frames_captured = capture["frames_captured"]
+    failed_reads = capture["failed_reads"]
+    frame_times = capture["frame_times"]
+    frames_by_second = capture["frames_by_second"]
+    test_duration = capture["test_duration"]
+    file_size = capture["total_bytes"]
+    for key in ("wire_bytes", "invalid_frames", "frame_transfer_ms", "decode", "tiles"):
+        if key in capture:
+            metrics[key] = capture[key]
+
+    # Calculate frame time statistics
+    if frame_times:
+        frame_times_ms = [t * 1000 for t in frame_times]
+        frame_times_ms.sort()
+        frame_time_percentiles = {
+            "p50": frame_times_ms[len(frame_times_ms) // 2],
+            "p90": frame_times_ms[int(len(frame_times_ms) * 0.9)],
+            "p95": frame_times_ms[int(len(frame_times_ms) * 0.95)],
+            "p99": frame_times_ms[int(len(frame_times_ms) * 0.99)],
+        }
+    else:
+        frame_time_percentiles = {"p50": 0, "p90": 0, "p95": 0, "p99": 0}
+
+    # Collect FPS summary
+    complete_seconds_fps = []
+    for second in sorted(frames_by_second.keys()):
+        if 0 < second <= duration:
+            complete_seconds_fps.append(frames_by_second[second]["frames"])
+            metrics["frames_per_second"].append(
+                {"second": second, **frames_by_second[second]}
+            )
+
+    if complete_seconds_fps:
+        complete_seconds_fps.sort(reverse=True)
+        fps_percentiles = {
+            "p50": complete_seconds_fps[len(complete_seconds_fps) // 2],
+            "p75": complete_seconds_fps[int(len(complete_seconds_fps) * 0.75)],
+            "p90": complete_seconds_fps[int(len(complete_seconds_fps) * 0.9)],
+            "p95": complete_seconds_fps[int(len(complete_seconds_fps) * 0.95)],
+            "p99": complete_seconds_fps[int(len(complete_seconds_fps) * 0.99)],
+        }
+    else:
+        fps_percentiles = {"p50": 0, "p75": 0, "p90": 0, "p95": 0, "p99": 0}
+
+    fps_stats = {
+        "min_fps": min(complete_seconds_fps) if complete_seconds_fps else 0,
+        "max_fps": max(complete_seconds_fps) if complete_seconds_fps else 0,
+        "fps_stability": round(statistics.stdev(complete_seconds_fps), 2)
+        if len(complete_seconds_fps) > 1
+        else 0,
+        "percentiles": fps_percentiles,
+    }
+
+    metrics.update(
+        {
+            "total_frames": frames_captured,  # raw frames from ESP
+            "dropped_frames": failed_reads,  # not read (ret=False)
+            "avg_fps": (
+                sum(complete_seconds_fps) / len(complete_seconds_fps)
+                if len(complete_seconds_fps) > 0
+                else 0
+            ),
+            "frame_time_min_ms": min(frame_times) * 1000 if frame_times else 0,
+            "frame_time_max_ms": max(frame_times) * 1000 if frame_times else 0,
+            "frame_time_percentiles_ms": frame_time_percentiles,
+            "frame_times_ms": [round(t * 1000, 3) for t in frame_times],
+            "frame_offsets_s": [round(t, 3) for t in capture["frame_offsets"]],
+            "total_size_mb": file_size / (1024 * 1024),
+            "bitrate_mbps": (file_size * 8) / (test_duration * 1024 * 1024)
+            if test_duration > 0
+            else 0,
+            "test_duration": test_duration,
+            "analyzed_duration": duration,
+            "fps_stats": fps_stats,
+            "video_file": capture["video_file"],
+        }
+    )
+
+    _log_video_metrics(metrics, logger)
+    return metrics
+
+
+def viewer_query(viewer: Optional[Dict[str, int]]) -> str:
+    """Build the /video query string with per-viewer limits.
+
+    Args:
+        viewer: Limits (fps, maxbytes), unset or zero values are left out
+
+    Returns:
+        Query string including "?", empty without limits
+    """
+    params = {
+        name: int(value)
+        for name, value in (viewer or {}).items()
+        if name in ("fps", "maxbytes") and value
+    }
+    return "?" + urlencode(params) if params else ""
+
+
+def _capture_opencv(
+    url: str, output_path: Path, actual_duration: float, logger: Any
+) -> Dict[str, Any]:
+    """Capture stream through OpenCV and re-encode it with real-time stretch."""
     # Open stream
     connection_start = time.time()
     logger.info("Opening video stream: %s", url)
     cap = cv2.VideoCapture(url)
     if not cap.isOpened():
         raise RuntimeError("Failed to open video stream")
-    metrics["connection_time"] = time.time() - connection_start
+    connection_time = time.time() - connection_start
 
     # Video stream properties
     frame_width = int(cap.get(cv2.CAP_PROP_FRAME_WIDTH))
@@ -106,6 +246,7 @@ def test_video(
     start_time = time.time()
     last_frame_time = start_time
     frame_times = []
+    frame_offsets = []
     frames_by_second = {}
     first_frame = True
     last_log_second = -1
@@ -135,6 +276,7 @@ def test_video(
         # Count frames from ESP
         frames_captured += 1
         frame_times.append(dt)
+        frame_offsets.append(elapsed)
 
         second = int(elapsed)
         if second not in frames_by_second:
@@ -169,81 +311,184 @@ def test_video(
     cap.release()
     out.release()
 
-    test_duration = time.time() - start_time
-    file_size = os.path.getsize(output_path) if os.path.exists(output_path) else 0
+    return {
+        "connection_time": connection_time,
+        "frames_captured": frames_captured,
+        "failed_reads": failed_reads,
+        "frame_times": frame_times,
+        "frame_offsets": frame_offsets,
+        "frames_by_second": frames_by_second,
+        "test_duration": time.time() - start_time,
+        "total_bytes": (
+            os.path.getsize(output_path) if os.path.exists(output_path) else 0
+        ),
+        "video_file": str(output_path),
+    }
+
 
-    # Calculate frame time statistics
-    if frame_times:
-        frame_times_ms = [t * 1000 for t in frame_times]
-        frame_times_ms.sort()
-        frame_time_percentiles = {
-            "p50": frame_times_ms[len(frame_times_ms) // 2],
-            "p90": frame_times_ms[int(len(frame_times_ms) * 0.9)],
-            "p95": frame_times_ms[int(len(frame_times_ms) * 0.95)],
-            "p99": frame_times_ms[int(len(frame_times_ms) * 0.99)],
-        }
-    else:
-        frame_time_percentiles = {"p50": 0, "p90": 0, "p95": 0, "p99": 0}
+def _capture_mjpeg(
+    url: str,
+    output_path: Path,
+    actual_duration: float,
+    decode_frames: bool,
+    logger: Any,
+) -> Dict[str, Any]:
+    """Capture HTTP MJPEG stream without decoding and store raw JPEG bytes."""
+    logger.info("Opening MJPEG stream: %s", url)
+    decoder = mjpeg.FrameDecoder() if decode_frames else None
+    try:
+        with open(output_path, "wb") as output:
+            capture = mjpeg.capture_mjpeg(url, output, actual_duration, decoder)
+    except OSError as e:
+        raise RuntimeError(f"Failed to open video stream: {e}") from e
+    finally:
+        decode_stats = decoder.close() if decoder is not None else None
+
+    start_time = capture["start_time"]
+    frames_captured = 0
+    invalid_frames = 0
+    frame_times = []
+    frame_offsets = []
+    transfer_times = []
+    frames_by_second = {}
+    last_frame_time = None
 
-    # Collect FPS summary
-    complete_seconds_fps = []
-    for second in sorted(frames_by_second.keys()):
-        if 0 < second <= duration:
-            complete_seconds_fps.append(frames_by_second[second]["frames"])
-            metrics["frames_per_second"].append(
-                {
-                    "second": second,
-                    "frames": frames_by_second[second]["frames"],
-                    "dropped": frames_by_second[second]["dropped"],
-                }
-            )
+    for part_start, part_end, size, valid in capture["parts"]:
+        # Skip the first part, it may have been buffered while connecting
+        if last_frame_time is None:
+            last_frame_time = part_end
+            continue
 
-    if complete_seconds_fps:
-        complete_seconds_fps.sort(reverse=True)
-        fps_percentiles = {
-            "p50": complete_seconds_fps[len(complete_seconds_fps) // 2],
-            "p75": complete_seconds_fps[int(len(complete_seconds_fps) * 0.75)],
-            "p90": complete_seconds_fps[int(len(complete_seconds_fps) * 0.9)],
-            "p95": complete_seconds_fps[int(len(complete_seconds_fps) * 0.95)],
-            "p99": complete_seconds_fps[int(len(complete_seconds_fps) * 0.99)],
-        }
-    else:
-        fps_percentiles = {"p50": 0, "p75": 0, "p90": 0, "p95": 0, "p99": 0}
+        second = int(part_end - start_time)
+        if second not in frames_by_second:
+            frames_by_second[second] = {"frames": 0, "dropped": 0, "bytes": 0}
+        frames_by_second[second]["bytes"] += size
 
-    fps_stats = {
-        "min_fps": min(complete_seconds_fps) if complete_seconds_fps else 0,
-        "max_fps": max(complete_seconds_fps) if complete_seconds_fps else 0,
-        "fps_stability": round(statistics.stdev(complete_seconds_fps), 2)
-        if len(complete_seconds_fps) > 1
-        else 0,
-        "percentiles": fps_percentiles,
-    }
+        if not valid:
+            invalid_frames += 1
+            frames_by_second[second]["dropped"] += 1
+            continue
 
-    metrics.update(
-        {
-            "total_frames": frames_captured,  # raw frames from ESP
-            "dropped_frames": failed_reads,  # not read (ret=False)
-            "avg_fps": (
-                sum(complete_seconds_fps) / len(complete_seconds_fps)
-                if len(complete_seconds_fps) > 0
-                else 0
-            ),
-            "frame_time_min_ms": min(frame_times) * 1000 if frame_times else 0,
-            "frame_time_max_ms": max(frame_times) * 1000 if frame_times else 0,
-            "frame_time_percentiles_ms": frame_time_percentiles,
-            "total_size_mb": file_size / (1024 * 1024),
-            "bitrate_mbps": (file_size * 8) / (test_duration * 1024 * 1024)
-            if test_duration > 0
+        frames_captured += 1
+        frame_times.append(part_end - last_frame_time)
+        frame_offsets.append(part_end - start_time)
+        transfer_times.append((part_end - part_start) * 1000)
+        last_frame_time = part_end
+        frames_by_second[second]["frames"] += 1
+
+    transfer_times.sort()
+    result = {
+        "connection_time": capture["connection_time"],
+        "frames_captured": frames_captured,
+        "failed_reads": invalid_frames,
+        "frame_times": frame_times,
+        "frame_offsets": frame_offsets,
+        "frames_by_second": frames_by_second,
+        "test_duration": capture["end_time"] - start_time,
+        "total_bytes": capture["wire_bytes"],
+        "wire_bytes": capture["wire_bytes"],
+        "invalid_frames": invalid_frames,
+        "frame_transfer_ms": {
+            "p50": transfer_times[len(transfer_times) // 2] if transfer_times else 0,
+            "p90": transfer_times[int(len(transfer_times) * 0.9)]
+            if transfer_times
             else 0,
-            "test_duration": test_duration,
-            "analyzed_duration": duration,
-            "fps_stats": fps_stats,
-            "video_file": str(output_path),
-        }
-    )
+            "p99": transfer_times[int(len(transfer_times) * 0.99)]
+            if transfer_times
+            else 0,
+        },
+        "video_file": str(output_path),
+    }
+    if decode_stats is not None:
+        result["decode"] = decode_stats
+    return result
 
-    _log_video_metrics(metrics, logger)
-    return metrics
+
+def _capture_tiles(
+    output_path: Path, actual_duration: float, logger: Any
+) -> Dict[str, Any]:
+    """Receive raw frames sent as changed tiles and compose them.
+
+    Datagrams are stored as received, each after its length as a
+    little-endian u16, the layout tests/host/tile_delta_bench.cpp writes.
+    """
+    logger.info("Listening for tile datagrams on UDP port %d", UDP_VIDEO_PORT)
+    connection_start = time.time()
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(("", UDP_VIDEO_PORT))
+    sock.settimeout(1.0)
+    composer = raw_tiles.TileComposer()
+
+    connection_time = None
+    start_time = time.time()
+    wire_bytes = invalid = 0
+    frame_times = []
+    frame_offsets = []
+    frame_bytes = []
+    frames_by_second = {}
+    last_frame_time = None
+    pending = 0
+    refreshes = 0
+    try:
+        with open(output_path, "wb") as output:
+            while (time.time() - start_time) < actual_duration:
+                try:
+                    data = sock.recv(65535)
+                except socket.timeout:
+                    continue
+                now = time.time()
+                if connection_time is None:
+                    connection_time = now - connection_start
+                output.write(struct.pack("<H", len(data)) + data)
+                wire_bytes += len(data)
+                pending += len(data)
+                try:
+                    header = raw_tiles.parse_header(data)
+                    frame = composer.feed(data)
+                except ValueError:
+                    invalid += 1
+                    continue
+                if frame is None:
+                    continue
+
+                refreshes += header.full
+                # Skip the first frame, its datagrams may predate the test
+                if last_frame_time is not None:
+                    second = int(now - start_time)
+                    if second not in frames_by_second:
+                        frames_by_second[second] = {"frames": 0, "dropped": 0}
+                    frames_by_second[second]["frames"] += 1
+                    frame_times.append(now - last_frame_time)
+                    frame_offsets.append(now - start_time)
+                    frame_bytes.append(pending)
+                last_frame_time = now
+                pending = 0
+    finally:
+        sock.close()
+
+    return {
+        "connection_time": connection_time or 0,
+        "frames_captured": len(frame_times),
+        "failed_reads": composer.incomplete_frames,
+        "frame_times": frame_times,
+        "frame_offsets": frame_offsets,
+        "frames_by_second": frames_by_second,
+        "test_duration": time.time() - start_time,
+        "total_bytes": wire_bytes,
+        "wire_bytes": wire_bytes,
+        "tiles": {
+            "frame_bytes": (
+                sum(frame_bytes) / len(frame_bytes) if frame_bytes else None
+            ),
+            "refreshes": refreshes,
+            "incomplete_frames": composer.incomplete_frames,
+            "invalid_datagrams": invalid,
+            "size": f"{composer.width}x{composer.height}",
+            "format": composer.format,
+        },
+        "video_file": str(output_path),
+    }
 
 
 def _log_video_metrics(metrics: Dict[str, Any], logger: Any) -> None:
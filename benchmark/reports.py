@@ -0,0 +1,803 @@
+"""Per-test deltas of firmware counters and the reports comparing test variants.
+
+Every *_delta function turns two snapshots of a firmware endpoint (taken
+before and after a test) into the work done during the test. Every *_report
+function compares such results across the variants of a full run, and its
+*_lines companion gives the log lines of one variant of the report.
+"""
+
+from typing import Any, Dict, Iterable, List, Optional
+
+from .utils import raw_codec
+
+CAMERA_PARAMS = ("fb_count", "fb_location", "grab_mode")
+
+
+def counter_delta(
+    before: Dict[str, Any], after: Dict[str, Any], names: Iterable[str]
+) -> Dict[str, Any]:
+    """Get how much counters grew between two snapshots.
+
+    Args:
+        before: Counters before the test, missing counters count as 0
+        after: Counters after the test
+        names: Counters to compare
+
+    Returns:
+        Dictionary with the increase of every counter
+    """
+    return {name: after[name] - before.get(name, 0) for name in names}
+
+
+def _mean(total: float, count: int) -> Optional[float]:
+    """Get total / count, None without a count."""
+    return total / count if count else None
+
+
+def _rate(
+    frames: int, before: Dict[str, Any], after: Dict[str, Any]
+) -> Optional[float]:
+    """Get frames per second between two /metrics snapshots."""
+    elapsed_ms = after.get("uptime_ms", 0) - before.get("uptime_ms", 0)
+    return frames * 1000 / elapsed_ms if elapsed_ms > 0 else None
+
+
+def _variant(params: Dict[str, Any], keys: Iterable[Any]) -> str:
+    """Join test parameters into a variant name, keys may be (key, default)."""
+    keys = [key if isinstance(key, tuple) else (key, None) for key in keys]
+    return "/".join(str(params.get(key, default)) for key, default in keys)
+
+
+def _summary(entry: Dict[str, Any], *names: str) -> Dict[str, Any]:
+    """Get summary metrics of a test result, None for missing ones."""
+    metrics = entry["results"].get("summary", {}).get("metrics", {})
+    return {name: metrics[name]["value"] if name in metrics else None for name in names}
+
+
+def alloc_delta(
+    before: Dict[str, Any], after: Dict[str, Any], budget: Dict[str, float]
+) -> Dict[str, Any]:
+    """Get heap allocations made during a test from two /metrics snapshots.
+
+    Args:
+        before: "allocs" of /metrics before the test
+        after: "allocs" of /metrics after the test
+        budget: Maximum mean allocations per command and per frame
+
+    Returns:
+        Dictionary with count, allocations and mean per scope, and the
+        scopes over their budget
+    """
+    delta: Dict[str, Any] = counter_delta(before, after, ("total",))
+    over = []
+    for scope in ("command", "frame"):
+        delta[scope] = counter_delta(before[scope], after[scope], ("count", "allocs"))
+        delta[scope]["mean"] = (
+            _mean(delta[scope]["allocs"], delta[scope]["count"]) or 0.0
+        )
+        if delta[scope]["mean"] > budget.get(scope, 0):
+            over.append(scope)
+    delta["over_budget"] = over
+    return delta
+
+
+def hot_path_delta(before: Dict[str, Any], after: Dict[str, Any]) -> Dict[str, Any]:
+    """Get hot path costs of a test from two /metrics snapshots.
+
+    Args:
+        before: "hot_paths" of /metrics before the test
+        after: "hot_paths" of /metrics after the test
+
+    Returns:
+        Dictionary with IRAM placement, stall counter availability and per
+        path calls, mean time per call, time per KB and the share of
+        instruction and data stall cycles
+    """
+    mhz = after.get("cpu_mhz") or 240
+    paths = {}
+    for name, end in after["paths"].items():
+        path = counter_delta(
+            before.get("paths", {}).get(name, {}),
+            end,
+            ("calls", "cycles", "bytes", "i_stall", "d_stall"),
+        )
+        if not path["calls"]:
+            continue
+        cycles = path["cycles"]
+        paths[name] = {
+            "calls": path["calls"],
+            "mean_us": cycles / path["calls"] / mhz,
+            "max_us": end["max_cycles"] / mhz,
+            "us_per_kb": _mean(cycles / mhz, path["bytes"] / 1024),
+            "i_stall_share": _mean(path["i_stall"], cycles) or 0.0,
+            "d_stall_share": _mean(path["d_stall"], cycles) or 0.0,
+        }
+    return {"iram": after.get("iram"), "stalls": after.get("stalls"), "paths": paths}
+
+
+def raw_codec_delta(before: Dict[str, Any], after: Dict[str, Any]) -> Dict[str, Any]:
+    """Get raw frame codec costs of a test from two /metrics snapshots.
+
+    Args:
+        before: /metrics before the test
+        after: /metrics after the test
+
+    Returns:
+        Dictionary with frames encoded, compression ratio, mean and maximum
+        encode time per frame and the rate of encoded frames on the device
+    """
+    end = after["raw_codec"]
+    delta = counter_delta(
+        before.get("raw_codec", {}),
+        end,
+        ("frames", "raw_bytes", "encoded_bytes", "encode_us"),
+    )
+    delta.update(
+        {
+            "ratio": raw_codec.compression_ratio(
+                delta["raw_bytes"], delta["encoded_bytes"]
+            ),
+            "encode_us": _mean(delta["encode_us"], delta["frames"]),
+            "max_encode_us": end["max_encode_us"],
+            "fps": _rate(delta["frames"], before, after),
+        }
+    )
+    return delta
+
+
+def raw_frame_delta(before: Dict[str, Any], after: Dict[str, Any]) -> Dict[str, Any]:
+    """Get raw frames prepared during a test from two /metrics snapshots.
+
+    Args:
+        before: /metrics before the test
+        after: /metrics after the test
+
+    Returns:
+        Dictionary with pixel format, downscale factor and size of the frames,
+        frames prepared, mean bytes per frame, mean downscale time per frame
+        and the rate of frames on the device
+    """
+    end = after["raw_frames"]
+    counters = counter_delta(
+        before.get("raw_frames", {}), end, ("frames", "bytes", "downscale_us")
+    )
+    frames = counters["frames"]
+    delta = {key: end[key] for key in ("format", "scale", "width", "height")}
+    delta.update(
+        {
+            "frames": frames,
+            "frame_bytes": _mean(counters["bytes"], frames),
+            "downscale_us": _mean(counters["downscale_us"], frames),
+            "fps": _rate(frames, before, after),
+        }
+    )
+    return delta
+
+
+def raw_tile_delta(before: Dict[str, Any], after: Dict[str, Any]) -> Dict[str, Any]:
+    """Get changed-tile streaming work of a test from two /metrics snapshots.
+
+    Args:
+        before: /metrics before the test
+        after: /metrics after the test
+
+    Returns:
+        Dictionary with tile size and threshold, frames sent, full refreshes,
+        frames sent whole for lack of memory, the share of changed tiles, mean
+        bytes per frame and mean and maximum send time per frame
+    """
+    end = after["raw_tiles"]
+    counters = counter_delta(
+        before.get("raw_tiles", {}),
+        end,
+        ("frames", "refreshes", "failures", "tiles", "changed", "bytes", "send_us"),
+    )
+    frames = counters.pop("frames")
+    send_us = counters.pop("send_us")
+    delta = {"tile_size": end["tile_size"], "threshold": end["threshold"]}
+    delta["frames"] = frames
+    delta.update(counters)
+    delta.update(
+        {
+            "changed_ratio": _mean(delta["changed"], delta["tiles"]),
+            "frame_bytes": _mean(delta["bytes"], frames),
+            "send_us": _mean(send_us, frames),
+            "max_send_us": end["max_send_us"],
+        }
+    )
+    return delta
+
+
+def soft_jpeg_delta(before: Dict[str, Any], after: Dict[str, Any]) -> Dict[str, Any]:
+    """Get software JPEG encoder work of a test from two /metrics snapshots.
+
+    Args:
+        before: /metrics before the test
+        after: /metrics after the test
+
+    Returns:
+        Dictionary with encoder core and quality, frames encoded, failures,
+        mean and maximum encode time, encoded frame rate and how often the
+        video service waited for the encoder (starved) or the encoder for a
+        free buffer (backed_up)
+    """
+    end = after["soft_jpeg"]
+    counters = counter_delta(
+        before.get("soft_jpeg", {}),
+        end,
+        ("frames", "failures", "starved", "backed_up", "encode_us"),
+    )
+    frames = counters["frames"]
+    encode_us = counters.pop("encode_us")
+    delta = {"core": end.get("core"), "quality": end.get("quality")}
+    delta.update(counters)
+    delta.update(
+        {
+            "encode_ms": _mean(encode_us / 1000, frames),
+            "max_encode_ms": end["max_encode_us"] / 1000,
+            "fps": _rate(frames, before, after),
+        }
+    )
+    return delta
+
+
+def motion_delta(before: Dict[str, Any], after: Dict[str, Any]) -> Dict[str, Any]:
+    """Get motion detector work of a test from two /metrics snapshots.
+
+    Args:
+        before: /metrics before the test
+        after: /metrics after the test
+
+    Returns:
+        Dictionary with frames scored and sent, the share of frames sent,
+        motion events, frames that could not be scored, mean and maximum
+        scoring time and the send interval at the end of the test
+    """
+    end = after["motion"]
+    delta = counter_delta(
+        before.get("motion", {}),
+        end,
+        ("frames", "sent", "events", "failures", "analyze_us"),
+    )
+    delta.update(
+        {
+            "sent_ratio": _mean(delta["sent"], delta["frames"]),
+            "analyze_us": _mean(delta["analyze_us"], delta["frames"]),
+            "max_analyze_us": end["max_analyze_us"],
+            "interval_ms": end["interval_ms"],
+        }
+    )
+    return delta
+
+
+# Sections of /metrics with a delta of their own, present only in builds
+# with the matching feature
+METRICS_DELTAS = (
+    ("raw_frames", raw_frame_delta),
+    ("raw_codec", raw_codec_delta),
+    ("raw_tiles", raw_tile_delta),
+    ("soft_jpeg", soft_jpeg_delta),
+    ("motion", motion_delta),
+)
+
+
+def metrics_deltas(
+    before: Dict[str, Any], after: Dict[str, Any], alloc_budget: Dict[str, float]
+) -> Dict[str, Any]:
+    """Get the deltas of every feature section of two /metrics snapshots.
+
+    Args:
+        before: /metrics before the test
+        after: /metrics after the test
+        alloc_budget: Maximum mean allocations per command and per frame
+
+    Returns:
+        Dictionary with a delta per section present in the build (allocs,
+        hot_paths, raw_frames, raw_codec, raw_tiles, soft_jpeg, motion)
+    """
+    deltas = {}
+    if "allocs" in before and "allocs" in after:
+        deltas["allocs"] = alloc_delta(before["allocs"], after["allocs"], alloc_budget)
+    if "hot_paths" in after:
+        deltas["hot_paths"] = hot_path_delta(
+            before.get("hot_paths", {}), after["hot_paths"]
+        )
+    for section, delta in METRICS_DELTAS:
+        if section in after:
+            deltas[section] = delta(before, after)
+    return deltas
+
+
+def camera_delta(before: Dict[str, Any], after: Dict[str, Any]) -> Dict[str, Any]:
+    """Compute capture statistics of a test from two /camera snapshots.
+
+    Args:
+        before: GET /camera before the test
+        after: GET /camera after the test
+
+    Returns:
+        Buffer settings and driver memory of the test, and frames, capture
+        FPS, mean wait for a frame, failures, sensor frames not consumed and
+        bad frames during the test
+    """
+    start, end = before["capture"], after["capture"]
+    if end["elapsed_ms"] < start["elapsed_ms"]:
+        start = {}  # camera reinitialized during the test, counters restarted
+    counters = counter_delta(
+        start, end, ("frames", "elapsed_ms", "failures", "unconsumed", "bad_frames")
+    )
+    frames = counters["frames"]
+    elapsed_ms = counters.pop("elapsed_ms")
+    grab_ms = end["mean_grab_ms"] * end["frames"] - start.get(
+        "mean_grab_ms", 0
+    ) * start.get("frames", 0)
+    capture = {
+        "frames": frames,
+        "fps": _mean(frames * 1000, elapsed_ms),
+        "mean_grab_ms": _mean(grab_ms, frames),
+    }
+    capture.update(counters)
+    result = {key: after.get(key) for key in CAMERA_PARAMS}
+    result["memory"] = after.get("memory", {})
+    result["capture"] = capture
+    return result
+
+
+def raw_codec_report(results: List[Dict[str, Any]]) -> Dict[str, Any]:
+    """Compare raw frames sent plain and encoded, per resolution.
+
+    Args:
+        results: Results of run_all_tests()
+
+    Returns:
+        Dictionary by "video protocol/resolution" with the mean FPS of plain
+        and encoded raw frames, the compression ratio and encode time per
+        frame of the codec and the FPS gain
+    """
+    report: Dict[str, Any] = {}
+    for entry in results:
+        params = entry["params"]
+        if not params.get("raw_mode") or "results" not in entry:
+            continue
+        row = _summary(entry, "fps")
+        codec = entry["results"].get("raw_codec")
+        if params.get("raw_codec") and codec:
+            row.update(
+                {
+                    "ratio": codec["ratio"],
+                    "encode_us": codec["encode_us"],
+                    "device_fps": codec["fps"],
+                }
+            )
+        variant = _variant(params, ("video_protocol", "resolution"))
+        report.setdefault(variant, {})[
+            "codec" if params.get("raw_codec") else "plain"
+        ] = row
+
+    for entry in report.values():
+        if entry.get("plain", {}).get("fps") and entry.get("codec", {}).get("fps"):
+            entry["fps_gain"] = entry["codec"]["fps"] / entry["plain"]["fps"]
+    return report
+
+
+def raw_codec_lines(variant: str, entry: Dict[str, Any]) -> List[str]:
+    """Log lines of one variant of raw_codec_report()."""
+    codec = entry.get("codec")
+    if not codec or not codec.get("ratio"):
+        return []
+    return [
+        f"{variant}: ratio {codec['ratio']:.2f}, "
+        f"{codec['encode_us'] or 0:.0f} us/frame to encode, "
+        f"{codec['fps']} FPS (plain {entry.get('plain', {}).get('fps')})"
+    ]
+
+
+def raw_format_report(results: List[Dict[str, Any]]) -> Dict[str, Any]:
+    """Compare raw pixel formats and downscale factors with full-size RGB565.
+
+    Args:
+        results: Results of run_all_tests()
+
+    Returns:
+        Dictionary by "video protocol/resolution" with a row per
+        "format/factor" (plus "/codec" with the raw frame codec): FPS, bytes
+        per frame, frame size and downscale time, and for every variant its
+        FPS and bytes per frame relative to plain RGB565 at full size
+    """
+    report: Dict[str, Any] = {}
+    for entry in results:
+        params = entry["params"]
+        if not params.get("raw_mode") or "results" not in entry:
+            continue
+        frames = entry["results"].get("raw_frames", {})
+        key = _variant(params, (("raw_format", "rgb565"), ("raw_scale", 1)))
+        if params.get("raw_codec"):
+            key += "/codec"
+        row = _summary(entry, "fps")
+        row.update(
+            {
+                "frame_bytes": frames.get("frame_bytes"),
+                "size": (
+                    f"{frames['width']}x{frames['height']}"
+                    if "width" in frames
+                    else None
+                ),
+                "downscale_us": frames.get("downscale_us"),
+            }
+        )
+        variant = _variant(params, ("video_protocol", "resolution"))
+        report.setdefault(variant, {})[key] = row
+
+    for entry in report.values():
+        baseline = entry.get("rgb565/1", {})
+        for key, row in entry.items():
+            if key == "rgb565/1":
+                continue
+            if baseline.get("fps") and row["fps"]:
+                row["fps_ratio"] = row["fps"] / baseline["fps"]
+            if baseline.get("frame_bytes") and row["frame_bytes"]:
+                row["bytes_ratio"] = row["frame_bytes"] / baseline["frame_bytes"]
+    return report
+
+
+def raw_format_lines(variant: str, entry: Dict[str, Any]) -> List[str]:
+    """Log lines of one variant of raw_format_report()."""
+    return [
+        f"{variant} {key}: {row['size']}, {row['frame_bytes']:.0f} bytes/frame "
+        f"({row['bytes_ratio'] * 100:.0f}% of RGB565), {row['fps']} FPS"
+        for key, row in entry.items()
+        if "bytes_ratio" in row
+    ]
+
+
+def raw_tile_report(results: List[Dict[str, Any]]) -> Dict[str, Any]:
+    """Compare raw frames sent whole with changed tiles.
+
+    Args:
+        results: Results of run_all_tests()
+
+    Returns:
+        Dictionary by variant (video protocol, resolution, raw format and
+        downscale factor) with FPS, bitrate and bytes per frame sent whole and
+        as tiles, the share of changed tiles and send time of the tiles, and
+        the bytes per frame and FPS of the tiles relative to whole frames
+    """
+    report: Dict[str, Any] = {}
+    for entry in results:
+        params = entry["params"]
+        if not params.get("raw_mode") or "results" not in entry:
+            continue
+        row = _summary(entry, "fps", "bitrate_mbps")
+        tiles = entry["results"].get("raw_tiles")
+        if params.get("raw_tiles") and tiles:
+            row.update(
+                {
+                    name: tiles[name]
+                    for name in ("frame_bytes", "changed_ratio", "refreshes", "send_us")
+                }
+            )
+        else:
+            row["frame_bytes"] = (
+                entry["results"].get("raw_frames", {}).get("frame_bytes")
+            )
+        variant = _variant(
+            params,
+            (
+                "video_protocol",
+                "resolution",
+                ("raw_format", "rgb565"),
+                ("raw_scale", 1),
+            ),
+        )
+        report.setdefault(variant, {})[
+            "tiles" if params.get("raw_tiles") else "frames"
+        ] = row
+
+    for variant in list(report):
+        entry = report[variant]
+        if "tiles" not in entry:
+            del report[variant]
+            continue
+        frames, tiles = entry.get("frames", {}), entry["tiles"]
+        if frames.get("frame_bytes") and tiles["frame_bytes"] is not None:
+            entry["bytes_ratio"] = tiles["frame_bytes"] / frames["frame_bytes"]
+        if frames.get("fps") and tiles["fps"]:
+            entry["fps_gain"] = tiles["fps"] / frames["fps"]
+    return report
+
+
+def raw_tile_lines(variant: str, entry: Dict[str, Any]) -> List[str]:
+    """Log lines of one variant of raw_tile_report()."""
+    if "bytes_ratio" not in entry:
+        return []
+    return [
+        f"{variant}: tiles send {entry['bytes_ratio'] * 100:.0f}% of the frame "
+        f"bytes, {entry['tiles']['fps']} FPS "
+        f"(whole {entry.get('frames', {}).get('fps')})"
+    ]
+
+
+def jpeg_encoder_report(results: List[Dict[str, Any]]) -> Dict[str, Any]:
+    """Compare the sensor JPEG encoder with the software encoder.
+
+    Args:
+        results: Results of run_all_tests()
+
+    Returns:
+        Dictionary by variant (video protocol, resolution, quality) with
+        FPS, frame size and estimated IJG quality of both encoders, the
+        encode time of the software encoder and its FPS relative to the
+        sensor
+    """
+    report: Dict[str, Any] = {}
+    for entry in results:
+        params = entry["params"]
+        encoder = params.get("jpeg_encoder")
+        if not encoder or "results" not in entry:
+            continue
+        sample = entry["results"].get("jpeg", {})
+        row = _summary(entry, "fps")
+        row.update(
+            {
+                "frame_bytes": sample.get("frame_bytes"),
+                "estimated_quality": sample.get("quality"),
+            }
+        )
+        soft = entry["results"].get("soft_jpeg")
+        if soft:
+            row.update({"encode_ms": soft["encode_ms"], "starved": soft["starved"]})
+        variant = _variant(params, ("video_protocol", "resolution", "quality"))
+        report.setdefault(variant, {})[encoder] = row
+
+    for entry in report.values():
+        hardware, software = entry.get("hardware", {}), entry.get("software", {})
+        if hardware.get("fps") and software.get("fps"):
+            entry["software_fps_ratio"] = software["fps"] / hardware["fps"]
+    return report
+
+
+def jpeg_encoder_lines(variant: str, entry: Dict[str, Any]) -> List[str]:
+    """Log lines of one variant of jpeg_encoder_report()."""
+    if "software_fps_ratio" not in entry:
+        return []
+    return [
+        f"{variant}: software JPEG at {entry['software_fps_ratio'] * 100:.0f}% of "
+        f"sensor FPS, quality {entry['software']['estimated_quality']} vs "
+        f"{entry['hardware']['estimated_quality']}"
+    ]
+
+
+def motion_report(results: List[Dict[str, Any]]) -> Dict[str, Any]:
+    """Compare fixed-rate streaming with the motion-adaptive rate.
+
+    Args:
+        results: Results of run_all_tests()
+
+    Returns:
+        Dictionary by variant (video protocol, resolution, quality, raw mode)
+        with FPS and bitrate at the fixed and at the adaptive rate, the frames
+        sent and scoring time of the detector and the bitrate saved
+    """
+    report: Dict[str, Any] = {}
+    for entry in results:
+        params = entry["params"]
+        if "results" not in entry:
+            continue
+        row = _summary(entry, "fps", "bitrate_mbps")
+        detector = entry["results"].get("motion")
+        if params.get("motion_adaptive") and detector:
+            row.update(
+                {
+                    name: detector[name]
+                    for name in ("sent_ratio", "events", "analyze_us")
+                }
+            )
+        variant = _variant(
+            params, ("video_protocol", "resolution", "quality", "raw_mode")
+        )
+        report.setdefault(variant, {})[
+            "adaptive" if params.get("motion_adaptive") else "fixed"
+        ] = row
+
+    for variant in list(report):
+        entry = report[variant]
+        if "adaptive" not in entry:
+            del report[variant]
+            continue
+        fixed, adaptive = entry.get("fixed", {}), entry["adaptive"]
+        if fixed.get("bitrate_mbps") and adaptive["bitrate_mbps"] is not None:
+            entry["bitrate_saved"] = (
+                1 - adaptive["bitrate_mbps"] / fixed["bitrate_mbps"]
+            )
+    return report
+
+
+def motion_lines(variant: str, entry: Dict[str, Any]) -> List[str]:
+    """Log lines of one variant of motion_report()."""
+    if "bitrate_saved" not in entry:
+        return []
+    return [
+        f"{variant}: motion-adaptive rate saves {entry['bitrate_saved'] * 100:.0f}% "
+        f"bitrate, {entry['adaptive'].get('sent_ratio')} of frames sent"
+    ]
+
+
+def hot_path_report(results: List[Dict[str, Any]]) -> Dict[str, Any]:
+    """Compare hot paths of flash and IRAM builds of the same variant.
+
+    Args:
+        results: Results of run_all_tests()
+
+    Returns:
+        Dictionary by variant (protocols, resolution, quality, raw mode)
+        with the hot path costs and mean FPS of the flash and IRAM builds,
+        and the speedup of every path per KB sent
+    """
+    report: Dict[str, Any] = {}
+    for entry in results:
+        params = entry["params"]
+        hot_paths = entry.get("results", {}).get("hot_paths")
+        if not hot_paths:
+            continue
+        variant = _variant(
+            params,
+            (
+                "video_protocol",
+                "control_protocol",
+                "resolution",
+                "quality",
+                "raw_mode",
+            ),
+        )
+        placement = "iram" if params.get("hot_path_iram") else "flash"
+        row = {"paths": hot_paths["paths"]}
+        row.update(_summary(entry, "fps"))
+        report.setdefault(variant, {})[placement] = row
+
+    for entry in report.values():
+        if "flash" not in entry or "iram" not in entry:
+            continue
+        speedup = {}
+        for name, flash in entry["flash"]["paths"].items():
+            iram = entry["iram"]["paths"].get(name, {})
+            if flash.get("us_per_kb") and iram.get("us_per_kb"):
+                speedup[name] = flash["us_per_kb"] / iram["us_per_kb"]
+        entry["speedup"] = speedup
+    return report
+
+
+def hot_path_lines(variant: str, entry: Dict[str, Any]) -> List[str]:
+    """Log lines of one variant of hot_path_report()."""
+    return [
+        f"{variant}: {path} {speedup:.2f}x faster per KB in IRAM"
+        for path, speedup in entry.get("speedup", {}).items()
+    ]
+
+
+def camera_buffer_report(results: List[Dict[str, Any]]) -> Dict[str, Any]:
+    """Compare frame buffer settings of the same variant.
+
+    Args:
+        results: Results of run_all_tests()
+
+    Returns:
+        Dictionary by variant (video protocol, resolution, quality, raw
+        mode) with capture FPS, client FPS, sensor frames not consumed and
+        memory of every "count/location/grab mode" setting and the setting
+        with the best capture FPS
+    """
+    report: Dict[str, Any] = {}
+    for entry in results:
+        params = entry["params"]
+        camera = entry.get("results", {}).get("camera")
+        if not camera or "capture" not in camera:
+            continue
+        variant = _variant(
+            params, ("video_protocol", "resolution", "quality", "raw_mode")
+        )
+        setting = _variant(camera, CAMERA_PARAMS)
+        capture = camera["capture"]
+        row = {"capture_fps": capture["fps"]}
+        row.update(_summary(entry, "fps"))
+        row.update(
+            {
+                name: capture[name]
+                for name in ("mean_grab_ms", "unconsumed", "bad_frames")
+            }
+        )
+        row.update(
+            {name: camera["memory"].get(name) for name in ("dram_bytes", "psram_bytes")}
+        )
+        report.setdefault(variant, {"settings": {}})["settings"][setting] = row
+
+    for entry in report.values():
+        fps = [
+            (row["capture_fps"], setting)
+            for setting, row in entry["settings"].items()
+            if row["capture_fps"] is not None
+        ]
+        entry["best_capture_fps"] = max(fps)[1] if fps else None
+    return report
+
+
+def camera_buffer_lines(variant: str, entry: Dict[str, Any]) -> List[str]:
+    """Log lines of one variant of camera_buffer_report()."""
+    return [f"{variant}: best capture FPS with {entry['best_capture_fps']} buffers"]
+
+
+def task_profile_report(results: List[Dict[str, Any]]) -> Dict[str, Any]:
+    """Compare task placement profiles for every video/control protocol pair."""
+    return profile_report(results, "task_profile")
+
+
+def profile_report(results: List[Dict[str, Any]], key: str) -> Dict[str, Any]:
+    """Compare runtime profiles for every video/control protocol pair.
+
+    Args:
+        results: Results of run_all_tests()
+        key: Test parameter holding the profile (task_profile, net_profile)
+
+    Returns:
+        Dictionary by "video/control" with mean FPS, frame time jitter
+        (p99 - p50) and control latency percentiles of every profile and
+        the best profile for FPS and for control latency
+    """
+    grouped: Dict[str, Dict[str, List[Dict[str, Any]]]] = {}
+    for entry in results:
+        params = entry["params"]
+        if "results" not in entry or not params.get(key):
+            continue
+        protocols = _variant(params, ("video_protocol", "control_protocol"))
+        metrics = entry["results"].get("summary", {}).get("metrics", {})
+        grouped.setdefault(protocols, {}).setdefault(params[key], []).append(metrics)
+
+    def mean(values):
+        values = [v for v in values if v is not None]
+        return sum(values) / len(values) if values else None
+
+    def value(metrics, name):
+        return metrics[name]["value"] if name in metrics else None
+
+    report = {}
+    for protocols, profiles in grouped.items():
+        rows = {}
+        for profile, runs in profiles.items():
+            rows[profile] = {
+                "tests": len(runs),
+                "fps": mean(value(m, "fps") for m in runs),
+                "jitter_ms": mean(
+                    value(m, "frame_time_p99_ms") - value(m, "frame_time_p50_ms")
+                    for m in runs
+                    if "frame_time_p99_ms" in m and "frame_time_p50_ms" in m
+                ),
+                "control_latency_p50_ms": mean(
+                    value(m, "control_latency_p50_ms") for m in runs
+                ),
+                "control_latency_p99_ms": mean(
+                    value(m, "control_latency_p99_ms") for m in runs
+                ),
+            }
+        fps = [(row["fps"], p) for p, row in rows.items() if row["fps"] is not None]
+        latency = [
+            (row["control_latency_p99_ms"], p)
+            for p, row in rows.items()
+            if row["control_latency_p99_ms"] is not None
+        ]
+        report[protocols] = {
+            "profiles": rows,
+            "best_fps": max(fps)[1] if fps else None,
+            "best_control_latency": min(latency)[1] if latency else None,
+        }
+    return report
+
+
+def profile_lines(name: str):
+    """Get the log line function of profile_report() for task or network profiles."""
+
+    def lines(protocols: str, entry: Dict[str, Any]) -> List[str]:
+        return [
+            f"{protocols}: best FPS with {entry['best_fps']} {name} profile, "
+            f"best control latency with {entry['best_control_latency']}"
+        ]
+
+    return lines
@@ -0,0 +1,451 @@
+"""Adaptive Pareto-frontier search over the benchmark parameter space.
+
+Instead of running the full Cartesian product of test parameters, the search
+measures a coarse grid first and then only refines around configurations on
+the Pareto frontier of the objectives (FPS, control latency, bitrate, image
+quality), until the run budget is spent or the frontier stops changing.
+"""
+
+import json
+import random
+from dataclasses import dataclass
+from datetime import datetime
+from pathlib import Path
+from typing import Any, Callable, Dict, List, Optional, Sequence, Tuple
+
+Point = Tuple[int, ...]
+
+
+@dataclass(frozen=True)
+class Axis:
+    """One dimension of the parameter space."""
+
+    name: str
+    values: Tuple[Any, ...]
+    ordinal: bool  # neighbouring values are similar (resolution, quality)
+
+
+@dataclass(frozen=True)
+class Objective:
+    """Objective of the search."""
+
+    name: str
+    maximize: bool
+
+
+# Objectives computed from the parameters rather than measured
+PARAM_OBJECTIVES = {
+    "pixels": lambda params, cfg: (
+        cfg["camera_resolutions"][params["resolution"]][0]
+        * cfg["camera_resolutions"][params["resolution"]][1]
+    ),
+    "jpeg_quality": lambda params, cfg: params["quality"],
+}
+
+DEFAULT_OBJECTIVES = {
+    "fps": "max",
+    "control_latency_p50_ms": "min",
+    "bitrate_mbps": "min",
+    "pixels": "max",
+    "jpeg_quality": "min",  # lower JPEG quality value means better image
+}
+
+
+class ParamSpace:
+    """Grid of test parameters with coarse sampling and neighbourhoods."""
+
+    def __init__(self, axes: Sequence[Axis], fixed: Optional[Dict[str, Any]] = None):
+        self.axes = list(axes)
+        self.fixed = fixed or {}
+
+    def params(self, point: Point) -> Dict[str, Any]:
+        """Get test parameters of a point."""
+        params = {axis.name: axis.values[i] for axis, i in zip(self.axes, point)}
+        params.update(self.fixed)
+        return params
+
+    def valid(self, point: Point) -> bool:
+        """Check whether a point can be tested."""
+        params = self.params(point)
+        # HTTP MJPEG has no RAW mode; raw formats, downscaling, the raw frame
+        # codec (RGB565 only) and changed tiles (UDP only, not with the codec)
+        # exist in RAW mode and the software JPEG encoder only outside of it
+        raw_format = params.get("raw_format", "rgb565")
+        if not params.get("raw_mode") and (
+            params.get("raw_codec")
+            or params.get("raw_tiles")
+            or raw_format != "rgb565"
+            or params.get("raw_scale", 1) > 1
+        ):
+            return False
+        if params.get("raw_codec") and raw_format != "rgb565":
+            return False
+        if params.get("raw_tiles") and (
+            params.get("raw_codec") or params.get("video_protocol") != "UDP"
+        ):
+            return False
+        if params.get("jpeg_encoder") == "software" and params.get("raw_mode"):
+            return False
+        return not (params.get("raw_mode") and params.get("video_protocol") == "HTTP")
+
+    def coarse(self, levels: int = 3) -> List[Point]:
+        """Get coarse grid: evenly spaced values of ordinal axes, all categories."""
+        choices = []
+        for axis in self.axes:
+            count = len(axis.values)
+            if axis.ordinal and count > levels:
+                choices.append(
+                    sorted(
+                        {round(i * (count - 1) / (levels - 1)) for i in range(levels)}
+                    )
+                )
+            else:
+                choices.append(list(range(count)))
+
+        points: List[Point] = [()]
+        for indices in choices:
+            points = [p + (i,) for p in points for i in indices]
+        return [p for p in points if self.valid(p)]
+
+    def neighbours(self, point: Point, steps: Sequence[int]) -> List[Point]:
+        """Get valid neighbours of a point.
+
+        Ordinal axes move by their current step in both directions,
+        categorical axes switch to every other value one axis at a time.
+        """
+        result = []
+        for axis_index, axis in enumerate(self.axes):
+            if axis.ordinal:
+                candidates = [
+                    point[axis_index] - steps[axis_index],
+                    point[axis_index] + steps[axis_index],
+                ]
+            else:
+                candidates = range(len(axis.values))
+            for value in candidates:
+                if value == point[axis_index] or not 0 <= value < len(axis.values):
+                    continue
+                neighbour = point[:axis_index] + (value,) + point[axis_index + 1 :]
+                if self.valid(neighbour):
+                    result.append(neighbour)
+        return result
+
+    def coarse_steps(self, levels: int = 3) -> List[int]:
+        """Get distance between coarse values of every axis."""
+        return [
+            max(1, (len(axis.values) - 1) // (levels - 1)) if axis.ordinal else 1
+            for axis in self.axes
+        ]
+
+
+def dominates(
+    a: Dict[str, float], b: Dict[str, float], objectives: Sequence[Objective]
+) -> bool:
+    """Check whether objective values a Pareto-dominate b."""
+    better = False
+    for objective in objectives:
+        x, y = a[objective.name], b[objective.name]
+        if not objective.maximize:
+            x, y = -x, -y
+        if x < y:
+            return False
+        better = better or x > y
+    return better
+
+
+def pareto_front(
+    evaluated: Dict[Point, Dict[str, float]], objectives: Sequence[Objective]
+) -> List[Point]:
+    """Get points that are not dominated by any other evaluated point."""
+    return [
+        point
+        for point, values in evaluated.items()
+        if not any(
+            dominates(other, values, objectives)
+            for other_point, other in evaluated.items()
+            if other_point != point
+        )
+    ]
+
+
+class ParetoSearch:
+    """Budgeted coarse-to-fine search of the Pareto frontier."""
+
+    def __init__(
+        self,
+        space: ParamSpace,
+        evaluate: Callable[[List[Dict[str, Any]]], List[Optional[Dict[str, float]]]],
+        objectives: Sequence[Objective],
+        budget: int,
+        *,
+        levels: int = 3,
+        seed: int = 0,
+        logger: Any = None,
+    ):
+        """Initialize search.
+
+        Args:
+            space: Parameter space
+            evaluate: Runs a batch of parameter sets and returns objective values
+                for each of them (None when a run failed)
+            objectives: Objectives of the frontier
+            budget: Maximum number of runs
+            levels: Number of values of ordinal axes in the coarse grid
+            seed: Random seed for sampling the coarse grid when it exceeds the budget
+            logger: Logger instance
+        """
+        self.space = space
+        self.evaluate = evaluate
+        self.objectives = list(objectives)
+        self.budget = budget
+        self.levels = levels
+        self.random = random.Random(seed)
+        self.logger = logger
+        self.evaluated: Dict[Point, Dict[str, float]] = {}
+        self.failed: List[Point] = []
+        self.rounds = 0
+
+    @property
+    def runs(self) -> int:
+        """Number of runs spent."""
+        return len(self.evaluated) + len(self.failed)
+
+    def _run_batch(self, points: List[Point]) -> None:
+        points = points[: self.budget - self.runs]
+        if not points:
+            return
+        self.rounds += 1
+        if self.logger:
+            self.logger.info(
+                "Search round %d: %d runs (%d/%d used)",
+                self.rounds,
+                len(points),
+                self.runs,
+                self.budget,
+            )
+        for point, values in zip(
+            points, self.evaluate([self.space.params(p) for p in points])
+        ):
+            if values is None:
+                self.failed.append(point)
+            else:
+                self.evaluated[point] = values
+
+    def run(self) -> List[Point]:
+        """Run the search.
+
+        Returns:
+            Points of the Pareto frontier
+        """
+        coarse = self.space.coarse(self.levels)
+        # Keep at least half of the budget for refinement
+        if len(coarse) > self.budget // 2:
+            coarse = self.random.sample(coarse, max(1, self.budget // 2))
+        self._run_batch(coarse)
+
+        steps = self.space.coarse_steps(self.levels)
+        while self.runs < self.budget:
+            front = pareto_front(self.evaluated, self.objectives)
+            tried = set(self.evaluated) | set(self.failed)
+            candidates = []
+            for point in front:
+                for neighbour in self.space.neighbours(point, steps):
+                    if neighbour not in tried and neighbour not in candidates:
+                        candidates.append(neighbour)
+
+            if not candidates:
+                if all(step == 1 for step in steps):
+                    break
+                steps = [max(1, step // 2) for step in steps]
+                continue
+
+            self._run_batch(candidates)
+            steps = [max(1, step // 2) for step in steps]
+
+        return pareto_front(self.evaluated, self.objectives)
+
+    def report(self, front: List[Point]) -> Dict[str, Any]:
+        """Get JSON-serializable report of the search."""
+        return {
+            "objectives": {
+                o.name: "max" if o.maximize else "min" for o in self.objectives
+            },
+            "budget": self.budget,
+            "runs": self.runs,
+            "rounds": self.rounds,
+            "frontier": [
+                {"params": self.space.params(p), "objectives": self.evaluated[p]}
+                for p in sorted(front)
+            ],
+            "evaluated": [
+                {"params": self.space.params(p), "objectives": values}
+                for p, values in sorted(self.evaluated.items())
+            ],
+            "failed": [self.space.params(p) for p in sorted(self.failed)],
+        }
+
+
+def objective_values(
+    test_params: Dict[str, Any],
+    results: Dict[str, Any],
+    objectives: Sequence[Objective],
+    config: Dict[str, Any],
+) -> Optional[Dict[str, float]]:
+    """Get objective values of a test result.
+
+    Args:
+        test_params: Test parameters
+        results: Results of run_test_combination()
+        objectives: Objectives of the search
+        config: Benchmark configuration
+
+    Returns:
+        Objective values or None if a measured objective is missing
+    """
+    values = {}
+    metrics = results.get("summary", {}).get("metrics", {})
+    for objective in objectives:
+        if objective.name in PARAM_OBJECTIVES:
+            values[objective.name] = PARAM_OBJECTIVES[objective.name](
+                test_params, config
+            )
+        elif objective.name in metrics:
+            values[objective.name] = metrics[objective.name]["value"]
+        else:
+            return None
+    return values
+
+
+def run_search(benchmark: Any, budget: Optional[int] = None) -> Path:
+    """Run Pareto search with the benchmark and save the frontier.
+
+    Args:
+        benchmark: ESPCamBenchmark instance
+        budget: Maximum number of runs, from config if None
+
+    Returns:
+        Path of the saved frontier JSON
+    """
+    cfg = benchmark.config.get("search", {})
+    combos = benchmark.config["test_combinations"]
+    space = ParamSpace(
+        [
+            Axis(
+                "video_protocol",
+                tuple(
+                    combos.get("video_protocols", benchmark.config["video_protocols"])
+                ),
+                False,
+            ),
+            Axis("control_protocol", tuple(combos["control_protocols"]), False),
+            Axis("resolution", tuple(combos["resolutions"]), True),
+            Axis("quality", tuple(sorted(combos["qualities"])), True),
+            Axis("raw_mode", (False, True), False),
+        ]
+        + (
+            [Axis("task_profile", tuple(combos["task_profiles"]), False)]
+            if combos.get("task_profiles")
+            else []
+        )
+        + (
+            [Axis("net_profile", tuple(combos["net_profiles"]), False)]
+            if combos.get("net_profiles")
+            else []
+        )
+        + (
+            [Axis("hot_path_iram", tuple(combos["hot_path_iram"]), False)]
+            if combos.get("hot_path_iram")
+            else []
+        )
+        + (
+            [Axis("raw_format", tuple(combos["raw_formats"]), False)]
+            if combos.get("raw_formats")
+            else []
+        )
+        + (
+            [Axis("raw_scale", tuple(sorted(combos["raw_scales"])), True)]
+            if combos.get("raw_scales")
+            else []
+        )
+        + (
+            [Axis("raw_codec", tuple(combos["raw_codec"]), False)]
+            if combos.get("raw_codec")
+            else []
+        )
+        + (
+            [Axis("raw_tiles", tuple(combos["raw_tiles"]), False)]
+            if combos.get("raw_tiles")
+            else []
+        )
+        + (
+            [Axis("jpeg_encoder", tuple(combos["jpeg_encoders"]), False)]
+            if combos.get("jpeg_encoders")
+            else []
+        )
+        + (
+            [Axis("motion_adaptive", tuple(combos["motion_adaptive"]), False)]
+            if combos.get("motion_adaptive")
+            else []
+        )
+        + (
+            [Axis("fb_count", tuple(sorted(combos["fb_counts"])), True)]
+            if combos.get("fb_counts")
+            else []
+        )
+        + (
+            [Axis("fb_location", tuple(combos["fb_locations"]), False)]
+            if combos.get("fb_locations")
+            else []
+        )
+        + (
+            [Axis("grab_mode", tuple(combos["grab_modes"]), False)]
+            if combos.get("grab_modes")
+            else []
+        ),
+        fixed={"metrics": True, "concurrent": combos.get("concurrent", False)},
+    )
+    objectives = [
+        Objective(name, goal == "max")
+        for name, goal in cfg.get("objectives", DEFAULT_OBJECTIVES).items()
+    ]
+
+    def evaluate(batch: List[Dict[str, Any]]) -> List[Optional[Dict[str, float]]]:
+        benchmark.firmware.build_all(batch)
+        # Run batch grouped by firmware variant so each image is flashed once
+        order = sorted(
+            range(len(batch)), key=lambda i: benchmark.firmware.variant_hash(batch[i])
+        )
+        values: List[Optional[Dict[str, float]]] = [None] * len(batch)
+        for i in order:
+            try:
+                results = benchmark.run_test_combination(batch[i])
+                values[i] = objective_values(
+                    batch[i], results, objectives, benchmark.config
+                )
+            except Exception as e:
+                benchmark.logger.error("Search run failed: %s", str(e))
+        return values
+
+    search = ParetoSearch(
+        space,
+        evaluate,
+        objectives,
+        budget or cfg.get("budget", 60),
+        levels=cfg.get("coarse_levels", 3),
+        logger=benchmark.logger,
+    )
+    front = search.run()
+
+    output_dir = Path(benchmark.config.get("results_dir", "results")) / "search"
+    output_dir.mkdir(parents=True, exist_ok=True)
+    output = output_dir / f"frontier_{datetime.now().strftime('%Y%m%d_%H%M%S')}.json"
+    with open(output, "w", encoding="utf-8") as f:
+        json.dump(search.report(front), f, indent=2)
+
+    benchmark.logger.info(
+        "Pareto frontier: %d configurations from %d runs, saved to %s",
+        len(front),
+        search.runs,
+        output,
+    )
+    return output
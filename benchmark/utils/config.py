@@ -3,7 +3,7 @@
 import os
 from datetime import datetime
 from pathlib import Path
-from typing import Any, Dict
+from typing import Any, Dict, Optional
 
 import yaml
 from dotenv import load_dotenv
@@ -33,7 +33,10 @@ def load_config(config_file: str) -> Dict[str, Any]:
 
 
 def generate_file_name(
-    test_params: Dict[str, Any], file_type: str, extension: str
+    test_params: Dict[str, Any],
+    file_type: str,
+    extension: str,
+    device_id: Optional[str] = None,
 ) -> str:
     """Generate a standardized file name with all relevant parameters.
 
@@ -41,6 +44,7 @@ def generate_file_name(
         test_params: Test parameters
         file_type: Type of file (video/metrics/log)
         extension: File extension without dot
+        device_id: Board identity, added when several boards run at once
 
     Returns:
         Formatted file name with parameters
@@ -60,5 +64,35 @@ def generate_file_name(
         params.append("metrics")
     if test_params.get("raw_mode"):
         params.append("raw")
+    if test_params.get("raw_format", "rgb565") != "rgb565":
+        params.append(test_params["raw_format"])
+    if test_params.get("raw_scale", 1) > 1:
+        params.append(f"x{test_params['raw_scale']}")
+    if test_params.get("raw_codec"):
+        params.append("codec")
+    if test_params.get("raw_tiles"):
+        params.append("tiles")
+    if test_params.get("jpeg_encoder") == "software":
+        params.append("swjpeg")
+    if test_params.get("motion_adaptive"):
+        params.append("motion")
+    if test_params.get("hot_path_iram"):
+        params.append("iram")
+    if test_params.get("task_profile"):
+        params.append(f"tp_{test_params['task_profile']}")
+    if test_params.get("net_profile"):
+        params.append(f"np_{test_params['net_profile']}")
+    if test_params.get("fb_count"):
+        params.append(f"fb{test_params['fb_count']}")
+    if test_params.get("fb_location"):
+        params.append(f"fb_{test_params['fb_location']}")
+    if test_params.get("grab_mode"):
+        params.append(f"grab_{test_params['grab_mode']}")
+    if test_params.get("concurrent"):
+        params.append("conc")
+    if test_params.get("contention"):
+        params.append(f"cont{test_params['contention']}")
+    if device_id and device_id != "unknown":
+        params.append(device_id)
 
     return f"{file_type}_{timestamp}_{'_'.join(params)}.{extension}"
@@ -0,0 +1,352 @@
+"""Runtime device control for ESP32-CAM benchmark.
+
+All transports are compiled into one firmware image, the active video and
+control transports are switched through the device HTTP API.
+"""
+
+import threading
+import time
+from typing import Any, Dict, List, Optional
+
+import requests
+
+
+def get_transport(ip_address: str, timeout: float = 5.0) -> Dict[str, Any]:
+    """Get active transports of the device.
+
+    Args:
+        ip_address: Device IP address
+        timeout: Request timeout in seconds
+
+    Returns:
+        Dictionary with active video and control protocols
+    """
+    response = requests.get(f"http://{ip_address}/transport", timeout=timeout)
+    response.raise_for_status()
+    return response.json()
+
+
+def get_info(ip_address: str, timeout: float = 5.0) -> Dict[str, Any]:
+    """Get board identity and build configuration.
+
+    Args:
+        ip_address: Device IP address
+        timeout: Request timeout in seconds
+
+    Returns:
+        Dictionary with device_id, MAC, chip and build information
+    """
+    response = requests.get(f"http://{ip_address}/info", timeout=timeout)
+    response.raise_for_status()
+    return response.json()
+
+
+def select_transport(
+    ip_address: str,
+    video_protocol: Optional[str],
+    control_protocol: Optional[str],
+    timeout: float = 10.0,
+) -> float:
+    """Switch device to the given transports and wait until they are active.
+
+    Args:
+        ip_address: Device IP address
+        video_protocol: Video protocol or None to disable video
+        control_protocol: Control protocol or None to disable control
+        timeout: Maximum time to wait for the switch in seconds
+
+    Returns:
+        Time taken by the switch in seconds
+
+    Raises:
+        RuntimeError: If the device does not switch in time
+    """
+    wanted = {
+        "video": video_protocol or "none",
+        "control": control_protocol or "none",
+    }
+    start_time = time.time()
+
+    response = requests.post(
+        f"http://{ip_address}/transport", json=wanted, timeout=timeout
+    )
+    response.raise_for_status()
+
+    while (time.time() - start_time) < timeout:
+        active = get_transport(ip_address)
+        if (
+            not active.get("pending")
+            and active.get("video", "").lower() == wanted["video"].lower()
+            and active.get("control", "").lower() == wanted["control"].lower()
+        ):
+            return time.time() - start_time
+        time.sleep(0.1)
+
+    raise RuntimeError(
+        f"Device did not switch to video={wanted['video']}, control={wanted['control']}"
+    )
+
+
+def get_tasks(ip_address: str, timeout: float = 5.0) -> Dict[str, Any]:
+    """Get task profile and placement of the device tasks.
+
+    Args:
+        ip_address: Device IP address
+        timeout: Request timeout in seconds
+
+    Returns:
+        Dictionary with active profile, available profiles and per-task
+        core, priority, free stack and iteration timing
+    """
+    response = requests.get(f"http://{ip_address}/tasks", timeout=timeout)
+    response.raise_for_status()
+    return response.json()
+
+
+def select_task_profile(ip_address: str, profile: str, timeout: float = 10.0) -> float:
+    """Switch device to a task placement profile and wait until it is active.
+
+    Args:
+        ip_address: Device IP address
+        profile: Profile name (loop, split, control_priority, video_core0)
+        timeout: Maximum time to wait for the switch in seconds
+
+    Returns:
+        Time taken by the switch in seconds
+
+    Raises:
+        RuntimeError: If the device does not switch in time
+    """
+    return _select_profile(ip_address, "tasks", profile, timeout)
+
+
+def get_network(ip_address: str, timeout: float = 5.0) -> Dict[str, Any]:
+    """Get network tuning profile and the build-time network settings.
+
+    Args:
+        ip_address: Device IP address
+        timeout: Request timeout in seconds
+
+    Returns:
+        Dictionary with active profile, power save mode, TX power, noDelay,
+        available profiles and fixed lwIP/AsyncTCP settings of the image
+    """
+    response = requests.get(f"http://{ip_address}/network", timeout=timeout)
+    response.raise_for_status()
+    return response.json()
+
+
+def select_net_profile(ip_address: str, profile: str, timeout: float = 10.0) -> float:
+    """Switch device to a network tuning profile and wait until it is active.
+
+    Args:
+        ip_address: Device IP address
+        profile: Profile name (default, throughput, latency, low_power)
+        timeout: Maximum time to wait for the switch in seconds
+
+    Returns:
+        Time taken by the switch in seconds
+
+    Raises:
+        RuntimeError: If the device does not switch in time
+    """
+    return _select_profile(ip_address, "network", profile, timeout)
+
+
+def get_wifi(ip_address: str, timeout: float = 5.0) -> Dict[str, Any]:
+    """Get WiFi link state and reconnect statistics.
+
+    Args:
+        ip_address: Device IP address
+        timeout: Request timeout in seconds
+
+    Returns:
+        Dictionary with access point, cache state, connect time, disconnect
+        and reconnect counts and the duration of the last outage
+    """
+    response = requests.get(f"http://{ip_address}/wifi", timeout=timeout)
+    response.raise_for_status()
+    return response.json()
+
+
+def drop_wifi(ip_address: str, drop_ms: int, timeout: float = 5.0) -> None:
+    """Make the device leave its access point and reconnect after drop_ms.
+
+    The device disconnects shortly after answering, the camera and the
+    transports keep running.
+    """
+    response = requests.post(
+        f"http://{ip_address}/wifi", json={"drop_ms": drop_ms}, timeout=timeout
+    )
+    response.raise_for_status()
+
+
+def get_camera(ip_address: str, timeout: float = 5.0) -> Dict[str, Any]:
+    """Get camera frame buffer settings and capture statistics.
+
+    Args:
+        ip_address: Device IP address
+        timeout: Request timeout in seconds
+
+    Returns:
+        Dictionary with buffer count, location and grab mode, memory taken by
+        the driver and capture rate, sensor frames not consumed and bad frames
+        since the settings were applied
+    """
+    response = requests.get(f"http://{ip_address}/camera", timeout=timeout)
+    response.raise_for_status()
+    return response.json()
+
+
+def select_camera(
+    ip_address: str,
+    fb_count: Optional[int] = None,
+    fb_location: Optional[str] = None,
+    grab_mode: Optional[str] = None,
+    timeout: float = 15.0,
+) -> float:
+    """Reinitialize the device camera with the given frame buffers.
+
+    Args:
+        ip_address: Device IP address
+        fb_count: Number of frame buffers (1-4), None keeps the current one
+        fb_location: Buffer location (psram, dram), None keeps the current one
+        grab_mode: Grab mode (when_empty, latest), None keeps the current one
+        timeout: Maximum time to wait for the reinitialization in seconds
+
+    Returns:
+        Time taken by the reinitialization in seconds
+
+    Raises:
+        RuntimeError: If the buffers do not fit or the device does not
+            switch in time
+    """
+    settings = {
+        "fb_count": fb_count,
+        "fb_location": fb_location,
+        "grab_mode": grab_mode,
+    }
+    settings = {key: value for key, value in settings.items() if value is not None}
+    start_time = time.time()
+    response = requests.post(
+        f"http://{ip_address}/camera", json=settings, timeout=timeout
+    )
+    response.raise_for_status()
+
+    while (time.time() - start_time) < timeout:
+        response = requests.get(f"http://{ip_address}/camera", timeout=5.0)
+        response.raise_for_status()
+        active = response.json()
+        if not active.get("pending"):
+            if active.get("error"):
+                raise RuntimeError(f"Camera buffers {settings}: {active['error']}")
+            if all(active.get(key) == value for key, value in settings.items()):
+                return time.time() - start_time
+        time.sleep(0.1)
+
+    raise RuntimeError(f"Device did not switch to camera buffers {settings}")
+
+
+def _select_profile(ip_address: str, path: str, profile: str, timeout: float) -> float:
+    """POST a profile to /<path> and poll GET /<path> until it is active."""
+    start_time = time.time()
+    response = requests.post(
+        f"http://{ip_address}/{path}", json={"profile": profile}, timeout=timeout
+    )
+    response.raise_for_status()
+
+    while (time.time() - start_time) < timeout:
+        response = requests.get(f"http://{ip_address}/{path}", timeout=5.0)
+        response.raise_for_status()
+        active = response.json()
+        if not active.get("pending") and active.get("profile") == profile:
+            return time.time() - start_time
+        time.sleep(0.1)
+
+    raise RuntimeError(f"Device did not switch to {path} profile {profile}")
+
+
+def get_metrics(ip_address: str, timeout: float = 2.0) -> Dict[str, Any]:
+    """Get device runtime metrics (heap, uptime, RSSI).
+
+    Args:
+        ip_address: Device IP address
+        timeout: Request timeout in seconds
+
+    Returns:
+        Dictionary with device metrics
+    """
+    response = requests.get(f"http://{ip_address}/metrics", timeout=timeout)
+    response.raise_for_status()
+    return response.json()
+
+
+class MetricsPoller:
+    """Polls device metrics in the background while a test runs.
+
+    Usage:
+        with MetricsPoller(ip) as poller:
+            run_test()
+        heap = poller.series("free_heap")
+    """
+
+    def __init__(self, ip_address: str, interval: float = 1.0):
+        self.ip_address = ip_address
+        self.interval = interval
+        self.samples: List[Dict[str, Any]] = []
+        self._stop = threading.Event()
+        self._thread: Optional[threading.Thread] = None
+
+    def __enter__(self) -> "MetricsPoller":
+        self._thread = threading.Thread(target=self._poll, daemon=True)
+        self._thread.start()
+        return self
+
+    def __exit__(self, *exc_info) -> None:
+        self._stop.set()
+        self._thread.join()
+
+    def _poll(self) -> None:
+        start_time = time.time()
+        while not self._stop.is_set():
+            try:
+                sample = get_metrics(self.ip_address)
+                sample["elapsed"] = time.time() - start_time
+                self.samples.append(sample)
+            except (requests.RequestException, ValueError):
+                pass
+            self._stop.wait(self.interval)
+
+    def series(self, name: str) -> List[float]:
+        """Get one value per second of the run, a failed poll repeats the last value."""
+        if not self.samples:
+            return []
+        values = []
+        index = 0
+        for second in range(int(self.samples[-1]["elapsed"]) + 1):
+            while (
+                index + 1 < len(self.samples)
+                and self.samples[index + 1]["elapsed"] < second + 1
+            ):
+                index += 1
+            values.append(self.samples[index].get(name, 0))
+        return values
+
+
+def stream_clients(samples: List[Dict[str, Any]]) -> List[Dict[str, Any]]:
+    """Get the last reported state of every viewer seen in polled metrics.
+
+    A viewer disappears from /metrics when it disconnects, so its counters
+    are taken from the last sample that still listed it.
+
+    Args:
+        samples: /metrics samples of a run
+
+    Returns:
+        Per-viewer delivered FPS, skipped frames and bytes
+    """
+    clients: Dict[tuple, Dict[str, Any]] = {}
+    for sample in samples:
+        for client in sample.get("streams", []):
+            clients[(client.get("transport"), client.get("id"))] = client
+    return list(clients.values())
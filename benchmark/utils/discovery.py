@@ -0,0 +1,102 @@
+"""Network discovery of ESP32-CAM boards.
+
+The firmware broadcasts a JSON beacon (device ID, build hash, IP, active
+transports, ports, build configuration and boot-to-ready time) on UDP port
+5002 right after boot and periodically afterwards, and answers a
+"discover" probe with a unicast beacon. Boards are found without reading
+their serial log.
+"""
+
+import json
+import socket
+import time
+from typing import Any, Callable, Dict, Optional
+
+DISCOVERY_PORT = 5002
+PROBE = b"discover"
+
+Beacon = Dict[str, Any]
+
+
+def parse_beacon(data: bytes, address: str) -> Optional[Beacon]:
+    """Parse a beacon datagram.
+
+    Args:
+        data: Datagram payload
+        address: Sender IP, used when the beacon has no IP
+
+    Returns:
+        Beacon dictionary or None if the datagram is not a board beacon
+    """
+    try:
+        beacon = json.loads(data.decode("utf-8"))
+    except (UnicodeDecodeError, ValueError):
+        return None
+    if not isinstance(beacon, dict) or beacon.get("type") != "esp32cam":
+        return None
+    if not beacon.get("ip") or beacon["ip"] == "0.0.0.0":
+        beacon["ip"] = address
+    return beacon
+
+
+def listen(
+    timeout: float = 3.0,
+    port: int = DISCOVERY_PORT,
+    probe: bool = True,
+    until: Optional[Callable[[Beacon], bool]] = None,
+) -> Dict[str, Beacon]:
+    """Collect beacons of boards on the local network.
+
+    Args:
+        timeout: Listening time in seconds
+        port: Discovery port
+        probe: Broadcast a probe so that boards answer without waiting for
+            their next periodic beacon
+        until: Stop as soon as a beacon matches this predicate
+
+    Returns:
+        Latest beacon of every board by device ID, each with the host time
+        it was received at ("received_at")
+    """
+    beacons: Dict[str, Beacon] = {}
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as sock:
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+        sock.bind(("", port))
+        if probe:
+            sock.sendto(PROBE, ("255.255.255.255", port))
+
+        deadline = time.time() + timeout
+        while (remaining := deadline - time.time()) > 0:
+            sock.settimeout(remaining)
+            try:
+                data, (address, _) = sock.recvfrom(2048)
+            except socket.timeout:
+                break
+            beacon = parse_beacon(data, address)
+            if beacon is None:
+                continue
+            beacon["received_at"] = time.time()
+            beacons[beacon.get("device_id", beacon["ip"])] = beacon
+            if until is not None and until(beacon):
+                break
+    return beacons
+
+
+def wait_for_beacon(
+    match: Callable[[Beacon], bool],
+    timeout: float = 30.0,
+    port: int = DISCOVERY_PORT,
+) -> Optional[Beacon]:
+    """Wait for the first beacon accepted by match.
+
+    Returns:
+        Beacon or None on timeout
+    """
+    beacons = listen(timeout, port, probe=True, until=match)
+    return next((b for b in beacons.values() if match(b)), None)
+
+
+def same_mac(a: Optional[str], b: Optional[str]) -> bool:
+    """Compare MAC addresses written in any case."""
+    return bool(a and b) and a.lower() == b.lower()
@@ -0,0 +1,398 @@
+"""Content-addressed firmware cache for ESP32-CAM benchmark.
+
+Every distinct build flag combination is hashed together with the firmware
+sources. Each variant is built once into its own build directory, the
+resulting images are copied into the cache and the benchmark loop only has
+to flash them.
+"""
+
+import hashlib
+import json
+import logging
+import os
+import shutil
+import subprocess
+import time
+from concurrent.futures import ThreadPoolExecutor, as_completed
+from pathlib import Path
+from typing import Any, Dict, Iterable, List, Optional, Tuple
+
+from . import serial
+
+# Files and directories that affect the produced firmware image
+FIRMWARE_SOURCES = ("src", "platformio.ini", "load_env.py")
+
+# Images produced by PlatformIO and their flash offsets
+FLASH_IMAGES = (
+    ("0x1000", "bootloader.bin"),
+    ("0x8000", "partitions.bin"),
+    ("0x10000", "firmware.bin"),
+)
+
+# Erased OTA data partition, so that a serial flash boots the first app slot
+# even if an OTA update had switched the board to the second one
+OTADATA_IMAGE = ("0xe000", "boot_app0.bin")
+OTADATA_SIZE = 0x2000
+
+UPLOAD_SPEED = 921600
+
+
+def build_flags(test_params: Dict[str, Any]) -> List[str]:
+    """Get PlatformIO build flags for test parameters.
+
+    Args:
+        test_params: Dictionary with test parameters
+
+    Returns:
+        List of -D flags
+    """
+    # Video and control protocols and task profiles are selected at runtime,
+    # so they are not part of the firmware variant
+    flags = []
+    if test_params.get("resolution"):
+        flags.append(f"-DCAMERA_RESOLUTION={test_params['resolution']}")
+    if test_params.get("quality"):
+        flags.append(f"-DJPEG_QUALITY={test_params['quality']}")
+    flags.append(f"-DENABLE_METRICS={1 if test_params.get('metrics') else 0}")
+    flags.append(f"-DRAW_MODE={1 if test_params.get('raw_mode') else 0}")
+    # Heap allocation counter, malloc and friends are wrapped at link time
+    if test_params.get("alloc_counter"):
+        flags.extend(
+            [
+                "-DALLOC_COUNTER=1",
+                "-Wl,--wrap=malloc",
+                "-Wl,--wrap=calloc",
+                "-Wl,--wrap=realloc",
+            ]
+        )
+    # Cycle and stall counters of the transport hot paths, and their placement in IRAM
+    if test_params.get("profile_hot_paths"):
+        flags.append("-DPROFILE_HOT_PATHS=1")
+    if test_params.get("hot_path_iram"):
+        flags.append("-DHOT_PATH_IRAM=1")
+    # Pixel format, downscaling, lossless compression and changed-tile streaming
+    # of raw frames; JPEG builds may encode in software from RGB565 instead of
+    # by the sensor
+    if test_params.get("raw_mode"):
+        if test_params.get("raw_format", "rgb565") != "rgb565":
+            flags.append(f"-DRAW_FORMAT={test_params['raw_format'].upper()}")
+        if test_params.get("raw_scale", 1) > 1:
+            flags.append(f"-DRAW_SCALE={test_params['raw_scale']}")
+        if test_params.get("raw_codec"):
+            flags.append("-DRAW_CODEC=1")
+        if test_params.get("raw_tiles"):
+            flags.append("-DRAW_TILES=1")
+    elif test_params.get("jpeg_encoder") == "software":
+        flags.append("-DSOFT_JPEG=1")
+    # Lower send rate of still scenes, scored by tile-based change detection
+    if test_params.get("motion_adaptive"):
+        flags.append("-DMOTION_ADAPTIVE=1")
+    # AsyncTCP pins its task when it starts, so its core is a build option
+    if test_params.get("async_tcp_core") is not None:
+        flags.append(f"-DCONFIG_ASYNC_TCP_RUNNING_CORE={test_params['async_tcp_core']}")
+    return flags
+
+
+def build_env(test_params: Dict[str, Any]) -> str:
+    """Get PlatformIO environment name for test parameters."""
+    return "esp32cam_with_metrics" if test_params.get("metrics") else "esp32cam"
+
+
+def wifi_credentials(project_dir: Path) -> Tuple[str, str]:
+    """Get the WiFi credentials load_env.py passes to the build.
+
+    Like load_env.py, values from the .env file of the project override the
+    environment and unset credentials fall back to placeholders.
+
+    Args:
+        project_dir: PlatformIO project directory
+
+    Returns:
+        SSID and password
+    """
+    values = dict(os.environ)
+    env_path = project_dir / ".env"
+    if env_path.exists():
+        for line in env_path.read_text(encoding="utf-8").splitlines():
+            line = line.strip()
+            if line and not line.startswith("#") and "=" in line:
+                key, value = line.split("=", 1)
+                values[key.strip()] = value.strip("\"'")
+    return (
+        values.get("WIFI_SSID", "your_ssid"),
+        values.get("WIFI_PASSWORD", "your_password"),
+    )
+
+
+def sources_digest(project_dir: Path) -> str:
+    """Hash all firmware sources of the project.
+
+    Args:
+        project_dir: PlatformIO project directory
+
+    Returns:
+        Hex digest of the sources
+    """
+    digest = hashlib.sha256()
+    for name in FIRMWARE_SOURCES:
+        path = project_dir / name
+        files = (
+            sorted(p for p in path.rglob("*") if p.is_file())
+            if path.is_dir()
+            else [path]
+        )
+        for file in files:
+            if not file.exists():
+                continue
+            digest.update(str(file.relative_to(project_dir)).encode())
+            digest.update(b"\0")
+            digest.update(file.read_bytes())
+            digest.update(b"\0")
+    return digest.hexdigest()
+
+
+class FirmwareCache:
+    """Builds firmware variants once and flashes cached images."""
+
+    def __init__(
+        self,
+        cache_dir: str = "results/firmware",
+        build_root: str = ".pio/variants",
+        jobs: Optional[int] = None,
+        project_dir: str = ".",
+        logger: Optional[logging.Logger] = None,
+    ):
+        """Initialize firmware cache.
+
+        Args:
+            cache_dir: Directory where built images are stored
+            build_root: Directory for per-variant PlatformIO build directories
+            jobs: Number of parallel builds (defaults to CPU count)
+            project_dir: PlatformIO project directory
+            logger: Logger instance
+        """
+        self.project_dir = Path(project_dir)
+        self.cache_dir = Path(cache_dir)
+        self.build_root = Path(build_root)
+        self.jobs = jobs or os.cpu_count() or 1
+        self.logger = logger or logging.getLogger(__name__)
+        self._sources_digest = None
+        self._flashed: Dict[str, str] = {}
+        # MAC addresses esptool reported while flashing, by serial port
+        self.macs: Dict[str, str] = {}
+
+    def variant_hash(self, test_params: Dict[str, Any]) -> str:
+        """Get content hash of the firmware variant for test parameters.
+
+        The hash covers the build environment, the sorted build flags, the
+        firmware sources and the WiFi credentials injected by load_env.py,
+        read after .env the way the build reads them.
+        """
+        if self._sources_digest is None:
+            self._sources_digest = sources_digest(self.project_dir)
+
+        ssid, password = wifi_credentials(self.project_dir)
+        key = {
+            "env": build_env(test_params),
+            "flags": sorted(build_flags(test_params)),
+            "sources": self._sources_digest,
+            "wifi": hashlib.sha256(f"{ssid}:{password}".encode()).hexdigest(),
+        }
+        return hashlib.sha256(json.dumps(key, sort_keys=True).encode()).hexdigest()[:16]
+
+    def image_dir(self, variant: str) -> Path:
+        """Get cache directory of a firmware variant."""
+        return self.cache_dir / variant
+
+    def is_cached(self, variant: str) -> bool:
+        """Check whether all images of a variant are in the cache."""
+        path = self.image_dir(variant)
+        return all(
+            (path / name).exists() for _, name in FLASH_IMAGES + (OTADATA_IMAGE,)
+        )
+
+    def firmware_image(self, test_params: Dict[str, Any]) -> Path:
+        """Get application image of a variant for OTA, building it first if needed."""
+        return self.image_dir(self.build(test_params)) / "firmware.bin"
+
+    def build(self, test_params: Dict[str, Any]) -> str:
+        """Build firmware variant into its own build directory and cache it.
+
+        Args:
+            test_params: Dictionary with test parameters
+
+        Returns:
+            Variant hash
+
+        Raises:
+            RuntimeError: If build fails
+        """
+        variant = self.variant_hash(test_params)
+        if self.is_cached(variant):
+            return variant
+
+        env_name = build_env(test_params)
+        build_dir = self.build_root / variant
+        env = os.environ.copy()
+        # The variant hash is reported by the firmware so the harness can verify
+        # which build a board is running
+        env["PLATFORMIO_BUILD_FLAGS"] = " ".join(
+            build_flags(test_params) + [f'-DBUILD_HASH=\\"{variant}\\"']
+        )
+        env["PLATFORMIO_BUILD_DIR"] = str(build_dir.resolve())
+
+        self.logger.info(
+            "Building firmware variant %s: %s", variant, env["PLATFORMIO_BUILD_FLAGS"]
+        )
+        start_time = time.time()
+        result = subprocess.run(
+            ["pio", "run", "-e", env_name],
+            cwd=self.project_dir,
+            env=env,
+            capture_output=True,
+            text=True,
+            check=False,
+        )
+        if result.returncode != 0:
+            raise RuntimeError(
+                f"Failed to build firmware variant {variant}: {result.stdout[-2000:]}"
+            )
+
+        target = self.image_dir(variant)
+        target.mkdir(parents=True, exist_ok=True)
+        for _, name in FLASH_IMAGES:
+            shutil.copy2(build_dir / env_name / name, target / name)
+        (target / OTADATA_IMAGE[1]).write_bytes(b"\xff" * OTADATA_SIZE)
+        with open(target / "manifest.json", "w", encoding="utf-8") as f:
+            json.dump(
+                {
+                    "variant": variant,
+                    "env": env_name,
+                    "flags": build_flags(test_params),
+                    "build_time": time.time() - start_time,
+                },
+                f,
+                indent=2,
+            )
+
+        self.logger.info(
+            "Firmware variant %s built in %.1f s", variant, time.time() - start_time
+        )
+        return variant
+
+    def build_all(self, combinations: Iterable[Dict[str, Any]]) -> Dict[str, str]:
+        """Build all distinct firmware variants in parallel.
+
+        Args:
+            combinations: Test parameter dictionaries
+
+        Returns:
+            Dictionary mapping variant hash to error message for failed builds
+        """
+        variants = {}
+        for test_params in combinations:
+            variant = self.variant_hash(test_params)
+            if not self.is_cached(variant):
+                variants.setdefault(variant, test_params)
+
+        if not variants:
+            self.logger.info("All firmware variants are cached")
+            return {}
+
+        # Install libraries once so parallel builds don't race on downloads
+        for env_name in sorted({build_env(p) for p in variants.values()}):
+            subprocess.run(
+                ["pio", "pkg", "install", "-e", env_name],
+                cwd=self.project_dir,
+                capture_output=True,
+                check=False,
+            )
+
+        self.logger.info(
+            "Building %d firmware variants with %d jobs", len(variants), self.jobs
+        )
+        errors = {}
+        start_time = time.time()
+        with ThreadPoolExecutor(max_workers=self.jobs) as executor:
+            futures = {
+                executor.submit(self.build, params): variant
+                for variant, params in variants.items()
+            }
+            for future in as_completed(futures):
+                try:
+                    future.result()
+                except RuntimeError as e:
+                    self.logger.error(str(e))
+                    errors[futures[future]] = str(e)
+
+        self.logger.info(
+            "Built %d firmware variants in %.1f s (%d failed)",
+            len(variants) - len(errors),
+            time.time() - start_time,
+            len(errors),
+        )
+        return errors
+
+    def is_flashed(self, test_params: Dict[str, Any], port: str) -> bool:
+        """Check whether the variant for test parameters is already on the board."""
+        return self._flashed.get(port) == self.variant_hash(test_params)
+
+    def flash(self, test_params: Dict[str, Any], port: str) -> str:
+        """Flash cached firmware variant, building it first if needed.
+
+        Flashing is skipped when the same variant is already on the device.
+
+        Args:
+            test_params: Dictionary with test parameters
+            port: Serial port of the device
+
+        Returns:
+            Variant hash
+
+        Raises:
+            RuntimeError: If build or flashing fails
+        """
+        variant = self.build(test_params)
+        if self._flashed.get(port) == variant:
+            self.logger.info("Firmware variant %s already flashed", variant)
+            return variant
+
+        image_dir = self.image_dir(variant)
+        cmd = [
+            "pio",
+            "pkg",
+            "exec",
+            "-p",
+            "tool-esptoolpy",
+            "--",
+            "esptool.py",
+            "--chip",
+            "esp32",
+            "--port",
+            port,
+            "--baud",
+            str(UPLOAD_SPEED),
+            "write_flash",
+            "-z",
+        ]
+        for offset, name in FLASH_IMAGES + (OTADATA_IMAGE,):
+            cmd.extend([offset, str(image_dir / name)])
+
+        self.logger.info("Flashing firmware variant %s to %s", variant, port)
+        self._flashed.pop(port, None)
+        try:
+            result = subprocess.run(cmd, check=True, capture_output=True, text=True)
+        except subprocess.CalledProcessError as e:
+            raise RuntimeError(f"Failed to flash firmware: {e.stdout}") from e
+
+        mac = serial.parse_mac(result.stdout)
+        if mac:
+            self.macs[port] = mac
+
+        self._flashed[port] = variant
+        return variant
+
+    def mark_flashed(self, port: Optional[str], variant: str) -> None:
+        """Record a variant installed without the serial port, e.g. over OTA."""
+        if port:
+            self._flashed[port] = variant
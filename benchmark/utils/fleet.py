@@ -0,0 +1,165 @@
+"""Multi-device fleet support for ESP32-CAM benchmark.
+
+Boards are discovered from their network beacons, on serial ports and from
+configured network addresses, the test matrix is sharded across them by firmware variant (so each board
+flashes as few images as possible) and every board runs its shard in its own
+worker thread.
+"""
+
+import logging
+import threading
+from dataclasses import dataclass, field
+from typing import Any, Callable, Dict, List, Optional
+
+import requests
+
+from . import device, discovery, serial
+
+UNKNOWN_DEVICE = "unknown"
+
+
+@dataclass
+class DeviceHandle:
+    """Board under test.
+
+    A board without a serial port is updated over OTA only, a board without
+    a known IP is found by its discovery beacon (or its serial log).
+    """
+
+    port: Optional[str] = None
+    ip: Optional[str] = None
+    device_id: str = UNKNOWN_DEVICE
+    info: Dict[str, Any] = field(default_factory=dict)
+    mac: Optional[str] = None
+    boot: Dict[str, Any] = field(default_factory=dict)  # boot-to-ready times
+    lock: threading.Lock = field(default_factory=threading.Lock, repr=False)
+
+    @property
+    def name(self) -> str:
+        """Human readable board name for logs."""
+        if self.device_id != UNKNOWN_DEVICE:
+            return self.device_id
+        return self.port or self.ip or UNKNOWN_DEVICE
+
+    def identify(self, timeout: float = 5.0) -> bool:
+        """Read board identity from the device.
+
+        Returns:
+            True if the device answered
+        """
+        if not self.ip:
+            return False
+        try:
+            self.info = device.get_info(self.ip, timeout)
+        except (requests.RequestException, ValueError):
+            return False
+        self.device_id = self.info.get("device_id", UNKNOWN_DEVICE)
+        self.mac = self.info.get("mac", self.mac)
+        return True
+
+    def matches(self, beacon: discovery.Beacon) -> bool:
+        """Check whether a discovery beacon comes from this board."""
+        if self.mac:
+            return discovery.same_mac(self.mac, beacon.get("mac"))
+        if self.device_id != UNKNOWN_DEVICE:
+            return beacon.get("device_id") == self.device_id
+        return bool(self.ip) and beacon.get("ip") == self.ip
+
+
+def discover_devices(
+    config: Dict[str, Any], logger: Optional[logging.Logger] = None
+) -> List[DeviceHandle]:
+    """Discover boards from beacons, serial ports and configured addresses.
+
+    Configured entries (``devices`` list with ``port`` and/or ``ip``) take
+    precedence, every other ESP32 serial port and every board that sends a
+    discovery beacon becomes a board of its own. Serial ports are matched to
+    beacons by the MAC address esptool reads from the board.
+
+    Args:
+        config: Benchmark configuration
+        logger: Logger instance
+
+    Returns:
+        List of boards
+    """
+    logger = logger or logging.getLogger(__name__)
+    devices = [
+        DeviceHandle(port=entry.get("port"), ip=entry.get("ip"))
+        for entry in config.get("devices") or []
+    ]
+    known_ports = {d.port for d in devices if d.port}
+    devices.extend(
+        DeviceHandle(port=port)
+        for port in serial.find_esp_ports()
+        if port not in known_ports
+    )
+    for handle in devices:
+        handle.identify()
+
+    discovery_cfg = config.get("discovery", {})
+    if discovery_cfg.get("enabled", True):
+        beacons = discovery.listen(
+            discovery_cfg.get("timeout", 3.0),
+            discovery_cfg.get("port", discovery.DISCOVERY_PORT),
+        )
+        for beacon in beacons.values():
+            handle = next((d for d in devices if d.matches(beacon)), None)
+            if handle is None:
+                # A serial board whose IP is unknown, identified by its MAC
+                for candidate in devices:
+                    if candidate.port and not candidate.ip and not candidate.mac:
+                        candidate.mac = serial.read_mac(candidate.port)
+                    if candidate.matches(beacon):
+                        handle = candidate
+                        break
+            if handle is None:
+                handle = DeviceHandle()
+                devices.append(handle)
+            handle.ip = beacon["ip"]
+            handle.identify()
+
+    for handle in devices:
+        if handle.ip:
+            logger.info("Found board %s at %s", handle.name, handle.ip)
+        else:
+            logger.info("Found board on %s", handle.port)
+    return devices
+
+
+def shard(
+    combinations: List[Dict[str, Any]],
+    count: int,
+    key: Callable[[Dict[str, Any]], str],
+) -> List[List[Dict[str, Any]]]:
+    """Split test combinations into balanced shards.
+
+    Combinations with the same firmware variant stay in one shard so that a
+    variant is flashed on a single board only, groups are assigned largest
+    first to the currently smallest shard. Only variants with more
+    combinations than a fair share of one board are split.
+
+    Args:
+        combinations: Test parameter dictionaries
+        count: Number of shards
+        key: Firmware variant of a combination
+
+    Returns:
+        List of shards, each grouped by variant
+    """
+    by_variant: Dict[str, List[Dict[str, Any]]] = {}
+    for test_params in combinations:
+        by_variant.setdefault(key(test_params), []).append(test_params)
+
+    # A variant larger than a fair share is split and flashed on several boards,
+    # otherwise one board would run most of the matrix
+    share = -(-len(combinations) // count) if count else 0
+    groups = []
+    for group in by_variant.values():
+        groups.extend(group[i : i + share] for i in range(0, len(group), share))
+    groups.sort(key=len, reverse=True)
+
+    shards: List[List[Dict[str, Any]]] = [[] for _ in range(count)]
+    for group in groups:
+        min(shards, key=len).extend(group)
+    return shards
@@ -0,0 +1,271 @@
+"""Tile-based motion detection and the motion-adaptive send rate.
+
+Port of src/motion.h with the same integer arithmetic, so frames replayed here
+get the scores and send decisions of firmware built with MOTION_ADAPTIVE=1. A
+frame is reduced to a signature of 16 x 12 tile means of its luma, the score
+is the number of tiles that changed by more than a threshold after removing
+the mean change of all tiles. The device camera cannot be fed recorded frames,
+so bandwidth saved and reaction latency are measured by replaying a corpus
+with scripted motion through this port; tests/host/motion_bench.cpp checks
+that the firmware code decides the same.
+"""
+
+from dataclasses import dataclass
+from typing import Any, Dict, Iterator, List, Optional, Sequence, Tuple
+
+import cv2
+import numpy as np
+
+TILES_X = 16
+TILES_Y = 12
+TILES = TILES_X * TILES_Y
+
+# Defaults of src/motion_rate.h
+SAMPLE_STEP = 4
+
+# (start, duration) in seconds of the motion events of the synthetic corpus
+DEFAULT_EVENTS = ((10.0, 3.0), (30.0, 1.0), (45.0, 5.0))
+
+
+@dataclass
+class MotionConfig:
+    """Detector and rate controller settings (MOTION_* build flags)."""
+
+    tile_threshold: int = 12
+    trigger_tiles: int = 2
+    min_interval_ms: int = 100  # FRAME_INTERVAL_MS
+    floor_interval_ms: int = 2000
+    hold_ms: int = 2000
+
+
+def signature(luma: np.ndarray, step: int = SAMPLE_STEP) -> np.ndarray:
+    """Get the tile means of a frame like motionSignature() does.
+
+    Args:
+        luma: 2D array of 8-bit luma
+        step: Sample every step pixels in both directions
+
+    Returns:
+        Array of TILES rounded tile means, row by row
+    """
+    height, width = luma.shape
+    sig = np.zeros(TILES, dtype=np.uint8)
+    for ty in range(TILES_Y):
+        y0, y1 = ty * height // TILES_Y, (ty + 1) * height // TILES_Y
+        for tx in range(TILES_X):
+            x0, x1 = tx * width // TILES_X, (tx + 1) * width // TILES_X
+            samples = luma[y0:y1:step, x0:x1:step]
+            count = samples.size
+            if count:
+                total = int(samples.sum(dtype=np.uint32))
+                sig[ty * TILES_X + tx] = (total + count // 2) // count
+    return sig
+
+
+def luma_rgb565(data: bytes, width: int, height: int) -> np.ndarray:
+    """Get the luma of a big-endian RGB565 frame like motionLumaRGB565()."""
+    pixels = np.frombuffer(data, dtype=">u2").reshape(height, width).astype(np.uint32)
+    red, green, blue = pixels >> 11, (pixels >> 5) & 0x3F, pixels & 0x1F
+    return ((red * 616 + green * 600 + blue * 232) >> 8).astype(np.uint8)
+
+
+def signature_from_jpeg(data: bytes) -> Optional[np.ndarray]:
+    """Get the signature of a JPEG frame from its 1/8-scale decode.
+
+    At 1/8 scale the decoder only uses the DC coefficient of every block, as
+    the firmware does. The firmware converts the decoded RGB back to luma, the
+    grayscale decode here may differ from it by one level.
+
+    Returns:
+        Tile means, None if the frame does not decode
+    """
+    luma = cv2.imdecode(
+        np.frombuffer(data, dtype=np.uint8), cv2.IMREAD_REDUCED_GRAYSCALE_8
+    )
+    return None if luma is None else signature(luma, 1)
+
+
+class MotionDetector:
+    """Scores signatures and decides which frames are sent (MotionState)."""
+
+    def __init__(self, config: Optional[MotionConfig] = None):
+        self.config = config or MotionConfig()
+        self.reference: Optional[np.ndarray] = None
+        self.started = False
+        self.score = 0
+        self.interval_ms = self.config.min_interval_ms
+        self.last_motion_ms = 0
+        self.last_sent_ms = 0
+
+    def update(self, sig: np.ndarray) -> int:
+        """Score a signature against the previous one and keep it (motionScore)."""
+        score = 0
+        if self.reference is not None:
+            diff = sig.astype(np.int32) - self.reference.astype(np.int32)
+            total = int(diff.sum())
+            shift = (abs(total) + TILES // 2) // TILES
+            shift = -shift if total < 0 else shift
+            score = int((np.abs(diff - shift) > self.config.tile_threshold).sum())
+        self.reference = sig.copy()
+        self.score = score
+        return score
+
+    def decide(self, now_ms: int) -> bool:
+        """Decide whether the frame scored last is sent (motionDecide)."""
+        config = self.config
+        if not self.started:
+            self.started = True
+            self.interval_ms = config.min_interval_ms
+            self.last_motion_ms = now_ms
+            send = True
+        elif self.score >= config.trigger_tiles:
+            self.last_motion_ms = now_ms
+            self.interval_ms = config.min_interval_ms
+            send = True
+        else:
+            send = (
+                now_ms - self.last_sent_ms + config.min_interval_ms // 2
+                >= self.interval_ms
+            )
+            if send and now_ms - self.last_motion_ms >= config.hold_ms:
+                self.interval_ms = min(self.interval_ms * 2, config.floor_interval_ms)
+        if send:
+            self.last_sent_ms = now_ms
+        return send
+
+
+@dataclass
+class ReplayFrame:
+    """Frame of a replay corpus."""
+
+    time_ms: int
+    luma: np.ndarray
+    event: Optional[int]  # index of the scripted motion shown, None if still
+
+
+def synthetic_corpus(
+    *,
+    width: int = 320,
+    height: int = 240,
+    seconds: float = 60.0,
+    interval_ms: int = 100,
+    events: Sequence[Tuple[float, float]] = DEFAULT_EVENTS,
+    seed: int = 1,
+) -> Iterator[ReplayFrame]:
+    """Generate a still scene with scripted motion events.
+
+    A textured gradient with sensor noise and a slow lighting drift (which the
+    detector must ignore) is crossed by a bright object during every event, it
+    enters and leaves the frame at the edges.
+
+    Args:
+        width: Frame width
+        height: Frame height
+        seconds: Length of the corpus
+        interval_ms: Capture interval
+        events: (start, duration) of every motion event in seconds
+        seed: Seed of the noise
+
+    Yields:
+        Frames in capture order
+    """
+    rng = np.random.default_rng(seed)
+    ys, xs = np.mgrid[0:height, 0:width]
+    texture = rng.integers(-20, 21, size=(height // 8 + 1, width // 8 + 1))
+    background = 60.0 + 120.0 * (xs + ys) / (width + height) + texture[ys // 8, xs // 8]
+    size = max(width, height) // 6
+    for index in range(int(seconds * 1000 / interval_ms)):
+        time_ms = index * interval_ms
+        drift = 15.0 * np.sin(2 * np.pi * time_ms / 40000.0)
+        frame = background + drift + rng.normal(0.0, 2.0, size=background.shape)
+        event = None
+        for number, (start, duration) in enumerate(events):
+            progress = (time_ms / 1000.0 - start) / duration
+            if 0.0 <= progress < 1.0:
+                event = number
+                # Enters at the left edge and leaves at the right one
+                x = int(progress * (width + size)) - size
+                y = (height - size) // 2
+                frame[y : y + size, max(x, 0) : max(x + size, 0)] = 230.0
+        yield ReplayFrame(time_ms, np.clip(frame, 0, 255).astype(np.uint8), event)
+
+
+def evaluate_replay(
+    frames: Sequence[ReplayFrame],
+    config: Optional[MotionConfig] = None,
+    source: str = "raw",
+    quality: int = 80,
+) -> Dict[str, Any]:
+    """Replay a corpus through the detector.
+
+    Bandwidth is measured with every frame encoded as JPEG, as a JPEG build
+    would send it. The reaction latency of an event is the time from its first
+    frame to the first frame sent because of motion.
+
+    Args:
+        frames: Corpus in capture order
+        config: Detector settings
+        source: "raw" to sign the luma directly, "jpeg" to sign the encoded
+            frame like a JPEG build does
+        quality: JPEG quality (1-100) of the encoded frames
+
+    Returns:
+        Dictionary with frames, frames sent, bytes of all and of the sent
+        frames, bandwidth saved, motion events with their reaction latency,
+        missed events, frames triggered outside events and the per-frame
+        scores and send decisions
+    """
+    detector = MotionDetector(config)
+    events: Dict[int, Dict[str, Any]] = {}
+    total_bytes = sent_bytes = sent = false_triggers = 0
+    previous_event: Optional[int] = None
+    scores: List[int] = []
+    decisions: List[bool] = []
+    for frame in frames:
+        ok, encoded = cv2.imencode(
+            ".jpg", frame.luma, [cv2.IMWRITE_JPEG_QUALITY, quality]
+        )
+        if not ok:
+            raise ValueError("JPEG encoding failed")
+        if source == "jpeg":
+            sig = signature_from_jpeg(encoded.tobytes())
+        else:
+            sig = signature(frame.luma)
+        score = detector.update(sig)
+        send = detector.decide(frame.time_ms)
+        scores.append(score)
+        decisions.append(send)
+
+        total_bytes += len(encoded)
+        if send:
+            sent += 1
+            sent_bytes += len(encoded)
+        triggered = score >= detector.config.trigger_tiles
+        shown, previous_event = previous_event, frame.event
+        if frame.event is None:
+            # The first frame after an event still changes: the object is gone
+            if triggered and shown is None:
+                false_triggers += 1
+            continue
+        event = events.setdefault(
+            frame.event, {"start_ms": frame.time_ms, "latency_ms": None}
+        )
+        if triggered and send and event["latency_ms"] is None:
+            event["latency_ms"] = frame.time_ms - event["start_ms"]
+
+    latencies = [
+        e["latency_ms"] for e in events.values() if e["latency_ms"] is not None
+    ]
+    return {
+        "frames": len(scores),
+        "sent": sent,
+        "total_bytes": total_bytes,
+        "sent_bytes": sent_bytes,
+        "bandwidth_saved": 1 - sent_bytes / total_bytes if total_bytes else None,
+        "events": [events[number] for number in sorted(events)],
+        "missed_events": len(events) - len(latencies),
+        "max_latency_ms": max(latencies) if latencies else None,
+        "false_triggers": false_triggers,
+        "scores": scores,
+        "sent_frames": decisions,
+    }
@@ -0,0 +1,161 @@
+"""OTA firmware deployment for ESP32-CAM benchmark.
+
+Cached firmware images are pushed to the board over WiFi in chunks. Each
+chunk carries its image offset, so after a dropped connection the upload
+resumes from the offset the device reports instead of starting over. The
+board verifies the image MD5 before switching to it and reports the build
+hash of the running firmware after the reboot.
+"""
+
+import hashlib
+import logging
+import time
+from pathlib import Path
+from typing import Any, Dict, Optional
+
+import requests
+
+from . import device
+
+
+class OTAError(RuntimeError):
+    """OTA update failed."""
+
+
+def _post(ip_address: str, path: str, timeout: float, **kwargs) -> Dict[str, Any]:
+    response = requests.post(f"http://{ip_address}{path}", timeout=timeout, **kwargs)
+    if response.status_code >= 500:
+        raise OTAError(f"{path} failed: {response.text}")
+    return response.json()
+
+
+def get_status(ip_address: str, timeout: float = 5.0) -> Dict[str, Any]:
+    """Get OTA session state of the device.
+
+    Returns:
+        Dictionary with active flag, written offset, image size, MD5 and
+        build hash of the running firmware
+    """
+    response = requests.get(f"http://{ip_address}/ota", timeout=timeout)
+    response.raise_for_status()
+    return response.json()
+
+
+def wait_for_build(
+    ip_address: str, build_hash: str, timeout: float = 60.0, interval: float = 1.0
+) -> Dict[str, Any]:
+    """Wait until the device runs the given build.
+
+    Returns:
+        Device info of the running firmware
+
+    Raises:
+        OTAError: If the device doesn't come back with the build in time
+    """
+    deadline = time.time() + timeout
+    info: Dict[str, Any] = {}
+    while time.time() < deadline:
+        try:
+            info = device.get_info(ip_address, timeout=interval * 2)
+            if info.get("build_hash") == build_hash:
+                return info
+        except (requests.RequestException, ValueError):
+            pass
+        time.sleep(interval)
+    raise OTAError(
+        f"Device runs build {info.get('build_hash', 'unknown')} instead of {build_hash}"
+    )
+
+
+def push_firmware(
+    ip_address: str,
+    image: Path,
+    build_hash: str,
+    *,
+    chunk_size: int = 32768,
+    retries: int = 5,
+    timeout: float = 10.0,
+    boot_timeout: float = 60.0,
+    logger: Optional[logging.Logger] = None,
+) -> Dict[str, Any]:
+    """Upload a firmware image over OTA and wait for the board to run it.
+
+    Args:
+        ip_address: Device IP address
+        image: Application image (firmware.bin)
+        build_hash: Build hash the new firmware reports
+        chunk_size: Bytes per upload request
+        retries: Number of consecutive failed requests before giving up
+        timeout: Request timeout in seconds
+        boot_timeout: Maximum time for the reboot into the new firmware
+        logger: Logger instance
+
+    Returns:
+        Dictionary with upload time, boot time, resumes and device info
+
+    Raises:
+        OTAError: If the upload or verification fails
+    """
+    logger = logger or logging.getLogger(__name__)
+    data = Path(image).read_bytes()
+    session = {
+        "size": len(data),
+        "md5": hashlib.md5(data).hexdigest(),
+        "build_hash": build_hash,
+    }
+
+    start_time = time.time()
+    failures = 0
+    resumes = 0
+    offset = None
+    while True:
+        try:
+            if offset is None:
+                # (Re)start or resume the session, the device tells where to continue
+                offset = _post(ip_address, "/ota/begin", timeout, json=session)[
+                    "offset"
+                ]
+            if offset >= len(data):
+                break
+            response = requests.post(
+                f"http://{ip_address}/ota/chunk",
+                params={"offset": offset},
+                data=data[offset : offset + chunk_size],
+                headers={"Content-Type": "application/octet-stream"},
+                timeout=timeout,
+            )
+            status = response.json()
+            if response.status_code >= 500:
+                raise OTAError(f"Chunk at {offset} failed: {response.text}")
+            if response.status_code == 409 or not status.get("active"):
+                raise requests.ConnectionError(f"Offset mismatch at {offset}")
+            offset = status["offset"]
+            failures = 0
+        except (requests.RequestException, ValueError, KeyError) as e:
+            failures += 1
+            if failures > retries:
+                raise OTAError(f"OTA upload failed at offset {offset}: {e}") from e
+            logger.warning("OTA upload interrupted (%s), resuming", str(e))
+            resumes += 1
+            offset = None
+            time.sleep(min(2**failures * 0.25, 5.0))
+
+    result = _post(ip_address, "/ota/end", timeout)
+    if result.get("error"):
+        raise OTAError(f"OTA finalization failed: {result['error']}")
+    upload_time = time.time() - start_time
+
+    info = wait_for_build(ip_address, build_hash, boot_timeout)
+    logger.info(
+        "OTA update to build %s: %d bytes in %.1f s, %d resumes",
+        build_hash,
+        len(data),
+        upload_time,
+        resumes,
+    )
+    return {
+        "upload_time": upload_time,
+        "boot_time": time.time() - start_time - upload_time,
+        "resumes": resumes,
+        "info": info,
+    }
@@ -0,0 +1,95 @@
+"""Decoder of the lossless RGB565 codec of RAW_MODE frames.
+
+Firmware built with RAW_CODEC=1 sends raw frames encoded by src/raw_codec.h:
+an 8-byte header ("R5", version, flags, width and height little-endian)
+followed by QOI-style operations, every pixel predicted from the one before
+it (literal pixels, small channel deltas, green-based deltas and runs).
+"""
+
+import struct
+from typing import Tuple
+
+import numpy as np
+
+MAGIC = b"R5"
+VERSION = 1
+HEADER = struct.Struct("<2sBBHH")
+
+OP_LITERAL = 0x00
+OP_DIFF = 0x40
+OP_LUMA = 0x80
+OP_RUN = 0xC0
+
+
+def is_encoded(data: bytes) -> bool:
+    """Check whether a frame is encoded, raw frames are passed unchanged."""
+    return len(data) >= HEADER.size and data[:2] == MAGIC
+
+
+def decode_rgb565(data: bytes) -> Tuple[int, int, bytes]:
+    """Decode an encoded frame.
+
+    Args:
+        data: Encoded frame including the header
+
+    Returns:
+        Width, height and the big-endian RGB565 pixels of the frame
+
+    Raises:
+        ValueError: If the frame is not encoded, has an unknown version or is
+            truncated
+    """
+    if not is_encoded(data):
+        raise ValueError("Not an encoded RGB565 frame")
+    _, version, _, width, height = HEADER.unpack_from(data)
+    if version != VERSION:
+        raise ValueError(f"Unsupported codec version {version}")
+
+    pixels = width * height
+    out = np.empty(pixels, dtype=">u2")
+    r = g = b = 0
+    pos = HEADER.size
+    index = 0
+    end = len(data)
+    while index < pixels:
+        if pos >= end:
+            raise ValueError(f"Frame truncated after {index} of {pixels} pixels")
+        op = data[pos]
+        pos += 1
+        tag = op & 0xC0
+        if tag == OP_RUN:
+            count = (op & 0x3F) + 1
+            out[index : index + count] = r << 11 | g << 5 | b
+            index += count
+            continue
+        if tag == OP_LITERAL:
+            count = op & 0x3F
+            literal = np.frombuffer(data, dtype=">u2", count=count, offset=pos)
+            out[index : index + count] = literal
+            pos += count * 2
+            index += count
+            last = int(literal[-1])
+            r, g, b = last >> 11, (last >> 5) & 0x3F, last & 0x1F
+            continue
+        if tag == OP_DIFF:
+            r = (r + ((op >> 4) & 3) - 2) & 0x1F
+            g = (g + ((op >> 2) & 3) - 2) & 0x3F
+            b = (b + (op & 3) - 2) & 0x1F
+        else:
+            dg = (op & 0x3F) - 32
+            second = data[pos]
+            pos += 1
+            r = (r + (second >> 4) - 8 + (dg >> 1)) & 0x1F
+            g = (g + dg) & 0x3F
+            b = (b + (second & 0x0F) - 8 + (dg >> 1)) & 0x1F
+        out[index] = r << 11 | g << 5 | b
+        index += 1
+
+    if index != pixels:
+        raise ValueError(f"Run beyond the end of the frame ({index} of {pixels})")
+    return width, height, out.tobytes()
+
+
+def compression_ratio(raw_bytes: int, encoded_bytes: int) -> float:
+    """Raw size divided by encoded size, 0 without data."""
+    return raw_bytes / encoded_bytes if encoded_bytes else 0.0
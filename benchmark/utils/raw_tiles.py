@@ -0,0 +1,419 @@
+"""Changed-tile streaming of RAW_MODE frames.
+
+Firmware built with RAW_TILES=1 sends raw frames over UDP as changed tiles
+(src/tile_delta.h): every datagram has a 20-byte header ("RT", version, flags,
+frame number, frame size, format, tile size, packet index and count, tiles in
+the packet, little-endian) followed by tiles, each a u16 tile index and the
+rows of the tile in the layout of the frame. Only tiles whose mean absolute
+sample difference to what the receiver holds exceeds a threshold are sent,
+with a full refresh every few frames.
+
+TileComposer is the receiver. TileEncoder is a port of the firmware encoder
+with the same arithmetic, so replays here send the datagrams the firmware
+would; tests/host/tile_delta_bench.cpp checks that byte for byte. The camera
+cannot be fed recorded frames, bytes per frame and the effective raw frame
+rate are measured by replaying a corpus through the port.
+"""
+
+import math
+import struct
+from dataclasses import dataclass, field
+from typing import Any, Dict, List, Optional, Sequence
+
+import numpy as np
+
+from .motion import ReplayFrame
+
+MAGIC = b"RT"
+VERSION = 1
+FLAG_FULL = 0x01
+HEADER = struct.Struct("<2sBBIHHBBHHH")
+
+# TileFormat numbering, names of the raw_format parameter
+FORMATS = ("rgb565", "yuv422", "grayscale")
+
+# Datagram header of the whole-frame UDP protocol (UDPVideoHeader) and its
+# largest payload
+FRAME_HEADER = 16
+FRAME_PAYLOAD = 1400
+
+
+@dataclass
+class TileConfig:
+    """Tile coder settings (RAW_TILE_* build flags)."""
+
+    tile_size: int = 16
+    threshold: int = 4
+    refresh_frames: int = 50
+    packet_size: int = 1400
+
+
+@dataclass
+class TileHeader:
+    """Header of a tile datagram."""
+
+    full: bool
+    frame_number: int
+    width: int
+    height: int
+    format: str
+    tile_size: int
+    packet: int
+    packets: int
+    tiles: int
+
+
+@dataclass
+class EncodedFrame:
+    """Datagrams of one frame and the work of the encoder."""
+
+    datagrams: List[bytes] = field(default_factory=list)
+    tiles: int = 0
+    changed: int = 0
+    full: bool = False
+
+    @property
+    def size(self) -> int:
+        """Datagram bytes including headers."""
+        return sum(len(d) for d in self.datagrams)
+
+
+def bytes_per_pixel(fmt: str) -> int:
+    """Get the bytes per pixel of a raw format."""
+    return 1 if fmt == "grayscale" else 2
+
+
+def whole_frame_bytes(frame_bytes: int) -> int:
+    """Get the datagram bytes of a frame sent whole by the UDP protocol."""
+    return frame_bytes + math.ceil(frame_bytes / FRAME_PAYLOAD) * FRAME_HEADER
+
+
+def parse_header(data: bytes) -> TileHeader:
+    """Parse the header of a tile datagram.
+
+    Raises:
+        ValueError: If the datagram is not a tile datagram or has an unknown
+            version or format
+    """
+    if len(data) < HEADER.size or data[:2] != MAGIC:
+        raise ValueError("Not a tile datagram")
+    (
+        _,
+        version,
+        flags,
+        frame_number,
+        width,
+        height,
+        fmt,
+        tile_size,
+        packet,
+        packets,
+        tiles,
+    ) = HEADER.unpack_from(data)
+    if version != VERSION:
+        raise ValueError(f"Unsupported tile version {version}")
+    if fmt >= len(FORMATS):
+        raise ValueError(f"Unknown tile format {fmt}")
+    return TileHeader(
+        bool(flags & FLAG_FULL),
+        frame_number,
+        width,
+        height,
+        FORMATS[fmt],
+        tile_size,
+        packet,
+        packets,
+        tiles,
+    )
+
+
+def _tile_rect(index: int, width: int, height: int, size: int) -> Sequence[int]:
+    """Get x, y, width and height of a tile, the last column and row may be smaller."""
+    columns = (width + size - 1) // size
+    x0, y0 = index % columns * size, index // columns * size
+    return x0, y0, min(size, width - x0), min(size, height - y0)
+
+
+def _tile_sums(values: np.ndarray, size: int) -> np.ndarray:
+    """Sum a per-pixel array over tiles, row by row."""
+    height, width = values.shape
+    rows, columns = -(-height // size), -(-width // size)
+    padded = np.zeros((rows * size, columns * size), dtype=np.int64)
+    padded[:height, :width] = values
+    return padded.reshape((rows, size, columns, size)).sum(axis=(1, 3)).ravel()
+
+
+def _pixel_errors(
+    frame: np.ndarray, reference: np.ndarray, width: int, height: int, fmt: str
+) -> np.ndarray:
+    """Get the absolute sample differences of every pixel like tileExceeds()."""
+    if fmt == "rgb565":
+        a = frame.view(">u2").reshape(height, width).astype(np.int32)
+        b = reference.view(">u2").reshape(height, width).astype(np.int32)
+        return (
+            np.abs((a >> 11) - (b >> 11)) * 8
+            + np.abs(((a >> 5) & 0x3F) - ((b >> 5) & 0x3F)) * 4
+            + np.abs((a & 0x1F) - (b & 0x1F)) * 8
+        )
+    diff = np.abs(frame.astype(np.int32) - reference.astype(np.int32))
+    return diff.reshape(height, width, bytes_per_pixel(fmt)).sum(axis=2)
+
+
+def _tile_samples(width: int, height: int, fmt: str, size: int) -> np.ndarray:
+    """Get the samples of every tile, RGB565 pixels count three."""
+    per_pixel = 3 if fmt == "rgb565" else bytes_per_pixel(fmt)
+    return _tile_sums(np.full((height, width), per_pixel, dtype=np.int64), size)
+
+
+def max_tile_error(
+    frame: bytes,
+    reference: bytes,
+    width: int,
+    height: int,
+    fmt: str,
+    *,
+    size: int = 16,
+) -> float:
+    """Get the largest mean absolute sample difference of a tile between two frames.
+
+    A composed frame stays within the threshold of the camera frame in this
+    measure, and equals it after a full refresh.
+    """
+    errors = _pixel_errors(
+        np.frombuffer(frame, dtype=np.uint8),
+        np.frombuffer(reference, dtype=np.uint8),
+        width,
+        height,
+        fmt,
+    )
+    return float(
+        (_tile_sums(errors, size) / _tile_samples(width, height, fmt, size)).max()
+    )
+
+
+class TileEncoder:
+    """Encodes frames into tile datagrams like tileDeltaEncode()."""
+
+    def __init__(self, config: Optional[TileConfig] = None):
+        self.config = config or TileConfig()
+        self.reference: Optional[np.ndarray] = None
+        self.width = self.height = 0
+        self.format = ""
+        self.frame_number = 0
+        self.since_refresh = 0
+
+    def encode(self, frame: bytes, width: int, height: int, fmt: str) -> EncodedFrame:
+        """Encode a frame and keep the sent tiles as the reference.
+
+        Args:
+            frame: Raw frame, big-endian pixels for RGB565
+            width: Frame width
+            height: Frame height
+            fmt: Raw format (rgb565, yuv422, grayscale)
+
+        Returns:
+            Datagrams and work of the frame
+        """
+        config, size, bpp = self.config, self.config.tile_size, bytes_per_pixel(fmt)
+        pixels = np.frombuffer(frame, dtype=np.uint8)
+        result = EncodedFrame()
+        result.full = (
+            self.reference is None
+            or (self.width, self.height, self.format) != (width, height, fmt)
+            or self.since_refresh + 1 >= config.refresh_frames
+        )
+        samples = _tile_samples(width, height, fmt, size)
+        result.tiles = len(samples)
+        if result.full:
+            changed = np.arange(result.tiles)
+            self.reference = np.zeros(len(pixels), dtype=np.uint8)
+        else:
+            errors = _pixel_errors(pixels, self.reference, width, height, fmt)
+            changed = np.flatnonzero(
+                _tile_sums(errors, size) > config.threshold * samples
+            )
+        result.changed = len(changed)
+
+        per_packet = (config.packet_size - HEADER.size) // (2 + size * size * bpp)
+        packets = max(1, -(-len(changed) // per_packet))
+        self.frame_number = (self.frame_number + 1) & 0xFFFFFFFF
+        image = pixels.reshape(height, width * bpp)
+        reference = self.reference.reshape(height, width * bpp)
+        for number in range(packets):
+            chunk = changed[number * per_packet : (number + 1) * per_packet]
+            body = bytearray()
+            for index in chunk:
+                x0, y0, w, h = _tile_rect(int(index), width, height, size)
+                rows = image[y0 : y0 + h, x0 * bpp : (x0 + w) * bpp]
+                body += struct.pack("<H", index) + rows.tobytes()
+                reference[y0 : y0 + h, x0 * bpp : (x0 + w) * bpp] = rows
+            header = HEADER.pack(
+                MAGIC,
+                VERSION,
+                FLAG_FULL if result.full else 0,
+                self.frame_number,
+                width,
+                height,
+                FORMATS.index(fmt),
+                size,
+                number,
+                packets,
+                len(chunk),
+            )
+            result.datagrams.append(header + bytes(body))
+
+        self.width, self.height, self.format = width, height, fmt
+        self.since_refresh = 0 if result.full else self.since_refresh + 1
+        return result
+
+
+class TileComposer:
+    """Composes frames from tile datagrams (the host receiver).
+
+    Datagrams apply on their own, a lost one leaves its tiles stale until
+    they change again or the next full refresh. Frames are only returned
+    once a full refresh arrived completely, before it parts of the frame
+    were never sent.
+    """
+
+    def __init__(self):
+        self.frame: Optional[np.ndarray] = None
+        self.width = self.height = 0
+        self.format = ""
+        self.synced = False
+        self.frame_number: Optional[int] = None
+        self.received: set = set()
+        self.frames = 0
+        self.incomplete_frames = 0  # frames with datagrams missing
+
+    def feed(self, data: bytes) -> Optional[bytes]:
+        """Apply a datagram.
+
+        Args:
+            data: Tile datagram
+
+        Returns:
+            Composed frame once all datagrams of a frame arrived, None until
+            then and before the first full refresh
+        """
+        header = parse_header(data)
+        if header.frame_number != self.frame_number:
+            if self.frame_number is not None and self.received:
+                self.incomplete_frames += 1
+            self.frame_number = header.frame_number
+            self.received = set()
+        if (header.width, header.height, header.format) != (
+            self.width,
+            self.height,
+            self.format,
+        ):
+            self.width, self.height, self.format = (
+                header.width,
+                header.height,
+                header.format,
+            )
+            bpp = bytes_per_pixel(header.format)
+            self.frame = np.zeros((header.height, header.width * bpp), dtype=np.uint8)
+            self.synced = False
+
+        bpp = bytes_per_pixel(header.format)
+        pos = HEADER.size
+        for _ in range(header.tiles):
+            (index,) = struct.unpack_from("<H", data, pos)
+            x0, y0, w, h = _tile_rect(
+                index, header.width, header.height, header.tile_size
+            )
+            count = w * h * bpp
+            if pos + 2 + count > len(data):
+                raise ValueError(f"Tile {index} truncated")
+            self.frame[y0 : y0 + h, x0 * bpp : (x0 + w) * bpp] = np.frombuffer(
+                data, dtype=np.uint8, count=count, offset=pos + 2
+            ).reshape(h, w * bpp)
+            pos += 2 + count
+
+        self.received.add(header.packet)
+        if len(self.received) < header.packets:
+            return None
+        self.received = set()
+        self.synced = self.synced or header.full
+        if not self.synced:
+            return None
+        self.frames += 1
+        return self.frame.tobytes()
+
+
+def from_luma(luma: np.ndarray, fmt: str) -> bytes:
+    """Get a raw frame of a luma image: gray pixels in every format."""
+    if fmt == "grayscale":
+        return luma.tobytes()
+    if fmt == "yuv422":
+        pairs = np.stack([luma, np.full_like(luma, 128)], axis=-1)
+        return pairs.tobytes()
+    value = luma.astype(np.uint16)
+    return ((value >> 3) << 11 | (value >> 2) << 5 | value >> 3).astype(">u2").tobytes()
+
+
+def evaluate_replay(
+    frames: Sequence[ReplayFrame],
+    config: Optional[TileConfig] = None,
+    fmt: str = "rgb565",
+    link_mbps: float = 8.0,
+) -> Dict[str, Any]:
+    """Replay a corpus through the tile encoder and the composer.
+
+    The effective raw frame rate is the rate a link of link_mbps carries,
+    sent whole by the UDP protocol or as changed tiles.
+
+    Args:
+        frames: Corpus in capture order
+        config: Tile coder settings
+        fmt: Raw format the frames are sent in
+        link_mbps: Usable link throughput in Mbit/s
+
+    Returns:
+        Dictionary with frames, mean bytes per frame sent whole and as tiles,
+        the share of bytes saved, the effective raw FPS of both, full
+        refreshes, the share of changed tiles, the largest tile error of a
+        composed frame and the per-frame tile bytes
+    """
+    encoder = TileEncoder(config)
+    composer = TileComposer()
+    size = encoder.config.tile_size
+    whole = tile_bytes = refreshes = changed = tiles = 0
+    max_error = 0.0
+    per_frame: List[int] = []
+    for frame in frames:
+        height, width = frame.luma.shape
+        data = from_luma(frame.luma, fmt)
+        encoded = encoder.encode(data, width, height, fmt)
+        composed = None
+        for datagram in encoded.datagrams:
+            composed = composer.feed(datagram)
+        if composed is None:
+            raise ValueError(f"Frame at {frame.time_ms} ms was not composed")
+        max_error = max(
+            max_error, max_tile_error(composed, data, width, height, fmt, size=size)
+        )
+
+        whole += whole_frame_bytes(len(data))
+        tile_bytes += encoded.size
+        refreshes += encoded.full
+        changed += encoded.changed
+        tiles += encoded.tiles
+        per_frame.append(encoded.size)
+
+    count = len(per_frame)
+    link_bytes = link_mbps * 1e6 / 8
+    return {
+        "format": fmt,
+        "frames": count,
+        "frame_bytes": whole / count if count else None,
+        "tile_bytes": tile_bytes / count if count else None,
+        "bytes_saved": 1 - tile_bytes / whole if whole else None,
+        "frame_fps": link_bytes * count / whole if whole else None,
+        "tile_fps": link_bytes * count / tile_bytes if tile_bytes else None,
+        "refreshes": refreshes,
+        "changed_ratio": changed / tiles if tiles else None,
+        "max_tile_error": max_error,
+        "bytes_per_frame": per_frame,
+    }
@@ -4,17 +4,17 @@ import logging
 import re
 import subprocess
 import time
-from typing import Optional
+from typing import List, Optional
 
 import serial
 import serial.tools.list_ports
 
 
-def find_esp_port() -> Optional[str]:
-    """Find ESP32 COM port.
+def find_esp_ports() -> List[str]:
+    """Find all ESP32 COM ports.
 
     Returns:
-        String with port name or None if not found
+        List of port names
     """
     # Common ESP32 USB-UART bridge chips
     esp_chips = {
@@ -28,6 +28,7 @@ def find_esp_port() -> Optional[str]:
     }
 
     ports = serial.tools.list_ports.comports()
+    found = []
     logging.debug("Found serial ports:")
     for port in ports:
         logging.debug(
@@ -39,8 +40,19 @@ def find_esp_port() -> Optional[str]:
                 chip_id.lower() in port.description.lower()
                 or chip_id.lower() in port.hwid.lower()
             ):
-                return port.device
-    return None
+                found.append(port.device)
+                break
+    return found
+
+
+def find_esp_port() -> Optional[str]:
+    """Find ESP32 COM port.
+
+    Returns:
+        String with port name or None if not found
+    """
+    ports = find_esp_ports()
+    return ports[0] if ports else None
 
 
 def flash_firmware(port: str) -> None:
@@ -60,9 +72,49 @@ def flash_firmware(port: str) -> None:
         raise RuntimeError(f"Failed to flash firmware: {e.stdout}") from e
 
 
+def read_mac(port: str) -> Optional[str]:
+    """Read the WiFi MAC address of the board on a serial port.
+
+    The board is reset by esptool and boots its firmware again.
+
+    Args:
+        port: COM port of the board
+
+    Returns:
+        MAC address or None if it could not be read
+    """
+    cmd = [
+        "pio",
+        "pkg",
+        "exec",
+        "-p",
+        "tool-esptoolpy",
+        "--",
+        "esptool.py",
+        "--port",
+        port,
+        "read_mac",
+    ]
+    try:
+        result = subprocess.run(
+            cmd, check=True, capture_output=True, text=True, timeout=30
+        )
+    except (subprocess.SubprocessError, OSError):
+        return None
+    return parse_mac(result.stdout)
+
+
+def parse_mac(output: str) -> Optional[str]:
+    """Find the MAC address in esptool output."""
+    match = re.search(r"MAC:\s*([0-9a-fA-F]{2}(?::[0-9a-fA-F]{2}){5})", output)
+    return match.group(1) if match else None
+
+
 def wait_for_ip(port: str, timeout: int = 30) -> Optional[str]:
     """Wait for IP address from ESP32 serial output.
 
+    Fallback for boards whose discovery beacons don't reach the host.
+
     Args:
         port: COM port to read from
         timeout: Maximum time to wait in seconds
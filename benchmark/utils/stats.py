@@ -0,0 +1,263 @@
+"""Repetition statistics for ESP32-CAM benchmark.
+
+Runs of one parameter set are repeated until the confidence intervals of the
+target metrics are narrow enough. The warmup of every run (connection setup,
+camera auto exposure, heap fragmentation settling) is detected from the
+per-second FPS and device heap series and excluded from all statistics.
+"""
+
+from typing import Any, Dict, Iterable, List, Optional, Sequence
+
+import numpy as np
+
+
+def coefficient_of_variation(values: Sequence[float]) -> float:
+    """Get sample standard deviation relative to the mean, 0 for <2 values."""
+    if len(values) < 2 or not np.mean(values):
+        return 0.0
+    return float(np.std(values, ddof=1) / abs(np.mean(values)))
+
+
+def bootstrap_ci(
+    values: Iterable[float],
+    percentile: Optional[float] = None,
+    *,
+    confidence: float = 0.95,
+    resamples: int = 2000,
+    seed: int = 0,
+) -> Dict[str, float]:
+    """Estimate a statistic with a bootstrap confidence interval.
+
+    Args:
+        values: Sample
+        percentile: Percentile to estimate, None for the mean
+        confidence: Confidence level of the interval
+        resamples: Number of bootstrap resamples
+        seed: Random seed, fixed so that reports are reproducible
+
+    Returns:
+        Dictionary with value, ci_low, ci_high and relative half-width
+        of the interval (inf when there are fewer than 2 values)
+    """
+    values = np.asarray(list(values), dtype=float)
+    if values.size == 0:
+        return {"value": 0.0, "ci_low": 0.0, "ci_high": 0.0, "rel_halfwidth": np.inf}
+
+    def statistic(data):
+        if percentile is None:
+            return data.mean(axis=-1)
+        return np.percentile(data, percentile, axis=-1)
+
+    value = float(statistic(values))
+    if len(values) < 2:
+        return {
+            "value": value,
+            "ci_low": value,
+            "ci_high": value,
+            "rel_halfwidth": np.inf,
+        }
+
+    rng = np.random.default_rng(seed)
+    estimates = statistic(rng.choice(values, (resamples, len(values))))
+    tail = (1 - confidence) / 2
+    low = float(np.quantile(estimates, tail))
+    high = float(np.quantile(estimates, 1 - tail))
+    return {
+        "value": value,
+        "ci_low": low,
+        "ci_high": high,
+        "rel_halfwidth": (high - low) / 2 / abs(value) if value else np.inf,
+    }
+
+
+def _first_stable_window(
+    series: Sequence[float], window: int, is_stable
+) -> Optional[int]:
+    """Get start of the first window accepted by is_stable."""
+    for start in range(len(series) - window + 1):
+        if is_stable(series[start : start + window]):
+            return start
+    return None
+
+
+def detect_warmup(
+    fps: Sequence[float],
+    heap: Optional[Sequence[float]] = None,
+    *,
+    window: int = 5,
+    fps_cv: float = 0.1,
+    heap_tolerance: float = 0.02,
+) -> Dict[str, Any]:
+    """Detect how many leading seconds of a run are warmup.
+
+    The run is warm once per-second FPS has a coefficient of variation below
+    fps_cv over a sliding window and the free heap varies by less than
+    heap_tolerance over a window.
+
+    Args:
+        fps: Frames received in each second of the run
+        heap: Free heap of the device in each second of the run
+        window: Sliding window length in seconds
+        fps_cv: Maximum FPS coefficient of variation of a stable window
+        heap_tolerance: Maximum relative heap range of a stable window
+
+    Returns:
+        Dictionary with warmup length in seconds and whether a stable
+        window was found (the whole run is kept if not)
+    """
+    fps_start = _first_stable_window(
+        fps, window, lambda w: np.mean(w) > 0 and coefficient_of_variation(w) <= fps_cv
+    )
+    heap_start = 0
+    if heap:
+        heap_start = _first_stable_window(
+            heap,
+            window,
+            lambda w: (max(w) - min(w)) <= heap_tolerance * max(w),
+        )
+
+    if fps_start is None or heap_start is None:
+        return {"seconds": 0, "stable": False}
+    return {"seconds": max(fps_start, heap_start), "stable": True}
+
+
+def apply_warmup(results: Dict[str, Any], warmup_s: float) -> None:
+    """Mark the warmup part of run results.
+
+    Per-second entries inside the warmup get a "warmup" flag and the number
+    of leading frame times and control latencies to skip is recorded, so
+    that statistics and the results store only use the stable part.
+
+    Args:
+        results: Results of a single run, modified in place
+        warmup_s: Warmup length in seconds from the start of the run
+    """
+    # Per-second series start after the skipped incomplete first second
+    warmup_end = warmup_s
+    video_metrics = results.get("video")
+    if video_metrics:
+        seconds = video_metrics.get("frames_per_second", [])
+        warmup_end += min((s["second"] for s in seconds), default=0)
+        for entry in seconds:
+            entry["warmup"] = entry["second"] < warmup_end
+        video_metrics["warmup_seconds"] = warmup_s
+        video_metrics["warmup_frames"] = sum(
+            1 for t in video_metrics.get("frame_offsets_s", []) if t < warmup_end
+        )
+
+    control_metrics = results.get("control")
+    if control_metrics:
+        control_metrics["warmup_seconds"] = warmup_s
+        control_metrics["warmup_commands"] = sum(
+            1 for t in control_metrics.get("latency_offsets_s", []) if t < warmup_end
+        )
+
+
+def stable_samples(results: Dict[str, Any]) -> Dict[str, List[float]]:
+    """Get sample series of a run without its warmup.
+
+    Returns:
+        Dictionary with per-second fps and bytes, frame times and
+        control latencies
+    """
+    samples: Dict[str, List[float]] = {}
+    video_metrics = results.get("video")
+    if video_metrics:
+        seconds = [
+            s for s in video_metrics.get("frames_per_second", []) if not s.get("warmup")
+        ]
+        samples["fps"] = [s["frames"] for s in seconds]
+        if seconds and all("bytes" in s for s in seconds):
+            samples["bytes_per_second"] = [s["bytes"] for s in seconds]
+        samples["frame_time_ms"] = list(
+            video_metrics.get("frame_times_ms", [])[
+                video_metrics.get("warmup_frames", 0) :
+            ]
+        )
+
+    control_metrics = results.get("control")
+    if control_metrics:
+        samples["control_latency_ms"] = list(
+            control_metrics.get("latency", [])[
+                control_metrics.get("warmup_commands", 0) :
+            ]
+        )
+    return samples
+
+
+def summarize_runs(
+    runs: List[Dict[str, Any]], confidence: float = 0.95
+) -> Dict[str, Any]:
+    """Summarize repeated runs of one parameter set.
+
+    Mean FPS and bitrate are estimated from per-run means, so their intervals
+    reflect run-to-run variance. Percentiles are estimated from the pooled
+    stable samples of all runs.
+
+    Args:
+        runs: Results of the runs with warmup applied
+        confidence: Confidence level of the intervals
+
+    Returns:
+        Dictionary with per-metric estimates, intervals and run-to-run CV
+    """
+    per_run = [stable_samples(run) for run in runs]
+    summary: Dict[str, Any] = {"runs": len(runs), "metrics": {}}
+
+    def add(name, run_values, pooled=None, percentile=None):
+        run_values = [v for v in run_values if v is not None]
+        if pooled is None:
+            estimate = bootstrap_ci(run_values, confidence=confidence)
+        else:
+            estimate = bootstrap_ci(pooled, percentile, confidence=confidence)
+        estimate["run_cv"] = coefficient_of_variation(run_values)
+        summary["metrics"][name] = estimate
+
+    if any("fps" in s for s in per_run):
+        add("fps", [np.mean(s["fps"]) if s.get("fps") else None for s in per_run])
+    if any("bytes_per_second" in s for s in per_run):
+        add(
+            "bitrate_mbps",
+            [
+                np.mean(s["bytes_per_second"]) * 8 / (1024 * 1024)
+                if s.get("bytes_per_second")
+                else None
+                for s in per_run
+            ],
+        )
+
+    for sample, name in (
+        ("frame_time_ms", "frame_time"),
+        ("control_latency_ms", "control_latency"),
+    ):
+        if not any(s.get(sample) for s in per_run):
+            continue
+        pooled = [v for s in per_run for v in s.get(sample, [])]
+        for percentile in (50, 90, 99):
+            add(
+                f"{name}_p{percentile}_ms",
+                [
+                    np.percentile(s[sample], percentile) if s.get(sample) else None
+                    for s in per_run
+                ],
+                pooled,
+                percentile,
+            )
+    return summary
+
+
+def converged(summary: Dict[str, Any], targets: Dict[str, float]) -> bool:
+    """Check whether all target metrics meet their confidence targets.
+
+    Args:
+        summary: Result of summarize_runs()
+        targets: Maximum relative CI half-width for each metric name
+
+    Returns:
+        True if every target metric that was measured is precise enough
+    """
+    for name, target in targets.items():
+        metric = summary["metrics"].get(name)
+        if metric is not None and metric["rel_halfwidth"] > target:
+            return False
+    return True
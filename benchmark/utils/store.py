@@ -0,0 +1,424 @@
+"""Results store and cross-run regression comparison for ESP32-CAM benchmark.
+
+Every test result is ingested into a local SQLite database keyed by git
+commit, test parameters, frame corpus and device ID. Raw samples (per-second
+FPS, frame times, control latencies) are kept so that two commits can be
+compared with a bootstrap significance test instead of single numbers.
+"""
+
+import contextlib
+import json
+import sqlite3
+import subprocess
+import threading
+import time
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Any, Dict, Iterable, List, Optional, Tuple
+
+import numpy as np
+
+from . import stats
+
+SCHEMA = """
+CREATE TABLE IF NOT EXISTS runs (
+    id INTEGER PRIMARY KEY AUTOINCREMENT,
+    git_commit TEXT NOT NULL,
+    dirty INTEGER NOT NULL DEFAULT 0,
+    params_key TEXT NOT NULL,
+    params TEXT NOT NULL,
+    corpus TEXT NOT NULL,
+    device_id TEXT NOT NULL,
+    created_at REAL NOT NULL,
+    metrics_file TEXT,
+    results TEXT NOT NULL
+);
+CREATE INDEX IF NOT EXISTS runs_key ON runs (git_commit, params_key, corpus);
+CREATE TABLE IF NOT EXISTS samples (
+    run_id INTEGER NOT NULL REFERENCES runs (id) ON DELETE CASCADE,
+    metric TEXT NOT NULL,
+    value REAL NOT NULL
+);
+CREATE INDEX IF NOT EXISTS samples_run ON samples (run_id, metric);
+"""
+
+DEFAULT_CORPUS = "live"
+UNKNOWN = "unknown"
+
+
+@dataclass(frozen=True)
+class ComparedMetric:
+    """Metric compared between commits."""
+
+    name: str
+    sample: str  # sample series the statistic is computed from
+    percentile: Optional[float]  # None for the mean
+    higher_is_better: bool
+
+
+COMPARED_METRICS = (
+    ComparedMetric("fps", "fps", None, True),
+    ComparedMetric("bitrate_mbps", "bitrate_mbps", None, True),
+    ComparedMetric("frame_time_p50_ms", "frame_time_ms", 50, False),
+    ComparedMetric("frame_time_p99_ms", "frame_time_ms", 99, False),
+    ComparedMetric("control_latency_p50_ms", "control_latency_ms", 50, False),
+    ComparedMetric("control_latency_p99_ms", "control_latency_ms", 99, False),
+)
+
+
+def git_commit(cwd: str = ".") -> Tuple[str, bool]:
+    """Get current git commit and whether the work tree has local changes.
+
+    Returns:
+        Tuple of commit hash (or "unknown" outside git) and dirty flag
+    """
+    try:
+        commit = subprocess.run(
+            ["git", "rev-parse", "HEAD"],
+            cwd=cwd,
+            capture_output=True,
+            text=True,
+            check=True,
+        ).stdout.strip()
+        status = subprocess.run(
+            ["git", "status", "--porcelain", "--untracked-files=no"],
+            cwd=cwd,
+            capture_output=True,
+            text=True,
+            check=True,
+        ).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return UNKNOWN, False
+    return commit, bool(status)
+
+
+def params_key(test_params: Dict[str, Any]) -> str:
+    """Get canonical key of test parameters."""
+    return json.dumps(
+        {k: v for k, v in test_params.items() if v is not None}, sort_keys=True
+    )
+
+
+def extract_samples(results: Dict[str, Any]) -> Dict[str, List[float]]:
+    """Extract raw sample series from test results, without the warmup.
+
+    Args:
+        results: Results of run_test_combination()
+
+    Returns:
+        Dictionary mapping sample series name to values
+    """
+    samples = stats.stable_samples(results)
+    if "bytes_per_second" in samples:
+        samples["bitrate_mbps"] = [
+            b * 8 / (1024 * 1024) for b in samples.pop("bytes_per_second")
+        ]
+    elif results.get("video"):
+        # Only the run total is known, e.g. for re-encoded OpenCV captures
+        samples["bitrate_mbps"] = [results["video"].get("bitrate_mbps", 0)]
+    return samples
+
+
+def _statistic(values: np.ndarray, percentile: Optional[float]) -> np.ndarray:
+    """Compute statistic along the last axis."""
+    if percentile is None:
+        return values.mean(axis=-1)
+    return np.percentile(values, percentile, axis=-1)
+
+
+def bootstrap_difference(
+    base: Iterable[float],
+    head: Iterable[float],
+    percentile: Optional[float] = None,
+    *,
+    resamples: int = 2000,
+    confidence: float = 0.95,
+    seed: int = 0,
+) -> Dict[str, float]:
+    """Bootstrap the difference of a statistic between two samples.
+
+    Args:
+        base: Baseline sample
+        head: Compared sample
+        percentile: Percentile to compare, None for the mean
+        resamples: Number of bootstrap resamples
+        confidence: Confidence level of the interval
+        seed: Random seed, fixed so that comparisons are reproducible
+
+    Returns:
+        Dictionary with base and head statistics, difference (head - base),
+        its confidence interval and a two-sided p-value
+    """
+    base = np.asarray(list(base), dtype=float)
+    head = np.asarray(list(head), dtype=float)
+    rng = np.random.default_rng(seed)
+
+    base_stat = float(_statistic(base, percentile))
+    head_stat = float(_statistic(head, percentile))
+    diffs = _statistic(
+        rng.choice(head, (resamples, len(head))), percentile
+    ) - _statistic(rng.choice(base, (resamples, len(base))), percentile)
+
+    tail = (1 - confidence) / 2
+    p_value = 2 * min(np.mean(diffs <= 0), np.mean(diffs >= 0))
+    return {
+        "base": base_stat,
+        "head": head_stat,
+        "difference": head_stat - base_stat,
+        "ci_low": float(np.quantile(diffs, tail)),
+        "ci_high": float(np.quantile(diffs, 1 - tail)),
+        "p_value": float(min(1.0, p_value)),
+    }
+
+
+class ResultsStore:
+    """SQLite store of benchmark runs and their raw samples."""
+
+    def __init__(self, path: str = "results/results.db"):
+        """Open (and create if needed) the results database.
+
+        Args:
+            path: Database file path
+        """
+        self.path = Path(path)
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        # Boards of a fleet store their runs from their own worker threads
+        self._lock = threading.Lock()
+        self._db = sqlite3.connect(str(self.path), check_same_thread=False)
+        self._db.execute("PRAGMA foreign_keys = ON")
+        self._db.executescript(SCHEMA)
+
+    def close(self) -> None:
+        """Close the database."""
+        self._db.close()
+
+    def add_run(
+        self,
+        test_params: Dict[str, Any],
+        results: Dict[str, Any],
+        *,
+        commit: Optional[str] = None,
+        dirty: bool = False,
+        corpus: str = DEFAULT_CORPUS,
+        device_id: str = UNKNOWN,
+        metrics_file: Optional[str] = None,
+        created_at: Optional[float] = None,
+    ) -> int:
+        """Store results of one test run.
+
+        Args:
+            test_params: Test parameters
+            results: Results of run_test_combination()
+            commit: Git commit of the firmware and harness, current HEAD if None
+            dirty: Whether the work tree had local changes
+            corpus: Frame corpus the run used ("live" for the camera)
+            device_id: Identity of the board
+            metrics_file: Metrics JSON file of the run
+            created_at: Run time, now if None
+
+        Returns:
+            Run ID
+        """
+        if commit is None:
+            commit, dirty = git_commit()
+
+        with self._lock, self._db:
+            cursor = self._db.execute(
+                "INSERT INTO runs (git_commit, dirty, params_key, params, corpus,"
+                " device_id, created_at, metrics_file, results)"
+                " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)",
+                (
+                    commit,
+                    int(dirty),
+                    params_key(test_params),
+                    json.dumps(test_params),
+                    corpus,
+                    device_id,
+                    created_at if created_at is not None else time.time(),
+                    metrics_file,
+                    json.dumps(results),
+                ),
+            )
+            run_id = cursor.lastrowid
+            self._db.executemany(
+                "INSERT INTO samples (run_id, metric, value) VALUES (?, ?, ?)",
+                (
+                    (run_id, metric, float(value))
+                    for metric, values in extract_samples(results).items()
+                    for value in values
+                ),
+            )
+        return run_id
+
+    def ingest_file(self, path: str) -> List[int]:
+        """Ingest a metrics JSON file written by the benchmark.
+
+        Args:
+            path: Metrics file path
+
+        Returns:
+            IDs of the stored runs
+        """
+        with open(path, encoding="utf-8") as f:
+            data = json.load(f)
+        # Repeated tests store every run, older files hold a single run
+        runs = data["results"].get("runs", [data["results"]])
+        return [
+            self.add_run(
+                data["parameters"],
+                run,
+                commit=data.get("commit", UNKNOWN),
+                dirty=data.get("dirty", False),
+                corpus=data.get("corpus", DEFAULT_CORPUS),
+                device_id=data.get("device_id", UNKNOWN),
+                metrics_file=str(path),
+                created_at=Path(path).stat().st_mtime,
+            )
+            for run in runs
+        ]
+
+    def resolve_commit(self, ref: str) -> str:
+        """Resolve a git ref or stored commit prefix to a stored commit.
+
+        Raises:
+            ValueError: If no stored commit matches the ref
+        """
+        with contextlib.suppress(OSError, subprocess.CalledProcessError):
+            ref = subprocess.run(
+                ["git", "rev-parse", "--verify", "--quiet", f"{ref}^{{commit}}"],
+                capture_output=True,
+                text=True,
+                check=True,
+            ).stdout.strip()
+
+        rows = self._db.execute(
+            "SELECT DISTINCT git_commit FROM runs WHERE git_commit LIKE ?",
+            (f"{ref}%",),
+        ).fetchall()
+        if len(rows) != 1:
+            raise ValueError(
+                f"{'No' if not rows else 'Ambiguous'} stored results for commit {ref}"
+            )
+        return rows[0][0]
+
+    def samples(
+        self,
+        commit: str,
+        key: str,
+        corpus: str = DEFAULT_CORPUS,
+        device_id: Optional[str] = None,
+    ) -> Tuple[int, Dict[str, List[float]]]:
+        """Get pooled samples of all runs of a commit and parameter set.
+
+        Returns:
+            Tuple of run count and dictionary of sample series
+        """
+        query = (
+            "SELECT id FROM runs WHERE git_commit = ? AND params_key = ? AND corpus = ?"
+        )
+        args: List[Any] = [commit, key, corpus]
+        if device_id is not None:
+            query += " AND device_id = ?"
+            args.append(device_id)
+        run_ids = [row[0] for row in self._db.execute(query, args)]
+
+        samples: Dict[str, List[float]] = {}
+        for run_id in run_ids:
+            for metric, value in self._db.execute(
+                "SELECT metric, value FROM samples WHERE run_id = ?", (run_id,)
+            ):
+                samples.setdefault(metric, []).append(value)
+        return len(run_ids), samples
+
+    def compare(
+        self,
+        base: str,
+        head: str,
+        *,
+        corpus: str = DEFAULT_CORPUS,
+        device_id: Optional[str] = None,
+        alpha: float = 0.05,
+        min_effect: float = 0.05,
+    ) -> List[Dict[str, Any]]:
+        """Compare every parameter set measured on both commits.
+
+        A change is flagged when it is statistically significant (p < alpha)
+        and larger than min_effect relative to the baseline, so that tiny
+        differences on large samples are not reported.
+
+        Args:
+            base: Baseline git ref or commit prefix
+            head: Compared git ref or commit prefix
+            corpus: Frame corpus
+            device_id: Compare only runs of this board, all boards if None
+            alpha: Significance level
+            min_effect: Minimum relative change that is reported
+
+        Returns:
+            List of comparisons with per-metric statistics and status
+            ("regression", "improvement" or "unchanged")
+        """
+        base = self.resolve_commit(base)
+        head = self.resolve_commit(head)
+        keys = [
+            row[0]
+            for row in self._db.execute(
+                "SELECT params_key FROM runs WHERE git_commit = ? AND corpus = ?"
+                " INTERSECT"
+                " SELECT params_key FROM runs WHERE git_commit = ? AND corpus = ?"
+                " ORDER BY 1",
+                (base, corpus, head, corpus),
+            )
+        ]
+
+        comparisons = []
+        for key in keys:
+            base_runs, base_samples = self.samples(base, key, corpus, device_id)
+            head_runs, head_samples = self.samples(head, key, corpus, device_id)
+            metrics = {}
+            for metric in COMPARED_METRICS:
+                base_values = base_samples.get(metric.sample)
+                head_values = head_samples.get(metric.sample)
+                if not base_values or not head_values:
+                    continue
+                stats = bootstrap_difference(
+                    base_values, head_values, metric.percentile
+                )
+                relative = (
+                    stats["difference"] / abs(stats["base"]) if stats["base"] else 0
+                )
+                status = "unchanged"
+                if stats["p_value"] < alpha and abs(relative) >= min_effect:
+                    better = (stats["difference"] > 0) == metric.higher_is_better
+                    status = "improvement" if better else "regression"
+                metrics[metric.name] = {**stats, "relative": relative, "status": status}
+
+            comparisons.append(
+                {
+                    "params": json.loads(key),
+                    "base_runs": base_runs,
+                    "head_runs": head_runs,
+                    "metrics": metrics,
+                }
+            )
+        return comparisons
+
+
+def format_comparison(comparisons: List[Dict[str, Any]]) -> str:
+    """Format comparison results as a text report."""
+    lines = []
+    for comparison in comparisons:
+        params = comparison["params"]
+        lines.append(
+            ", ".join(f"{k}={v}" for k, v in sorted(params.items()))
+            + f" (runs: {comparison['base_runs']} -> {comparison['head_runs']})"
+        )
+        for name, metric in comparison["metrics"].items():
+            marker = {"regression": "!!", "improvement": "++"}.get(
+                metric["status"], "  "
+            )
+            lines.append(
+                f"  {marker} {name:<24} {metric['base']:10.2f} -> {metric['head']:10.2f}"
+                f" ({metric['relative']:+.1%}, p={metric['p_value']:.3f})"
+            )
+    return "\n".join(lines)
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <atomic>
+
+// Heap allocation counter for checking that steady-state command and frame handling does not
+// allocate. Enabled with -DALLOC_COUNTER=1 together with the linker flags
+// -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc (added by the benchmark for the
+// alloc_counter test parameter). Allocations are counted per task, so allocations of the
+// WiFi driver or AsyncTCP running at the same time don't show up in a scope; allocations made
+// by ESP-IDF components directly through heap_caps_malloc() are not counted.
+#ifndef ALLOC_COUNTER
+#define ALLOC_COUNTER 0
+#endif
+
+#if ALLOC_COUNTER
+static __thread uint32_t taskAllocs = 0;
+static std::atomic<uint32_t> totalAllocs{0};
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    taskAllocs++;
+    totalAllocs.fetch_add(1, std::memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    taskAllocs++;
+    totalAllocs.fetch_add(1, std::memory_order_relaxed);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    taskAllocs++;
+    totalAllocs.fetch_add(1, std::memory_order_relaxed);
+    return __real_realloc(ptr, size);
+}
+}
+
+struct AllocStats {
+    std::atomic<uint32_t> events{0};
+    std::atomic<uint32_t> allocs{0};
+    std::atomic<uint32_t> maxAllocs{0};
+};
+
+static AllocStats commandAllocs;  // control commands and signaling messages
+static AllocStats frameAllocs;    // video loop iterations, one frame each
+
+// Counts allocations of the current task from construction to the end of the scope. Scopes
+// open before the receive call, so the allocations of the network library count as well; a
+// scope that received nothing is dropped with discard().
+class AllocScope {
+   public:
+    explicit AllocScope(AllocStats& stats) : stats_(stats), start_(taskAllocs) {}
+
+    void discard() {
+        discarded_ = true;
+    }
+
+    ~AllocScope() {
+        if (discarded_) {
+            return;
+        }
+        uint32_t allocs = taskAllocs - start_;
+        stats_.events.fetch_add(1, std::memory_order_relaxed);
+        stats_.allocs.fetch_add(allocs, std::memory_order_relaxed);
+        uint32_t max = stats_.maxAllocs.load(std::memory_order_relaxed);
+        while (allocs > max && !stats_.maxAllocs.compare_exchange_weak(max, allocs)) {
+        }
+    }
+
+   private:
+    AllocStats& stats_;
+    uint32_t    start_;
+    bool        discarded_ = false;
+};
+
+#define COUNT_ALLOCS(stats) AllocScope allocScope_(stats)
+#define DISCARD_ALLOCS()    allocScope_.discard()
+
+void addAllocStats(JsonObject allocs, const char* name, const AllocStats& stats) {
+    JsonObject entry = allocs.createNestedObject(name);
+    uint32_t   count = stats.events.load();
+    entry["count"]   = count;
+    entry["allocs"]  = stats.allocs.load();
+    entry["max"]     = stats.maxAllocs.load();
+    entry["mean"]    = count ? (float) stats.allocs.load() / count : 0.0f;
+}
+
+// Allocation counters for /metrics
+void addAllocMetrics(JsonDocument& doc) {
+    JsonObject allocs = doc.createNestedObject("allocs");
+    allocs["total"]   = totalAllocs.load();
+    addAllocStats(allocs, "command", commandAllocs);
+    addAllocStats(allocs, "frame", frameAllocs);
+}
+#else
+#define COUNT_ALLOCS(stats)
+#define DISCARD_ALLOCS()
+#endif
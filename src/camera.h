@@ -2,6 +2,8 @@
 
 #include <Arduino.h>
 
+#include "esp_camera.h"
+
 // Camera control state
 static struct {
     int pan;         // -100 to 100
@@ -60,3 +62,11 @@ void camera_init() {
     digitalWrite(LED_BUILTIN, LOW);
 #endif
 }
+
+// Write the brightness to the sensor, 0..100 maps to its -2..2 range. esp_camera_init() resets
+// the sensor registers, so the camera reinitialization calls this from loop() while the service
+// tasks are stopped; control commands only update the state.
+bool camera_apply_sensor() {
+    sensor_t* sensor = esp_camera_sensor_get();
+    return sensor && sensor->set_brightness(sensor, camera_state.brightness / 25 - 2) == 0;
+}
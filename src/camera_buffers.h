@@ -0,0 +1,323 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <Preferences.h>
+
+#include "camera.h"
+#include "config.h"
+#include "esp_camera.h"
+#include "esp_heap_caps.h"
+#include "json_config.h"
+#include "raw_frames.h"
+#include "soft_jpeg.h"
+
+extern AsyncWebServer server;
+
+#define CAMERA_XSTR(x)       CAMERA_STR(x)
+#define CAMERA_STR(x)        #x
+#define CAMERA_CONCAT_(a, b) a##b
+#define CAMERA_CONCAT(a, b)  CAMERA_CONCAT_(a, b)
+
+// Camera frame buffers: count, location (PSRAM or internal DRAM) and grab mode are runtime
+// settings stored in NVS. A change reinitializes the camera driver from loop() while the
+// service tasks are stopped. If the new buffers do not fit (DRAM at larger resolutions), the
+// previous settings are restored and the error is reported by GET /camera. The sensor settings
+// of camera.h are written again after every reinitialization.
+#define CAMERA_FB_MAX 4
+
+struct CameraBuffers {
+    uint8_t              count;
+    camera_fb_location_t location;
+    camera_grab_mode_t   grabMode;
+};
+
+bool sameBuffers(const CameraBuffers& a, const CameraBuffers& b) {
+    return a.count == b.count && a.location == b.location && a.grabMode == b.grabMode;
+}
+
+static const char* const fbLocationNames[] = {"psram", "dram"};
+static const char* const grabModeNames[]   = {"when_empty", "latest"};
+
+static const CameraBuffers defaultBuffers = {2, CAMERA_FB_IN_PSRAM, CAMERA_GRAB_WHEN_EMPTY};
+
+static CameraBuffers activeBuffers        = defaultBuffers;
+static CameraBuffers pendingBuffers       = defaultBuffers;
+static volatile bool cameraBuffersPending = false;
+static bool          cameraPendingPersist = false;
+static const char*   cameraError          = nullptr;  // last failed change, nullptr if none
+
+// Internal and PSRAM memory taken by the driver with the active settings
+static size_t cameraDramBytes  = 0;
+static size_t cameraPsramBytes = 0;
+
+// Capture statistics since the active settings were applied
+static uint32_t          cameraStartMs      = 0;
+static volatile uint32_t cameraCaptures     = 0;
+static volatile uint32_t cameraGrabFailures = 0;
+static volatile uint64_t cameraGrabUs       = 0;  // time spent waiting in esp_camera_fb_get()
+static volatile uint32_t cameraUnconsumed   = 0;  // sensor frames never grabbed
+static volatile uint32_t cameraBadFrames    = 0;  // JPEG frames without start or end marker
+
+// The driver has no counters, so frames that were never grabbed are derived from the capture
+// timestamps: the shortest interval seen is the sensor frame period, and a longer gap means
+// frames in between were dropped or overwritten by the driver. That includes the frames the
+// application skips on purpose (FRAME_INTERVAL_MS pacing, a grab that waits for a newer frame,
+// no viewers), so this is not a count of overruns; compare it across settings at the same
+// pacing.
+static int64_t  cameraLastFrameUs = 0;
+static uint32_t cameraPeriodUs    = 0;
+
+void countUnconsumedFrames(const camera_fb_t* fb) {
+    int64_t stamp = (int64_t) fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+    int64_t gap   = stamp - cameraLastFrameUs;
+    if (cameraLastFrameUs && gap > 0) {
+        if (!cameraPeriodUs || gap < cameraPeriodUs) {
+            cameraPeriodUs = gap;
+        } else if (gap > cameraPeriodUs * 3 / 2) {
+            cameraUnconsumed += (gap + cameraPeriodUs / 2) / cameraPeriodUs - 1;
+        }
+    }
+    cameraLastFrameUs = stamp;
+}
+
+bool validJpeg(const camera_fb_t* fb) {
+    return fb->len >= 4 && fb->buf[0] == 0xFF && fb->buf[1] == 0xD8 &&
+           fb->buf[fb->len - 2] == 0xFF && fb->buf[fb->len - 1] == 0xD9;
+}
+
+// esp_camera_fb_get() with capture statistics, used by every transport. With SOFT_JPEG the
+// frame comes from the software encoder.
+camera_fb_t* grabFrame() {
+    uint32_t start = micros();
+#if SOFT_JPEG
+    camera_fb_t* fb = softJpegGrab();
+#else
+    camera_fb_t* fb = esp_camera_fb_get();
+#endif
+    cameraGrabUs += micros() - start;
+    if (!fb) {
+        cameraGrabFailures++;  // timeout of the driver, no frame within its wait
+        return nullptr;
+    }
+    cameraCaptures++;
+    countUnconsumedFrames(fb);
+    if (fb->format == PIXFORMAT_JPEG && !validJpeg(fb)) {
+        cameraBadFrames++;
+    }
+    return fb;
+}
+
+// Give a frame from grabFrame() back
+void returnFrame(camera_fb_t* fb) {
+#if SOFT_JPEG
+    softJpegReturn(fb);
+#else
+    esp_camera_fb_return(fb);
+#endif
+}
+
+esp_err_t startCamera(const CameraBuffers& buffers) {
+    camera_config_t config = {};
+    config.ledc_channel    = LEDC_CHANNEL_0;
+    config.ledc_timer      = LEDC_TIMER_0;
+    config.pin_d0          = Y2_GPIO_NUM;
+    config.pin_d1          = Y3_GPIO_NUM;
+    config.pin_d2          = Y4_GPIO_NUM;
+    config.pin_d3          = Y5_GPIO_NUM;
+    config.pin_d4          = Y6_GPIO_NUM;
+    config.pin_d5          = Y7_GPIO_NUM;
+    config.pin_d6          = Y8_GPIO_NUM;
+    config.pin_d7          = Y9_GPIO_NUM;
+    config.pin_xclk        = XCLK_GPIO_NUM;
+    config.pin_pclk        = PCLK_GPIO_NUM;
+    config.pin_vsync       = VSYNC_GPIO_NUM;
+    config.pin_href        = HREF_GPIO_NUM;
+    config.pin_sscb_sda    = SIOD_GPIO_NUM;
+    config.pin_sscb_scl    = SIOC_GPIO_NUM;
+    config.pin_pwdn        = PWDN_GPIO_NUM;
+    config.pin_reset       = RESET_GPIO_NUM;
+    config.xclk_freq_hz    = 20000000;
+#if RAW_MODE
+    config.pixel_format = RAW_PIXFORMAT;  // Raw format of RAW_FORMAT
+#elif SOFT_JPEG
+    config.pixel_format = PIXFORMAT_RGB565;  // Source of the software encoder
+#else
+    config.pixel_format = PIXFORMAT_JPEG;  // JPEG format for normal mode
+#endif
+    config.frame_size   = CAMERA_CONCAT(FRAMESIZE_, CAMERA_RESOLUTION);
+    config.jpeg_quality = JPEG_QUALITY;
+    config.fb_count     = buffers.count;
+    config.fb_location  = buffers.location;
+    config.grab_mode    = buffers.grabMode;
+
+    Serial.printf("Camera: %s, frame size %d, quality %d, %u buffers in %s, grab %s\n",
+                  RAW_MODE ? "RAW " CAMERA_XSTR(RAW_FORMAT) " / " CAMERA_XSTR(RAW_SCALE)
+                           : (SOFT_JPEG ? "RGB565, software JPEG" : "JPEG"),
+                  config.frame_size,
+                  config.jpeg_quality,
+                  buffers.count,
+                  fbLocationNames[buffers.location],
+                  grabModeNames[buffers.grabMode]);
+
+    size_t    freeDram  = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t    freePsram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    esp_err_t err       = esp_camera_init(&config);
+    if (err != ESP_OK) {
+        return err;
+    }
+    cameraDramBytes    = freeDram - heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    cameraPsramBytes   = freePsram - heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    activeBuffers      = buffers;
+    cameraStartMs      = millis();
+    cameraCaptures     = 0;
+    cameraGrabFailures = 0;
+    cameraGrabUs       = 0;
+    cameraUnconsumed   = 0;
+    cameraBadFrames    = 0;
+    cameraLastFrameUs  = 0;
+    cameraPeriodUs     = 0;
+    return ESP_OK;
+}
+
+void saveCameraBuffers(const CameraBuffers& buffers) {
+    Preferences prefs;
+    prefs.begin("camera", false);
+    prefs.putUChar("fb_count", buffers.count);
+    prefs.putUChar("fb_location", buffers.location);
+    prefs.putUChar("grab_mode", buffers.grabMode);
+    prefs.end();
+}
+
+CameraBuffers loadCameraBuffers() {
+    Preferences prefs;
+    prefs.begin("camera", true);
+    uint8_t count    = prefs.getUChar("fb_count", defaultBuffers.count);
+    uint8_t location = prefs.getUChar("fb_location", defaultBuffers.location);
+    uint8_t grabMode = prefs.getUChar("grab_mode", defaultBuffers.grabMode);
+    prefs.end();
+    if (count < 1 || count > CAMERA_FB_MAX || location > 1 || grabMode > 1) {
+        return defaultBuffers;
+    }
+    return {count,
+            static_cast<camera_fb_location_t>(location),
+            static_cast<camera_grab_mode_t>(grabMode)};
+}
+
+// Initialize the camera with the buffers stored in NVS, falling back to the defaults if they
+// do not fit
+bool initCamera() {
+    CameraBuffers buffers = loadCameraBuffers();
+    esp_err_t     err     = startCamera(buffers);
+    if (err != ESP_OK && !sameBuffers(buffers, defaultBuffers)) {
+        Serial.printf("Camera initialization failed with error 0x%x, using default buffers\n", err);
+        esp_camera_deinit();
+        err = startCamera(defaultBuffers);
+    }
+    if (err != ESP_OK) {
+        Serial.printf("Camera initialization failed with error 0x%x\n", err);
+        return false;
+    }
+    startSoftJpeg();
+    return true;
+}
+
+void initCameraBuffers() {
+    server.on("/camera", HTTP_GET, [](AsyncWebServerRequest* request) {
+        uint32_t elapsed  = millis() - cameraStartMs;
+        uint32_t captures = cameraCaptures;
+
+        StaticJsonDocument<768> doc;
+        doc["fb_count"]    = activeBuffers.count;
+        doc["fb_location"] = fbLocationNames[activeBuffers.location];
+        doc["grab_mode"]   = grabModeNames[activeBuffers.grabMode];
+        doc["resolution"]  = CAMERA_XSTR(CAMERA_RESOLUTION);
+        doc["pending"]     = cameraBuffersPending;
+        doc["error"]       = cameraError;
+
+        JsonObject memory            = doc.createNestedObject("memory");
+        memory["dram_bytes"]         = cameraDramBytes;
+        memory["psram_bytes"]        = cameraPsramBytes;
+        memory["free_dram"]          = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+        memory["largest_dram_block"] = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+        memory["free_psram"]         = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+
+        JsonObject capture      = doc.createNestedObject("capture");
+        capture["elapsed_ms"]   = elapsed;
+        capture["frames"]       = captures;
+        capture["failures"]     = cameraGrabFailures;
+        capture["fps"]          = elapsed ? captures * 1000.0f / elapsed : 0.0f;
+        capture["mean_grab_ms"] = captures ? cameraGrabUs / 1000.0f / captures : 0.0f;
+        capture["unconsumed"]   = cameraUnconsumed;
+        capture["bad_frames"]   = cameraBadFrames;
+
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+
+    // {"fb_count": 3, "fb_location": "dram", "grab_mode": "latest"}, missing fields keep their
+    // current value
+    onJsonConfigPost("/camera", [](JsonDocument& doc) -> const char* {
+        CameraBuffers buffers = activeBuffers;
+        if (doc.containsKey("fb_count")) {
+            int count = doc["fb_count"] | 0;
+            if (count < 1 || count > CAMERA_FB_MAX) {
+                return "fb_count must be 1..4";
+            }
+            buffers.count = count;
+        }
+        if (doc.containsKey("fb_location") &&
+            !parseName(doc["fb_location"], fbLocationNames, &buffers.location)) {
+            return "Unknown fb_location";
+        }
+        if (doc.containsKey("grab_mode") &&
+            !parseName(doc["grab_mode"], grabModeNames, &buffers.grabMode)) {
+            return "Unknown grab_mode";
+        }
+        pendingBuffers       = buffers;
+        cameraPendingPersist = doc["persist"] | true;
+        cameraBuffersPending = true;
+        return nullptr;
+    });
+}
+
+// Reinitialize the camera with buffers requested via /camera. Called from loop() while no
+// service task holds a camera frame. A failed restore of the previous buffers leaves the camera
+// stopped and is reported by GET /camera.
+void applyPendingCameraBuffers() {
+    if (!cameraBuffersPending) {
+        return;
+    }
+    if (sameBuffers(pendingBuffers, activeBuffers)) {
+        cameraError          = nullptr;
+        cameraBuffersPending = false;
+        return;  // nothing changed, keep the driver and its statistics
+    }
+    CameraBuffers previous = activeBuffers;
+    stopSoftJpeg();
+    esp_camera_deinit();
+    esp_err_t err = startCamera(pendingBuffers);
+    if (err != ESP_OK) {
+        Serial.printf("Camera reinitialization failed with error 0x%x, restoring buffers\n", err);
+        cameraError = "camera initialization failed, previous buffers restored";
+        esp_camera_deinit();
+        err = startCamera(previous);
+        if (err != ESP_OK) {
+            Serial.printf("Camera restore failed with error 0x%x\n", err);
+            cameraError          = "camera initialization failed, previous buffers not restored";
+            cameraBuffersPending = false;
+            return;
+        }
+    } else {
+        cameraError = nullptr;
+        if (cameraPendingPersist) {
+            saveCameraBuffers(pendingBuffers);
+        }
+    }
+    if (!camera_apply_sensor() && !cameraError) {
+        cameraError = "sensor settings not restored after camera reinitialization";
+    }
+    startSoftJpeg();
+    cameraBuffersPending = false;
+}
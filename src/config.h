@@ -9,6 +9,11 @@
 #define WIFI_PASS "your_password"  // Default value if not defined
 #endif
 
+// Content hash of the firmware variant, set by the benchmark firmware cache
+#ifndef BUILD_HASH
+#define BUILD_HASH "unknown"
+#endif
+
 // Camera pins for ESP32-CAM
 #define PWDN_GPIO_NUM  32
 #define RESET_GPIO_NUM -1
@@ -32,9 +37,36 @@
 #define JPEG_QUALITY 12  // 0-63, lower means higher quality
 #endif
 
+// RAW_MODE pixel format (RGB565, YUV422 or GRAYSCALE) and box downscale factor (1, 2, 4 or 8),
+// see raw_frames.h
+#ifndef RAW_FORMAT
+#define RAW_FORMAT RGB565
+#endif
+
+#ifndef RAW_SCALE
+#define RAW_SCALE 1
+#endif
+
 // Frame interval in milliseconds (1000/FPS)
 #define FRAME_INTERVAL_MS 100  // 10 FPS
 
+// Network ports of the video and control transports
+#define RTSP_PORT             8554
+#define UDP_VIDEO_PORT        5000
+#define UDP_CONTROL_PORT      5001
+#define WEBSOCKET_PORT        8080  // WebSocket control
+#define WEBRTC_SIGNALING_PORT 8081  // WebRTC signaling (WebSocket)
+#define DISCOVERY_PORT        5002  // Discovery beacons (UDP broadcast)
+
+// Discovery beacon timing: a burst right after boot, then periodic beacons
+#define DISCOVERY_INTERVAL_MS       5000
+#define DISCOVERY_BOOT_INTERVAL_MS  250
+#define DISCOVERY_BOOT_BEACONS      8
+
+// Control command handling
+#define CONTROL_BUFFER_SIZE 256
+#define CONTROL_INTERVAL_MS 10
+
 // Metrics and logging
 #if ENABLE_METRICS
 #define START_METRIC(name) uint32_t name##_start = millis()
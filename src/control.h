@@ -0,0 +1,187 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <cstdarg>
+
+#include "alloc_counter.h"
+#include "camera.h"
+#include "config.h"
+#include "profiling.h"
+#include "queue.h"
+
+// Command handling shared by the control transports. Parsing uses a StaticJsonDocument on the
+// stack and replies are precomputed or serialized into caller buffers, so parsing and applying
+// a command does not touch the heap. ALLOC_COUNTER also counts what the network library
+// allocates to deliver the command.
+static const char   CONTROL_ACK[]     = "{\"status\":\"ok\",\"received\":true}";
+static const size_t CONTROL_ACK_LEN   = sizeof(CONTROL_ACK) - 1;
+static const size_t CONTROL_STATE_MAX = 96;
+
+// Serial.printf() allocates for output longer than 64 bytes, log through a stack buffer
+void controlLog(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void controlLog(const char* format, ...) {
+    char    line[160];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (len > 0) {
+        Serial.write((const uint8_t*) line, (size_t) len < sizeof(line) ? len : sizeof(line) - 1);
+    }
+}
+
+// A parsed control command, fields missing from the JSON are not set in mask
+enum : uint8_t {
+    CONTROL_PAN        = 1,
+    CONTROL_TILT       = 2,
+    CONTROL_ZOOM       = 4,
+    CONTROL_LED        = 8,
+    CONTROL_BRIGHTNESS = 16,
+};
+
+struct ControlCommand {
+    uint8_t mask;
+    int     pan;
+    int     tilt;
+    int     zoom;
+    int     led;
+    int     brightness;
+};
+
+// Under the dedicated task profiles the control task applies the commands that arrive in
+// other tasks (HTTP /control in async_tcp). Any task may enqueue, only the control task
+// dequeues; without a control task (loop profile) commands are applied where they arrive.
+#ifndef CONTROL_QUEUE_SIZE
+#define CONTROL_QUEUE_SIZE 8
+#endif
+
+static MpscQueue<ControlCommand, CONTROL_QUEUE_SIZE> controlQueue;
+
+// The running control task. Submitters count themselves in controlSubmitting, so the task
+// does not exit between the lookup and the notification.
+static TaskHandle_t     controlTask       = nullptr;
+static volatile uint8_t controlSubmitting = 0;
+static portMUX_TYPE     controlTaskLock   = portMUX_INITIALIZER_UNLOCKED;
+
+// Parse a JSON control command, returns false if it could not be parsed
+HOT_PATH bool parseControlCommand(const char* data, size_t len, ControlCommand* command) {
+    PROFILE_HOT_PATH(controlPath);
+    PROFILE_BYTES(len);
+    StaticJsonDocument<200> doc;
+    if (deserializeJson(doc, data, len)) {
+        return false;
+    }
+
+    const char* const names[] = {"pan", "tilt", "zoom", "led", "brightness"};
+    int* const        values[] = {&command->pan,
+                                  &command->tilt,
+                                  &command->zoom,
+                                  &command->led,
+                                  &command->brightness};
+    command->mask              = 0;
+    for (uint8_t i = 0; i < 5; i++) {
+        if (doc[names[i]].is<int>()) {
+            *values[i] = doc[names[i]].as<int>();
+            command->mask |= 1 << i;
+        }
+    }
+    return true;
+}
+
+void applyParsedCommand(const ControlCommand& command) {
+    if (command.mask & CONTROL_PAN) {
+        camera_pan(command.pan);
+    }
+    if (command.mask & CONTROL_TILT) {
+        camera_tilt(command.tilt);
+    }
+    if (command.mask & CONTROL_ZOOM) {
+        camera_zoom(command.zoom);
+    }
+    if (command.mask & CONTROL_LED) {
+        camera_led(command.led);
+    }
+    if (command.mask & CONTROL_BRIGHTNESS) {
+        camera_brightness(command.brightness);
+    }
+
+#if ENABLE_METRICS
+    controlLog("Control update - Pan: %d, Tilt: %d, Zoom: %d, LED: %d, Brightness: %d\n",
+               camera_get_pan(),
+               camera_get_tilt(),
+               camera_get_zoom(),
+               camera_get_led(),
+               camera_get_brightness());
+#endif
+}
+
+// Apply a JSON control command in the calling task, returns false if it could not be parsed
+bool applyControlCommand(const char* data, size_t len) {
+    ControlCommand command;
+    if (!parseControlCommand(data, len, &command)) {
+        return false;
+    }
+    applyParsedCommand(command);
+    return true;
+}
+
+// Hand a command to the control task, or apply it right away if none runs. Returns false if
+// the queue is full.
+bool submitControlCommand(const ControlCommand& command) {
+    portENTER_CRITICAL(&controlTaskLock);
+    TaskHandle_t task = controlTask;
+    if (task) {
+        controlSubmitting++;
+    }
+    portEXIT_CRITICAL(&controlTaskLock);
+    if (!task) {
+        applyParsedCommand(command);
+        return true;
+    }
+
+    bool queued = controlQueue.tryPush(command);
+    if (queued) {
+        xTaskNotifyGive(task);
+    }
+    portENTER_CRITICAL(&controlTaskLock);
+    controlSubmitting--;
+    portEXIT_CRITICAL(&controlTaskLock);
+    return queued;
+}
+
+// Register the calling task as the consumer, or with nullptr unregister it once no submitter
+// still holds its handle
+void setControlTask(TaskHandle_t task) {
+    portENTER_CRITICAL(&controlTaskLock);
+    controlTask = task;
+    portEXIT_CRITICAL(&controlTaskLock);
+    while (!task && controlSubmitting) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+}
+
+// Apply the queued commands, called by the control task and once more after it stopped
+void drainControlQueue() {
+    ControlCommand command;
+    while (controlQueue.tryPop(&command)) {
+        applyParsedCommand(command);
+    }
+}
+
+// Serialize camera control state, returns its length
+size_t serializeControlState(char* buffer, size_t size) {
+    int len = snprintf(buffer,
+                       size,
+                       "{\"pan\":%d,\"tilt\":%d,\"zoom\":%d,\"led\":%d,\"brightness\":%d}",
+                       camera_get_pan(),
+                       camera_get_tilt(),
+                       camera_get_zoom(),
+                       camera_get_led(),
+                       camera_get_brightness());
+    if (len <= 0) {
+        return 0;
+    }
+    return (size_t) len < size ? len : size - 1;
+}
@@ -3,51 +3,61 @@
 #include <ArduinoJson.h>
 #include <ESPAsyncWebServer.h>
 
-#include "camera.h"
+#include "control.h"
+#include "net_profile.h"
 
 extern AsyncWebServer server;
 
+// Routes stay registered for the lifetime of the server, the flag tells
+// whether HTTP is the selected control transport
+static bool controlHTTPActive = false;
+
 void initControlHTTP() {
     server.on(
         "/control",
         HTTP_POST,
-        [](AsyncWebServerRequest* request) { request->send(200); },
+        [](AsyncWebServerRequest* request) {
+            // Commands with a body are answered from the body handler
+            if (!controlHTTPActive) {
+                request->send(503);
+            } else if (request->contentLength() == 0) {
+                request->send(400, "text/plain", "Missing JSON body");
+            }
+        },
         nullptr,
         [](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
-            StaticJsonDocument<200> doc;
-            DeserializationError    error = deserializeJson(doc, (const char*) data, len);
-            if (error) {
-                request->send(400, "text/plain", "Invalid JSON");
+            if (!controlHTTPActive) {
                 return;
             }
-
-            if (doc["pan"].is<int>()) {
-                camera_pan(doc["pan"].as<int>());
-            }
-            if (doc["tilt"].is<int>()) {
-                camera_tilt(doc["tilt"].as<int>());
-            }
-            if (doc["zoom"].is<int>()) {
-                camera_zoom(doc["zoom"].as<int>());
-            }
-            if (doc["led"].is<int>()) {
-                camera_led(doc["led"].as<int>());
+            COUNT_ALLOCS(commandAllocs);
+            applyNetProfile(request->client());
+            ControlCommand command;
+            if (!parseControlCommand((const char*) data, len, &command)) {
+                request->send(400, "text/plain", "Invalid JSON");
+                return;
             }
-            if (doc["brightness"].is<int>()) {
-                camera_brightness(doc["brightness"].as<int>());
+            // Under the dedicated task profiles the control task applies the command, the
+            // reply acknowledges that it was queued
+            if (!submitControlCommand(command)) {
+                request->send(503, "text/plain", "Control queue full");
+                return;
             }
+            // AsyncWebServer allocates the request and response objects itself, the reply
+            // body is sent from flash without a copy
+            request->send_P(200, "application/json", CONTROL_ACK);
         });
 
     server.on("/status", HTTP_GET, [](AsyncWebServerRequest* request) {
-        StaticJsonDocument<200> doc;
-        doc["pan"]        = camera_get_pan();
-        doc["tilt"]       = camera_get_tilt();
-        doc["zoom"]       = camera_get_zoom();
-        doc["led"]        = camera_get_led();
-        doc["brightness"] = camera_get_brightness();
-
-        String response;
-        serializeJson(doc, response);
-        request->send(200, "application/json", response);
+        char state[CONTROL_STATE_MAX];
+        serializeControlState(state, sizeof(state));
+        request->send(200, "application/json", state);
     });
 }
+
+void startControlHTTP() {
+    controlHTTPActive = true;
+}
+
+void stopControlHTTP() {
+    controlHTTPActive = false;
+}
@@ -2,74 +2,61 @@
 
 #include <ArduinoJson.h>
 #include <WiFi.h>
-#include <WiFiUdp.h>
+#include <lwip/sockets.h>
 
 #include "config.h"
+#include "control.h"
 
-// UDP instance for control commands
-WiFiUDP controlUDP;
-
-// Control command structure (shared with other protocols)
-struct ControlCommand {
-    int  pan;         // -100 to 100
-    int  tilt;        // -100 to 100
-    int  zoom;        // -100 to 100
-    bool led;         // true/false
-    int  brightness;  // 0 to 100
-};
-
-// Current control state
-static ControlCommand currentControl = {0, 0, 0, false, 50};
+// Control commands arrive on a non-blocking lwIP socket and are read straight into
+// packetBuffer. WiFiUDP::parsePacket() would allocate a receive buffer and a cbuf for every
+// packet.
+static int controlSocket = -1;
 
 // Buffer for incoming packets
 char packetBuffer[CONTROL_BUFFER_SIZE];
 
 // Initialize UDP control server
 void initControlUDP() {
-    controlUDP.begin(UDP_CONTROL_PORT);
+    controlSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (controlSocket < 0) {
+        Serial.println("UDP control socket failed");
+        return;
+    }
+    struct sockaddr_in addr = {};
+    addr.sin_family         = AF_INET;
+    addr.sin_port           = htons(UDP_CONTROL_PORT);
+    addr.sin_addr.s_addr    = htonl(INADDR_ANY);
+    if (bind(controlSocket, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        Serial.printf("UDP control port %d bind failed\n", UDP_CONTROL_PORT);
+        close(controlSocket);
+        controlSocket = -1;
+        return;
+    }
+    fcntl(controlSocket, F_SETFL, O_NONBLOCK);
+}
+
+// Stop UDP control server and release its socket
+void stopControlUDP() {
+    if (controlSocket >= 0) {
+        close(controlSocket);
+        controlSocket = -1;
+    }
 }
 
 // Process incoming UDP control packet
-void processControlPacket(char* data, size_t len) {
+void processControlPacket(char* data, size_t len, const struct sockaddr_in& remote) {
 #if ENABLE_METRICS
     START_METRIC(control_process);
 #endif
 
-    StaticJsonDocument<200> doc;
-    DeserializationError    error = deserializeJson(doc, data, len);
-
-    if (!error) {
-        if (doc.containsKey("pan"))
-            currentControl.pan = doc["pan"];
-        if (doc.containsKey("tilt"))
-            currentControl.tilt = doc["tilt"];
-        if (doc.containsKey("zoom"))
-            currentControl.zoom = doc["zoom"];
-        if (doc.containsKey("led"))
-            currentControl.led = doc["led"];
-        if (doc.containsKey("brightness"))
-            currentControl.brightness = doc["brightness"];
-
-#if ENABLE_METRICS
-        Serial.printf("Control update - Pan: %d, Tilt: %d, Zoom: %d, LED: %d, Brightness: %d\n",
-                      currentControl.pan,
-                      currentControl.tilt,
-                      currentControl.zoom,
-                      currentControl.led,
-                      currentControl.brightness);
-#endif
-
+    if (applyControlCommand(data, len)) {
         // Send acknowledgment
-        StaticJsonDocument<200> response;
-        response["status"]   = "ok";
-        response["received"] = true;
-
-        String responseStr;
-        serializeJson(response, responseStr);
-
-        controlUDP.beginPacket(controlUDP.remoteIP(), controlUDP.remotePort());
-        controlUDP.print(responseStr);
-        controlUDP.endPacket();
+        sendto(controlSocket,
+               CONTROL_ACK,
+               CONTROL_ACK_LEN,
+               0,
+               (const struct sockaddr*) &remote,
+               sizeof(remote));
     }
 
 #if ENABLE_METRICS
@@ -79,42 +66,36 @@ void processControlPacket(char* data, size_t len) {
 
 // Handle UDP control commands
 void handleControlUDP() {
-    // Check for incoming packets
-    int packetSize = controlUDP.parsePacket();
-    if (packetSize) {
+    if (controlSocket >= 0) {
+        // Opened before the receive, so a command counts everything from the socket on
+        COUNT_ALLOCS(commandAllocs);
+        struct sockaddr_in remote    = {};
+        socklen_t          remoteLen = sizeof(remote);
+
+        int len = recvfrom(controlSocket,
+                           packetBuffer,
+                           CONTROL_BUFFER_SIZE - 1,
+                           MSG_DONTWAIT,
+                           (struct sockaddr*) &remote,
+                           &remoteLen);
+        if (len > 0) {
 #if ENABLE_METRICS
-        Serial.printf("Received UDP packet of size %d from %s:%d\n",
-                      packetSize,
-                      controlUDP.remoteIP().toString().c_str(),
-                      controlUDP.remotePort());
+            uint32_t ip = remote.sin_addr.s_addr;
+            controlLog("Received UDP packet of size %d from %u.%u.%u.%u:%u\n",
+                       len,
+                       ip & 0xFF,
+                       (ip >> 8) & 0xFF,
+                       (ip >> 16) & 0xFF,
+                       ip >> 24,
+                       ntohs(remote.sin_port));
 #endif
-
-        // Read the packet
-        int len = controlUDP.read(packetBuffer, CONTROL_BUFFER_SIZE - 1);
-        if (len > 0) {
             packetBuffer[len] = 0;  // Null terminate
-            processControlPacket(packetBuffer, len);
+            processControlPacket(packetBuffer, len, remote);
+        } else {
+            DISCARD_ALLOCS();  // no packet
         }
     }
 
-// Apply control values to hardware
-#if ENABLE_METRICS
-    START_METRIC(control_apply);
-#endif
-
-// Example LED control using built-in LED
-#ifdef LED_BUILTIN
-    if (currentControl.led) {
-        digitalWrite(LED_BUILTIN, HIGH);
-    } else {
-        digitalWrite(LED_BUILTIN, LOW);
-    }
-#endif
-
-#if ENABLE_METRICS
-    END_METRIC(control_apply);
-#endif
-
     // Small delay to prevent too frequent updates
     vTaskDelay(pdMS_TO_TICKS(CONTROL_INTERVAL_MS));
 }
@@ -4,21 +4,17 @@
 #include <WebSocketsServer.h>
 
 #include "config.h"
+#include "control.h"
 
 // WebSocket server instance
 WebSocketsServer webSocket(WEBSOCKET_PORT);
 
-// Control command structure (shared with other protocols)
-struct ControlCommand {
-    int  pan;         // -100 to 100
-    int  tilt;        // -100 to 100
-    int  zoom;        // -100 to 100
-    bool led;         // true/false
-    int  brightness;  // 0 to 100
-};
+// Acknowledgment with room for the frame header in front of it, so the library can send it
+// without copying the payload into a temporary buffer
+static uint8_t webSocketAck[WEBSOCKETS_MAX_HEADER_SIZE + CONTROL_ACK_LEN + 1];
 
-// Current control state
-static ControlCommand currentControl = {0, 0, 0, false, 50};
+// Set when webSocket.loop() handled a command, other iterations are not counted
+static bool webSocketCommand = false;
 
 // WebSocket event handler
 void webSocketEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
@@ -35,56 +31,21 @@ void webSocketEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length)
 #endif
 
             // Send current state on connection
-            StaticJsonDocument<200> doc;
-            doc["pan"]        = currentControl.pan;
-            doc["tilt"]       = currentControl.tilt;
-            doc["zoom"]       = currentControl.zoom;
-            doc["led"]        = currentControl.led;
-            doc["brightness"] = currentControl.brightness;
-
-            String response;
-            serializeJson(doc, response);
-            webSocket.sendTXT(num, response);
+            char   state[CONTROL_STATE_MAX];
+            size_t len = serializeControlState(state, sizeof(state));
+            webSocket.sendTXT(num, (const uint8_t*) state, len);
         } break;
 
         case WStype_TEXT: {
 #if ENABLE_METRICS
             START_METRIC(control_process);
 #endif
+            webSocketCommand = true;
 
-            StaticJsonDocument<200> doc;
-            DeserializationError    error = deserializeJson(doc, payload, length);
-
-            if (!error) {
-                if (doc.containsKey("pan"))
-                    currentControl.pan = doc["pan"];
-                if (doc.containsKey("tilt"))
-                    currentControl.tilt = doc["tilt"];
-                if (doc.containsKey("zoom"))
-                    currentControl.zoom = doc["zoom"];
-                if (doc.containsKey("led"))
-                    currentControl.led = doc["led"];
-                if (doc.containsKey("brightness"))
-                    currentControl.brightness = doc["brightness"];
-
-#if ENABLE_METRICS
-                Serial.printf(
-                    "Control update - Pan: %d, Tilt: %d, Zoom: %d, LED: %d, Brightness: %d\n",
-                    currentControl.pan,
-                    currentControl.tilt,
-                    currentControl.zoom,
-                    currentControl.led,
-                    currentControl.brightness);
-#endif
-
+            if (applyControlCommand((const char*) payload, length)) {
                 // Send acknowledgment
-                StaticJsonDocument<200> response;
-                response["status"]   = "ok";
-                response["received"] = true;
-
-                String responseStr;
-                serializeJson(response, responseStr);
-                webSocket.sendTXT(num, responseStr);
+                webSocket.sendTXT(
+                    num, webSocketAck + WEBSOCKETS_MAX_HEADER_SIZE, CONTROL_ACK_LEN, true);
             }
 
 #if ENABLE_METRICS
@@ -96,6 +57,7 @@ void webSocketEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length)
 
 // Initialize WebSocket control server
 void initControlWebSocket() {
+    memcpy(webSocketAck + WEBSOCKETS_MAX_HEADER_SIZE, CONTROL_ACK, CONTROL_ACK_LEN);
     webSocket.begin();
     webSocket.onEvent(webSocketEvent);
 
@@ -104,28 +66,23 @@ void initControlWebSocket() {
 #endif
 }
 
+// Stop WebSocket control server and disconnect its clients
+void stopControlWebSocket() {
+    webSocket.close();
+}
+
 // Handle WebSocket control updates
 void handleControlWebSocket() {
-    // Handle WebSocket events
-    webSocket.loop();
-
-// Apply control values to hardware
-#if ENABLE_METRICS
-    START_METRIC(control_apply);
-#endif
-
-// Example LED control using built-in LED
-#ifdef LED_BUILTIN
-    if (currentControl.led) {
-        digitalWrite(LED_BUILTIN, HIGH);
-    } else {
-        digitalWrite(LED_BUILTIN, LOW);
+    // Handle WebSocket events. Allocations are counted around the whole loop(), the library
+    // allocates the payload of every message before it calls webSocketEvent().
+    {
+        COUNT_ALLOCS(commandAllocs);
+        webSocketCommand = false;
+        webSocket.loop();
+        if (!webSocketCommand) {
+            DISCARD_ALLOCS();
+        }
     }
-#endif
-
-#if ENABLE_METRICS
-    END_METRIC(control_apply);
-#endif
 
     // Small delay to prevent too frequent updates
     vTaskDelay(pdMS_TO_TICKS(CONTROL_INTERVAL_MS));
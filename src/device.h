@@ -0,0 +1,60 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <WiFi.h>
+
+#include "config.h"
+
+extern AsyncWebServer server;
+
+#define DEVICE_XSTR(x) DEVICE_STR(x)
+#define DEVICE_STR(x)  #x
+
+// millis() when setup() finished and the HTTP server was up (boot-to-ready time)
+static uint32_t deviceReadyMs = 0;
+
+// Stable board identity derived from the factory MAC, so results of different boards
+// can be told apart regardless of their IP addresses or serial ports
+const char* deviceId() {
+    static char id[20] = "";
+    if (!id[0]) {
+        uint64_t mac = ESP.getEfuseMac();
+        snprintf(id,
+                 sizeof(id),
+                 "esp32cam-%02x%02x%02x",
+                 (uint8_t) (mac >> 24),
+                 (uint8_t) (mac >> 32),
+                 (uint8_t) (mac >> 40));
+    }
+    return id;
+}
+
+// Board identity and build configuration
+void initDeviceInfo() {
+    server.on("/info", HTTP_GET, [](AsyncWebServerRequest* request) {
+        StaticJsonDocument<512> doc;
+        doc["device_id"]     = deviceId();
+        doc["mac"]           = WiFi.macAddress();
+        doc["chip_model"]    = ESP.getChipModel();
+        doc["chip_revision"] = ESP.getChipRevision();
+        doc["cpu_freq_mhz"]  = ESP.getCpuFreqMHz();
+        doc["flash_size"]    = ESP.getFlashChipSize();
+        doc["psram_size"]    = ESP.getPsramSize();
+        doc["sketch_md5"]    = ESP.getSketchMD5();
+        doc["build_hash"]    = BUILD_HASH;
+        doc["ready_ms"]      = deviceReadyMs;
+
+        JsonObject build  = doc.createNestedObject("build");
+        build["resolution"] = DEVICE_XSTR(CAMERA_RESOLUTION);
+        build["quality"]    = JPEG_QUALITY;
+        build["metrics"]    = ENABLE_METRICS;
+        build["raw_mode"]   = RAW_MODE;
+        build["raw_format"] = DEVICE_XSTR(RAW_FORMAT);
+        build["raw_scale"]  = RAW_SCALE;
+
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+#include "config.h"
+#include "device.h"
+#include "transport.h"
+#include "wifi_link.h"
+
+// Discovery beacon broadcast on DISCOVERY_PORT so the benchmark finds boards without
+// reading their serial log. A probe datagram ("discover") to the same port is answered
+// with a unicast beacon right away.
+WiFiUDP discoveryUDP;
+
+static uint32_t discoveryLastMs     = 0;
+static uint8_t  discoveryBootCount  = 0;
+static uint32_t discoverySequence   = 0;
+static uint32_t discoveryReconnects = 0;
+
+void sendBeacon(IPAddress address, uint16_t port) {
+    StaticJsonDocument<768> doc;
+    doc["type"]       = "esp32cam";
+    doc["device_id"]  = deviceId();
+    doc["build_hash"] = BUILD_HASH;
+    doc["ip"]         = WiFi.localIP().toString();
+    doc["mac"]        = WiFi.macAddress();
+    doc["ready_ms"]   = deviceReadyMs;
+    doc["uptime_ms"]  = millis();
+    doc["seq"]        = discoverySequence++;
+
+    JsonObject transport = doc.createNestedObject("transport");
+    transport["video"]   = videoProtocolName(activeVideo);
+    transport["control"] = controlProtocolName(activeControl);
+
+    JsonObject ports          = doc.createNestedObject("ports");
+    ports["http"]             = 80;
+    ports["rtsp"]             = RTSP_PORT;
+    ports["udp_video"]        = UDP_VIDEO_PORT;
+    ports["udp_control"]      = UDP_CONTROL_PORT;
+    ports["websocket"]        = WEBSOCKET_PORT;
+    ports["webrtc_signaling"] = WEBRTC_SIGNALING_PORT;
+
+    JsonObject build    = doc.createNestedObject("build");
+    build["resolution"] = DEVICE_XSTR(CAMERA_RESOLUTION);
+    build["quality"]    = JPEG_QUALITY;
+    build["metrics"]    = ENABLE_METRICS;
+    build["raw_mode"]   = RAW_MODE;
+    build["raw_format"] = DEVICE_XSTR(RAW_FORMAT);
+    build["raw_scale"]  = RAW_SCALE;
+
+    char   buffer[768];
+    size_t len = serializeJson(doc, buffer, sizeof(buffer));
+    discoveryUDP.beginPacket(address, port);
+    discoveryUDP.write((const uint8_t*) buffer, len);
+    discoveryUDP.endPacket();
+}
+
+// Called once the HTTP server is up, this is the moment the board counts as ready
+void initDiscovery() {
+    deviceReadyMs = millis();
+    discoveryUDP.begin(DISCOVERY_PORT);
+    Serial.printf("- Discovery beacons on UDP port %d (ready after %u ms)\n",
+                  DISCOVERY_PORT,
+                  deviceReadyMs);
+}
+
+// Called from loop()
+void handleDiscovery() {
+    if (!wifiConnected()) {
+        return;
+    }
+    if (discoveryReconnects != wifiReconnects) {
+        // Announce the board again after a reconnect, its address may have changed
+        discoveryReconnects = wifiReconnects;
+        discoveryBootCount  = 0;
+    }
+
+    char probe[16];
+    if (discoveryUDP.parsePacket() > 0) {
+        int len = discoveryUDP.read(probe, sizeof(probe) - 1);
+        probe[len > 0 ? len : 0] = '\0';
+        if (strncmp(probe, "discover", 8) == 0) {
+            sendBeacon(discoveryUDP.remoteIP(), discoveryUDP.remotePort());
+        }
+    }
+
+    uint32_t interval = discoveryBootCount < DISCOVERY_BOOT_BEACONS ? DISCOVERY_BOOT_INTERVAL_MS
+                                                                    : DISCOVERY_INTERVAL_MS;
+    if (millis() - discoveryLastMs >= interval) {
+        sendBeacon(IPAddress(255, 255, 255, 255), DISCOVERY_PORT);
+        discoveryLastMs = millis();
+        if (discoveryBootCount < DISCOVERY_BOOT_BEACONS) {
+            discoveryBootCount++;
+        }
+    }
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+// Integer-factor box downscaling of raw camera frames. Every output pixel is the rounded mean
+// of a factor x factor block of input pixels, factors are 2, 4 or 8.
+//
+// A frame is processed in strips of `factor` input rows that produce one output row. The rows
+// of a strip are read front to back and summed into an accumulator of one output row, which
+// stays in cache while the input streams past once. The accumulator packs two 16-bit sums per
+// 32-bit word and every input word is split into channel lanes with masks, so one addition
+// sums two samples:
+//
+//   GRAYSCALE  acc[k]      Y of output pixels 2k and 2k + 1
+//   YUV422     acc[2k]     Y of output pixels 2k and 2k + 1, acc[2k + 1] U and V of the pair
+//   RGB565     acc[2x]     red and blue of output pixel x, acc[2x + 1] green
+//
+// A lane holds at most 8 x 8 samples of 8 bits (16320), so sums never carry into the next
+// lane. Output rows keep the layout of the input: 1 byte per pixel for GRAYSCALE, Y U Y V for
+// YUV422 and big-endian RGB565 as the camera driver delivers it. The output width is rounded
+// down to an even number of pixels and trailing input rows that do not fill a strip are
+// dropped.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifndef DOWNSCALE_ATTR
+#define DOWNSCALE_ATTR
+#endif
+
+#define DOWNSCALE_MAX_FACTOR 8
+
+#define LANES_8BIT  0x00FF00FFu
+#define LANES_6BIT  0x003F003Fu
+#define LANES_5BIT  0x001F001Fu
+#define LANES_ROUND 0x00010001u  // 1 in both lanes
+
+enum DownscaleFormat : uint8_t { DOWNSCALE_RGB565, DOWNSCALE_YUV422, DOWNSCALE_GRAYSCALE };
+
+inline bool downscaleFactorValid(uint8_t factor) {
+    return factor == 2 || factor == 4 || factor == 8;
+}
+
+inline uint16_t downscaleWidth(uint16_t width, uint8_t factor) {
+    return (width / factor) & ~1u;
+}
+
+inline uint16_t downscaleHeight(uint16_t height, uint8_t factor) {
+    return height / factor;
+}
+
+inline size_t downscaleBytesPerPixel(DownscaleFormat format) {
+    return format == DOWNSCALE_GRAYSCALE ? 1 : 2;
+}
+
+// Accumulator words needed for a frame of the given width
+inline size_t downscaleAccWords(uint16_t width, uint8_t factor) {
+    return (size_t) downscaleWidth(width, factor) * 2;
+}
+
+inline uint32_t loadWord(const uint8_t* src) {
+    uint32_t word;
+    memcpy(&word, src, 4);  // a single load on aligned frame buffers
+    return word;
+}
+
+// Sum one input row into the accumulator. Little-endian loads: byte 0 of the row is the low
+// byte of the word.
+inline void accumulateGray(const uint8_t* row, uint16_t outWidth, uint8_t factor, uint32_t* acc) {
+    if (factor == 2) {
+        // Two output pixels per word, adjacent bytes summed into the two lanes
+        for (uint16_t k = 0; k < outWidth / 2; k++) {
+            uint32_t word = loadWord(row + k * 4);
+            acc[k] += (word & LANES_8BIT) + ((word >> 8) & LANES_8BIT);
+        }
+        return;
+    }
+    uint8_t words = factor / 4;  // words per output pixel
+    for (uint16_t k = 0; k < outWidth / 2; k++) {
+        uint32_t even = 0, odd = 0;
+        for (uint8_t i = 0; i < words; i++) {
+            uint32_t a = loadWord(row + (k * 2 * words + i) * 4);
+            uint32_t b = loadWord(row + ((k * 2 + 1) * words + i) * 4);
+            even += (a & LANES_8BIT) + ((a >> 8) & LANES_8BIT);
+            odd += (b & LANES_8BIT) + ((b >> 8) & LANES_8BIT);
+        }
+        acc[k] += ((even + (even >> 16)) & 0xFFFF) | (odd + (odd >> 16)) << 16;
+    }
+}
+
+// Y U Y V: a word holds one input pixel pair, Y in the even bytes and U, V in the odd ones.
+// An output pair covers `factor` words, the first half of them for its first pixel.
+inline void accumulateYUV422(const uint8_t* row,
+                             uint16_t       outWidth,
+                             uint8_t        factor,
+                             uint32_t*      acc) {
+    uint8_t half = factor / 2;
+    for (uint16_t k = 0; k < outWidth / 2; k++) {
+        const uint8_t* pair = row + (size_t) k * factor * 4;
+        uint32_t       even = 0, odd = 0, chroma = 0;
+        for (uint8_t i = 0; i < factor; i++) {
+            uint32_t word = loadWord(pair + i * 4);
+            uint32_t luma = word & LANES_8BIT;
+            chroma += (word >> 8) & LANES_8BIT;
+            if (i < half) {
+                even += luma;
+            } else {
+                odd += luma;
+            }
+        }
+        acc[2 * k] += ((even + (even >> 16)) & 0xFFFF) | (odd + (odd >> 16)) << 16;
+        acc[2 * k + 1] += chroma;
+    }
+}
+
+// Big-endian RGB565: after a byte swap a word holds the first pixel in its upper half, so the
+// channels of both pixels separate into lanes with one shift and mask each
+inline void accumulateRGB565(const uint8_t* row,
+                             uint16_t       outWidth,
+                             uint8_t        factor,
+                             uint32_t*      acc) {
+    uint8_t words = factor / 2;  // words per output pixel
+    for (uint16_t x = 0; x < outWidth; x++) {
+        const uint8_t* block = row + (size_t) x * factor * 2;
+        uint32_t       r = 0, g = 0, b = 0;
+        for (uint8_t i = 0; i < words; i++) {
+            uint32_t word = __builtin_bswap32(loadWord(block + i * 4));
+            r += (word >> 11) & LANES_5BIT;
+            g += (word >> 5) & LANES_6BIT;
+            b += word & LANES_5BIT;
+        }
+        acc[2 * x] += ((r + (r >> 16)) & 0xFFFF) | (b + (b >> 16)) << 16;
+        acc[2 * x + 1] += (g + (g >> 16)) & 0xFFFF;
+    }
+}
+
+// Rounded means of both lanes of an accumulator word, shift = log2(factor * factor)
+inline uint32_t laneMeans(uint32_t sums, uint8_t shift) {
+    return ((sums + (LANES_ROUND << shift >> 1)) >> shift) & LANES_8BIT;
+}
+
+inline void writeRow(DownscaleFormat format,
+                     const uint32_t* acc,
+                     uint16_t        outWidth,
+                     uint8_t         shift,
+                     uint8_t*        dst) {
+    if (format == DOWNSCALE_GRAYSCALE) {
+        for (uint16_t k = 0; k < outWidth / 2; k++) {
+            uint32_t means = laneMeans(acc[k], shift);
+            dst[2 * k]     = means;
+            dst[2 * k + 1] = means >> 16;
+        }
+    } else if (format == DOWNSCALE_YUV422) {
+        for (uint16_t k = 0; k < outWidth / 2; k++) {
+            uint32_t luma   = laneMeans(acc[2 * k], shift);
+            uint32_t chroma = laneMeans(acc[2 * k + 1], shift);
+            dst[4 * k]      = luma;
+            dst[4 * k + 1]  = chroma;
+            dst[4 * k + 2]  = luma >> 16;
+            dst[4 * k + 3]  = chroma >> 16;
+        }
+    } else {
+        for (uint16_t x = 0; x < outWidth; x++) {
+            uint32_t rb    = laneMeans(acc[2 * x], shift);
+            uint32_t g     = laneMeans(acc[2 * x + 1], shift);
+            uint16_t pixel = (rb & 0x1F) << 11 | (g & 0x3F) << 5 | (rb >> 16);
+            dst[2 * x]     = pixel >> 8;
+            dst[2 * x + 1] = pixel;
+        }
+    }
+}
+
+// Downscale a frame into dst, which holds downscaleWidth() * downscaleHeight() pixels. acc is
+// scratch of downscaleAccWords() words, best in internal RAM. Returns the output size, 0 for
+// an unsupported factor.
+DOWNSCALE_ATTR inline size_t downscaleFrame(DownscaleFormat format,
+                                            const uint8_t*  src,
+                                            uint16_t        width,
+                                            uint16_t        height,
+                                            uint8_t         factor,
+                                            uint32_t*       acc,
+                                            uint8_t*        dst) {
+    if (!downscaleFactorValid(factor)) {
+        return 0;
+    }
+    uint16_t outWidth  = downscaleWidth(width, factor);
+    uint16_t outHeight = downscaleHeight(height, factor);
+    size_t   inStride  = width * downscaleBytesPerPixel(format);
+    size_t   outStride = outWidth * downscaleBytesPerPixel(format);
+    uint8_t  shift     = 2 * __builtin_ctz(factor);
+
+    for (uint16_t y = 0; y < outHeight; y++) {
+        memset(acc, 0, downscaleAccWords(width, factor) * sizeof(uint32_t));
+        const uint8_t* strip = src + (size_t) y * factor * inStride;
+        for (uint8_t row = 0; row < factor; row++) {
+            const uint8_t* line = strip + row * inStride;
+            if (format == DOWNSCALE_GRAYSCALE) {
+                accumulateGray(line, outWidth, factor, acc);
+            } else if (format == DOWNSCALE_YUV422) {
+                accumulateYUV422(line, outWidth, factor, acc);
+            } else {
+                accumulateRGB565(line, outWidth, factor, acc);
+            }
+        }
+        writeRow(format, acc, outWidth, shift, dst + y * outStride);
+    }
+    return outStride * outHeight;
+}
@@ -0,0 +1,361 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "camera_buffers.h"
+#include "config.h"
+#include "esp_camera.h"
+#include "motion_rate.h"
+#include "profiling.h"
+#include "raw_frames.h"
+
+// Frames shared by several viewers. The video service copies every captured frame into a
+// PSRAM slot and returns the camera buffer right away, viewers take a reference to the newest
+// slot and keep it while they send. A viewer slower than the camera holds on to its slot and
+// new frames go to the other slots, so capture never waits for the slowest viewer. A frame is
+// dropped only when every slot is held.
+#ifndef FRAME_POOL_SLOTS
+#define FRAME_POOL_SLOTS 4
+#endif
+
+// Viewers of all streaming transports together
+#ifndef STREAM_MAX_CLIENTS
+#define STREAM_MAX_CLIENTS 8
+#endif
+
+// A viewer that waits this long for a new frame (beyond its own rate limit) counts a stall. The
+// wait ends when the frame is published, not when the transport gets to send it. With
+// MOTION_ADAPTIVE a still scene is published every MOTION_FLOOR_MS.
+#ifndef STREAM_STALL_MS
+#if MOTION_ADAPTIVE
+#define STREAM_STALL_MS (MOTION_FLOOR_MS + FRAME_INTERVAL_MS)
+#else
+#define STREAM_STALL_MS (2 * FRAME_INTERVAL_MS)
+#endif
+#endif
+
+struct PooledFrame {
+    uint8_t* buf;
+    size_t   len;
+    size_t   capacity;
+    uint32_t number;  // sequence number of the frame, starts at 1
+    uint32_t capturedMs;
+    uint8_t  motion;  // motion score of the frame, 0 without MOTION_ADAPTIVE
+    uint8_t  refs;
+};
+
+static PooledFrame  framePool[FRAME_POOL_SLOTS];
+static PooledFrame* latestFrame      = nullptr;
+static uint32_t     framePoolNumber  = 0;
+static uint32_t     framePoolDropped = 0;  // frames dropped because every slot was held
+static uint32_t     captureFailures  = 0;  // esp_camera_fb_get() returned no frame
+static portMUX_TYPE framePoolLock    = portMUX_INITIALIZER_UNLOCKED;
+
+// Called by the video task after every published frame, so responses waiting in async_tcp
+// (/video, /capture?wait=) are filled right away instead of on the next AsyncTCP poll
+typedef void (*FrameListener)();
+static FrameListener frameListeners[2];
+
+void addFrameListener(FrameListener listener) {
+    for (FrameListener& slot : frameListeners) {
+        if (!slot) {
+            slot = listener;
+            return;
+        }
+    }
+}
+
+// Take a reference to the newest frame, nullptr if nothing was captured yet
+PooledFrame* acquireLatestFrame() {
+    portENTER_CRITICAL(&framePoolLock);
+    PooledFrame* frame = latestFrame;
+    if (frame) {
+        frame->refs++;
+    }
+    portEXIT_CRITICAL(&framePoolLock);
+    return frame;
+}
+
+void releaseFrame(PooledFrame* frame) {
+    portENTER_CRITICAL(&framePoolLock);
+    frame->refs--;
+    portEXIT_CRITICAL(&framePoolLock);
+}
+
+// Copy a camera frame into a free slot and make it the newest frame.
+// Returns false if the frame was dropped.
+HOT_PATH bool publishFrame(const camera_fb_t* fb) {
+    PooledFrame* slot = nullptr;
+    portENTER_CRITICAL(&framePoolLock);
+    for (uint8_t i = 0; i < FRAME_POOL_SLOTS; i++) {
+        if (framePool[i].refs == 0 && &framePool[i] != latestFrame) {
+            slot       = &framePool[i];
+            slot->refs = 1;  // held by the writer while copying
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&framePoolLock);
+    if (!slot) {
+        framePoolDropped++;
+        return false;
+    }
+
+    if (fb->len > slot->capacity) {
+        // Slots grow to the largest frame seen plus headroom, so the steady state does
+        // not allocate
+        size_t   capacity = fb->len + fb->len / 4;
+        uint8_t* buf      = (uint8_t*) heap_caps_realloc(
+            slot->buf, capacity, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!buf) {
+            releaseFrame(slot);
+            framePoolDropped++;
+            return false;
+        }
+        slot->buf      = buf;
+        slot->capacity = capacity;
+    }
+    {
+        PROFILE_HOT_PATH(frameCopyPath);
+        PROFILE_BYTES(fb->len);
+        memcpy(slot->buf, fb->buf, fb->len);
+    }
+    slot->len        = fb->len;
+    slot->capturedMs = millis();
+    slot->motion     = lastMotionScore();
+
+    portENTER_CRITICAL(&framePoolLock);
+    slot->number = ++framePoolNumber;
+    slot->refs--;
+    latestFrame = slot;
+    portEXIT_CRITICAL(&framePoolLock);
+
+    for (FrameListener listener : frameListeners) {
+        if (listener) {
+            listener();
+        }
+    }
+    return true;
+}
+
+// Transport names of the viewers, compared by pointer
+static const char* const STREAM_HTTP      = "http";
+static const char* const STREAM_WEBSOCKET = "websocket";
+
+// Frames held back by MOTION_ADAPTIVE are neither sent nor published, by any transport.
+// Snapshot pollers then read the newest published frame, which a still scene refreshes every
+// MOTION_FLOOR_MS.
+//
+// Capture the next camera frame into the pool, the camera buffer is returned right away.
+// Returns false on a capture failure (also counted in captureFailures).
+bool captureToPool() {
+    camera_fb_t* fb = grabFrame();
+    // An empty frame counts as a failure, a zero-length chunk would end an HTTP response
+    bool captured = fb && fb->len > 0;
+    if (!captured) {
+        captureFailures++;
+    } else if (motionWantsFrame(fb)) {
+        publishFrame(prepareRawFrame(fb));
+    }
+    if (fb) {
+        returnFrame(fb);
+    }
+    return captured;
+}
+
+// Age of the newest frame in the pool, UINT32_MAX if there is none
+uint32_t latestFrameAgeMs() {
+    uint32_t now = millis();
+    portENTER_CRITICAL(&framePoolLock);
+    uint32_t age = latestFrame ? now - latestFrame->capturedMs : UINT32_MAX;
+    portEXIT_CRITICAL(&framePoolLock);
+    return age;
+}
+
+// Snapshot pollers (/capture) read the newest pool frame and never capture themselves. The
+// video service keeps the pool fed until SNAPSHOT_IDLE_MS after the last snapshot request.
+#ifndef SNAPSHOT_IDLE_MS
+#define SNAPSHOT_IDLE_MS 5000
+#endif
+
+static volatile uint32_t snapshotRequestMs = 0;  // 0 = never requested
+
+bool snapshotWanted() {
+    return snapshotRequestMs && millis() - snapshotRequestMs < SNAPSHOT_IDLE_MS;
+}
+
+// For the transports that send straight from the camera buffer (RTSP, UDP): the frame to send,
+// also published for snapshot pollers, or nullptr if MOTION_ADAPTIVE holds it back
+camera_fb_t* prepareStreamFrame(camera_fb_t* fb) {
+    if (!motionWantsFrame(fb)) {
+        return nullptr;
+    }
+    camera_fb_t* frame = prepareRawFrame(fb);
+    if (snapshotWanted()) {
+        publishFrame(frame);
+    }
+    return frame;
+}
+
+// Per-viewer delivery state. Every viewer asks for its own rate and maximum frame size
+// and gets the newest frame when it is due, the frames in between are skipped for it only.
+struct StreamClient {
+    bool        active;
+    const char* transport;
+    uint32_t    id;        // transport specific connection id
+    uint16_t    fps;       // requested rate, 0 = every frame
+    uint32_t    maxBytes;  // larger frames are skipped, 0 = no limit
+    uint32_t    connectedMs;
+    uint32_t    dueMs;      // earliest time of the next frame
+    uint32_t    lastFrame;  // number of the last frame taken or skipped
+    uint32_t    delivered;
+    uint32_t    skipped;
+    uint64_t    bytes;
+    uint32_t    stalls;
+    uint32_t    stallMs;         // total time of the stalls
+    uint32_t    waitingSinceMs;  // due but no new frame since then, 0 = not waiting
+    uint32_t    maxStallMs;
+};
+
+static StreamClient streamClients[STREAM_MAX_CLIENTS];
+
+// Claim a viewer slot, nullptr if all are in use
+StreamClient* openStreamClient(const char* transport,
+                               uint32_t    id,
+                               uint16_t    fps,
+                               uint32_t    maxBytes) {
+    StreamClient* client = nullptr;
+    portENTER_CRITICAL(&framePoolLock);
+    for (uint8_t i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        if (!streamClients[i].active) {
+            client         = &streamClients[i];
+            client->active = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&framePoolLock);
+    if (!client) {
+        return nullptr;
+    }
+
+    client->transport      = transport;
+    client->id             = id;
+    client->fps            = fps;
+    client->maxBytes       = maxBytes;
+    client->connectedMs    = millis();
+    client->dueMs          = client->connectedMs;
+    client->lastFrame      = 0;
+    client->delivered      = 0;
+    client->skipped        = 0;
+    client->bytes          = 0;
+    client->stalls         = 0;
+    client->stallMs        = 0;
+    client->waitingSinceMs = 0;
+    client->maxStallMs     = 0;
+    return client;
+}
+
+void closeStreamClient(StreamClient* client) {
+    client->active = false;
+}
+
+uint8_t streamClientCount(const char* transport) {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        if (streamClients[i].active && streamClients[i].transport == transport) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// The viewer is due but there is no new frame (capture failed or is slower than the viewer).
+// The wait is timed from the first call until the next frame is taken.
+void streamClientWaiting(StreamClient* client, uint32_t now) {
+    if (!client->waitingSinceMs) {
+        client->waitingSinceMs = now ? now : 1;
+    }
+}
+
+// Time the viewer has been waiting for a new frame so far
+uint32_t streamClientWaitMs(const StreamClient& client, uint32_t now) {
+    return client.waitingSinceMs ? now - client.waitingSinceMs : 0;
+}
+
+// Decide whether a frame goes to the viewer. Frames published since the last frame taken
+// count as skipped once a newer frame is taken, oversized frames right away. publishedMs is
+// the time the frame became available, a wait is timed up to it.
+bool streamClientWants(StreamClient* client,
+                       uint32_t      number,
+                       size_t        len,
+                       uint32_t      publishedMs,
+                       uint32_t      now) {
+    if (client->fps && (int32_t) (now - client->dueMs) < 0) {
+        return false;  // not due yet, a newer frame may be taken later
+    }
+    if (number == client->lastFrame) {
+        streamClientWaiting(client, now);
+        return false;  // nothing new
+    }
+
+    int32_t waited = client->waitingSinceMs ? (int32_t) (publishedMs - client->waitingSinceMs) : 0;
+    if (waited >= (int32_t) STREAM_STALL_MS) {
+        client->stalls++;
+        client->stallMs += waited;
+        if ((uint32_t) waited > client->maxStallMs) {
+            client->maxStallMs = waited;
+        }
+    }
+    client->waitingSinceMs = 0;
+
+    if (client->lastFrame && number > client->lastFrame + 1) {
+        client->skipped += number - client->lastFrame - 1;
+    }
+    client->lastFrame = number;
+    if (client->maxBytes && len > client->maxBytes) {
+        client->skipped++;
+        return false;
+    }
+
+    if (client->fps) {
+        // Keep the average rate on target, but do not catch up after a long gap
+        uint32_t interval = 1000 / client->fps;
+        bool     onTime   = now - client->dueMs < interval;
+        client->dueMs     = onTime ? client->dueMs + interval : now + interval;
+    }
+    client->delivered++;
+    client->bytes += len;
+    return true;
+}
+
+// Pool and per-viewer counters for /metrics
+void addStreamMetrics(JsonDocument& doc) {
+    JsonObject pool = doc.createNestedObject("frame_pool");
+    pool["frames"]           = framePoolNumber;
+    pool["dropped"]          = framePoolDropped;
+    pool["capture_failures"] = captureFailures;
+
+    uint32_t  now     = millis();
+    JsonArray streams = doc.createNestedArray("streams");
+    for (uint8_t i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        const StreamClient& client = streamClients[i];
+        if (!client.active) {
+            continue;
+        }
+        uint32_t   elapsed = now - client.connectedMs;
+        JsonObject entry   = streams.createNestedObject();
+        entry["transport"]    = client.transport;
+        entry["id"]           = client.id;
+        entry["fps_limit"]    = client.fps;
+        entry["max_bytes"]    = client.maxBytes;
+        entry["fps"]          = elapsed ? client.delivered * 1000.0f / elapsed : 0.0f;
+        entry["delivered"]    = client.delivered;
+        entry["skipped"]      = client.skipped;
+        entry["bytes"]        = client.bytes;
+        entry["connected_ms"] = elapsed;
+        entry["stalls"]       = client.stalls;
+        entry["stall_ms"]     = client.stallMs;
+        entry["max_stall_ms"] = client.maxStallMs;
+        entry["waiting_ms"]   = streamClientWaitMs(client, now);
+    }
+}
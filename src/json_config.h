@@ -0,0 +1,73 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+
+extern AsyncWebServer server;
+
+// Runtime settings changed with a small JSON POST (/transport, /tasks, /network, /wifi,
+// /camera). The module parses the body and records the change as pending, loop() applies it.
+
+inline const char* entryName(const char* name) {
+    return name;
+}
+
+template <typename T>
+const char* entryName(const T& entry) {
+    return entry.name;
+}
+
+// Look a name up in a table of names or of entries with a name member, case-insensitively.
+// The index is stored as the enum or integer type of value.
+template <typename T, size_t N, typename E>
+bool parseName(const char* name, const T (&table)[N], E* value) {
+    for (size_t i = 0; i < N; i++) {
+        if (name && strcasecmp(name, entryName(table[i])) == 0) {
+            *value = static_cast<E>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses and records a change, returns nullptr or the message of a 400 reply
+typedef const char* (*JsonConfigHandler)(JsonDocument& doc);
+
+// Register POST path with a JSON body. The body is a few bytes, one split across TCP segments
+// is rejected instead of being parsed in parts. Accepted changes are answered with 202.
+void onJsonConfigPost(const char* path, JsonConfigHandler handle) {
+    server.on(
+        path,
+        HTTP_POST,
+        [](AsyncWebServerRequest* request) {
+            // Requests with a body are answered from the body handler
+            if (request->contentLength() == 0) {
+                request->send(400, "text/plain", "Missing JSON body");
+            }
+        },
+        nullptr,
+        [handle](AsyncWebServerRequest* request,
+                 uint8_t*               data,
+                 size_t                 len,
+                 size_t                 index,
+                 size_t                 total) {
+            if (index != 0 || len != total) {
+                if (index == 0) {
+                    request->send(400, "text/plain", "JSON body must arrive in one segment");
+                }
+                return;
+            }
+
+            StaticJsonDocument<128> doc;
+            if (deserializeJson(doc, (const char*) data, len)) {
+                request->send(400, "text/plain", "Invalid JSON");
+                return;
+            }
+            const char* error = handle(doc);
+            if (error) {
+                request->send(400, "text/plain", error);
+                return;
+            }
+            request->send(202, "application/json", "{\"status\":\"pending\"}");
+        });
+}
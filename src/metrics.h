@@ -0,0 +1,67 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <WiFi.h>
+
+#include "alloc_counter.h"
+#include "frame_pool.h"
+#include "profiling.h"
+#include "raw_tiles.h"
+#include "snapshot.h"
+
+extern AsyncWebServer server;
+
+// Room for the optional sections of /metrics
+#define METRICS_DOC_SIZE                                        \
+    ((PROFILE_HOT_PATHS ? 2560 : 1536) + (RAW_MODE ? 256 : 0) + \
+     (RAW_CODEC || SOFT_JPEG || RAW_TILES ? 256 : 0) + (MOTION_ADAPTIVE ? 256 : 0))
+
+// Runtime metrics polled by the benchmark while a test runs (heap settling is part of
+// warmup detection). Always available, independent of ENABLE_METRICS serial logging.
+// Every connected viewer reports its own delivered rate and skipped frames.
+// Builds with ALLOC_COUNTER also report heap allocations per control command and per frame,
+// builds with PROFILE_HOT_PATHS the cycles and stalls of the transport hot paths, raw builds
+// report the format, size and downscaling time of their frames, with RAW_CODEC also the
+// compression ratio and encode time of the raw frame codec. Builds with SOFT_JPEG report the
+// work of the software JPEG encoder, builds with MOTION_ADAPTIVE the frames scored and sent by
+// the motion detector and builds with RAW_TILES the tiles sent by the UDP transport.
+void initMetrics() {
+    server.on("/metrics", HTTP_GET, [](AsyncWebServerRequest* request) {
+        StaticJsonDocument<METRICS_DOC_SIZE> doc;
+        doc["uptime_ms"]      = millis();
+        doc["free_heap"]      = ESP.getFreeHeap();
+        doc["min_free_heap"]  = ESP.getMinFreeHeap();
+        doc["max_alloc_heap"] = ESP.getMaxAllocHeap();
+        doc["free_psram"]     = ESP.getFreePsram();
+        doc["rssi"]           = WiFi.RSSI();
+        doc["temperature"]    = temperatureRead();
+        addStreamMetrics(doc);
+        addSnapshotMetrics(doc);
+#if ALLOC_COUNTER
+        addAllocMetrics(doc);
+#endif
+#if PROFILE_HOT_PATHS
+        addHotPathMetrics(doc);
+#endif
+#if RAW_MODE
+        addRawFrameMetrics(doc);
+#endif
+#if RAW_MODE && RAW_CODEC
+        addRawCodecMetrics(doc);
+#endif
+#if SOFT_JPEG
+        addSoftJpegMetrics(doc);
+#endif
+#if MOTION_ADAPTIVE
+        addMotionMetrics(doc);
+#endif
+#if RAW_TILES
+        addRawTileMetrics(doc);
+#endif
+
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+// Tile-based change detection and the motion-adaptive send rate. A frame is reduced to a luma
+// signature of MOTION_TILES_X x MOTION_TILES_Y tile means, sampled every `step` pixels. The
+// score of a frame is the number of tiles whose mean moved by more than the tile threshold
+// since the previous frame, after removing the mean change of all tiles, so auto exposure and
+// lighting drift do not count as motion.
+//
+// The rate controller sends every frame while the score reaches the trigger and for holdMs
+// after that. A still scene then backs off: every frame sent doubles the interval until the
+// floor is reached. Motion jumps straight back to every frame, the frame that shows it is
+// sent.
+//
+// motion_rate.h feeds it the camera frames. benchmark/utils/motion.py is a port that replays
+// recorded or synthetic frames with the same results.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#define MOTION_TILES_X 16
+#define MOTION_TILES_Y 12
+#define MOTION_TILES   (MOTION_TILES_X * MOTION_TILES_Y)
+
+struct MotionConfig {
+    uint8_t  tileThreshold;  // change of a tile mean that counts, in luma levels
+    uint8_t  triggerTiles;   // changed tiles that count as motion
+    uint32_t minIntervalMs;  // capture interval, every frame is sent during motion
+    uint32_t floorIntervalMs;
+    uint32_t holdMs;  // every frame is sent this long after the last motion
+};
+
+// Zero-initialized before the first frame
+struct MotionState {
+    uint8_t  reference[MOTION_TILES];  // signature of the previous frame
+    bool     hasReference;
+    bool     started;
+    uint8_t  score;  // changed tiles of the last frame
+    uint32_t intervalMs;
+    uint32_t lastMotionMs;
+    uint32_t lastSentMs;
+};
+
+// Luma 0-255 of a big-endian RGB565 pixel, weights 0.30 / 0.59 / 0.11
+inline uint8_t motionLumaRGB565(const uint8_t* pixel) {
+    uint32_t value = pixel[0] << 8 | pixel[1];
+    return ((value >> 11) * 616 + ((value >> 5) & 0x3F) * 600 + (value & 0x1F) * 232) >> 8;
+}
+
+// Tile means of a frame, luma(x, y) returns the luma of a pixel. Tile edges are spread evenly
+// over the frame, the samples of a tile start at its top left pixel.
+template <typename Luma>
+void motionSignature(uint16_t width, uint16_t height, uint8_t step, Luma luma, uint8_t* sig) {
+    for (uint8_t ty = 0; ty < MOTION_TILES_Y; ty++) {
+        uint32_t y0 = (uint32_t) ty * height / MOTION_TILES_Y;
+        uint32_t y1 = (uint32_t) (ty + 1) * height / MOTION_TILES_Y;
+        for (uint8_t tx = 0; tx < MOTION_TILES_X; tx++) {
+            uint32_t x0  = (uint32_t) tx * width / MOTION_TILES_X;
+            uint32_t x1  = (uint32_t) (tx + 1) * width / MOTION_TILES_X;
+            uint32_t sum = 0, count = 0;
+            for (uint32_t y = y0; y < y1; y += step) {
+                for (uint32_t x = x0; x < x1; x += step) {
+                    sum += luma(x, y);
+                    count++;
+                }
+            }
+            sig[ty * MOTION_TILES_X + tx] = count ? (sum + count / 2) / count : 0;
+        }
+    }
+}
+
+// Score a signature against the previous one and keep it as the new reference
+inline uint8_t motionScore(MotionState& state, const MotionConfig& config, const uint8_t* sig) {
+    uint8_t score = 0;
+    if (state.hasReference) {
+        // Mean change of all tiles, rounded half away from zero
+        int32_t total = 0;
+        for (uint16_t i = 0; i < MOTION_TILES; i++) {
+            total += sig[i] - state.reference[i];
+        }
+        int32_t shift = (abs(total) + MOTION_TILES / 2) / MOTION_TILES;
+        shift         = total < 0 ? -shift : shift;
+        for (uint16_t i = 0; i < MOTION_TILES; i++) {
+            if (abs(sig[i] - state.reference[i] - shift) > config.tileThreshold) {
+                score++;
+            }
+        }
+    }
+    for (uint16_t i = 0; i < MOTION_TILES; i++) {
+        state.reference[i] = sig[i];
+    }
+    state.hasReference = true;
+    state.score        = score;
+    return score;
+}
+
+// Decide whether the frame captured at nowMs, scored last, is sent
+inline bool motionDecide(MotionState& state, const MotionConfig& config, uint32_t nowMs) {
+    bool send;
+    if (!state.started) {
+        state.started      = true;
+        state.intervalMs   = config.minIntervalMs;
+        state.lastMotionMs = nowMs;  // the first frames are sent at full rate
+        send               = true;
+    } else if (state.score >= config.triggerTiles) {
+        state.lastMotionMs = nowMs;
+        state.intervalMs   = config.minIntervalMs;
+        send               = true;
+    } else {
+        // Half a capture interval of tolerance, so capture jitter does not skip a frame
+        send = nowMs - state.lastSentMs + config.minIntervalMs / 2 >= state.intervalMs;
+        if (send && nowMs - state.lastMotionMs >= config.holdMs) {
+            uint32_t interval = state.intervalMs * 2;
+            state.intervalMs  = interval < config.floorIntervalMs ? interval
+                                                                  : config.floorIntervalMs;
+        }
+    }
+    if (send) {
+        state.lastSentMs = nowMs;
+    }
+    return send;
+}
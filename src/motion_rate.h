@@ -0,0 +1,243 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+
+#include "config.h"
+#include "esp_camera.h"
+#include "esp_heap_caps.h"
+
+extern AsyncWebServer server;
+
+// MOTION_ADAPTIVE=1 streams still scenes at a lower rate (src/motion.h). The camera keeps
+// capturing at FRAME_INTERVAL_MS and every frame is scored: raw frames are sampled directly,
+// JPEG frames are decoded at 1/8 scale, which only needs the DC coefficient of every 8x8
+// block. Frames the controller holds back are neither sent nor published by any transport, so
+// snapshot pollers see the same reduced rate (frame_pool.h). Consumers read the score of the
+// last frame from GET /motion, HTTP frames carry it in an X-Motion header.
+#ifndef MOTION_ADAPTIVE
+#define MOTION_ADAPTIVE 0
+#endif
+
+#if MOTION_ADAPTIVE
+#include "esp_jpg_decode.h"
+#include "motion.h"
+
+// Send interval of a still scene
+#ifndef MOTION_FLOOR_MS
+#define MOTION_FLOOR_MS 2000
+#endif
+
+// Every frame is sent this long after the last motion
+#ifndef MOTION_HOLD_MS
+#define MOTION_HOLD_MS 2000
+#endif
+
+// Change of a tile mean (luma levels) that counts, and changed tiles that count as motion
+#ifndef MOTION_TILE_THRESHOLD
+#define MOTION_TILE_THRESHOLD 12
+#endif
+
+#ifndef MOTION_TRIGGER_TILES
+#define MOTION_TRIGGER_TILES 2
+#endif
+
+// Raw frames are sampled every MOTION_SAMPLE_STEP pixels in both directions
+#ifndef MOTION_SAMPLE_STEP
+#define MOTION_SAMPLE_STEP 4
+#endif
+
+static const MotionConfig motionConfig = {MOTION_TILE_THRESHOLD,
+                                          MOTION_TRIGGER_TILES,
+                                          FRAME_INTERVAL_MS,
+                                          MOTION_FLOOR_MS,
+                                          MOTION_HOLD_MS};
+
+// Only the video service scores frames
+static MotionState motionState = {};
+
+// Luma of a JPEG frame at 1/8 scale, one pixel per 8x8 block
+struct MotionLuma {
+    const camera_fb_t* fb;
+    uint8_t*           buf;
+    size_t             capacity;
+    uint16_t           width;
+    uint16_t           height;
+};
+
+static MotionLuma motionLuma = {};
+
+static volatile uint8_t motionLastScore = 0;
+static uint32_t         motionFrames    = 0;
+static uint32_t         motionSent      = 0;
+static uint32_t         motionEvents    = 0;  // motion after a still scene
+static uint32_t         motionFailures  = 0;  // frames that could not be scored, always sent
+static uint32_t         motionMaxUs     = 0;
+static uint64_t         motionUs        = 0;
+
+size_t motionJpegRead(void* arg, size_t index, uint8_t* buf, size_t len) {
+    MotionLuma* luma = (MotionLuma*) arg;
+    if (buf) {
+        memcpy(buf, luma->fb->buf + index, len);
+    }
+    return len;
+}
+
+// RGB888 blocks of the decoder, called without data at the start and the end of the image
+bool motionJpegWrite(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data) {
+    MotionLuma* luma = (MotionLuma*) arg;
+    if (!data) {
+        return true;
+    }
+    for (uint16_t row = 0; row < h && y + row < luma->height; row++) {
+        uint8_t* out = luma->buf + (size_t) (y + row) * luma->width + x;
+        for (uint16_t col = 0; col < w && x + col < luma->width; col++) {
+            const uint8_t* pixel = data + ((size_t) row * w + col) * 3;
+            out[col]             = (pixel[0] * 77 + pixel[1] * 150 + pixel[2] * 29) >> 8;
+        }
+    }
+    return true;
+}
+
+bool motionDecodeJpeg(const camera_fb_t* fb) {
+    uint16_t width  = (fb->width + 7) / 8;
+    uint16_t height = (fb->height + 7) / 8;
+    size_t   len    = (size_t) width * height;
+    if (len > motionLuma.capacity) {
+        uint8_t* buf = (uint8_t*) heap_caps_realloc(motionLuma.buf, len, MALLOC_CAP_8BIT);
+        if (!buf) {
+            return false;
+        }
+        motionLuma.buf      = buf;
+        motionLuma.capacity = len;
+    }
+    motionLuma.fb     = fb;
+    motionLuma.width  = width;
+    motionLuma.height = height;
+    return esp_jpg_decode(fb->len, JPG_SCALE_8X, motionJpegRead, motionJpegWrite, &motionLuma) ==
+           ESP_OK;
+}
+
+// Luma signature of a camera frame, false if the frame cannot be read
+bool motionSignatureOf(const camera_fb_t* fb, uint8_t* sig) {
+    const uint8_t* buf   = fb->buf;
+    uint32_t       width = fb->width;
+    switch (fb->format) {
+        case PIXFORMAT_GRAYSCALE:
+            motionSignature(
+                fb->width,
+                fb->height,
+                MOTION_SAMPLE_STEP,
+                [buf, width](uint32_t x, uint32_t y) { return buf[y * width + x]; },
+                sig);
+            return true;
+        case PIXFORMAT_YUV422:
+            motionSignature(
+                fb->width,
+                fb->height,
+                MOTION_SAMPLE_STEP,
+                [buf, width](uint32_t x, uint32_t y) { return buf[(y * width + x) * 2]; },
+                sig);
+            return true;
+        case PIXFORMAT_RGB565:
+            motionSignature(
+                fb->width,
+                fb->height,
+                MOTION_SAMPLE_STEP,
+                [buf, width](uint32_t x, uint32_t y) {
+                    return motionLumaRGB565(buf + (y * width + x) * 2);
+                },
+                sig);
+            return true;
+        case PIXFORMAT_JPEG: {
+            if (!motionDecodeJpeg(fb)) {
+                return false;
+            }
+            const uint8_t* luma      = motionLuma.buf;
+            uint32_t       lumaWidth = motionLuma.width;
+            motionSignature(
+                motionLuma.width,
+                motionLuma.height,
+                1,
+                [luma, lumaWidth](uint32_t x, uint32_t y) { return luma[y * lumaWidth + x]; },
+                sig);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// Score a captured camera frame and decide whether it is streamed
+bool motionWantsFrame(const camera_fb_t* fb) {
+    uint32_t start = micros();
+    uint8_t  sig[MOTION_TILES];
+    if (!motionSignatureOf(fb, sig)) {
+        motionFailures++;
+        return true;
+    }
+    uint32_t now    = millis();
+    bool     active = motionState.started && now - motionState.lastMotionMs < MOTION_HOLD_MS;
+    uint8_t  score  = motionScore(motionState, motionConfig, sig);
+    bool     send   = motionDecide(motionState, motionConfig, now);
+    uint32_t us     = micros() - start;
+
+    motionFrames++;
+    motionUs += us;
+    if (us > motionMaxUs) {
+        motionMaxUs = us;
+    }
+    if (send) {
+        motionSent++;
+    }
+    if (!active && score >= MOTION_TRIGGER_TILES) {
+        motionEvents++;
+    }
+    motionLastScore = score;
+    return send;
+}
+
+uint8_t lastMotionScore() {
+    return motionLastScore;
+}
+
+// Detector totals for /metrics
+void addMotionMetrics(JsonDocument& doc) {
+    JsonObject motion        = doc.createNestedObject("motion");
+    motion["frames"]         = motionFrames;
+    motion["sent"]           = motionSent;
+    motion["events"]         = motionEvents;
+    motion["failures"]       = motionFailures;
+    motion["analyze_us"]     = motionUs;
+    motion["max_analyze_us"] = motionMaxUs;
+    motion["interval_ms"]    = motionState.intervalMs;
+}
+
+void initMotion() {
+    // Score of the last captured frame for consumers: changed tiles of the tile grid
+    server.on("/motion", HTTP_GET, [](AsyncWebServerRequest* request) {
+        StaticJsonDocument<256> doc;
+        doc["score"]       = motionLastScore;
+        doc["tiles"]       = MOTION_TILES;
+        doc["trigger"]     = MOTION_TRIGGER_TILES;
+        doc["motion"]      = motionLastScore >= MOTION_TRIGGER_TILES;
+        doc["interval_ms"] = motionState.intervalMs;
+        doc["floor_ms"]    = MOTION_FLOOR_MS;
+
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+}
+#else
+inline bool motionWantsFrame(const camera_fb_t* fb) {
+    return true;
+}
+
+inline uint8_t lastMotionScore() {
+    return 0;
+}
+
+inline void initMotion() {}
+#endif
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <AsyncTCP.h>
+#include <ESPAsyncWebServer.h>
+#include <Preferences.h>
+#include <WiFi.h>
+
+#include "config.h"
+#include "json_config.h"
+
+extern AsyncWebServer server;
+
+// Network stack tuning. WiFi power save and TX power are switched at runtime, Nagle's
+// algorithm is disabled (noDelay) per TCP connection when it is accepted, so a profile
+// change applies to new connections. lwIP buffer and window sizes come from the precompiled
+// Arduino sdkconfig and the AsyncTCP task stack/queue are fixed in the library; they are
+// reported so that results record them, only the AsyncTCP core is a build option.
+struct NetProfile {
+    const char*    name;
+    wifi_ps_type_t powerSave;
+    wifi_power_t   txPower;
+    bool           noDelay;
+};
+
+static const NetProfile netProfiles[] = {
+    {"default", WIFI_PS_MIN_MODEM, WIFI_POWER_19_5dBm, false},  // Arduino defaults
+    {"throughput", WIFI_PS_NONE, WIFI_POWER_19_5dBm, false},    // radio always on, Nagle
+    {"latency", WIFI_PS_NONE, WIFI_POWER_19_5dBm, true},        // radio always on, no Nagle
+    {"low_power", WIFI_PS_MAX_MODEM, WIFI_POWER_11dBm, false},
+};
+static const uint8_t netProfileCount = sizeof(netProfiles) / sizeof(NetProfile);
+
+static uint8_t       activeNetProfile  = 0;
+static volatile bool netProfilePending = false;
+static uint8_t       pendingNetProfile = 0;
+
+static const char* const powerSaveNames[] = {"none", "min_modem", "max_modem"};
+
+bool netNoDelay() {
+    return netProfiles[activeNetProfile].noDelay;
+}
+
+// Apply the profile's Nagle setting to a newly accepted connection
+void applyNetProfile(AsyncClient* client) {
+    if (client) {
+        client->setNoDelay(netNoDelay());
+    }
+}
+
+void applyNetProfile(WiFiClient& client) {
+    client.setNoDelay(netNoDelay());
+}
+
+void saveNetProfile(uint8_t index) {
+    Preferences prefs;
+    prefs.begin("network", false);
+    prefs.putUChar("profile", index);
+    prefs.end();
+}
+
+uint8_t loadNetProfile() {
+    Preferences prefs;
+    prefs.begin("network", true);
+    uint8_t index = prefs.getUChar("profile", 0);
+    prefs.end();
+    return index < netProfileCount ? index : 0;
+}
+
+// Switch the radio settings of the active profile, needs a started WiFi driver
+void applyRadioSettings() {
+    const NetProfile& profile = netProfiles[activeNetProfile];
+    WiFi.setSleep(profile.powerSave);
+    WiFi.setTxPower(profile.txPower);
+    Serial.printf("Network profile: %s (power save %s, TX power %.1f dBm, noDelay %d)\n",
+                  profile.name,
+                  powerSaveNames[profile.powerSave],
+                  profile.txPower / 4.0f,
+                  profile.noDelay);
+}
+
+void initNetProfile() {
+    server.on("/network", HTTP_GET, [](AsyncWebServerRequest* request) {
+        const NetProfile& profile = netProfiles[activeNetProfile];
+
+        StaticJsonDocument<768> doc;
+        doc["profile"]      = profile.name;
+        doc["pending"]      = netProfilePending;
+        doc["power_save"]   = powerSaveNames[profile.powerSave];
+        doc["tx_power_dbm"] = WiFi.getTxPower() / 4.0f;
+        doc["no_delay"]     = profile.noDelay;
+        JsonArray profiles  = doc.createNestedArray("profiles");
+        for (uint8_t i = 0; i < netProfileCount; i++) {
+            profiles.add(netProfiles[i].name);
+        }
+
+        // Build-time settings, fixed for this image
+        JsonObject build        = doc.createNestedObject("build");
+        build["async_tcp_core"] = CONFIG_ASYNC_TCP_RUNNING_CORE;
+#ifdef CONFIG_LWIP_TCP_SND_BUF_DEFAULT
+        build["tcp_snd_buf"] = CONFIG_LWIP_TCP_SND_BUF_DEFAULT;
+#endif
+#ifdef CONFIG_LWIP_TCP_WND_DEFAULT
+        build["tcp_wnd"] = CONFIG_LWIP_TCP_WND_DEFAULT;
+#endif
+#ifdef CONFIG_LWIP_TCP_MSS
+        build["tcp_mss"] = CONFIG_LWIP_TCP_MSS;
+#endif
+#ifdef CONFIG_ESP32_WIFI_STATIC_TX_BUFFER_NUM
+        build["wifi_tx_buffers"] = CONFIG_ESP32_WIFI_STATIC_TX_BUFFER_NUM;
+#endif
+
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+
+    onJsonConfigPost("/network", [](JsonDocument& doc) -> const char* {
+        uint8_t profile;
+        if (!parseName(doc["profile"], netProfiles, &profile)) {
+            return "Unknown network profile";
+        }
+        if (doc["persist"] | true) {
+            saveNetProfile(profile);
+        }
+        pendingNetProfile = profile;
+        netProfilePending = true;
+        return nullptr;
+    });
+
+    activeNetProfile = loadNetProfile();
+    applyRadioSettings();
+}
+
+// Apply a profile requested via /network, called from loop()
+void applyPendingNetProfile() {
+    if (!netProfilePending) {
+        return;
+    }
+    netProfilePending = false;
+    activeNetProfile  = pendingNetProfile;
+    applyRadioSettings();
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <Update.h>
+
+#include "config.h"
+
+extern AsyncWebServer server;
+
+// Resumable OTA update over HTTP. The image is sent in chunks, each POST /ota/chunk carries
+// the offset it starts at, so an interrupted upload continues from GET /ota "offset"
+// instead of starting over. One upload at a time; the session survives dropped connections
+// but not a reboot. The new image is activated only after its MD5 matches.
+static bool     otaActive         = false;
+static size_t   otaSize           = 0;
+static size_t   otaWritten        = 0;
+static char     otaMD5[33]        = "";
+static char     otaBuildHash[33]  = "";
+static int      otaChunkStatus    = 200;  // status of the chunk request being received
+static bool     otaRestartPending = false;
+static uint32_t otaRestartAt      = 0;
+
+void sendOTAStatus(AsyncWebServerRequest* request, int code, const char* error = nullptr) {
+    StaticJsonDocument<256> doc;
+    doc["active"]     = otaActive;
+    doc["offset"]     = otaWritten;
+    doc["size"]       = otaSize;
+    doc["md5"]        = otaMD5;
+    doc["build_hash"] = BUILD_HASH;
+    if (error) {
+        doc["error"] = error;
+    }
+
+    String response;
+    serializeJson(doc, response);
+    request->send(code, "application/json", response);
+}
+
+void initOTA() {
+    server.on("/ota", HTTP_GET, [](AsyncWebServerRequest* request) {
+        sendOTAStatus(request, 200);
+    });
+
+    // {"size": bytes, "md5": hex, "build_hash": hash}; continues a session with the same MD5
+    server.on(
+        "/ota/begin",
+        HTTP_POST,
+        [](AsyncWebServerRequest* request) {
+            if (request->contentLength() == 0) {
+                request->send(400, "text/plain", "Missing JSON body");
+            }
+        },
+        nullptr,
+        [](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+            StaticJsonDocument<192> doc;
+            if (deserializeJson(doc, (const char*) data, len)) {
+                request->send(400, "text/plain", "Invalid JSON");
+                return;
+            }
+            const char* md5  = doc["md5"] | "";
+            size_t      size = doc["size"] | 0;
+            if (strlen(md5) != 32 || size == 0) {
+                request->send(400, "text/plain", "size and md5 are required");
+                return;
+            }
+
+            if (otaActive && strcmp(md5, otaMD5) == 0 && size == otaSize) {
+                sendOTAStatus(request, 200);  // resume
+                return;
+            }
+            if (otaActive) {
+                Update.abort();
+            }
+            otaActive  = false;
+            otaWritten = 0;
+            if (!Update.begin(size) || !Update.setMD5(md5)) {
+                sendOTAStatus(request, 500, Update.errorString());
+                return;
+            }
+            otaActive = true;
+            otaSize   = size;
+            strlcpy(otaMD5, md5, sizeof(otaMD5));
+            strlcpy(otaBuildHash, doc["build_hash"] | "", sizeof(otaBuildHash));
+            Serial.printf("OTA started: %u bytes, build %s\n", size, otaBuildHash);
+            sendOTAStatus(request, 200);
+        });
+
+    // Raw image bytes, ?offset= is the image offset of the first byte
+    server.on(
+        "/ota/chunk",
+        HTTP_POST,
+        [](AsyncWebServerRequest* request) {
+            sendOTAStatus(
+                request, otaChunkStatus, otaChunkStatus == 200 ? nullptr : "Chunk rejected");
+        },
+        nullptr,
+        [](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+            if (index == 0) {
+                size_t offset  = request->hasParam("offset")
+                                     ? request->getParam("offset")->value().toInt()
+                                     : 0;
+                otaChunkStatus = !otaActive ? 409 : (offset != otaWritten ? 409 : 200);
+            }
+            if (otaChunkStatus != 200) {
+                return;
+            }
+            if (Update.write(data, len) != len) {
+                otaChunkStatus = 500;
+                return;
+            }
+            otaWritten += len;
+        });
+
+    server.on("/ota/end", HTTP_POST, [](AsyncWebServerRequest* request) {
+        if (!otaActive || otaWritten != otaSize) {
+            sendOTAStatus(request, 409, "Image incomplete");
+            return;
+        }
+        otaActive = false;
+        if (!Update.end()) {
+            sendOTAStatus(request, 500, Update.errorString());
+            return;
+        }
+        Serial.printf("OTA finished, restarting into build %s\n", otaBuildHash);
+        sendOTAStatus(request, 200);
+        // Restart from loop() once the response has been sent
+        otaRestartAt      = millis() + 500;
+        otaRestartPending = true;
+    });
+}
+
+// Called from loop()
+void handleOTA() {
+    if (otaRestartPending && (int32_t) (millis() - otaRestartAt) >= 0) {
+        ESP.restart();
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "esp_attr.h"
+
+// Hot paths of the transports: the frame pool copy, the MJPEG chunk callback, the UDP and RTP
+// packetizers, the WebRTC frame fan-out and the control parser. They run from flash through
+// the cache that is shared with PSRAM, so a miss stalls the core while the line is fetched,
+// and large frame copies evict the code of the next call.
+//
+// HOT_PATH_IRAM=1 places these functions in IRAM. Only their own code moves, the library
+// functions they call (WiFiUDP, lwIP, ArduinoJson) still run from flash.
+#ifndef HOT_PATH_IRAM
+#define HOT_PATH_IRAM 0
+#endif
+
+#if HOT_PATH_IRAM
+#define HOT_PATH IRAM_ATTR
+#else
+#define HOT_PATH
+#endif
+
+// PROFILE_HOT_PATHS=1 counts CPU cycles (CCOUNT) of every call of a hot path. Where the
+// Xtensa performance monitor is available, instruction fetch stalls on cache misses and data
+// stalls (PSRAM loads and stores) are counted too. The counters are per core and all
+// profiled tasks are pinned; counts include interrupts taken during the call.
+#ifndef PROFILE_HOT_PATHS
+#define PROFILE_HOT_PATHS 0
+#endif
+
+#if PROFILE_HOT_PATHS
+#if __has_include(<xtensa_perfmon_access.h>)
+#include <xtensa_perfmon_access.h>
+#include <xtensa_perfmon_masks.h>
+#define PROFILE_STALLS 1
+#else
+#define PROFILE_STALLS 0
+#endif
+
+// Performance counter ids
+#define PERFMON_I_STALL 0
+#define PERFMON_D_STALL 1
+
+// Totals of one hot path. A path runs in one task at a time, so the totals need no lock.
+struct HotPathStats {
+    const char*       name;
+    volatile uint32_t calls;
+    volatile uint32_t maxCycles;
+    volatile uint64_t cycles;
+    volatile uint64_t iStall;
+    volatile uint64_t dStall;
+    volatile uint64_t bytes;
+};
+
+static HotPathStats frameCopyPath   = {"frame_copy"};
+static HotPathStats httpChunkPath   = {"http_chunk"};
+static HotPathStats udpPacketPath   = {"udp_packet"};
+static HotPathStats rtpPacketPath   = {"rtp_packet"};
+static HotPathStats webrtcFramePath = {"webrtc_frame"};
+static HotPathStats controlPath     = {"control_parse"};
+
+static HotPathStats* const hotPaths[] = {
+    &frameCopyPath, &httpChunkPath, &udpPacketPath, &rtpPacketPath, &webrtcFramePath, &controlPath};
+
+#if PROFILE_STALLS
+static bool perfmonStarted[portNUM_PROCESSORS];
+
+// Start the stall counters of the calling core on its first profiled call
+void startPerfmon() {
+    int core = xPortGetCoreID();
+    if (perfmonStarted[core]) {
+        return;
+    }
+    xtensa_perfmon_stop();
+    xtensa_perfmon_init(PERFMON_I_STALL, XTPERF_CNT_I_STALL, XTPERF_MASK_I_STALL_CACHE_MISS, 0, -1);
+    xtensa_perfmon_init(PERFMON_D_STALL, XTPERF_CNT_D_STALL, XTPERF_MASK_D_STALL_ALL, 0, -1);
+    xtensa_perfmon_reset(PERFMON_I_STALL);
+    xtensa_perfmon_reset(PERFMON_D_STALL);
+    xtensa_perfmon_start();
+    perfmonStarted[core] = true;
+}
+#endif
+
+// Counts cycles and stalls from construction to the end of the scope
+class HotPathScope {
+   public:
+    explicit HotPathScope(HotPathStats& stats) : stats_(stats) {
+#if PROFILE_STALLS
+        startPerfmon();
+        iStall_ = xtensa_perfmon_value(PERFMON_I_STALL);
+        dStall_ = xtensa_perfmon_value(PERFMON_D_STALL);
+#endif
+        start_ = ESP.getCycleCount();
+    }
+
+    ~HotPathScope() {
+        uint32_t cycles = ESP.getCycleCount() - start_;
+        stats_.calls++;
+        stats_.cycles += cycles;
+        if (cycles > stats_.maxCycles) {
+            stats_.maxCycles = cycles;
+        }
+#if PROFILE_STALLS
+        stats_.iStall += xtensa_perfmon_value(PERFMON_I_STALL) - iStall_;
+        stats_.dStall += xtensa_perfmon_value(PERFMON_D_STALL) - dStall_;
+#endif
+        stats_.bytes += bytes;
+    }
+
+    size_t bytes = 0;  // payload handled by the call
+
+   private:
+    HotPathStats& stats_;
+    uint32_t      start_;
+    uint32_t      iStall_ = 0;
+    uint32_t      dStall_ = 0;
+};
+
+#define PROFILE_HOT_PATH(stats) HotPathScope hotPathScope_(stats)
+#define PROFILE_BYTES(n)        hotPathScope_.bytes = (n)
+
+// Hot path counters for /metrics
+void addHotPathMetrics(JsonDocument& doc) {
+    JsonObject profile = doc.createNestedObject("hot_paths");
+    profile["iram"]    = HOT_PATH_IRAM;
+    profile["stalls"]  = PROFILE_STALLS;
+    profile["cpu_mhz"] = ESP.getCpuFreqMHz();
+    JsonObject paths   = profile.createNestedObject("paths");
+    for (HotPathStats* stats : hotPaths) {
+        JsonObject entry    = paths.createNestedObject(stats->name);
+        entry["calls"]      = stats->calls;
+        entry["cycles"]     = stats->cycles;
+        entry["max_cycles"] = stats->maxCycles;
+        entry["i_stall"]    = stats->iStall;
+        entry["d_stall"]    = stats->dStall;
+        entry["bytes"]      = stats->bytes;
+    }
+}
+#else
+#define PROFILE_HOT_PATH(stats)
+#define PROFILE_BYTES(n)
+#endif
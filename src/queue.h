@@ -0,0 +1,142 @@
+#pragma once
+
+// Fixed-capacity lock-free queues between tasks: SpscQueue hands frames to the software JPEG
+// encoder (soft_jpeg.h), MpscQueue hands HTTP control commands to the control task
+// (control.h).
+//
+// Both queues are non-blocking: tryPush() fails when the queue is full and tryPop() when it
+// is empty. A consumer that should sleep while the queue is empty pairs the queue with a task
+// notification (FreeRTOS) or a condition variable (host).
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Indices written by different cores live on separate cache lines. The ESP32 cache line is
+// 32 bytes, common host CPUs use 64.
+#ifndef QUEUE_CACHE_LINE
+#if defined(ESP_PLATFORM) || defined(ARDUINO_ARCH_ESP32)
+#define QUEUE_CACHE_LINE 32
+#else
+#define QUEUE_CACHE_LINE 64
+#endif
+#endif
+
+// Single producer, single consumer ring buffer. Producer and consumer each own one index and
+// keep a cached copy of the other one, so most operations touch no shared cache line.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two");
+
+   public:
+    bool tryPush(T value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tailCache_ == Capacity) {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head - tailCache_ == Capacity) {
+                return false;
+            }
+        }
+        slots_[head & (Capacity - 1)] = std::move(value);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T* value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == headCache_) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail == headCache_) {
+                return false;
+            }
+        }
+        *value = std::move(slots_[tail & (Capacity - 1)]);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called concurrently with push or pop
+    size_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    static constexpr size_t capacity() {
+        return Capacity;
+    }
+
+   private:
+    alignas(QUEUE_CACHE_LINE) std::atomic<size_t> head_{0};  // written by the producer
+    size_t tailCache_ = 0;
+    alignas(QUEUE_CACHE_LINE) std::atomic<size_t> tail_{0};  // written by the consumer
+    size_t headCache_ = 0;
+    alignas(QUEUE_CACHE_LINE) T slots_[Capacity];
+};
+
+// Multiple producers, single consumer bounded queue. Every slot carries a sequence number that
+// tells whether it is free for the producer of a given position or holds a value for the
+// consumer (Vyukov's bounded queue with a single consumer). Producers claim positions with a
+// compare-and-swap, the consumer needs no atomic read-modify-write.
+template <typename T, size_t Capacity>
+class MpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two");
+
+   public:
+    MpscQueue() {
+        for (size_t i = 0; i < Capacity; i++) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPush(T value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot&     slot     = slots_[head & (Capacity - 1)];
+            size_t    sequence = slot.sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff     = (ptrdiff_t) sequence - (ptrdiff_t) head;
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(head + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                head = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T* value) {
+        Slot&  slot     = slots_[tail_ & (Capacity - 1)];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != tail_ + 1) {
+            return false;  // empty, or a producer has not finished writing the slot yet
+        }
+        *value = std::move(slot.value);
+        slot.sequence.store(tail_ + Capacity, std::memory_order_release);
+        tail_++;
+        return true;
+    }
+
+    static constexpr size_t capacity() {
+        return Capacity;
+    }
+
+   private:
+    struct alignas(QUEUE_CACHE_LINE) Slot {
+        std::atomic<size_t> sequence;
+        T                   value;
+    };
+
+    alignas(QUEUE_CACHE_LINE) std::atomic<size_t> head_{0};  // shared by the producers
+    alignas(QUEUE_CACHE_LINE) size_t tail_ = 0;              // owned by the consumer
+    Slot slots_[Capacity];
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+// Lossless codec for RGB565 frames in the spirit of QOI. Every pixel is predicted from the one
+// before it and stored as the smallest of four operations:
+//
+//   00nnnnnn                    literal, n = 1..63 big-endian pixels follow
+//   01rrggbb                    channel deltas -2..1 (biased by 2)
+//   10gggggg rrrrbbbb           green delta -32..31 (biased by 32), red and blue deltas minus
+//                               half of the green delta, -8..7 (biased by 8)
+//   11nnnnnn                    previous pixel repeated n + 1 times (1..64)
+//
+// Deltas wrap around the channel width (5 bits red and blue, 6 bits green). The stream starts
+// with an 8-byte header ("R5", version, flags, width and height little-endian) and the first
+// pixel is predicted from black. Rows are not reset, the last pixel of a row predicts the
+// first of the next one.
+//
+// The encoder reads two pixels per 32-bit load and computes the three channel deltas with one
+// subtraction: red, green and blue are spread into separate fields of a word with a guard bit
+// above each, so no borrow crosses a field. The decoder on the receiving side is
+// benchmark/utils/raw_codec.py.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifndef RAW_CODEC_ATTR
+#define RAW_CODEC_ATTR
+#endif
+
+#define RAW_CODEC_HEADER  8
+#define RAW_CODEC_VERSION 1
+
+#define RAW_OP_LITERAL 0x00
+#define RAW_OP_DIFF    0x40
+#define RAW_OP_LUMA    0x80
+#define RAW_OP_RUN     0xC0
+
+#define RAW_LITERAL_MAX 63
+#define RAW_RUN_MAX     64
+
+// Channel fields of a spread pixel: blue bits 0-4, red bits 11-15, green bits 21-26
+#define RAW_FIELDS    0x07E0F81Fu
+#define RAW_GUARDS    0x08010020u  // bit above every field
+#define RAW_DIFF_BIAS 0x00401002u  // 2 in every field
+#define RAW_DIFF_MASK 0x0780E01Cu  // field bits that must be clear for a biased delta 0..3
+
+// Largest encoded size of a frame, every pixel a literal
+inline size_t rawCodecBound(size_t pixels) {
+    return RAW_CODEC_HEADER + pixels * 2 + (pixels + RAW_LITERAL_MAX - 1) / RAW_LITERAL_MAX;
+}
+
+inline uint32_t rawSpread(uint32_t pixel) {
+    return (pixel & 0xF81F) | ((pixel & 0x07E0) << 16);
+}
+
+struct RawEncoder {
+    uint8_t* out;
+    uint8_t* literal;  // tag of the open literal block, nullptr if none
+    uint32_t prev;
+    uint32_t run;
+};
+
+inline void rawFlushRun(RawEncoder& enc) {
+    if (enc.run) {
+        *enc.out++ = RAW_OP_RUN | (enc.run - 1);
+        enc.run    = 0;
+    }
+}
+
+inline void rawEncodePixel(RawEncoder& enc, uint32_t pixel) {
+    if (pixel == enc.prev) {
+        enc.literal = nullptr;
+        if (++enc.run == RAW_RUN_MAX) {
+            rawFlushRun(enc);
+        }
+        return;
+    }
+    rawFlushRun(enc);
+
+    // Wrapped deltas of all three channels, then the same biased by 2 for the DIFF test
+    uint32_t delta  = ((rawSpread(pixel) | RAW_GUARDS) - rawSpread(enc.prev)) & RAW_FIELDS;
+    uint32_t biased = (delta + RAW_DIFF_BIAS) & RAW_FIELDS;
+    enc.prev        = pixel;
+    if (!(biased & RAW_DIFF_MASK)) {
+        *enc.out++  = RAW_OP_DIFF | ((biased >> 11) & 3) << 4 | ((biased >> 21) & 3) << 2 |
+                     (biased & 3);
+        enc.literal = nullptr;
+        return;
+    }
+
+    int32_t dg = (int32_t) ((delta >> 21) ^ 0x20) - 0x20;
+    int32_t dr = (int32_t) (((delta >> 11) & 0x1F) ^ 0x10) - 0x10;
+    int32_t db = (int32_t) ((delta & 0x1F) ^ 0x10) - 0x10;
+    int32_t rg = dr - (dg >> 1) + 8;
+    int32_t bg = db - (dg >> 1) + 8;
+    // LUMA and a literal pixel take two bytes each, an open literal block is extended instead,
+    // which keeps the worst case at two bytes per pixel plus one tag per block
+    bool literalOpen = enc.literal && *enc.literal != (RAW_OP_LITERAL | RAW_LITERAL_MAX);
+    if (!literalOpen && (uint32_t) rg < 16 && (uint32_t) bg < 16) {
+        *enc.out++  = RAW_OP_LUMA | (dg + 32);
+        *enc.out++  = rg << 4 | bg;
+        enc.literal = nullptr;
+        return;
+    }
+
+    if (!literalOpen) {
+        enc.literal  = enc.out++;
+        *enc.literal = RAW_OP_LITERAL;
+    }
+    (*enc.literal)++;
+    *enc.out++ = pixel >> 8;
+    *enc.out++ = pixel;
+}
+
+// Encode a big-endian RGB565 frame (the byte order of the camera driver) into dst, which holds
+// at least rawCodecBound(width * height) bytes. Returns the encoded size.
+RAW_CODEC_ATTR inline size_t encodeRGB565(const uint8_t* src,
+                                          uint16_t       width,
+                                          uint16_t       height,
+                                          uint8_t*       dst) {
+    dst[0] = 'R';
+    dst[1] = '5';
+    dst[2] = RAW_CODEC_VERSION;
+    dst[3] = 0;
+    dst[4] = width;
+    dst[5] = width >> 8;
+    dst[6] = height;
+    dst[7] = height >> 8;
+
+    RawEncoder enc = {dst + RAW_CODEC_HEADER, nullptr, 0, 0};
+    size_t     pixels = (size_t) width * height;
+    size_t     pairs  = pixels / 2;
+    for (size_t i = 0; i < pairs; i++) {
+        uint32_t word;
+        memcpy(&word, src + i * 4, 4);  // a single load on aligned frame buffers
+        word = __builtin_bswap32(word);  // first pixel in the upper half
+        if (word == enc.prev * 0x10001u && enc.run <= RAW_RUN_MAX - 2) {
+            // Both pixels continue the run
+            enc.literal = nullptr;
+            enc.run += 2;
+            if (enc.run == RAW_RUN_MAX) {
+                rawFlushRun(enc);
+            }
+            continue;
+        }
+        rawEncodePixel(enc, word >> 16);
+        rawEncodePixel(enc, word & 0xFFFF);
+    }
+    if (pixels & 1) {
+        rawEncodePixel(enc, src[pixels * 2 - 2] << 8 | src[pixels * 2 - 1]);
+    }
+    rawFlushRun(enc);
+    return enc.out - dst;
+}
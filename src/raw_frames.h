@@ -0,0 +1,201 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "config.h"
+#include "esp_camera.h"
+#include "esp_heap_caps.h"
+#include "profiling.h"
+
+// RAW_FORMAT selects the pixel format of RAW_MODE frames: RGB565 (2 bytes per pixel), YUV422
+// (2 bytes, Y U Y V) or GRAYSCALE (1 byte, the luma of the sensor). RAW_SCALE=2, 4 or 8
+// box-downscales frames by that factor on the device (src/downscale.h), so machine vision
+// consumers get 1 byte per pixel at a fraction of the sensor resolution.
+//
+// RAW_CODEC=1 compresses RGB565 frames losslessly (src/raw_codec.h) after downscaling. The host
+// decodes them with benchmark/utils/raw_codec.py.
+//
+// Frames are prepared before the transports send them and before they enter the frame pool, so
+// UDP, RTSP, WebSocket and /capture carry the same frame. JPEG builds send the camera frame
+// unchanged.
+#ifndef RAW_CODEC
+#define RAW_CODEC 0
+#endif
+
+#define RAW_XSTR(x)       RAW_STR(x)
+#define RAW_STR(x)        #x
+#define RAW_CONCAT_(a, b) a##b
+#define RAW_CONCAT(a, b)  RAW_CONCAT_(a, b)
+#define RAW_PIXFORMAT     RAW_CONCAT(PIXFORMAT_, RAW_FORMAT)
+
+#if RAW_SCALE != 1 && RAW_SCALE != 2 && RAW_SCALE != 4 && RAW_SCALE != 8
+#error "RAW_SCALE must be 1, 2, 4 or 8"
+#endif
+
+#if RAW_MODE
+// Frames prepared and their size, with downscaling the time it took
+static uint32_t rawFrames      = 0;
+static uint64_t rawFrameBytes  = 0;
+static uint32_t rawScaleMaxUs  = 0;
+static uint64_t rawScaleUs     = 0;
+static uint16_t rawFrameWidth  = 0;
+static uint16_t rawFrameHeight = 0;
+#endif
+
+#if RAW_MODE && RAW_SCALE > 1
+#define DOWNSCALE_ATTR HOT_PATH
+#include "downscale.h"
+
+// Downscaled frame, valid until the next call. Only the video service prepares frames.
+static camera_fb_t rawScaledFrame;
+static uint8_t*    rawScaleBuf      = nullptr;
+static size_t      rawScaleCapacity = 0;
+static uint32_t*   rawScaleAcc      = nullptr;  // accumulator of one output row, internal RAM
+static size_t      rawScaleAccWords = 0;
+
+// Downscale a camera frame. Returns the downscaled frame, or fb itself if the buffers could not
+// be allocated.
+camera_fb_t* downscaleRawFrame(camera_fb_t* fb) {
+    DownscaleFormat format = fb->format == PIXFORMAT_GRAYSCALE ? DOWNSCALE_GRAYSCALE
+                             : fb->format == PIXFORMAT_YUV422  ? DOWNSCALE_YUV422
+                                                               : DOWNSCALE_RGB565;
+    uint16_t        width  = downscaleWidth(fb->width, RAW_SCALE);
+    uint16_t        height = downscaleHeight(fb->height, RAW_SCALE);
+    size_t          len    = (size_t) width * height * downscaleBytesPerPixel(format);
+    size_t          words  = downscaleAccWords(fb->width, RAW_SCALE);
+    // The output buffer grows to the first downscaled frame and is reused after that
+    if (len > rawScaleCapacity) {
+        uint8_t* buf = (uint8_t*) heap_caps_realloc(
+            rawScaleBuf, len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!buf) {
+            return fb;
+        }
+        rawScaleBuf      = buf;
+        rawScaleCapacity = len;
+    }
+    if (words > rawScaleAccWords) {
+        uint32_t* acc = (uint32_t*) heap_caps_realloc(
+            rawScaleAcc, words * sizeof(uint32_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!acc) {
+            return fb;
+        }
+        rawScaleAcc      = acc;
+        rawScaleAccWords = words;
+    }
+
+    uint32_t start = micros();
+    downscaleFrame(format, fb->buf, fb->width, fb->height, RAW_SCALE, rawScaleAcc, rawScaleBuf);
+    uint32_t us = micros() - start;
+
+    rawScaleUs += us;
+    if (us > rawScaleMaxUs) {
+        rawScaleMaxUs = us;
+    }
+
+    rawScaledFrame        = *fb;
+    rawScaledFrame.buf    = rawScaleBuf;
+    rawScaledFrame.len    = len;
+    rawScaledFrame.width  = width;
+    rawScaledFrame.height = height;
+    return &rawScaledFrame;
+}
+#else
+inline camera_fb_t* downscaleRawFrame(camera_fb_t* fb) {
+    return fb;
+}
+#endif
+
+#if RAW_MODE && RAW_CODEC
+#define RAW_CODEC_ATTR HOT_PATH
+#include "raw_codec.h"
+
+static_assert(RAW_PIXFORMAT == PIXFORMAT_RGB565, "RAW_CODEC compresses RGB565 frames only");
+
+// Encoded frame, valid until the next call. Only the video service encodes.
+static camera_fb_t rawEncodedFrame;
+static uint8_t*    rawCodecBuf      = nullptr;
+static size_t      rawCodecCapacity = 0;
+
+static uint32_t rawCodecFrames       = 0;
+static uint32_t rawCodecMaxUs        = 0;
+static uint64_t rawCodecUs           = 0;
+static uint64_t rawCodecRawBytes     = 0;
+static uint64_t rawCodecEncodedBytes = 0;
+
+// Encode a camera frame. Returns the encoded frame, or fb itself if the output buffer could
+// not be allocated.
+camera_fb_t* encodeRawFrame(camera_fb_t* fb) {
+    size_t bound = rawCodecBound((size_t) fb->width * fb->height);
+    if (bound > rawCodecCapacity) {
+        // Sized once for the worst case of the resolution, the steady state does not allocate
+        uint8_t* buf = (uint8_t*) heap_caps_realloc(
+            rawCodecBuf, bound, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!buf) {
+            return fb;
+        }
+        rawCodecBuf      = buf;
+        rawCodecCapacity = bound;
+    }
+
+    uint32_t start = micros();
+    size_t   len   = encodeRGB565(fb->buf, fb->width, fb->height, rawCodecBuf);
+    uint32_t us    = micros() - start;
+
+    rawCodecFrames++;
+    rawCodecUs += us;
+    if (us > rawCodecMaxUs) {
+        rawCodecMaxUs = us;
+    }
+    rawCodecRawBytes += fb->len;
+    rawCodecEncodedBytes += len;
+
+    rawEncodedFrame     = *fb;
+    rawEncodedFrame.buf = rawCodecBuf;
+    rawEncodedFrame.len = len;
+    return &rawEncodedFrame;
+}
+
+// Codec totals for /metrics
+void addRawCodecMetrics(JsonDocument& doc) {
+    JsonObject codec       = doc.createNestedObject("raw_codec");
+    codec["frames"]        = rawCodecFrames;
+    codec["raw_bytes"]     = rawCodecRawBytes;
+    codec["encoded_bytes"] = rawCodecEncodedBytes;
+    codec["encode_us"]     = rawCodecUs;
+    codec["max_encode_us"] = rawCodecMaxUs;
+}
+#else
+inline camera_fb_t* encodeRawFrame(camera_fb_t* fb) {
+    return fb;
+}
+#endif
+
+// Frame the transports send for a camera frame: downscaled and encoded as the build asks
+camera_fb_t* prepareRawFrame(camera_fb_t* fb) {
+#if RAW_MODE
+    camera_fb_t* frame = encodeRawFrame(downscaleRawFrame(fb));
+    rawFrames++;
+    rawFrameBytes += frame->len;
+    rawFrameWidth  = frame->width;
+    rawFrameHeight = frame->height;
+    return frame;
+#else
+    return fb;
+#endif
+}
+
+#if RAW_MODE
+// Raw frame format and totals for /metrics
+void addRawFrameMetrics(JsonDocument& doc) {
+    JsonObject raw          = doc.createNestedObject("raw_frames");
+    raw["format"]           = RAW_XSTR(RAW_FORMAT);
+    raw["scale"]            = RAW_SCALE;
+    raw["width"]            = rawFrameWidth;
+    raw["height"]           = rawFrameHeight;
+    raw["frames"]           = rawFrames;
+    raw["bytes"]            = rawFrameBytes;
+    raw["downscale_us"]     = rawScaleUs;
+    raw["max_downscale_us"] = rawScaleMaxUs;
+}
+#endif
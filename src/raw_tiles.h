@@ -0,0 +1,150 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "config.h"
+#include "esp_camera.h"
+#include "esp_heap_caps.h"
+#include "profiling.h"
+#include "raw_frames.h"
+
+// RAW_TILES=1 streams RAW_MODE frames over UDP as changed tiles (src/tile_delta.h): only the
+// RAW_TILE_SIZE x RAW_TILE_SIZE tiles whose samples moved more than RAW_TILE_THRESHOLD levels
+// on average since they were last sent go out, with a full refresh every RAW_TILE_REFRESH
+// frames. The host composes frames with benchmark/utils/raw_tiles.py. Frames are tiled after
+// downscaling, RTSP, WebRTC and /capture still carry whole frames.
+#ifndef RAW_TILES
+#define RAW_TILES 0
+#endif
+
+#if RAW_TILES && !RAW_MODE
+#error "RAW_TILES sends raw frames, it needs RAW_MODE"
+#endif
+
+#if RAW_TILES && RAW_CODEC
+#error "RAW_TILES sends raw pixels, it cannot be combined with RAW_CODEC"
+#endif
+
+#if RAW_TILES
+#define TILE_DELTA_ATTR HOT_PATH
+#include "tile_delta.h"
+
+#ifndef RAW_TILE_SIZE
+#define RAW_TILE_SIZE 16
+#endif
+
+#ifndef RAW_TILE_THRESHOLD
+#define RAW_TILE_THRESHOLD 4
+#endif
+
+#ifndef RAW_TILE_REFRESH
+#define RAW_TILE_REFRESH 50
+#endif
+
+// Datagram size of the tiles, UDP_MAX_PACKET_SIZE of the whole-frame protocol
+#define RAW_TILE_PACKET 1400
+
+#define RAW_TILE_BPP (RAW_PIXFORMAT == PIXFORMAT_GRAYSCALE ? 1 : 2)
+
+static_assert(RAW_TILE_SIZE % 2 == 0, "RAW_TILE_SIZE must be even for YUV422 pixel pairs");
+static_assert(TILE_DELTA_HEADER + 2 + RAW_TILE_SIZE * RAW_TILE_SIZE * RAW_TILE_BPP <=
+                  RAW_TILE_PACKET,
+              "a tile must fit a datagram, RAW_TILE_SIZE is at most 16 (36 for GRAYSCALE)");
+
+static const TileDeltaConfig rawTileConfig = {
+    RAW_TILE_SIZE, RAW_TILE_THRESHOLD, RAW_TILE_REFRESH, RAW_TILE_PACKET};
+
+// Only the video service sends tiles
+static TileDeltaState rawTileState     = {};
+static size_t         rawTileRefBytes  = 0;
+static uint32_t       rawTileFlagCount = 0;
+static uint8_t        rawTilePacket[RAW_TILE_PACKET];
+
+static uint32_t rawTileFrames    = 0;
+static uint32_t rawTileRefreshes = 0;
+static uint32_t rawTileFailures  = 0;  // frames sent whole, no memory for the reference
+static uint64_t rawTileTiles     = 0;
+static uint64_t rawTileChanged   = 0;
+static uint64_t rawTileBytes     = 0;
+static uint64_t rawTileUs        = 0;
+static uint32_t rawTileMaxUs     = 0;
+
+// Allocate the reference and tile flags for a prepared raw frame. Returns false if the frame
+// cannot be tiled and must be sent whole.
+bool reserveRawTiles(const camera_fb_t* fb) {
+    uint32_t tiles = tileCount(fb->width, fb->height, RAW_TILE_SIZE);
+    // Reallocated only when the frame grows, e.g. after a resolution change
+    if (fb->len > rawTileRefBytes) {
+        uint8_t* reference = (uint8_t*) heap_caps_realloc(
+            rawTileState.reference, fb->len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!reference) {
+            rawTileFailures++;
+            return false;
+        }
+        rawTileState.reference = reference;
+        rawTileRefBytes        = fb->len;
+    }
+    if (tiles > rawTileFlagCount) {
+        uint8_t* changed = (uint8_t*) heap_caps_realloc(
+            rawTileState.changed, tiles, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!changed) {
+            rawTileFailures++;
+            return false;
+        }
+        rawTileState.changed = changed;
+        rawTileFlagCount     = tiles;
+    }
+    return true;
+}
+
+// Send a prepared raw frame as changed tiles after reserveRawTiles(), sendPacket(data, len)
+// sends one datagram
+template <typename Send>
+void sendRawTiles(const camera_fb_t* fb, Send sendPacket) {
+    TileFormat format = fb->format == PIXFORMAT_GRAYSCALE ? TILE_GRAYSCALE
+                        : fb->format == PIXFORMAT_YUV422  ? TILE_YUV422
+                                                          : TILE_RGB565;
+
+    uint32_t       start = micros();
+    TileDeltaStats stats = tileDeltaEncode(rawTileState,
+                                           rawTileConfig,
+                                           format,
+                                           fb->buf,
+                                           fb->width,
+                                           fb->height,
+                                           rawTilePacket,
+                                           [&](const uint8_t* data, size_t len) {
+                                               PROFILE_HOT_PATH(udpPacketPath);
+                                               PROFILE_BYTES(len);
+                                               sendPacket(data, len);
+                                           });
+    uint32_t       us    = micros() - start;
+
+    rawTileFrames++;
+    rawTileRefreshes += stats.full;
+    rawTileTiles += stats.tiles;
+    rawTileChanged += stats.changed;
+    rawTileBytes += stats.bytes;
+    rawTileUs += us;
+    if (us > rawTileMaxUs) {
+        rawTileMaxUs = us;
+    }
+}
+
+// Tile totals for /metrics, send_us covers change detection and sending the datagrams
+void addRawTileMetrics(JsonDocument& doc) {
+    JsonObject tiles     = doc.createNestedObject("raw_tiles");
+    tiles["tile_size"]   = RAW_TILE_SIZE;
+    tiles["threshold"]   = RAW_TILE_THRESHOLD;
+    tiles["refresh"]     = RAW_TILE_REFRESH;
+    tiles["frames"]      = rawTileFrames;
+    tiles["refreshes"]   = rawTileRefreshes;
+    tiles["failures"]    = rawTileFailures;
+    tiles["tiles"]       = rawTileTiles;
+    tiles["changed"]     = rawTileChanged;
+    tiles["bytes"]       = rawTileBytes;
+    tiles["send_us"]     = rawTileUs;
+    tiles["max_send_us"] = rawTileMaxUs;
+}
+#endif
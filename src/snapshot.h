@@ -0,0 +1,215 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <freertos/semphr.h>
+
+#include "config.h"
+#include "frame_pool.h"
+
+extern AsyncWebServer server;
+
+// GET /capture returns the newest frame of the frame pool, it never triggers a capture of its
+// own. The ETag is the frame number: a poller that sends If-None-Match with the number it
+// already has gets 304 Not Modified. With ?wait=ms the request is held until a newer frame
+// exists (long poll) and answered 304 if none arrives in time.
+//
+// Held requests are registered and re-checked by the video task as soon as it publishes a
+// frame. Beyond SNAPSHOT_MAX_HELD of them, and for the timeout, the check runs when AsyncTCP
+// polls the connection (every ~500 ms).
+#ifndef SNAPSHOT_MAX_HELD
+#define SNAPSHOT_MAX_HELD 8
+#endif
+
+#ifndef SNAPSHOT_MAX_WAIT_MS
+#define SNAPSHOT_MAX_WAIT_MS 10000
+#endif
+
+// An older cached frame is served only if no fresh one arrives within this time
+#ifndef SNAPSHOT_MAX_AGE_MS
+#define SNAPSHOT_MAX_AGE_MS 1000
+#endif
+
+static uint32_t snapshotsServed      = 0;
+static uint32_t snapshotsNotModified = 0;
+
+class SnapshotResponse;
+
+// Held responses, the lock is taken by async_tcp (respond, poll, disconnect) and by the video
+// task when it publishes a frame
+static SnapshotResponse* heldSnapshots[SNAPSHOT_MAX_HELD];
+static SemaphoreHandle_t snapshotLock = nullptr;
+
+// Response that decides between 200, 304 and 503 once a frame is available or the wait is
+// over. Until then it stays in RESPONSE_SETUP and sends nothing.
+class SnapshotResponse : public AsyncAbstractResponse {
+   public:
+    SnapshotResponse(uint32_t knownFrame, uint32_t waitMs)
+        : knownFrame_(knownFrame), startMs_(millis()), waitMs_(waitMs) {}
+
+    ~SnapshotResponse() {
+        xSemaphoreTake(snapshotLock, portMAX_DELAY);
+        setHeld(false);
+        xSemaphoreGive(snapshotLock);
+        if (frame_) {
+            releaseFrame(frame_);
+        }
+    }
+
+    bool _sourceValid() const override {
+        return true;
+    }
+
+    void _respond(AsyncWebServerRequest* request) override {
+        // The request is deleted after the disconnect, the video task must not start it then
+        request->onDisconnect([this]() {
+            xSemaphoreTake(snapshotLock, portMAX_DELAY);
+            setHeld(false);
+            request_ = nullptr;
+            xSemaphoreGive(snapshotLock);
+        });
+        xSemaphoreTake(snapshotLock, portMAX_DELAY);
+        request_ = request;
+        tryStart();
+        setHeld(!started_);
+        xSemaphoreGive(snapshotLock);
+    }
+
+    // Locked even once started, the video task may still be inside tryStart()
+    size_t _ack(AsyncWebServerRequest* request, size_t len, uint32_t time) override {
+        xSemaphoreTake(snapshotLock, portMAX_DELAY);
+        size_t sent = 0;
+        if (!started_) {
+            tryStart();
+        } else {
+            sent = AsyncAbstractResponse::_ack(request, len, time);
+        }
+        xSemaphoreGive(snapshotLock);
+        return sent;
+    }
+
+    size_t _fillBuffer(uint8_t* buf, size_t maxLen) override {
+        size_t remain = frame_->len - offset_;
+        size_t toSend = (remain < maxLen) ? remain : maxLen;
+        memcpy(buf, frame_->buf + offset_, toSend);
+        offset_ += toSend;
+        return toSend;
+    }
+
+    // Check a held response, called with snapshotLock taken
+    void tryStart() {
+        if (started_ || !request_) {
+            return;
+        }
+        uint32_t     now   = millis();
+        PooledFrame* frame = acquireLatestFrame();
+        bool         fresh = frame && now - frame->capturedMs <= SNAPSHOT_MAX_AGE_MS;
+        bool         newer = frame && frame->number != knownFrame_;
+
+        // Wait for a frame newer than the client's, a stale cache waits for a fresh frame
+        uint32_t wait = waitMs_;
+        if (!fresh && wait < SNAPSHOT_MAX_AGE_MS) {
+            wait = SNAPSHOT_MAX_AGE_MS;
+        }
+        if (!(fresh && newer) && now - startMs_ < wait) {
+            if (frame) {
+                releaseFrame(frame);
+            }
+            return;
+        }
+
+        started_ = true;
+        setHeld(false);
+        if (!frame) {
+            setCode(503);
+        } else if (!newer) {
+            releaseFrame(frame);
+            setCode(304);
+            snapshotsNotModified++;
+        } else {
+            frame_ = frame;
+            setCode(200);
+            setContentType(RAW_MODE ? "application/octet-stream" : "image/jpeg");
+            setContentLength(frame->len);
+            snapshotsServed++;
+        }
+
+        if (frame) {
+            char etag[16];
+            snprintf(etag, sizeof(etag), "\"%u\"", frame->number);
+            addHeader("ETag", etag);
+#if MOTION_ADAPTIVE
+            addHeader("X-Motion", String(frame->motion));
+#endif
+        }
+        addHeader("Cache-Control", "no-cache");
+        addHeader("Access-Control-Allow-Origin", "*");
+        addHeader("Access-Control-Expose-Headers", MOTION_ADAPTIVE ? "ETag, X-Motion" : "ETag");
+        AsyncAbstractResponse::_respond(request_);
+    }
+
+   private:
+    void setHeld(bool held) {
+        for (SnapshotResponse*& slot : heldSnapshots) {
+            if (held ? !slot : slot == this) {
+                slot = held ? this : nullptr;
+                return;
+            }
+        }
+    }
+
+    AsyncWebServerRequest* request_ = nullptr;
+    PooledFrame*           frame_   = nullptr;
+    size_t                 offset_  = 0;
+    uint32_t               knownFrame_;
+    uint32_t               startMs_;
+    uint32_t               waitMs_;
+    bool                   started_ = false;
+};
+
+// Frame number from an If-None-Match value ("12", W/"12" or 12), 0 if there is none
+uint32_t parseFrameETag(const char* value) {
+    while (*value && (*value < '0' || *value > '9')) {
+        value++;
+    }
+    return strtoul(value, nullptr, 10);
+}
+
+// New frame in the pool: answer the held requests it satisfies
+void wakeSnapshots() {
+    xSemaphoreTake(snapshotLock, portMAX_DELAY);
+    for (SnapshotResponse* response : heldSnapshots) {
+        if (response) {
+            response->tryStart();
+        }
+    }
+    xSemaphoreGive(snapshotLock);
+}
+
+void initSnapshot() {
+    snapshotLock = xSemaphoreCreateMutex();
+    addFrameListener(wakeSnapshots);
+
+    server.on("/capture", HTTP_GET, [](AsyncWebServerRequest* request) {
+        snapshotRequestMs = millis() | 1;  // never 0, which means "not requested"
+
+        uint32_t knownFrame = 0;
+        if (request->hasHeader("If-None-Match")) {
+            knownFrame = parseFrameETag(request->getHeader("If-None-Match")->value().c_str());
+        }
+        uint32_t waitMs = 0;
+        if (request->hasParam("wait")) {
+            long value = request->getParam("wait")->value().toInt();
+            waitMs     = value > 0 ? (uint32_t) value : 0;
+            waitMs     = waitMs < SNAPSHOT_MAX_WAIT_MS ? waitMs : SNAPSHOT_MAX_WAIT_MS;
+        }
+
+        request->send(new SnapshotResponse(knownFrame, waitMs));
+    });
+}
+
+void addSnapshotMetrics(JsonDocument& doc) {
+    JsonObject snapshots      = doc.createNestedObject("snapshots");
+    snapshots["served"]       = snapshotsServed;
+    snapshots["not_modified"] = snapshotsNotModified;
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "config.h"
+#include "esp_camera.h"
+#include "esp_heap_caps.h"
+
+// SOFT_JPEG=1 lets the sensor deliver RGB565 and encodes JPEG in software, so raw pixels can
+// be processed on the device before compression. An encoder task pinned to SOFT_JPEG_CORE
+// takes raw frames from the driver and encodes them into one of SOFT_JPEG_BUFFERS output
+// buffers while the video service sends the previous frame from another one. Encoded frames
+// go to the video service through one queue and come back through a second one.
+//
+// fmt2jpg_cb() converts the source in strips of one MCU row (8 or 16 lines) and streams the
+// output through a callback straight into the output buffer, so the encoder needs no copy of
+// the frame besides the output buffers. The camera buffer is returned as soon as the frame is
+// encoded.
+#ifndef SOFT_JPEG
+#define SOFT_JPEG 0
+#endif
+
+#if SOFT_JPEG && RAW_MODE
+#error "SOFT_JPEG sends JPEG frames, it cannot be combined with RAW_MODE"
+#endif
+
+#if SOFT_JPEG
+#include "img_converters.h"
+#include "queue.h"
+
+// Core of the encoder task, the Arduino loop and the default video service run on core 1
+#ifndef SOFT_JPEG_CORE
+#define SOFT_JPEG_CORE 0
+#endif
+
+// Quality of the software encoder, 1-100 with higher being better. The sensor scale of
+// JPEG_QUALITY (0-63, lower is better) is mapped linearly, the benchmark compares the actual
+// quality of both encoders from their quantization tables.
+#ifndef SOFT_JPEG_QUALITY
+#define SOFT_JPEG_QUALITY (100 - JPEG_QUALITY * 100 / 64)
+#endif
+
+// Output buffers in flight, a power of two. Two let encoding of a frame overlap sending of
+// the previous one.
+#ifndef SOFT_JPEG_BUFFERS
+#define SOFT_JPEG_BUFFERS 2
+#endif
+
+// How long the video service waits for an encoded frame before it reports a failed capture
+#ifndef SOFT_JPEG_WAIT_MS
+#define SOFT_JPEG_WAIT_MS 1000
+#endif
+
+// The encoder object of fmt2jpg_cb() lives on the stack
+#define SOFT_JPEG_STACK    16384
+#define SOFT_JPEG_PRIORITY 2
+
+struct SoftJpegFrame {
+    camera_fb_t fb;  // first member, frames handed out as camera_fb_t* are cast back
+    size_t      capacity;
+};
+
+static SoftJpegFrame softJpegFrames[SOFT_JPEG_BUFFERS];
+
+static SpscQueue<SoftJpegFrame*, SOFT_JPEG_BUFFERS> softJpegReady;  // encoder -> video service
+static SpscQueue<SoftJpegFrame*, SOFT_JPEG_BUFFERS> softJpegFree;   // video service -> encoder
+
+static TaskHandle_t          softJpegTaskHandle = nullptr;
+static volatile TaskHandle_t softJpegConsumer   = nullptr;  // task waiting for a frame
+static volatile bool         softJpegStop       = false;
+static volatile bool         softJpegRunning    = false;
+
+static volatile uint32_t softJpegEncoded  = 0;
+static volatile uint32_t softJpegFailures = 0;
+static volatile uint32_t softJpegMaxUs    = 0;
+static volatile uint64_t softJpegUs       = 0;
+static volatile uint64_t softJpegBytes    = 0;
+static volatile uint32_t softJpegStarved  = 0;  // the video service had to wait for a frame
+static volatile uint32_t softJpegBackedUp = 0;  // the encoder had to wait for a free buffer
+
+// Output callback of fmt2jpg_cb(), buffers grow to the largest frame seen plus headroom
+size_t softJpegWrite(void* arg, size_t index, const void* data, size_t len) {
+    SoftJpegFrame* frame = (SoftJpegFrame*) arg;
+    if (index + len > frame->capacity) {
+        size_t   capacity = (index + len) + (index + len) / 4;
+        uint8_t* buf      = (uint8_t*) heap_caps_realloc(
+            frame->fb.buf, capacity, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!buf) {
+            return 0;  // ends the encoding
+        }
+        frame->fb.buf   = buf;
+        frame->capacity = capacity;
+    }
+    memcpy(frame->fb.buf + index, data, len);
+    frame->fb.len = index + len;
+    return len;
+}
+
+void softJpegTask(void* parameter) {
+    SoftJpegFrame* frame = nullptr;
+    while (!softJpegStop) {
+        if (!frame && !softJpegFree.tryPop(&frame)) {
+            // Every buffer is queued or being sent, woken by softJpegReturn()
+            softJpegBackedUp++;
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FRAME_INTERVAL_MS));
+            continue;
+        }
+        camera_fb_t* raw = esp_camera_fb_get();
+        if (!raw) {
+            softJpegFailures++;
+            continue;
+        }
+
+        frame->fb.len  = 0;
+        uint32_t start = micros();
+        bool encoded = fmt2jpg_cb(raw->buf,
+                                  raw->len,
+                                  raw->width,
+                                  raw->height,
+                                  raw->format,
+                                  SOFT_JPEG_QUALITY,
+                                  softJpegWrite,
+                                  frame);
+        frame->fb.width     = raw->width;
+        frame->fb.height    = raw->height;
+        frame->fb.format    = PIXFORMAT_JPEG;
+        frame->fb.timestamp = raw->timestamp;
+        esp_camera_fb_return(raw);
+        uint32_t us = micros() - start;
+        if (!encoded || frame->fb.len == 0) {
+            softJpegFailures++;
+            continue;
+        }
+
+        softJpegEncoded++;
+        softJpegUs += us;
+        if (us > softJpegMaxUs) {
+            softJpegMaxUs = us;
+        }
+        softJpegBytes += frame->fb.len;
+        softJpegReady.tryPush(frame);  // cannot fail, the queue holds every buffer
+        frame = nullptr;
+        TaskHandle_t consumer = softJpegConsumer;
+        if (consumer) {
+            xTaskNotifyGive(consumer);
+        }
+    }
+    softJpegRunning = false;
+    vTaskDelete(nullptr);
+}
+
+// Next encoded frame for the video service, nullptr if the encoder delivered none in time
+camera_fb_t* softJpegGrab() {
+    softJpegConsumer     = xTaskGetCurrentTaskHandle();
+    SoftJpegFrame* frame = nullptr;
+    if (!softJpegReady.tryPop(&frame)) {
+        softJpegStarved++;
+        uint32_t start = millis();
+        while (!softJpegReady.tryPop(&frame)) {
+            uint32_t waited = millis() - start;
+            if (waited >= SOFT_JPEG_WAIT_MS ||
+                !ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SOFT_JPEG_WAIT_MS - waited))) {
+                return nullptr;
+            }
+        }
+    }
+    return &frame->fb;
+}
+
+// Give a frame from softJpegGrab() back to the encoder
+void softJpegReturn(camera_fb_t* fb) {
+    if (!softJpegFree.tryPush(reinterpret_cast<SoftJpegFrame*>(fb))) {
+        softJpegFailures++;  // returned twice, the queue already holds every buffer
+    }
+    if (softJpegTaskHandle) {
+        xTaskNotifyGive(softJpegTaskHandle);
+    }
+}
+
+// Start the encoder after the camera was initialized. The video service must not hold a frame.
+void startSoftJpeg() {
+    // Every buffer goes back to the free queue, whatever was encoded before is dropped
+    SoftJpegFrame* frame;
+    while (softJpegReady.tryPop(&frame)) {
+    }
+    while (softJpegFree.tryPop(&frame)) {
+    }
+    for (uint8_t i = 0; i < SOFT_JPEG_BUFFERS; i++) {
+        softJpegFree.tryPush(&softJpegFrames[i]);
+    }
+    softJpegStop    = false;
+    softJpegRunning = true;
+    xTaskCreatePinnedToCore(softJpegTask,
+                            "soft_jpeg",
+                            SOFT_JPEG_STACK,
+                            nullptr,
+                            SOFT_JPEG_PRIORITY,
+                            &softJpegTaskHandle,
+                            SOFT_JPEG_CORE);
+}
+
+// Stop the encoder before the camera is deinitialized, waits until it returned its raw frame
+void stopSoftJpeg() {
+    if (!softJpegTaskHandle) {
+        return;
+    }
+    softJpegStop = true;
+    xTaskNotifyGive(softJpegTaskHandle);
+    while (softJpegRunning) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    softJpegTaskHandle = nullptr;
+    softJpegConsumer   = nullptr;  // the video service task is stopped or restarted as well
+}
+
+// Encoder totals for /metrics
+void addSoftJpegMetrics(JsonDocument& doc) {
+    JsonObject jpeg       = doc.createNestedObject("soft_jpeg");
+    jpeg["core"]          = SOFT_JPEG_CORE;
+    jpeg["quality"]       = SOFT_JPEG_QUALITY;
+    jpeg["buffers"]       = SOFT_JPEG_BUFFERS;
+    jpeg["frames"]        = softJpegEncoded;
+    jpeg["failures"]      = softJpegFailures;
+    jpeg["encode_us"]     = softJpegUs;
+    jpeg["max_encode_us"] = softJpegMaxUs;
+    jpeg["bytes"]         = softJpegBytes;
+    jpeg["starved"]       = softJpegStarved;
+    jpeg["backed_up"]     = softJpegBackedUp;
+}
+#else
+inline void startSoftJpeg() {}
+inline void stopSoftJpeg() {}
+#endif
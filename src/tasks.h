@@ -0,0 +1,268 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <AsyncTCP.h>
+#include <ESPAsyncWebServer.h>
+#include <Preferences.h>
+
+#include "camera_buffers.h"
+#include "config.h"
+#include "json_config.h"
+#include "transport.h"
+
+extern AsyncWebServer server;
+
+// Placement of the video (capture + packetize) and control services. The "loop" profile
+// keeps the original layout, both serviced one after the other from loop() (core 1,
+// priority 1). Other profiles run each service in its own pinned task. Core 0 is shared
+// with the WiFi driver and lwIP; the AsyncTCP task core is a build option
+// (CONFIG_ASYNC_TCP_RUNNING_CORE), so it is reported but not switched at runtime.
+struct TaskProfile {
+    const char* name;
+    bool        dedicated;
+    int8_t      videoCore;
+    uint8_t     videoPriority;
+    int8_t      controlCore;
+    uint8_t     controlPriority;
+};
+
+static const TaskProfile taskProfiles[] = {
+    {"loop", false, 1, 1, 1, 1},
+    {"split", true, 1, 2, 0, 5},             // control next to the network stack
+    {"control_priority", true, 1, 2, 1, 5},  // both away from WiFi, control preempts video
+    {"video_core0", true, 0, 2, 1, 5},       // capture next to the network stack
+};
+static const uint8_t taskProfileCount = sizeof(taskProfiles) / sizeof(TaskProfile);
+
+#define SERVICE_TASK_STACK 8192
+
+struct ServiceStats {
+    const char*       name;
+    TaskHandle_t      handle;
+    volatile bool     running;
+    volatile uint32_t iterations;
+    volatile uint32_t totalUs;
+    volatile uint32_t maxUs;
+};
+
+static ServiceStats videoService   = {"video", nullptr, false, 0, 0, 0};
+static ServiceStats controlService = {"control", nullptr, false, 0, 0, 0};
+
+static uint8_t       activeTaskProfile  = 0;
+static volatile bool taskProfilePending = false;
+static uint8_t       pendingTaskProfile = 0;
+static volatile bool serviceTasksStop   = false;
+
+void recordIteration(ServiceStats* stats, uint32_t start) {
+    uint32_t elapsed = micros() - start;
+    stats->iterations++;
+    stats->totalUs += elapsed;
+    if (elapsed > stats->maxUs) {
+        stats->maxUs = elapsed;
+    }
+}
+
+void videoServiceTask(void* parameter) {
+    while (!serviceTasksStop) {
+        uint32_t start = micros();
+        handleVideoTransport();
+        recordIteration(&videoService, start);
+    }
+    videoService.running = false;
+    vTaskDelete(nullptr);
+}
+
+void controlServiceTask(void* parameter) {
+    setControlTask(xTaskGetCurrentTaskHandle());
+    while (!serviceTasksStop) {
+        uint32_t start = micros();
+        if (!handleControlTransport()) {
+            // HTTP control is served by AsyncTCP, wait for the commands it queues
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONTROL_INTERVAL_MS));
+        }
+        drainControlQueue();
+        recordIteration(&controlService, start);
+    }
+    setControlTask(nullptr);
+    controlService.running = false;
+    vTaskDelete(nullptr);
+}
+
+void startService(ServiceStats* stats, TaskFunction_t function, int8_t core, uint8_t priority) {
+    stats->iterations = 0;
+    stats->totalUs    = 0;
+    stats->maxUs      = 0;
+    stats->running    = true;
+    if (xTaskCreatePinnedToCore(function,
+                                stats->name,
+                                SERVICE_TASK_STACK,
+                                nullptr,
+                                priority,
+                                &stats->handle,
+                                core) != pdPASS) {
+        stats->running = false;
+        stats->handle  = nullptr;
+        Serial.printf("Failed to start %s task\n", stats->name);
+    }
+}
+
+void startServiceTasks() {
+    const TaskProfile& profile = taskProfiles[activeTaskProfile];
+    serviceTasksStop           = false;
+    if (!profile.dedicated) {
+        videoService.iterations   = 0;
+        videoService.totalUs      = 0;
+        videoService.maxUs        = 0;
+        controlService.iterations = 0;
+        controlService.totalUs    = 0;
+        controlService.maxUs      = 0;
+        return;
+    }
+    startService(&videoService, videoServiceTask, profile.videoCore, profile.videoPriority);
+    startService(&controlService, controlServiceTask, profile.controlCore, profile.controlPriority);
+}
+
+// Stop dedicated tasks after their current iteration, so transports can be switched safely
+void stopServiceTasks() {
+    serviceTasksStop = true;
+    while (videoService.running || controlService.running) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    videoService.handle   = nullptr;
+    controlService.handle = nullptr;
+    // Commands queued after the control task's last iteration
+    drainControlQueue();
+}
+
+void saveTaskProfile(uint8_t index) {
+    Preferences prefs;
+    prefs.begin("tasks", false);
+    prefs.putUChar("profile", index);
+    prefs.end();
+}
+
+uint8_t loadTaskProfile() {
+    Preferences prefs;
+    prefs.begin("tasks", true);
+    uint8_t index = prefs.getUChar("profile", 0);
+    prefs.end();
+    return index < taskProfileCount ? index : 0;
+}
+
+void addTaskStats(JsonArray           tasks,
+                  const char*         name,
+                  TaskHandle_t        handle,
+                  const ServiceStats* stats) {
+    JsonObject task = tasks.createNestedObject();
+    task["name"]    = name;
+    if (handle) {
+        BaseType_t core    = xTaskGetAffinity(handle);
+        task["core"]       = core == tskNO_AFFINITY ? -1 : core;
+        task["priority"]   = uxTaskPriorityGet(handle);
+        task["stack_free"] = uxTaskGetStackHighWaterMark(handle);
+    }
+    if (stats) {
+        uint32_t iterations = stats->iterations;
+        task["iterations"]  = iterations;
+        task["avg_us"]      = iterations ? stats->totalUs / iterations : 0;
+        task["max_us"]      = stats->maxUs;
+    }
+}
+
+void initTasks() {
+    server.on("/tasks", HTTP_GET, [](AsyncWebServerRequest* request) {
+        StaticJsonDocument<1536> doc;
+        doc["profile"]        = taskProfiles[activeTaskProfile].name;
+        doc["pending"]        = taskProfilePending;
+        doc["async_tcp_core"] = CONFIG_ASYNC_TCP_RUNNING_CORE;
+        JsonArray profiles    = doc.createNestedArray("profiles");
+        for (uint8_t i = 0; i < taskProfileCount; i++) {
+            profiles.add(taskProfiles[i].name);
+        }
+
+        bool      dedicated = taskProfiles[activeTaskProfile].dedicated;
+        JsonArray tasks     = doc.createNestedArray("tasks");
+        if (dedicated) {
+            addTaskStats(tasks, "video", videoService.handle, &videoService);
+            addTaskStats(tasks, "control", controlService.handle, &controlService);
+        } else {
+            // Both services run in loopTask, iteration stats are those of the whole loop
+            addTaskStats(tasks, "loopTask", xTaskGetHandle("loopTask"), &videoService);
+        }
+        addTaskStats(tasks, "async_tcp", xTaskGetHandle("async_tcp"), nullptr);
+        addTaskStats(tasks, "wifi", xTaskGetHandle("wifi"), nullptr);
+        addTaskStats(tasks, "tiT", xTaskGetHandle("tiT"), nullptr);
+
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+
+    onJsonConfigPost("/tasks", [](JsonDocument& doc) -> const char* {
+        uint8_t profile;
+        if (!parseName(doc["profile"], taskProfiles, &profile)) {
+            return "Unknown task profile";
+        }
+        if (doc["persist"] | true) {
+            saveTaskProfile(profile);
+        }
+        pendingTaskProfile = profile;
+        taskProfilePending = true;
+        return nullptr;
+    });
+
+    activeTaskProfile = loadTaskProfile();
+    startServiceTasks();
+    Serial.printf("Task profile: %s\n", taskProfiles[activeTaskProfile].name);
+}
+
+// Apply camera buffer, transport and task profile changes, called from loop()
+void applyPendingChanges() {
+    if (!transportPending && !taskProfilePending && !cameraBuffersPending) {
+        return;
+    }
+    stopServiceTasks();
+    applyPendingCameraBuffers();
+    applyPendingTransport();
+    if (taskProfilePending) {
+        taskProfilePending = false;
+        activeTaskProfile  = pendingTaskProfile;
+        Serial.printf("Task profile: %s\n", taskProfiles[activeTaskProfile].name);
+    }
+    startServiceTasks();
+}
+
+// Service transports from loop() unless dedicated tasks do it
+void handleServices() {
+    if (taskProfiles[activeTaskProfile].dedicated) {
+        vTaskDelay(pdMS_TO_TICKS(CONTROL_INTERVAL_MS));
+        return;
+    }
+    uint32_t start = micros();
+    handleTransport();
+    recordIteration(&videoService, start);
+}
+
+#if ENABLE_METRICS
+void printServiceStats() {
+    Serial.printf("Task profile: %s (loop on core %d)\n",
+                  taskProfiles[activeTaskProfile].name,
+                  xPortGetCoreID());
+    const ServiceStats* services[] = {&videoService, &controlService};
+    for (const ServiceStats* stats : services) {
+        if (!stats->handle) {
+            continue;
+        }
+        uint32_t iterations = stats->iterations;
+        Serial.printf("Task %s: core %d, priority %u, stack free %u, %u iterations, "
+                      "avg %u us, max %u us\n",
+                      stats->name,
+                      (int) xTaskGetAffinity(stats->handle),
+                      (unsigned) uxTaskPriorityGet(stats->handle),
+                      (unsigned) uxTaskGetStackHighWaterMark(stats->handle),
+                      iterations,
+                      iterations ? stats->totalUs / iterations : 0,
+                      stats->maxUs);
+    }
+}
+#endif
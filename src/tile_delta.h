@@ -0,0 +1,231 @@
+#pragma once
+
+// Changed-tile coding of raw frames. A frame is split into fixed tiles of tileSize x tileSize
+// pixels (the last column and row may be smaller) and only the tiles whose content moved away
+// from what the receiver holds are sent. The encoder keeps a reference copy of every tile as
+// last sent, so slow drift adds up until it crosses the threshold and the receiver never
+// drifts further than the threshold from the camera. Every refreshFrames frames, on the first
+// frame and when the frame size changes, all tiles are sent (full refresh), which also
+// repairs tiles lost with a datagram.
+//
+// A tile changed when the mean absolute difference of its samples to the reference exceeds
+// the threshold, in 8-bit levels: bytes of GRAYSCALE and YUV422 frames, the red, green and
+// blue channels of RGB565 pixels scaled to 8 bits.
+//
+// Changed tiles are packed into datagrams of at most packetSize bytes, every datagram can be
+// applied on its own:
+//
+//   header   "RT", version, flags, frame number (u32), width, height (u16), format, tile size,
+//            packet index, packet count, tiles in the packet (u16), all little-endian
+//   tiles    tile index (u16) followed by the rows of the tile, tile width x bytes per pixel
+//            each, in the layout of the frame
+//
+// flags bit 0 marks a full refresh. A frame without changes is one datagram without tiles.
+// raw_tiles.h sends the datagrams, benchmark/utils/raw_tiles.py composes the frames again.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef TILE_DELTA_ATTR
+#define TILE_DELTA_ATTR
+#endif
+
+#define TILE_DELTA_HEADER  20
+#define TILE_DELTA_VERSION 1
+#define TILE_DELTA_FULL    0x01
+
+// Same numbering as DownscaleFormat, sent in the header
+enum TileFormat : uint8_t { TILE_RGB565, TILE_YUV422, TILE_GRAYSCALE };
+
+struct TileDeltaConfig {
+    uint8_t  tileSize;       // multiple of 2, a tile must fit a datagram
+    uint8_t  threshold;      // mean absolute sample difference of a changed tile
+    uint16_t refreshFrames;  // frames between full refreshes
+    uint16_t packetSize;     // largest datagram
+};
+
+// The caller provides the reference, a copy of the frame as the receiver holds it, and one
+// flag per tile. Zero-initialized before the first frame.
+struct TileDeltaState {
+    uint8_t*   reference;
+    uint8_t*   changed;
+    uint16_t   width;
+    uint16_t   height;
+    TileFormat format;
+    bool       hasReference;
+    uint32_t   frameNumber;
+    uint32_t   sinceRefresh;  // frames since the last full refresh
+};
+
+// Work of one frame
+struct TileDeltaStats {
+    uint32_t tiles;
+    uint32_t changed;
+    uint32_t packets;
+    uint32_t bytes;  // datagram bytes including headers
+    bool     full;
+};
+
+inline size_t tileBytesPerPixel(TileFormat format) {
+    return format == TILE_GRAYSCALE ? 1 : 2;
+}
+
+inline uint16_t tileColumns(uint16_t width, uint8_t tileSize) {
+    return (width + tileSize - 1) / tileSize;
+}
+
+inline uint32_t tileCount(uint16_t width, uint16_t height, uint8_t tileSize) {
+    return (uint32_t) tileColumns(width, tileSize) * ((height + tileSize - 1) / tileSize);
+}
+
+// Largest tile with its index, in bytes
+inline size_t tileRecordBytes(TileFormat format, uint8_t tileSize) {
+    return 2 + (size_t) tileSize * tileSize * tileBytesPerPixel(format);
+}
+
+inline size_t tilesPerPacket(TileFormat format, uint8_t tileSize, uint16_t packetSize) {
+    return (packetSize - TILE_DELTA_HEADER) / tileRecordBytes(format, tileSize);
+}
+
+inline void tileDeltaPut16(uint8_t* out, uint16_t value) {
+    out[0] = value;
+    out[1] = value >> 8;
+}
+
+inline void tileDeltaPut32(uint8_t* out, uint32_t value) {
+    tileDeltaPut16(out, value);
+    tileDeltaPut16(out + 2, value >> 16);
+}
+
+// Whether the samples of a tile moved more than limit in sum away from the reference. Stops
+// at the first row past the limit, unchanged tiles are read completely.
+inline bool tileExceeds(TileFormat     format,
+                        const uint8_t* frame,
+                        const uint8_t* reference,
+                        size_t         stride,
+                        size_t         rowBytes,
+                        uint16_t       rows,
+                        uint32_t       limit) {
+    uint32_t sum = 0;
+    for (uint16_t y = 0; y < rows; y++) {
+        const uint8_t* a = frame + y * stride;
+        const uint8_t* b = reference + y * stride;
+        if (format == TILE_RGB565) {
+            for (size_t i = 0; i < rowBytes; i += 2) {
+                uint32_t pa = a[i] << 8 | a[i + 1];
+                uint32_t pb = b[i] << 8 | b[i + 1];
+                int32_t  dr = (int32_t) (pa >> 11) - (int32_t) (pb >> 11);
+                int32_t  dg = (int32_t) ((pa >> 5) & 0x3F) - (int32_t) ((pb >> 5) & 0x3F);
+                int32_t  db = (int32_t) (pa & 0x1F) - (int32_t) (pb & 0x1F);
+                sum += abs(dr) * 8 + abs(dg) * 4 + abs(db) * 8;
+            }
+        } else {
+            for (size_t i = 0; i < rowBytes; i++) {
+                sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+            }
+        }
+        if (sum > limit) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Encode a frame into datagrams. packet is scratch of config.packetSize bytes, sink(data, len)
+// sends one datagram. The reference and the tile flags of state must hold width x height
+// pixels and tileCount() flags.
+template <typename Sink>
+TILE_DELTA_ATTR TileDeltaStats tileDeltaEncode(TileDeltaState&        state,
+                                               const TileDeltaConfig& config,
+                                               TileFormat             format,
+                                               const uint8_t*         frame,
+                                               uint16_t               width,
+                                               uint16_t               height,
+                                               uint8_t*               packet,
+                                               Sink                   sink) {
+    uint8_t  size    = config.tileSize;
+    size_t   bpp     = tileBytesPerPixel(format);
+    size_t   stride  = (size_t) width * bpp;
+    uint16_t columns = tileColumns(width, size);
+
+    TileDeltaStats stats = {};
+    stats.tiles          = tileCount(width, height, size);
+    stats.full = !state.hasReference || state.width != width || state.height != height ||
+                 state.format != format || state.sinceRefresh + 1 >= config.refreshFrames;
+
+    // Mark the changed tiles first, the packet count goes into every header
+    for (uint32_t t = 0; t < stats.tiles; t++) {
+        uint16_t x0     = t % columns * size;
+        uint16_t y0     = t / columns * size;
+        uint16_t w      = width - x0 < size ? width - x0 : size;
+        uint16_t h      = height - y0 < size ? height - y0 : size;
+        size_t   offset = y0 * stride + x0 * bpp;
+
+        // RGB565 pixels count three samples
+        uint32_t samples = (uint32_t) w * h * (format == TILE_RGB565 ? 3 : bpp);
+        state.changed[t] = stats.full || tileExceeds(format,
+                                                     frame + offset,
+                                                     state.reference + offset,
+                                                     stride,
+                                                     w * bpp,
+                                                     h,
+                                                     config.threshold * samples);
+        stats.changed += state.changed[t];
+    }
+
+    size_t   perPacket = tilesPerPacket(format, size, config.packetSize);
+    uint16_t packets   = stats.changed ? (stats.changed + perPacket - 1) / perPacket : 1;
+    state.frameNumber++;
+
+    uint32_t t = 0;
+    for (uint16_t p = 0; p < packets; p++) {
+        uint8_t* out   = packet + TILE_DELTA_HEADER;
+        uint16_t tiles = 0;
+        for (; t < stats.tiles && tiles < perPacket; t++) {
+            if (!state.changed[t]) {
+                continue;
+            }
+            uint16_t x0     = t % columns * size;
+            uint16_t y0     = t / columns * size;
+            uint16_t w      = width - x0 < size ? width - x0 : size;
+            uint16_t h      = height - y0 < size ? height - y0 : size;
+            size_t   offset = y0 * stride + x0 * bpp;
+            tileDeltaPut16(out, t);
+            out += 2;
+            for (uint16_t y = 0; y < h; y++) {
+                const uint8_t* row = frame + offset + y * stride;
+                memcpy(out, row, w * bpp);
+                memcpy(state.reference + offset + y * stride, row, w * bpp);
+                out += w * bpp;
+            }
+            tiles++;
+        }
+
+        packet[0] = 'R';
+        packet[1] = 'T';
+        packet[2] = TILE_DELTA_VERSION;
+        packet[3] = stats.full ? TILE_DELTA_FULL : 0;
+        tileDeltaPut32(packet + 4, state.frameNumber);
+        tileDeltaPut16(packet + 8, width);
+        tileDeltaPut16(packet + 10, height);
+        packet[12] = format;
+        packet[13] = size;
+        tileDeltaPut16(packet + 14, p);
+        tileDeltaPut16(packet + 16, packets);
+        tileDeltaPut16(packet + 18, tiles);
+
+        size_t len = out - packet;
+        sink(packet, len);
+        stats.packets++;
+        stats.bytes += len;
+    }
+
+    state.width        = width;
+    state.height       = height;
+    state.format       = format;
+    state.hasReference = true;
+    state.sinceRefresh = stats.full ? 0 : state.sinceRefresh + 1;
+    return stats;
+}
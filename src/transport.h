@@ -0,0 +1,275 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <Preferences.h>
+
+#include "alloc_counter.h"
+#include "config.h"
+#include "ctrl_http.h"
+#include "ctrl_udp.h"
+#include "ctrl_websocket.h"
+#include "json_config.h"
+#include "video_http.h"
+#include "video_rtsp.h"
+#include "video_udp.h"
+#include "video_webrtc.h"
+#include "wifi_link.h"
+
+extern AsyncWebServer server;
+
+// All transports are compiled in, one video and one control transport are active at a time.
+// The selection comes from NVS at boot (VIDEO_PROTOCOL/CONTROL_PROTOCOL build flags are only
+// defaults) and can be changed at runtime via POST /transport.
+enum class VideoProtocol : uint8_t { NONE, HTTP, RTSP, UDP, WEBRTC };
+enum class ControlProtocol : uint8_t { NONE, HTTP, UDP, WEBSOCKET };
+
+#define TRANSPORT_XSTR(x) TRANSPORT_STR(x)
+#define TRANSPORT_STR(x)  #x
+
+static const char* const videoProtocolNames[]   = {"none", "HTTP", "RTSP", "UDP", "WebRTC"};
+static const char* const controlProtocolNames[] = {"none", "HTTP", "UDP", "WebSocket"};
+static const uint8_t     videoProtocolCount     = sizeof(videoProtocolNames) / sizeof(char*);
+static const uint8_t     controlProtocolCount   = sizeof(controlProtocolNames) / sizeof(char*);
+
+static VideoProtocol   activeVideo   = VideoProtocol::NONE;
+static ControlProtocol activeControl = ControlProtocol::NONE;
+
+// Selection requested from the async_tcp task, applied from loop() so that transports
+// are never started or stopped while they are being serviced
+static volatile bool   transportPending = false;
+static VideoProtocol   pendingVideo     = VideoProtocol::NONE;
+static ControlProtocol pendingControl   = ControlProtocol::NONE;
+static bool            pendingPersist   = false;
+
+const char* videoProtocolName(VideoProtocol protocol) {
+    return videoProtocolNames[static_cast<uint8_t>(protocol)];
+}
+
+const char* controlProtocolName(ControlProtocol protocol) {
+    return controlProtocolNames[static_cast<uint8_t>(protocol)];
+}
+
+void startVideo(VideoProtocol protocol) {
+    switch (protocol) {
+        case VideoProtocol::HTTP:
+            startVideoHTTP();
+            break;
+        case VideoProtocol::RTSP:
+            initVideoRTSP();
+            break;
+        case VideoProtocol::UDP:
+            initVideoUDP();
+            break;
+        case VideoProtocol::WEBRTC:
+            initVideoWebRTC();
+            break;
+        case VideoProtocol::NONE:
+            break;
+    }
+    activeVideo = protocol;
+}
+
+void stopVideo() {
+    switch (activeVideo) {
+        case VideoProtocol::HTTP:
+            stopVideoHTTP();
+            break;
+        case VideoProtocol::RTSP:
+            stopVideoRTSP();
+            break;
+        case VideoProtocol::UDP:
+            stopVideoUDP();
+            break;
+        case VideoProtocol::WEBRTC:
+            stopVideoWebRTC();
+            break;
+        case VideoProtocol::NONE:
+            break;
+    }
+    activeVideo = VideoProtocol::NONE;
+}
+
+void startControl(ControlProtocol protocol) {
+    switch (protocol) {
+        case ControlProtocol::HTTP:
+            startControlHTTP();
+            break;
+        case ControlProtocol::UDP:
+            initControlUDP();
+            break;
+        case ControlProtocol::WEBSOCKET:
+            initControlWebSocket();
+            break;
+        case ControlProtocol::NONE:
+            break;
+    }
+    activeControl = protocol;
+}
+
+void stopControl() {
+    switch (activeControl) {
+        case ControlProtocol::HTTP:
+            stopControlHTTP();
+            break;
+        case ControlProtocol::UDP:
+            stopControlUDP();
+            break;
+        case ControlProtocol::WEBSOCKET:
+            stopControlWebSocket();
+            break;
+        case ControlProtocol::NONE:
+            break;
+    }
+    activeControl = ControlProtocol::NONE;
+}
+
+void selectTransport(VideoProtocol video, ControlProtocol control) {
+    if (video != activeVideo) {
+        stopVideo();
+        startVideo(video);
+    }
+    if (control != activeControl) {
+        stopControl();
+        startControl(control);
+    }
+    Serial.printf("Transport: video=%s, control=%s\n",
+                  videoProtocolName(activeVideo),
+                  controlProtocolName(activeControl));
+}
+
+void saveTransport(VideoProtocol video, ControlProtocol control) {
+    Preferences prefs;
+    prefs.begin("transport", false);
+    prefs.putUChar("video", static_cast<uint8_t>(video));
+    prefs.putUChar("control", static_cast<uint8_t>(control));
+    prefs.end();
+}
+
+// Load transport selection from NVS, falling back to the build flags
+void loadTransport(VideoProtocol* video, ControlProtocol* control) {
+    if (!parseName(TRANSPORT_XSTR(VIDEO_PROTOCOL), videoProtocolNames, video)) {
+        *video = VideoProtocol::HTTP;
+    }
+    if (!parseName(TRANSPORT_XSTR(CONTROL_PROTOCOL), controlProtocolNames, control)) {
+        *control = ControlProtocol::HTTP;
+    }
+
+    Preferences prefs;
+    prefs.begin("transport", true);
+    uint8_t storedVideo   = prefs.getUChar("video", static_cast<uint8_t>(*video));
+    uint8_t storedControl = prefs.getUChar("control", static_cast<uint8_t>(*control));
+    prefs.end();
+
+    if (storedVideo < videoProtocolCount) {
+        *video = static_cast<VideoProtocol>(storedVideo);
+    }
+    if (storedControl < controlProtocolCount) {
+        *control = static_cast<ControlProtocol>(storedControl);
+    }
+}
+
+// Apply a selection requested via /transport, called from loop()
+void applyPendingTransport() {
+    if (!transportPending) {
+        return;
+    }
+    transportPending = false;
+    selectTransport(pendingVideo, pendingControl);
+    if (pendingPersist) {
+        saveTransport(pendingVideo, pendingControl);
+    }
+}
+
+// Register routes of all transports and start the selected ones
+void initTransport() {
+    initVideoHTTP();
+    initControlHTTP();
+
+    server.on("/transport", HTTP_GET, [](AsyncWebServerRequest* request) {
+        StaticJsonDocument<128> doc;
+        doc["video"]   = videoProtocolName(activeVideo);
+        doc["control"] = controlProtocolName(activeControl);
+        doc["pending"] = transportPending;
+
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+
+    onJsonConfigPost("/transport", [](JsonDocument& doc) -> const char* {
+        VideoProtocol   video   = activeVideo;
+        ControlProtocol control = activeControl;
+        if (doc.containsKey("video") && !parseName(doc["video"], videoProtocolNames, &video)) {
+            return "Unknown video protocol";
+        }
+        if (doc.containsKey("control") &&
+            !parseName(doc["control"], controlProtocolNames, &control)) {
+            return "Unknown control protocol";
+        }
+        pendingVideo     = video;
+        pendingControl   = control;
+        pendingPersist   = doc["persist"] | true;
+        transportPending = true;
+        return nullptr;
+    });
+
+    VideoProtocol   video;
+    ControlProtocol control;
+    loadTransport(&video, &control);
+    selectTransport(video, control);
+}
+
+// Service the active control transport, returns false if it needs no polling
+bool handleControlTransport() {
+    switch (activeControl) {
+        case ControlProtocol::UDP:
+            handleControlUDP();
+            return true;
+        case ControlProtocol::WEBSOCKET:
+            handleControlWebSocket();
+            return true;
+        case ControlProtocol::HTTP:
+        case ControlProtocol::NONE:
+            break;
+    }
+    return false;
+}
+
+// Service the active video transport
+void handleVideoTransport() {
+    if (!wifiConnected()) {
+        // Keep the camera and the transports, streams resume when the link is back
+        vTaskDelay(pdMS_TO_TICKS(FRAME_INTERVAL_MS));
+        return;
+    }
+    COUNT_ALLOCS(frameAllocs);
+    switch (activeVideo) {
+        case VideoProtocol::HTTP:
+            handleVideoHTTP();
+            break;
+        case VideoProtocol::RTSP:
+            handleVideoRTSP();
+            break;
+        case VideoProtocol::UDP:
+            handleVideoUDP();
+            break;
+        case VideoProtocol::WEBRTC:
+            handleVideoWebRTC();
+            break;
+        case VideoProtocol::NONE:
+            vTaskDelay(pdMS_TO_TICKS(FRAME_INTERVAL_MS));
+            break;
+    }
+
+    // Capture for snapshot pollers when the active transport has no client to capture for
+    if (snapshotWanted() && latestFrameAgeMs() > 2 * FRAME_INTERVAL_MS) {
+        captureToPool();
+    }
+}
+
+// Service the active transports one after the other, called from loop()
+void handleTransport() {
+    handleControlTransport();
+    handleVideoTransport();
+}
@@ -2,23 +2,245 @@
 
 #include <ESPAsyncWebServer.h>
 #include <WiFi.h>
+#include <freertos/semphr.h>
 
 #include "config.h"
 #include "esp_camera.h"
+#include "frame_pool.h"
+#include "net_profile.h"
 
 #define BOUNDARY "123456789000000000000987654321"
 
 // Глобальный сервер (extern где-то в вашем main.cpp)
 extern AsyncWebServer server;
 
-/*
-  Ключевой момент: если заголовок (boundary+Content-Length) больше, чем maxLen,
-  мы отправляем его не за один вызов snprintf -> memcpy, а частями.
-*/
+// Маршруты регистрируются один раз, флаг показывает, выбран ли HTTP как видеотранспорт
+static bool videoHTTPActive = false;
+
+class MJPEGResponse;
+
+// Состояние отправки одного зрителя /video: кадр из пула, который сейчас передается, и его
+// заголовок multipart. Заголовок (boundary+Content-Length) может не поместиться в maxLen,
+// поэтому он отправляется частями. lock защищает ответ: его наполняет async_tcp (ACK, poll) и
+// задача видео, когда публикует кадр для ждущего зрителя. framePublished задача видео ставит при
+// каждой публикации, а тот, кто держит мьютекс, проверяет его, прежде чем сдаться.
+struct HTTPViewer {
+    StreamClient*          client;
+    PooledFrame*           frame;
+    size_t                 offset;  // сколько байт кадра уже отправили
+    char                   header[128];
+    size_t                 headerLen;
+    size_t                 headerSent;
+    SemaphoreHandle_t      lock;
+    AsyncWebServerRequest* request;         // nullptr после отключения
+    MJPEGResponse*         response;        // удаляется вместе с request
+    volatile bool          waiting;         // последний вызов вернул RESPONSE_TRY_AGAIN
+    volatile bool          framePublished;  // новый кадр после последней попытки его взять
+};
+
+static HTTPViewer httpViewers[STREAM_MAX_CLIENTS];
+
+void pumpViewer(HTTPViewer* viewer);
+
+void releaseViewerFrame(HTTPViewer* viewer) {
+    if (viewer->frame) {
+        releaseFrame(viewer->frame);
+        viewer->frame = nullptr;
+    }
+}
+
+// Самый новый кадр из пула, если он положен зрителю, иначе nullptr
+PooledFrame* acquireDueFrame(HTTPViewer* viewer) {
+    PooledFrame* frame = acquireLatestFrame();
+    uint32_t     now   = millis();
+    if (!frame) {
+        streamClientWaiting(viewer->client, now);
+        return nullptr;
+    }
+    if (!streamClientWants(viewer->client, frame->number, frame->len, frame->capturedMs, now)) {
+        releaseFrame(frame);
+        return nullptr;
+    }
+    return frame;
+}
+
+// Наполнение chunked-ответа одного зрителя. Кадры берутся из пула, захват идет в задаче видео,
+// поэтому async_tcp никогда не ждет камеру: если нового кадра нет или зрителю еще рано,
+// возвращаем RESPONSE_TRY_AGAIN. Сама библиотека повторит вызов только после следующего ACK или
+// poll (~500 мс), поэтому ждущего зрителя будит wakeVideoHTTP() при публикации кадра.
+// Возврат 0 AsyncWebServer считает концом ответа, поэтому он используется только при
+// переключении транспорта: сбой захвата или пропущенный кадр не обрывают поток, а считаются
+// задержкой (stall) этого зрителя.
+HOT_PATH size_t fillVideoHTTP(HTTPViewer* viewer, uint8_t* buffer, size_t maxLen) {
+    // 0) Транспорт переключили — освобождаем кадр и завершаем поток
+    if (!videoHTTPActive) {
+        releaseViewerFrame(viewer);
+        return 0;
+    }
+
+    // 1) Если нет текущего кадра, берём самый новый, когда он положен этому зрителю
+    if (!viewer->frame) {
+        viewer->framePublished = false;
+        PooledFrame* frame     = acquireDueFrame(viewer);
+        // Кадр, опубликованный во время попытки, wakeVideoHTTP() не отдаст: мьютекс занят нами.
+        // Поэтому перед RESPONSE_TRY_AGAIN проверяем флаг и пробуем еще раз
+        while (!frame) {
+            viewer->waiting = true;
+            if (!viewer->framePublished) {
+                return RESPONSE_TRY_AGAIN;
+            }
+            viewer->framePublished = false;
+            frame                  = acquireDueFrame(viewer);
+        }
+        viewer->waiting    = false;
+        viewer->frame      = frame;
+        viewer->offset     = 0;
+        viewer->headerSent = 0;
+        // Формируем строку заголовка (boundary + Content-Length + Content-Type). С
+        // MOTION_ADAPTIVE добавляем X-Motion — оценку движения кадра (число изменившихся тайлов)
+#if MOTION_ADAPTIVE
+        viewer->headerLen = snprintf(viewer->header,
+                                     sizeof(viewer->header),
+                                     "\r\n--%s\r\n"
+                                     "Content-Type: image/jpeg\r\n"
+                                     "Content-Length: %u\r\n"
+                                     "X-Motion: %u\r\n\r\n",
+                                     BOUNDARY,
+                                     frame->len,
+                                     frame->motion);
+#else
+        viewer->headerLen = snprintf(viewer->header,
+                                     sizeof(viewer->header),
+                                     "\r\n--%s\r\n"
+                                     "Content-Type: image/jpeg\r\n"
+                                     "Content-Length: %u\r\n\r\n",
+                                     BOUNDARY,
+                                     frame->len);
+#endif
+        // На всякий случай проверяем, не вышли ли за пределы буфера заголовка. Такой кадр
+        // пропускаем, поток продолжается со следующего
+        if (viewer->headerLen >= sizeof(viewer->header)) {
+            Serial.println("[video_http] ERROR: header buffer too small for header!");
+            viewer->client->skipped++;
+            releaseViewerFrame(viewer);
+            return RESPONSE_TRY_AGAIN;
+        }
+        VIDEO_LOG("[video_http] Frame %u to viewer %u, size=%u\n",
+                  frame->number,
+                  viewer->client->id,
+                  frame->len);
+    }
+
+    // 2) Сначала отправляем заголовок, кусками не больше maxLen
+    if (viewer->headerSent < viewer->headerLen) {
+        size_t remainHeader = viewer->headerLen - viewer->headerSent;
+        size_t chunkSize    = (remainHeader < maxLen) ? remainHeader : maxLen;
+        memcpy(buffer, viewer->header + viewer->headerSent, chunkSize);
+        viewer->headerSent += chunkSize;
+        return chunkSize;
+    }
+
+    // 3) Отправляем тело (JPEG) по кускам
+    size_t remain = viewer->frame->len - viewer->offset;
+    size_t toSend = (remain < maxLen) ? remain : maxLen;
+    memcpy(buffer, viewer->frame->buf + viewer->offset, toSend);
+    viewer->offset += toSend;
+
+    // Если дошли до конца кадра, отдаем его обратно в пул
+    if (viewer->offset >= viewer->frame->len) {
+        releaseViewerFrame(viewer);
+    }
+    return toSend;
+}
+
+// Chunked-ответ /video. Отличается от beginChunkedResponse() только мьютексом зрителя вокруг
+// _respond/_ack, чтобы wakeVideoHTTP() мог наполнять ответ из задачи видео.
+class MJPEGResponse : public AsyncAbstractResponse {
+   public:
+    explicit MJPEGResponse(HTTPViewer* viewer) : _viewer(viewer) {
+        _code              = 200;
+        _contentType       = String("multipart/x-mixed-replace;boundary=") + BOUNDARY;
+        _sendContentLength = false;
+        _chunked           = true;
+    }
+
+    bool _sourceValid() const override {
+        return true;
+    }
+
+    // Отпустив мьютекс, проверяем, не пропустили ли кадр, опубликованный пока он был занят
+    void _respond(AsyncWebServerRequest* request) override {
+        xSemaphoreTake(_viewer->lock, portMAX_DELAY);
+        AsyncAbstractResponse::_respond(request);
+        xSemaphoreGive(_viewer->lock);
+        pumpViewer(_viewer);
+    }
+
+    size_t _ack(AsyncWebServerRequest* request, size_t len, uint32_t time) override {
+        xSemaphoreTake(_viewer->lock, portMAX_DELAY);
+        size_t sent = AsyncAbstractResponse::_ack(request, len, time);
+        xSemaphoreGive(_viewer->lock);
+        pumpViewer(_viewer);
+        return sent;
+    }
+
+    // То же, что делает poll библиотеки, вызывается под мьютексом зрителя
+    void pump(AsyncWebServerRequest* request) {
+        if (!_finished() && request->client()->canSend()) {
+            AsyncAbstractResponse::_ack(request, 0, 0);
+        }
+    }
+
+    size_t _fillBuffer(uint8_t* buffer, size_t maxLen) override {
+        PROFILE_HOT_PATH(httpChunkPath);
+        size_t len = fillVideoHTTP(_viewer, buffer, maxLen);
+        PROFILE_BYTES(len == RESPONSE_TRY_AGAIN ? 0 : len);
+        return len;
+    }
+
+   private:
+    HTTPViewer* _viewer;
+};
+
+// Наполняет ответ ждущего зрителя, для которого опубликован кадр. Если мьютекс занят, его
+// держит async_tcp или задача видео: fillVideoHTTP() под мьютексом увидит framePublished, а
+// отпустивший мьютекс вызовет pumpViewer() еще раз, поэтому кадр не теряется.
+void pumpViewer(HTTPViewer* viewer) {
+    while (viewer->waiting && viewer->framePublished &&
+           xSemaphoreTake(viewer->lock, 0) == pdTRUE) {
+        viewer->waiting = false;
+        if (viewer->response) {
+            viewer->response->pump(viewer->request);
+        }
+        xSemaphoreGive(viewer->lock);
+    }
+}
+
+// Новый кадр в пуле: наполняем ответы ждущих зрителей сразу, а не по следующему poll
+void wakeVideoHTTP() {
+    for (HTTPViewer& viewer : httpViewers) {
+        viewer.framePublished = true;
+        pumpViewer(&viewer);
+    }
+}
+
+// Целое значение параметра запроса, 0 если его нет
+uint32_t queryParam(AsyncWebServerRequest* request, const char* name) {
+    if (!request->hasParam(name)) {
+        return 0;
+    }
+    long value = request->getParam(name)->value().toInt();
+    return value > 0 ? (uint32_t) value : 0;
+}
 
 void initVideoHTTP() {
     VIDEO_LOG("Initializing video HTTP...");
 
+    for (HTTPViewer& viewer : httpViewers) {
+        viewer.lock = xSemaphoreCreateMutex();
+    }
+    addFrameListener(wakeVideoHTTP);
+
     // Маршрут: HTML-страница с <img src="/video">
     server.on("/stream", HTTP_GET, [](AsyncWebServerRequest* request) {
         VIDEO_LOG("Stream page requested");
@@ -37,107 +259,49 @@ void initVideoHTTP() {
         VIDEO_LOG("Stream page sent");
     });
 
-    // Маршрут /video — отправка MJPEG потока chunked-методом
+    // Маршрут /video?fps=N&maxbytes=M — отправка MJPEG потока chunked-методом. fps ограничивает
+    // частоту кадров для этого зрителя, кадры больше maxbytes ему не отправляются.
     server.on("/video", HTTP_GET, [](AsyncWebServerRequest* request) {
         VIDEO_LOG("Video stream requested");
 
-        AsyncWebServerResponse* response = request->beginChunkedResponse(
-            String("multipart/x-mixed-replace;boundary=") + BOUNDARY,
-            [=](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
-                // Статические переменные для хранения контекста между вызовами:
-                static camera_fb_t* fb = nullptr;
-                static size_t offset = 0;  // сколько уже отправили байт из fb->buf
-                static bool needHeader = true;  // надо ли сформировать новый заголовок?
-                static int failCount = 0;
-
-                // -- Поля для "частичной" отправки заголовка:
-                static char headerBuf[128];  // буфер, куда сформируем заголовок
-                static size_t headerLen = 0;  // фактическая длина заголовка
-                static size_t headerSent = 0;  // сколько байт заголовка уже отправили
-
-                // 1) Если нет текущего кадра, берём новый
-                if (!fb) {
-                    fb = esp_camera_fb_get();
-                    if (!fb) {
-                        failCount++;
-                        VIDEO_LOG("[video_http] Camera capture failed, failCount=%d\n", failCount);
-                        if (failCount > 5) {
-                            vTaskDelay(pdMS_TO_TICKS(100));  // небольшая задержка, если нет кадров
-                            failCount = 0;
-                        }
-                        // Возвращаем 0, чтобы не портить поток
-                        return 0;
-                    }
-                    failCount  = 0;
-                    offset     = 0;
-                    needHeader = true;
-                    headerSent = 0;
-                    headerLen  = 0;
-
-                    VIDEO_LOG("[video_http] Got new frame, size=%u\n", fb->len);
-                }
-
-                // 2) Сначала, если нужно, готовим и отправляем заголовок
-                if (needHeader) {
-                    if (headerLen == 0) {
-                        // Формируем строку заголовка (boundary + Content-Length + Content-Type)
-                        headerLen = snprintf(headerBuf,
-                                             sizeof(headerBuf),
-                                             "\r\n--%s\r\n"
-                                             "Content-Type: image/jpeg\r\n"
-                                             "Content-Length: %u\r\n\r\n",
-                                             BOUNDARY,
-                                             fb->len);
-                        // На всякий случай проверяем, не вышли ли за пределы headerBuf
-                        if (headerLen >= sizeof(headerBuf)) {
-                            Serial.println("[video_http] ERROR: headerBuf too small for header!");
-                            // Освобождаем fb и возвращаем 0
-                            esp_camera_fb_return(fb);
-                            fb = nullptr;
-                            return 0;
-                        }
-                        VIDEO_LOG("[video_http] Header length=%u\n", (unsigned) headerLen);
-                    }
-
-                    // Сколько ещё осталось байт заголовка, которые не отправили?
-                    size_t remainHeader = headerLen - headerSent;
-                    // Отправим кусок, не превышающий maxLen
-                    size_t chunkSize = (remainHeader < maxLen) ? remainHeader : maxLen;
-
-                    memcpy(buffer, headerBuf + headerSent, chunkSize);
-                    headerSent += chunkSize;
-
-                    // Если закончили отправлять заголовок — переходим к телу JPEG
-                    if (headerSent >= headerLen) {
-                        needHeader = false;
-                    }
-
-                    return chunkSize;
-                }
-
-                // 3) Отправляем тело (JPEG) по кускам
-                size_t remain = fb->len - offset;  // ещё неотправленные байты кадра
-                if (remain == 0) {
-                    // Вдруг offset == fb->len, но мы почему-то опять тут
-                    // Освободим кадр, чтобы взять следующий
-                    esp_camera_fb_return(fb);
-                    fb = nullptr;
-                    return 0;
-                }
-
-                size_t toSend = (remain < maxLen) ? remain : maxLen;
-                memcpy(buffer, fb->buf + offset, toSend);
-                offset += toSend;
-
-                // Если дошли до конца кадра
-                if (offset >= fb->len) {
-                    esp_camera_fb_return(fb);
-                    fb = nullptr;
-                    VIDEO_LOG("[video_http] Frame fully sent!");
-                }
-
-                return toSend;
-            });
+        if (!videoHTTPActive) {
+            request->send(503, "text/plain", "HTTP video transport is not active");
+            return;
+        }
+
+        static uint32_t connections = 0;
+
+        uint16_t      fps      = queryParam(request, "fps");
+        uint32_t      maxBytes = queryParam(request, "maxbytes");
+        StreamClient* client   = openStreamClient(STREAM_HTTP, ++connections, fps, maxBytes);
+        if (!client) {
+            request->send(503, "text/plain", "Too many video clients");
+            return;
+        }
+        HTTPViewer*    viewer   = &httpViewers[client - streamClients];
+        MJPEGResponse* response = new MJPEGResponse(viewer);
+        xSemaphoreTake(viewer->lock, portMAX_DELAY);
+        viewer->client         = client;
+        viewer->frame          = nullptr;
+        viewer->request        = request;
+        viewer->response       = response;
+        viewer->waiting        = false;
+        viewer->framePublished = false;
+        xSemaphoreGive(viewer->lock);
+
+        // Зритель отключился (или поток завершен): возвращаем кадр и освобождаем слот. Запрос и
+        // ответ удаляются после этого вызова, поэтому wakeVideoHTTP() их больше не трогает
+        request->onDisconnect([viewer]() {
+            xSemaphoreTake(viewer->lock, portMAX_DELAY);
+            viewer->request  = nullptr;
+            viewer->response = nullptr;
+            viewer->waiting  = false;
+            releaseViewerFrame(viewer);
+            closeStreamClient(viewer->client);
+            xSemaphoreGive(viewer->lock);
+        });
+
+        applyNetProfile(request->client());
 
         // Доп. заголовки
         response->addHeader("Access-Control-Allow-Origin", "*");
@@ -147,13 +311,38 @@ void initVideoHTTP() {
         response->addHeader("Expires", "0");
 
         request->send(response);
-        VIDEO_LOG("Chunked MJPEG stream started");
+        VIDEO_LOG("Chunked MJPEG stream started for viewer %u\n", client->id);
     });
 
     VIDEO_LOG("Video HTTP initialized");
 }
 
+void startVideoHTTP() {
+    videoHTTPActive = true;
+}
+
+void stopVideoHTTP() {
+    videoHTTPActive = false;
+}
+
+// Захват для зрителей /video и /capture: кадр копируется в пул и сразу возвращается камере,
+// зрители забирают его из пула каждый в своем темпе
 void handleVideoHTTP() {
+    static int failCount = 0;
+
+    if (streamClientCount(STREAM_HTTP) > 0 || snapshotWanted()) {
+        if (captureToPool()) {
+            failCount = 0;
+        } else {
+            failCount++;
+            VIDEO_LOG("[video_http] Camera capture failed, failCount=%d\n", failCount);
+        }
+        if (failCount > 5) {
+            vTaskDelay(pdMS_TO_TICKS(100));  // небольшая задержка, если нет кадров
+            failCount = 0;
+        }
+    }
+
     // Если хотим ограничить FPS (определено в config.h)
     vTaskDelay(pdMS_TO_TICKS(FRAME_INTERVAL_MS));
 }
@@ -4,8 +4,15 @@
 
 #include <cstdio>
 
+#include "alloc_counter.h"
 #include "config.h"
 #include "esp_camera.h"
+#include "frame_pool.h"
+#include "net_profile.h"
+#include "profiling.h"
+
+// Longest request line kept, the rest of a longer line is read as the next line
+#define RTSP_LINE_SIZE 128
 
 // RTSP server implementation
 class RTSPServer {
@@ -46,18 +53,22 @@ class RTSPServer {
     }
 
     void handleDescribe() {
-        char sdp[512];
+        IPAddress localIP = WiFi.localIP();
+        char      sdp[512];
         snprintf(sdp,
                  sizeof(sdp),
                  "v=0\r\n"
-                 "o=- %u 1 IN IP4 %s\r\n"
+                 "o=- %u 1 IN IP4 %u.%u.%u.%u\r\n"
                  "s=ESP32-CAM Stream\r\n"
                  "t=0 0\r\n"
                  "m=video %d RTP/AVP 26\r\n"
                  "c=IN IP4 0.0.0.0\r\n"
                  "a=control:trackID=0\r\n",
                  sessionId,
-                 WiFi.localIP().toString().c_str(),
+                 localIP[0],
+                 localIP[1],
+                 localIP[2],
+                 localIP[3],
                  RTSP_PORT);
 
         char response[768];
@@ -118,7 +129,9 @@ class RTSPServer {
         clientConnected = false;
     }
 
-    void sendRTPPacket(const uint8_t* data, size_t len) {
+    HOT_PATH void sendRTPPacket(const uint8_t* data, size_t len) {
+        PROFILE_HOT_PATH(rtpPacketPath);
+        PROFILE_BYTES(len);
         RTPHeader header;
         header.version_p_x_cc = 0x80;  // Version 2, no padding, no extension, no CSRC
         header.marker_payload = 0x1A;  // JPEG payload type
@@ -147,11 +160,23 @@ class RTSPServer {
 #endif
     }
 
+    void end() {
+        if (clientConnected) {
+            client.stop();
+            clientConnected = false;
+        }
+        server.end();
+#if ENABLE_METRICS
+        VIDEO_LOG("RTSP server stopped\n");
+#endif
+    }
+
     void handle() {
         if (!clientConnected) {
             client = server.available();
             if (client) {
                 clientConnected = true;
+                applyNetProfile(client);
 #if ENABLE_METRICS
                 VIDEO_LOG("New RTSP client connected\n");
 #endif
@@ -159,28 +184,34 @@ class RTSPServer {
         }
 
         if (clientConnected && client.available()) {
-            String request = client.readStringUntil('\n');
+            COUNT_ALLOCS(commandAllocs);
+            char   request[RTSP_LINE_SIZE];
+            size_t len   = client.readBytesUntil('\n', request, sizeof(request) - 1);
+            request[len] = '\0';
 #if ENABLE_METRICS
-            VIDEO_LOG("%s\n", request.c_str());
+            VIDEO_LOG("%.*s\n", 60, request);
 #endif
 
             // Parse request
-            if (request.indexOf("OPTIONS") >= 0)
+            if (strstr(request, "OPTIONS"))
                 handleOptions();
-            else if (request.indexOf("DESCRIBE") >= 0)
+            else if (strstr(request, "DESCRIBE"))
                 handleDescribe();
-            else if (request.indexOf("SETUP") >= 0)
+            else if (strstr(request, "SETUP"))
                 handleSetup();
-            else if (request.indexOf("PLAY") >= 0)
+            else if (strstr(request, "PLAY"))
                 handlePlay();
-            else if (request.indexOf("TEARDOWN") >= 0)
+            else if (strstr(request, "TEARDOWN"))
                 handleTeardown();
 
             // Find CSeq
+            char line[RTSP_LINE_SIZE];
             while (client.available()) {
-                String line = client.readStringUntil('\n');
-                if (line.indexOf("CSeq") >= 0) {
-                    sequenceNumber = line.substring(line.indexOf(":") + 1).toInt();
+                len       = client.readBytesUntil('\n', line, sizeof(line) - 1);
+                line[len] = '\0';
+                if (strstr(line, "CSeq")) {
+                    const char* value = strchr(line, ':');
+                    sequenceNumber    = value ? atoi(value + 1) : sequenceNumber;
                     break;
                 }
             }
@@ -218,6 +249,11 @@ void initVideoRTSP() {
     rtspServer.begin();
 }
 
+// Stop RTSP server and release its sockets
+void stopVideoRTSP() {
+    rtspServer.end();
+}
+
 // Handle RTSP video streaming
 void handleVideoRTSP() {
     rtspServer.handle();
@@ -227,7 +263,7 @@ void handleVideoRTSP() {
         START_METRIC(frame_capture);
 #endif
 
-        camera_fb_t* fb = esp_camera_fb_get();
+        camera_fb_t* fb = grabFrame();
         if (!fb) {
 #if ENABLE_METRICS
             VIDEO_LOG("Camera capture failed\n");
@@ -237,16 +273,23 @@ void handleVideoRTSP() {
 
 #if ENABLE_METRICS
         END_METRIC(frame_capture);
-        START_METRIC(frame_send);
 #endif
 
-        rtspServer.sendFrame(fb);
-
+        // Raw frames are downscaled and encoded as the build asks, snapshot pollers read the
+        // same frame from the pool
+        camera_fb_t* frame = prepareStreamFrame(fb);
+        if (frame) {
 #if ENABLE_METRICS
-        END_METRIC(frame_send);
+            START_METRIC(frame_send);
 #endif
 
-        esp_camera_fb_return(fb);
+            rtspServer.sendFrame(frame);
+
+#if ENABLE_METRICS
+            END_METRIC(frame_send);
+#endif
+        }
+        returnFrame(fb);
     }
 
     // Maintain target frame rate
@@ -5,6 +5,9 @@
 
 #include "config.h"
 #include "esp_camera.h"
+#include "frame_pool.h"
+#include "profiling.h"
+#include "raw_tiles.h"
 
 // UDP instance for video streaming
 WiFiUDP videoUDP;
@@ -29,8 +32,13 @@ void initVideoUDP() {
     videoUDP.begin(UDP_VIDEO_PORT);
 }
 
+// Stop UDP video streaming and release its socket
+void stopVideoUDP() {
+    videoUDP.stop();
+}
+
 // Send frame data in UDP packets
-void sendFrameUDP(camera_fb_t* fb) {
+HOT_PATH void sendFrameUDP(camera_fb_t* fb) {
 #if ENABLE_METRICS
     START_METRIC(frame_send);
 #endif
@@ -46,20 +54,25 @@ void sendFrameUDP(camera_fb_t* fb) {
         uint16_t payloadSize =
             (i == totalPackets - 1) ? (fb->len - i * UDP_MAX_PACKET_SIZE) : UDP_MAX_PACKET_SIZE;
 
-        // Prepare header
-        UDPVideoHeader header = {.frameNumber  = frameCounter,
-                                 .packetNumber = i,
-                                 .totalPackets = totalPackets,
-                                 .frameSize    = fb->len,
-                                 .payloadSize  = payloadSize};
+        {
+            PROFILE_HOT_PATH(udpPacketPath);
+            PROFILE_BYTES(payloadSize);
 
-        // Send header
-        videoUDP.beginPacket(WiFi.broadcastIP(), UDP_VIDEO_PORT);
-        videoUDP.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+            // Prepare header
+            UDPVideoHeader header = {.frameNumber  = frameCounter,
+                                     .packetNumber = i,
+                                     .totalPackets = totalPackets,
+                                     .frameSize    = fb->len,
+                                     .payloadSize  = payloadSize};
 
-        // Send payload
-        videoUDP.write(fb->buf + i * UDP_MAX_PACKET_SIZE, payloadSize);
-        videoUDP.endPacket();
+            // Send header
+            videoUDP.beginPacket(WiFi.broadcastIP(), UDP_VIDEO_PORT);
+            videoUDP.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+
+            // Send payload
+            videoUDP.write(fb->buf + i * UDP_MAX_PACKET_SIZE, payloadSize);
+            videoUDP.endPacket();
+        }
 
         // Small delay to prevent flooding
         delayMicroseconds(100);
@@ -71,13 +84,40 @@ void sendFrameUDP(camera_fb_t* fb) {
 #endif
 }
 
+#if RAW_TILES
+// Send the changed tiles of a raw frame, the whole frame if it cannot be tiled
+HOT_PATH void sendTilesUDP(camera_fb_t* fb) {
+    if (!reserveRawTiles(fb)) {
+        sendFrameUDP(fb);
+        return;
+    }
+
+#if ENABLE_METRICS
+    START_METRIC(frame_send);
+#endif
+
+    sendRawTiles(fb, [](const uint8_t* data, size_t len) {
+        videoUDP.beginPacket(WiFi.broadcastIP(), UDP_VIDEO_PORT);
+        videoUDP.write(data, len);
+        videoUDP.endPacket();
+
+        // Small delay to prevent flooding
+        delayMicroseconds(100);
+    });
+
+#if ENABLE_METRICS
+    END_METRIC(frame_send);
+#endif
+}
+#endif
+
 // Handle UDP video streaming
 void handleVideoUDP() {
 #if ENABLE_METRICS
     START_METRIC(frame_capture);
 #endif
 
-    camera_fb_t* fb = esp_camera_fb_get();
+    camera_fb_t* fb = grabFrame();
     if (!fb) {
 #if ENABLE_METRICS
         VIDEO_LOG("Camera capture failed\n");
@@ -89,10 +129,17 @@ void handleVideoUDP() {
     END_METRIC(frame_capture);
 #endif
 
-    // Send frame via UDP
-    sendFrameUDP(fb);
-
-    esp_camera_fb_return(fb);
+    // Send frame via UDP, raw frames downscaled and encoded as the build asks. Snapshot pollers
+    // read the same frame from the pool.
+    camera_fb_t* frame = prepareStreamFrame(fb);
+    if (frame) {
+#if RAW_TILES
+        sendTilesUDP(frame);
+#else
+        sendFrameUDP(frame);
+#endif
+    }
+    returnFrame(fb);
 
     // Maintain target frame rate
     vTaskDelay(pdMS_TO_TICKS(FRAME_INTERVAL_MS));
@@ -5,39 +5,52 @@
 #include <WiFi.h>
 
 #include "config.h"
+#include "control.h"
 #include "esp_camera.h"
+#include "frame_pool.h"
+#include "profiling.h"
 
 // WebSocket server for WebRTC signaling
-WebSocketsServer webRTC(WEBSOCKET_PORT);
+WebSocketsServer webRTC(WEBRTC_SIGNALING_PORT);
 
-// WebRTC connection state
-enum WebRTCState { DISCONNECTED, SIGNALING, CONNECTED };
+// Peers that sent an offer, one stream client per WebSocket connection
+static StreamClient* webrtcViewers[WEBSOCKETS_SERVER_CLIENT_MAX];
+static bool          webrtcMessage = false;  // webRTC.loop() handled a signaling message
 
-static WebRTCState webrtcState   = DISCONNECTED;
-static uint8_t     currentClient = 0;
+void closeWebRTCViewer(uint8_t num) {
+    if (num < WEBSOCKETS_SERVER_CLIENT_MAX && webrtcViewers[num]) {
+        closeStreamClient(webrtcViewers[num]);
+        webrtcViewers[num] = nullptr;
+    }
+}
 
-// SDP and ICE candidate handling
+// SDP and ICE candidate handling, parsed in place without copying the payload. The offer may
+// carry "fps" and "maxbytes" limits of this peer, like /video?fps=N&maxbytes=M.
 void handleWebRTCMessage(uint8_t num, uint8_t* payload, size_t length) {
-    String message = String(reinterpret_cast<const char*>(payload));
+    webrtcMessage = true;
+
+    StaticJsonDocument<1024> doc;
+    DeserializationError     error = deserializeJson(doc, (const char*) payload, length);
 
 #if ENABLE_METRICS
-    VIDEO_LOG("WebRTC message from client %u: %s\n", num, message.c_str());
+    controlLog("WebRTC message from client %u: %u bytes, type %s\n",
+               num,
+               length,
+               error ? "invalid" : (doc["type"] | "none"));
 #endif
 
-    StaticJsonDocument<1024> doc;
-    DeserializationError     error = deserializeJson(doc, message);
-
     if (!error) {
-        if (doc.containsKey("type")) {
-            String type = doc["type"];
-
-            if (type == "offer") {
-                // Handle SDP offer
-                String sdp = doc["sdp"];
-                // Process SDP offer and generate answer
-                // This is a simplified implementation
-                webrtcState   = CONNECTED;
-                currentClient = num;
+        const char* type = doc["type"];
+        if (type && strcmp(type, "offer") == 0) {
+            // Handle SDP offer
+            const char* sdp = doc["sdp"];
+            // Process SDP offer and generate answer
+            // This is a simplified implementation
+            (void) sdp;
+            closeWebRTCViewer(num);
+            if (num < WEBSOCKETS_SERVER_CLIENT_MAX) {
+                webrtcViewers[num] =
+                    openStreamClient(STREAM_WEBSOCKET, num, doc["fps"] | 0, doc["maxbytes"] | 0);
             }
         }
     }
@@ -47,10 +60,7 @@ void handleWebRTCMessage(uint8_t num, uint8_t* payload, size_t length) {
 void webRTCEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
     switch (type) {
         case WStype_DISCONNECTED: {
-            if (num == currentClient) {
-                webrtcState   = DISCONNECTED;
-                currentClient = 0;
-            }
+            closeWebRTCViewer(num);
 #if ENABLE_METRICS
             VIDEO_LOG("[%u] Disconnected!\n", num);
 #endif
@@ -77,14 +87,26 @@ void initVideoWebRTC() {
     webRTC.onEvent(webRTCEvent);
 
 #if ENABLE_METRICS
-    VIDEO_LOG("WebRTC signaling server started on port %d\n", WEBSOCKET_PORT);
+    VIDEO_LOG("WebRTC signaling server started on port %d\n", WEBRTC_SIGNALING_PORT);
 #endif
 }
 
-// Send video frame over WebRTC data channel
-void sendWebRTCFrame(camera_fb_t* fb) {
-    if (webrtcState != CONNECTED || !fb)
+// Stop WebRTC signaling server and drop the peers
+void stopVideoWebRTC() {
+    webRTC.close();
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        closeWebRTCViewer(num);
+    }
+}
+
+// Send the newest pool frame over the WebRTC data channel to every peer it is due for. The
+// camera buffer is already back with the driver, so a slow peer does not hold it.
+HOT_PATH void sendWebRTCFrame() {
+    PooledFrame* frame = acquireLatestFrame();
+    if (!frame)
         return;
+    PROFILE_HOT_PATH(webrtcFramePath);
+    PROFILE_BYTES(frame->len);
 
     // In a real implementation, this would:
     // 1. Packetize the frame according to the negotiated codec
@@ -93,22 +115,36 @@ void sendWebRTCFrame(camera_fb_t* fb) {
     // 4. Send over the established ICE connection
 
     // Here we just send the raw frame over the WebSocket (NOT how WebRTC actually works!)
-    if (webRTC.connectedClients() > 0) {
-        webRTC.sendBIN(currentClient, fb->buf, fb->len);
+    uint32_t now = millis();
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        StreamClient* viewer = webrtcViewers[num];
+        if (viewer &&
+            streamClientWants(viewer, frame->number, frame->len, frame->capturedMs, now)) {
+            webRTC.sendBIN(num, frame->buf, frame->len);
+        }
     }
+    releaseFrame(frame);
 }
 
 // Handle WebRTC video streaming
 void handleVideoWebRTC() {
-    webRTC.loop();
+    // Signaling allocations are counted around loop() like WebSocket control commands
+    {
+        COUNT_ALLOCS(commandAllocs);
+        webrtcMessage = false;
+        webRTC.loop();
+        if (!webrtcMessage) {
+            DISCARD_ALLOCS();
+        }
+    }
 
-    if (webrtcState != DISCONNECTED) {
+    // Peers and snapshot pollers read the frame from the pool, like /video viewers
+    if (streamClientCount(STREAM_WEBSOCKET) > 0 || snapshotWanted()) {
 #if ENABLE_METRICS
         START_METRIC(frame_capture);
 #endif
 
-        camera_fb_t* fb = esp_camera_fb_get();
-        if (!fb) {
+        if (!captureToPool()) {
 #if ENABLE_METRICS
             VIDEO_LOG("Camera capture failed\n");
 #endif
@@ -120,13 +156,11 @@ void handleVideoWebRTC() {
         START_METRIC(frame_send);
 #endif
 
-        sendWebRTCFrame(fb);
+        sendWebRTCFrame();
 
 #if ENABLE_METRICS
         END_METRIC(frame_send);
 #endif
-
-        esp_camera_fb_return(fb);
     }
 
     // Maintain target frame rate
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <Preferences.h>
+#include <WiFi.h>
+
+#include "config.h"
+#include "json_config.h"
+#include "net_profile.h"
+
+extern AsyncWebServer server;
+
+// WiFi association with a cached access point. Channel, BSSID and IP configuration of the
+// last connection are stored in NVS, the next association skips the channel scan and DHCP
+// and keeps the address, so TCP streams and control sessions survive a short outage. If the
+// cached access point does not answer within WIFI_FAST_CONNECT_MS, the cache is ignored and
+// a full scan with DHCP follows.
+//
+// Disconnects are reported by WiFi events and reconnected from loop() with a backoff. The
+// camera and the transports stay initialized, video capture pauses while the link is down.
+#ifndef WIFI_FAST_CONNECT_MS
+#define WIFI_FAST_CONNECT_MS 3000
+#endif
+
+// One association attempt with scan and DHCP
+#ifndef WIFI_CONNECT_TIMEOUT_MS
+#define WIFI_CONNECT_TIMEOUT_MS 15000
+#endif
+
+// Pause between failed attempts, doubles up to the maximum
+#ifndef WIFI_RETRY_MIN_MS
+#define WIFI_RETRY_MIN_MS 500
+#endif
+#ifndef WIFI_RETRY_MAX_MS
+#define WIFI_RETRY_MAX_MS 8000
+#endif
+
+// Reuse the cached IP configuration, 0 on networks whose DHCP server moves addresses
+#ifndef WIFI_CACHE_IP
+#define WIFI_CACHE_IP 1
+#endif
+
+// Link drops requested via POST /wifi: longest drop, and the delay that lets the response
+// leave before the link goes down
+#define WIFI_DROP_MAX_MS   60000
+#define WIFI_DROP_DELAY_MS 200
+
+struct WiFiCache {
+    uint8_t  channel;  // 0 = nothing cached
+    uint8_t  bssid[6];
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+static WiFiCache wifiCache      = {};
+static bool      wifiCacheStale = false;  // the cached access point did not answer
+
+// Set from the WiFi event task
+static volatile bool     wifiLinkUp      = false;
+static volatile uint32_t wifiDownSinceMs = 0;  // 0 = never connected or up
+static volatile uint32_t wifiDisconnects = 0;
+static volatile uint8_t  wifiLastReason  = 0;
+
+// Owned by loop()
+static uint32_t          wifiAttemptMs     = 0;  // start of the running attempt, 0 = none
+static bool              wifiAttemptFast   = false;
+static uint32_t          wifiNextAttemptMs = 0;
+static uint32_t          wifiRetryMs       = WIFI_RETRY_MIN_MS;
+static uint32_t          wifiConnectMs     = 0;  // duration of the last successful attempt
+static bool              wifiConnectFast   = false;
+static uint32_t          wifiReconnects    = 0;
+static uint32_t          wifiLastOutageMs  = 0;
+static volatile uint32_t wifiDropMs        = 0;  // requested link drop, 0 = none
+static volatile uint32_t wifiDropRequestMs = 0;
+
+bool wifiConnected() {
+    return wifiLinkUp;
+}
+
+void onWiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
+    if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+        wifiLinkUp = true;
+    } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED && wifiLinkUp) {
+        // Failed attempts report disconnects too, only the loss of a working link counts
+        wifiLinkUp      = false;
+        wifiDownSinceMs = millis() | 1;
+        wifiLastReason  = info.wifi_sta_disconnected.reason;
+        wifiDisconnects++;
+    }
+}
+
+void loadWiFiCache() {
+    Preferences prefs;
+    prefs.begin("wifi", true);
+    if (prefs.getBytes("ap", &wifiCache, sizeof(wifiCache)) != sizeof(wifiCache)) {
+        wifiCache.channel = 0;
+    }
+    prefs.end();
+}
+
+// Store the current association, NVS is written only when it changed
+void saveWiFiCache() {
+    WiFiCache current = {};
+    current.channel   = WiFi.channel();
+    memcpy(current.bssid, WiFi.BSSID(), sizeof(current.bssid));
+    current.ip      = WiFi.localIP();
+    current.gateway = WiFi.gatewayIP();
+    current.subnet  = WiFi.subnetMask();
+    current.dns     = WiFi.dnsIP();
+    wifiCacheStale  = false;
+    if (memcmp(&current, &wifiCache, sizeof(current)) == 0) {
+        return;
+    }
+    wifiCache = current;
+
+    Preferences prefs;
+    prefs.begin("wifi", false);
+    prefs.putBytes("ap", &wifiCache, sizeof(wifiCache));
+    prefs.end();
+}
+
+void beginWiFiAttempt() {
+    wifiAttemptFast = wifiCache.channel && !wifiCacheStale;
+    if (wifiAttemptFast && WIFI_CACHE_IP) {
+        WiFi.config(IPAddress(wifiCache.ip),
+                    IPAddress(wifiCache.gateway),
+                    IPAddress(wifiCache.subnet),
+                    IPAddress(wifiCache.dns));
+    } else {
+        WiFi.config(IPAddress(), IPAddress(), IPAddress());  // DHCP
+    }
+    if (wifiAttemptFast) {
+        WiFi.begin(WIFI_SSID, WIFI_PASS, wifiCache.channel, wifiCache.bssid);
+    } else {
+        WiFi.begin(WIFI_SSID, WIFI_PASS);
+    }
+    wifiAttemptMs = millis() | 1;
+}
+
+void onWiFiConnected(uint32_t now) {
+    wifiConnectMs   = now - wifiAttemptMs;
+    wifiConnectFast = wifiAttemptFast;
+    wifiAttemptMs   = 0;
+    wifiRetryMs     = WIFI_RETRY_MIN_MS;
+    saveWiFiCache();
+
+    if (wifiDownSinceMs) {
+        wifiLastOutageMs = now - wifiDownSinceMs;
+        wifiDownSinceMs  = 0;
+        wifiReconnects++;
+        applyRadioSettings();
+        Serial.printf("WiFi reconnected after %u ms (%s, %u ms to connect), IP %s\n",
+                      wifiLastOutageMs,
+                      wifiConnectFast ? "cached access point" : "scan",
+                      wifiConnectMs,
+                      WiFi.localIP().toString().c_str());
+    }
+}
+
+// Drive (re)association, called from loop() and while setup() waits for the first link
+void handleWiFiLink() {
+    uint32_t now = millis();
+    if (wifiDropMs && now - wifiDropRequestMs >= WIFI_DROP_DELAY_MS) {
+        // Benchmark hook: take the link down and stay away for the requested time
+        wifiNextAttemptMs = now + wifiDropMs;
+        wifiDropMs        = 0;
+        wifiAttemptMs     = 0;
+        WiFi.disconnect();
+        return;
+    }
+    if (wifiLinkUp) {
+        if (wifiAttemptMs) {
+            onWiFiConnected(now);
+        }
+        return;
+    }
+
+    if (wifiAttemptMs) {
+        uint32_t limit = wifiAttemptFast ? WIFI_FAST_CONNECT_MS : WIFI_CONNECT_TIMEOUT_MS;
+        if (now - wifiAttemptMs < limit) {
+            return;
+        }
+        WiFi.disconnect();
+        wifiAttemptMs = 0;
+        if (wifiAttemptFast) {
+            // Try a full scan right away, the access point may have moved to another channel
+            Serial.println("Cached access point did not answer, scanning");
+            wifiCacheStale    = true;
+            wifiNextAttemptMs = now;
+        } else {
+            wifiNextAttemptMs = now + wifiRetryMs;
+            wifiRetryMs       = wifiRetryMs * 2;
+            if (wifiRetryMs > WIFI_RETRY_MAX_MS) {
+                wifiRetryMs = WIFI_RETRY_MAX_MS;
+            }
+        }
+    }
+    if ((int32_t) (now - wifiNextAttemptMs) >= 0) {
+        beginWiFiAttempt();
+    }
+}
+
+// Connect at boot, blocks until the first link is up
+void connectWiFi() {
+    WiFi.persistent(false);  // the cache lives in its own NVS namespace
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(false);  // reconnected from loop() with the cached access point
+    WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    loadWiFiCache();
+
+    uint32_t lastReport = millis();
+    while (!wifiLinkUp || wifiAttemptMs) {
+        handleWiFiLink();
+        delay(10);
+        if (millis() - lastReport >= 10000) {
+            Serial.println("Still trying to connect...");
+            lastReport = millis();
+        }
+    }
+    Serial.printf("- Connected in %u ms (%s)\n",
+                  wifiConnectMs,
+                  wifiConnectFast ? "cached access point" : "scan");
+}
+
+void initWiFiLink() {
+    server.on("/wifi", HTTP_GET, [](AsyncWebServerRequest* request) {
+        StaticJsonDocument<512> doc;
+        doc["connected"]      = wifiLinkUp;
+        doc["ip"]             = WiFi.localIP().toString();
+        doc["bssid"]          = WiFi.BSSIDstr();
+        doc["channel"]        = WiFi.channel();
+        doc["rssi"]           = WiFi.RSSI();
+        doc["cached"]         = wifiCache.channel != 0;
+        doc["cache_ip"]       = WIFI_CACHE_IP;
+        doc["connect_ms"]     = wifiConnectMs;
+        doc["fast_connect"]   = wifiConnectFast;
+        doc["disconnects"]    = wifiDisconnects;
+        doc["reconnects"]     = wifiReconnects;
+        doc["last_outage_ms"] = wifiLastOutageMs;
+        doc["last_reason"]    = wifiLastReason;
+
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+
+    // {"drop_ms": 2000} disconnects after the response and reconnects after the given time
+    onJsonConfigPost("/wifi", [](JsonDocument& doc) -> const char* {
+        uint32_t dropMs = doc["drop_ms"] | 0;
+        if (dropMs == 0 || dropMs > WIFI_DROP_MAX_MS) {
+            return "drop_ms must be 1..60000";
+        }
+        wifiDropRequestMs = millis();
+        wifiDropMs        = dropMs;
+        return nullptr;
+    });
+}
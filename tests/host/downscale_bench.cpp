@@ -0,0 +1,196 @@
+// Host microbenchmark of the box downscaler in src/downscale.h: time per frame of the packed
+// strip downscaler against a plain per-sample loop for every raw format, resolution and factor.
+// Both must produce the same pixels.
+//
+//   make host-bench                        full run
+//   downscale_bench --quick                short run
+//   downscale_bench --quick --write DIR    also write every VGA frame (.gray, .yuv, .rgb565) and
+//                                          its downscaled versions (.x2, .x4, .x8), checked
+//                                          against numpy by the test suite
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "downscale.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Resolution {
+    const char* name;
+    uint16_t    width;
+    uint16_t    height;
+};
+
+static const Resolution resolutions[] = {{"QVGA", 320, 240}, {"VGA", 640, 480}, {"SVGA", 800, 600}};
+
+struct Format {
+    const char*     name;
+    const char*     extension;
+    DownscaleFormat format;
+};
+
+static const Format formats[] = {{"gray", "gray", DOWNSCALE_GRAYSCALE},
+                                 {"yuv422", "yuv", DOWNSCALE_YUV422},
+                                 {"rgb565", "rgb565", DOWNSCALE_RGB565}};
+
+// Channel c (0 = first) of pixel x of a row in the given format
+static unsigned sample(DownscaleFormat format, const uint8_t* row, int x, int c) {
+    if (format == DOWNSCALE_GRAYSCALE) {
+        return row[x];
+    }
+    if (format == DOWNSCALE_YUV422) {
+        // Y of the pixel, then U and V of its pair
+        return c == 0 ? row[x * 2] : row[(x & ~1) * 2 + (c == 1 ? 1 : 3)];
+    }
+    unsigned pixel = row[x * 2] << 8 | row[x * 2 + 1];
+    return c == 0 ? pixel >> 11 : (c == 1 ? (pixel >> 5) & 0x3F : pixel & 0x1F);
+}
+
+// One sample at a time, the reference for the packed version
+static size_t plainDownscale(DownscaleFormat format,
+                             const uint8_t*  src,
+                             uint16_t        width,
+                             uint16_t        height,
+                             uint8_t         factor,
+                             uint8_t*        dst) {
+    int    outWidth  = downscaleWidth(width, factor);
+    int    outHeight = downscaleHeight(height, factor);
+    size_t bpp       = downscaleBytesPerPixel(format);
+    int    channels  = format == DOWNSCALE_GRAYSCALE ? 1 : 3;
+    int    area      = factor * factor;
+    for (int y = 0; y < outHeight; y++) {
+        uint8_t* out = dst + (size_t) y * outWidth * bpp;
+        for (int x = 0; x < outWidth; x++) {
+            unsigned mean[3] = {0, 0, 0};
+            for (int c = 0; c < channels; c++) {
+                unsigned sum = 0;
+                for (int dy = 0; dy < factor; dy++) {
+                    const uint8_t* row = src + (size_t) (y * factor + dy) * width * bpp;
+                    for (int dx = 0; dx < factor; dx++) {
+                        // Chroma of an output pair is the mean over both of its pixels
+                        int sx = format == DOWNSCALE_YUV422 && c ? (x & ~1) * factor + dx * 2
+                                                                 : x * factor + dx;
+                        sum += sample(format, row, sx, c);
+                    }
+                }
+                mean[c] = (sum + area / 2) / area;
+            }
+            if (format == DOWNSCALE_GRAYSCALE) {
+                out[x] = mean[0];
+            } else if (format == DOWNSCALE_YUV422) {
+                out[x * 2]     = mean[0];
+                out[x * 2 + 1] = x & 1 ? mean[2] : mean[1];
+            } else {
+                uint16_t pixel = mean[0] << 11 | mean[1] << 5 | mean[2];
+                out[x * 2]     = pixel >> 8;
+                out[x * 2 + 1] = pixel;
+            }
+        }
+    }
+    return (size_t) outWidth * outHeight * bpp;
+}
+
+// A lit gradient with noise and a few objects, every byte used
+static std::vector<uint8_t> sceneFrame(const Resolution& res, size_t bpp, std::mt19937& rng) {
+    std::vector<uint8_t>          frame((size_t) res.width * res.height * bpp);
+    std::uniform_int_distribution noise(-6, 6);
+    for (size_t i = 0; i < frame.size(); i++) {
+        int x     = (int) (i / bpp % res.width);
+        int y     = (int) (i / bpp / res.width);
+        int value = 40 + 160 * (x + y) / (res.width + res.height) + noise(rng);
+        if ((x / 40 + y / 40) % 5 == 0) {
+            value = rng() % 256;
+        }
+        frame[i] = value < 0 ? 0 : (value > 255 ? 255 : value);
+    }
+    return frame;
+}
+
+static void writeFile(const std::string& path, const uint8_t* data, size_t len) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file) {
+        fwrite(data, 1, len, file);
+        fclose(file);
+    }
+}
+
+template <typename F>
+static double timeUs(int iterations, F run) {
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        run();
+    }
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+    bool        quick = false;
+    const char* dir   = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (strcmp(argv[i], "--write") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        }
+    }
+    int iterations = quick ? 3 : 50;
+
+    std::mt19937 rng(42);
+    printf("%-7s %-5s %6s %10s %10s %10s %8s\n",
+           "format",
+           "res",
+           "factor",
+           "out B",
+           "plain us",
+           "packed us",
+           "speedup");
+    for (const Resolution& res : resolutions) {
+        for (const Format& format : formats) {
+            size_t               bpp   = downscaleBytesPerPixel(format.format);
+            std::vector<uint8_t> frame = sceneFrame(res, bpp, rng);
+            std::string base = dir ? std::string(dir) + "/" + format.name + "_" + res.name : "";
+            if (dir && strcmp(res.name, "VGA") == 0) {
+                writeFile(base + "." + format.extension, frame.data(), frame.size());
+            }
+            for (uint8_t factor = 2; factor <= DOWNSCALE_MAX_FACTOR; factor *= 2) {
+                std::vector<uint32_t> acc(downscaleAccWords(res.width, factor));
+                std::vector<uint8_t>  packed(frame.size()), plain(frame.size());
+                size_t                len = 0;
+
+                double usPlain = timeUs(iterations, [&] {
+                    plainDownscale(
+                        format.format, frame.data(), res.width, res.height, factor, plain.data());
+                });
+                double usPacked = timeUs(iterations, [&] {
+                    len = downscaleFrame(format.format,
+                                         frame.data(),
+                                         res.width,
+                                         res.height,
+                                         factor,
+                                         acc.data(),
+                                         packed.data());
+                });
+                printf("%-7s %-5s %6u %10zu %10.1f %10.1f %8.2f\n",
+                       format.name,
+                       res.name,
+                       factor,
+                       len,
+                       usPlain,
+                       usPacked,
+                       usPlain / usPacked);
+                if (memcmp(packed.data(), plain.data(), len) != 0) {
+                    printf("packed and plain downscaling differ\n");
+                    return 1;
+                }
+                if (dir && strcmp(res.name, "VGA") == 0) {
+                    writeFile(base + ".x" + std::to_string(factor), packed.data(), len);
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+// Host microbenchmark of the motion detector in src/motion.h: time per frame of the luma
+// signature for every raw format and resolution, and of scoring and the send decision.
+//
+//   make host-bench                                    full run
+//   motion_bench --quick                               short run
+//   motion_bench --replay FILE W H COUNT INTERVAL_MS   score COUNT grayscale frames of W x H
+//                                                      from FILE, one "score send" line per
+//                                                      frame, compared with
+//                                                      benchmark/utils/motion.py by the tests
+//
+// The firmware signs JPEG frames from a 1/8-scale decode of the sensor output, which needs the
+// ROM decoder of the ESP32. Its signature is the grayscale one at step 1 over 1/64 of the
+// pixels.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "motion.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Resolution {
+    const char* name;
+    uint16_t    width;
+    uint16_t    height;
+};
+
+static const Resolution resolutions[] = {{"QVGA", 320, 240}, {"VGA", 640, 480}, {"SVGA", 800, 600}};
+
+// Defaults of src/motion_rate.h at FRAME_INTERVAL_MS 100
+static const MotionConfig config = {12, 2, 100, 2000, 2000};
+
+static const uint8_t SAMPLE_STEP = 4;
+
+// Keeps the timed results alive
+static volatile uint32_t sink;
+
+template <typename F>
+static double timeUs(int iterations, F run) {
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        run();
+    }
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / iterations;
+}
+
+static int replay(
+    const char* path, uint16_t width, uint16_t height, int count, uint32_t interval) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        printf("cannot open %s\n", path);
+        return 1;
+    }
+    std::vector<uint8_t> frame((size_t) width * height);
+    MotionState          state = {};
+    uint8_t              sig[MOTION_TILES];
+    for (int i = 0; i < count; i++) {
+        if (fread(frame.data(), 1, frame.size(), file) != frame.size()) {
+            printf("short read at frame %d\n", i);
+            fclose(file);
+            return 1;
+        }
+        const uint8_t* buf = frame.data();
+        motionSignature(
+            width,
+            height,
+            SAMPLE_STEP,
+            [buf, width](uint32_t x, uint32_t y) { return buf[y * width + x]; },
+            sig);
+        uint8_t score = motionScore(state, config, sig);
+        bool    send  = motionDecide(state, config, i * interval);
+        printf("%u %d\n", score, send);
+    }
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 7 && strcmp(argv[1], "--replay") == 0) {
+        return replay(argv[2], atoi(argv[3]), atoi(argv[4]), atoi(argv[5]), atoi(argv[6]));
+    }
+    bool quick      = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    int  iterations = quick ? 5 : 200;
+
+    std::mt19937 rng(42);
+    printf("%-7s %-5s %12s %12s\n", "format", "res", "signature us", "score us");
+    for (const Resolution& res : resolutions) {
+        size_t               pixels = (size_t) res.width * res.height;
+        std::vector<uint8_t> frame(pixels * 2);
+        for (uint8_t& byte : frame) {
+            byte = rng();
+        }
+        const uint8_t* buf   = frame.data();
+        uint32_t       width = res.width;
+        uint8_t        sig[MOTION_TILES];
+        MotionState    state = {};
+
+        double gray = timeUs(iterations, [&] {
+            motionSignature(
+                res.width,
+                res.height,
+                SAMPLE_STEP,
+                [buf, width](uint32_t x, uint32_t y) { return buf[y * width + x]; },
+                sig);
+            sink = sig[0];
+        });
+        double yuv = timeUs(iterations, [&] {
+            motionSignature(
+                res.width,
+                res.height,
+                SAMPLE_STEP,
+                [buf, width](uint32_t x, uint32_t y) { return buf[(y * width + x) * 2]; },
+                sig);
+            sink = sig[0];
+        });
+        double rgb = timeUs(iterations, [&] {
+            motionSignature(
+                res.width,
+                res.height,
+                SAMPLE_STEP,
+                [buf, width](uint32_t x, uint32_t y) {
+                    return motionLumaRGB565(buf + (y * width + x) * 2);
+                },
+                sig);
+            sink = sig[0];
+        });
+        uint32_t now   = 0;
+        double   score = timeUs(iterations * 100, [&] {
+            sig[now % MOTION_TILES] ^= 0x40;
+            sink = motionScore(state, config, sig) + motionDecide(state, config, now += 100);
+        });
+        printf("%-7s %-5s %12.1f %12.3f\n", "gray", res.name, gray, score);
+        printf("%-7s %-5s %12.1f %12.3f\n", "yuv422", res.name, yuv, score);
+        printf("%-7s %-5s %12.1f %12.3f\n", "rgb565", res.name, rgb, score);
+    }
+    return 0;
+}
@@ -0,0 +1,215 @@
+// Host microbenchmarks for the queues in src/queue.h: throughput and latency under
+// contention, with a mutex-protected ring as reference. Every run also checks that no item
+// is lost, duplicated or reordered per producer, the exit code is non-zero if one was.
+//
+//   make host-bench              full run
+//   queue_bench --quick          short run used by the test suite
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "queue.h"
+
+using Clock = std::chrono::steady_clock;
+
+static bool failed = false;
+
+static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch())
+        .count();
+}
+
+// Busy-wait that yields after a while, so that the benchmark also completes on a single core
+template <typename Predicate>
+static void spinUntil(Predicate done) {
+    for (unsigned spins = 0; !done(); spins++) {
+        if (spins >= 1000) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Reference: ring buffer behind a mutex
+template <typename T, size_t Capacity>
+class MutexQueue {
+   public:
+    bool tryPush(T value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ == Capacity) {
+            return false;
+        }
+        slots_[(head_ + count_++) % Capacity] = value;
+        return true;
+    }
+
+    bool tryPop(T* value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ == 0) {
+            return false;
+        }
+        *value = slots_[head_];
+        head_  = (head_ + 1) % Capacity;
+        count_--;
+        return true;
+    }
+
+   private:
+    std::mutex mutex_;
+    T          slots_[Capacity];
+    size_t     head_  = 0;
+    size_t     count_ = 0;
+};
+
+struct Item {
+    uint32_t producer;
+    uint32_t sequence;
+    uint64_t timestamp;
+};
+
+struct Result {
+    double opsPerSecond;
+    double p50Ns;
+    double p99Ns;
+};
+
+static double percentile(std::vector<uint64_t>& values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t index = (size_t) (p / 100.0 * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return (double) values[index];
+}
+
+// Producers push items stamped with the push time, one consumer pops them and records the
+// time each item spent in the queue. Latency includes queueing under contention.
+template <typename Queue>
+static Result runContention(unsigned producers, uint32_t itemsPerProducer) {
+    static Queue          queue;
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool>     go{false};
+
+    std::vector<std::thread> threads;
+    for (unsigned p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+            ready++;
+            spinUntil([&] { return go.load(std::memory_order_acquire); });
+            for (uint32_t i = 0; i < itemsPerProducer; i++) {
+                Item item = {p, i, nowNs()};
+                while (!queue.tryPush(item)) {
+                    std::this_thread::yield();
+                    item.timestamp = nowNs();
+                }
+            }
+        });
+    }
+    spinUntil([&] { return ready.load() == producers; });
+
+    std::vector<uint32_t> expected(producers, 0);
+    std::vector<uint64_t> latencies;
+    uint64_t              total = (uint64_t) producers * itemsPerProducer;
+    latencies.reserve(total);
+
+    auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    Item item;
+    for (uint64_t received = 0; received < total;) {
+        if (!queue.tryPop(&item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        latencies.push_back(nowNs() - item.timestamp);
+        if (item.producer >= producers || item.sequence != expected[item.producer]) {
+            failed = true;
+        }
+        expected[item.producer] = item.sequence + 1;
+        received++;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    if (queue.tryPop(&item)) {
+        failed = true;  // more items than were pushed
+    }
+
+    return {total / seconds, percentile(latencies, 50), percentile(latencies, 99)};
+}
+
+// Round trip between two threads over a pair of queues, no queueing involved
+template <typename Queue>
+static Result runPingPong(uint32_t rounds) {
+    static Queue request;
+    static Queue response;
+
+    std::thread echo([&] {
+        Item item;
+        for (uint32_t i = 0; i < rounds; i++) {
+            spinUntil([&] { return request.tryPop(&item); });
+            spinUntil([&] { return response.tryPush(item); });
+        }
+    });
+
+    std::vector<uint64_t> latencies;
+    latencies.reserve(rounds);
+    auto start = Clock::now();
+    Item item  = {0, 0, 0};
+    for (uint32_t i = 0; i < rounds; i++) {
+        uint64_t sent = nowNs();
+        item.sequence = i;
+        spinUntil([&] { return request.tryPush(item); });
+        spinUntil([&] { return response.tryPop(&item); });
+        latencies.push_back(nowNs() - sent);
+        if (item.sequence != i) {
+            failed = true;
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    echo.join();
+
+    return {rounds / seconds, percentile(latencies, 50), percentile(latencies, 99)};
+}
+
+static void print(const char* name, unsigned producers, const Result& result) {
+    printf("%-18s %9u %14.0f %12.0f %12.0f\n",
+           name,
+           producers,
+           result.opsPerSecond,
+           result.p50Ns,
+           result.p99Ns);
+}
+
+int main(int argc, char** argv) {
+    bool     quick  = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    uint32_t items  = quick ? 20000 : 2000000;
+    uint32_t rounds = quick ? 2000 : 200000;
+
+    printf("%-18s %9s %14s %12s %12s\n", "benchmark", "producers", "ops/s", "p50 ns", "p99 ns");
+    print("spsc pingpong", 1, runPingPong<SpscQueue<Item, 16>>(rounds));
+    print("mutex pingpong", 1, runPingPong<MutexQueue<Item, 16>>(rounds));
+    print("spsc stream", 1, runContention<SpscQueue<Item, 1024>>(1, items));
+    print("mutex stream", 1, runContention<MutexQueue<Item, 1024>>(1, items));
+
+    // At least 4 producers even on small hosts, oversubscription still checks correctness
+    unsigned maxProducers = std::min(8u, std::max(4u, std::thread::hardware_concurrency()));
+    for (unsigned producers = 1; producers <= maxProducers; producers *= 2) {
+        print("mpsc stream",
+              producers,
+              runContention<MpscQueue<Item, 1024>>(producers, items / producers));
+        print("mutex mpsc stream",
+              producers,
+              runContention<MutexQueue<Item, 1024>>(producers, items / producers));
+    }
+
+    if (failed) {
+        printf("FAILED: items lost, duplicated or reordered\n");
+        return 1;
+    }
+    return 0;
+}
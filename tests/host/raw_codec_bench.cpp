@@ -0,0 +1,151 @@
+// Host microbenchmark of the RGB565 codec in src/raw_codec.h: compression ratio and encode
+// time per frame for synthetic frames of the camera resolutions. The frames cover a smooth
+// scene with sensor noise, a flat scene with a few objects and pure noise (worst case).
+//
+//   make host-bench                       full run
+//   raw_codec_bench --quick               short run
+//   raw_codec_bench --quick --write DIR   also write every frame (.rgb565) and its encoding
+//                                         (.r5), decoded by the test suite
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "raw_codec.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Resolution {
+    const char* name;
+    uint16_t    width;
+    uint16_t    height;
+};
+
+static const Resolution resolutions[] = {
+    {"QQVGA", 160, 120}, {"QVGA", 320, 240}, {"VGA", 640, 480}, {"SVGA", 800, 600}};
+
+static void putPixel(std::vector<uint8_t>& frame, size_t index, int r, int g, int b) {
+    uint16_t pixel       = (r & 0x1F) << 11 | (g & 0x3F) << 5 | (b & 0x1F);
+    frame[index * 2]     = pixel >> 8;
+    frame[index * 2 + 1] = pixel;
+}
+
+static int clampChannel(int value, int max) {
+    return value < 0 ? 0 : (value > max ? max : value);
+}
+
+// Gradient lit from one corner with +-1 LSB noise, as a camera sees a plain wall
+static std::vector<uint8_t> smoothFrame(const Resolution& res, std::mt19937& rng) {
+    std::vector<uint8_t>          frame(res.width * res.height * 2);
+    std::uniform_int_distribution noise(-1, 1);
+    for (int y = 0; y < res.height; y++) {
+        for (int x = 0; x < res.width; x++) {
+            int r = clampChannel(8 + 16 * x / res.width + noise(rng), 31);
+            int g = clampChannel(20 + 24 * y / res.height + noise(rng), 63);
+            int b = clampChannel(12 + 8 * (x + y) / (res.width + res.height) + noise(rng), 31);
+            putPixel(frame, (size_t) y * res.width + x, r, g, b);
+        }
+    }
+    return frame;
+}
+
+// Uniform background with solid rectangles
+static std::vector<uint8_t> flatFrame(const Resolution& res, std::mt19937& rng) {
+    std::vector<uint8_t> frame(res.width * res.height * 2);
+    for (size_t i = 0; i < (size_t) res.width * res.height; i++) {
+        putPixel(frame, i, 20, 40, 20);
+    }
+    for (int n = 0; n < 6; n++) {
+        int x0 = rng() % res.width, y0 = rng() % res.height;
+        int x1 = x0 + res.width / 6, y1 = y0 + res.height / 6;
+        int r = rng() % 32, g = rng() % 64, b = rng() % 32;
+        for (int y = y0; y < y1 && y < res.height; y++) {
+            for (int x = x0; x < x1 && x < res.width; x++) {
+                putPixel(frame, (size_t) y * res.width + x, r, g, b);
+            }
+        }
+    }
+    return frame;
+}
+
+static std::vector<uint8_t> noiseFrame(const Resolution& res, std::mt19937& rng) {
+    std::vector<uint8_t> frame(res.width * res.height * 2);
+    for (uint8_t& byte : frame) {
+        byte = rng();
+    }
+    return frame;
+}
+
+static void writeFile(const std::string& path, const uint8_t* data, size_t len) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file) {
+        fwrite(data, 1, len, file);
+        fclose(file);
+    }
+}
+
+int main(int argc, char** argv) {
+    bool        quick = false;
+    const char* dir   = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (strcmp(argv[i], "--write") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        }
+    }
+    int iterations = quick ? 3 : 50;
+
+    typedef std::vector<uint8_t> (*Generator)(const Resolution&, std::mt19937&);
+    struct Pattern {
+        const char* name;
+        Generator   generate;
+    };
+    const Pattern patterns[] = {
+        {"smooth", smoothFrame}, {"flat", flatFrame}, {"noise", noiseFrame}};
+
+    std::mt19937 rng(42);
+    printf("%-8s %-6s %10s %10s %7s %10s %8s\n",
+           "pattern",
+           "res",
+           "raw B",
+           "encoded B",
+           "ratio",
+           "us/frame",
+           "MB/s");
+    for (const Resolution& res : resolutions) {
+        size_t               pixels = (size_t) res.width * res.height;
+        std::vector<uint8_t> encoded(rawCodecBound(pixels));
+        for (const Pattern& pattern : patterns) {
+            std::vector<uint8_t> frame = pattern.generate(res, rng);
+            size_t               len   = 0;
+            auto                 start = Clock::now();
+            for (int i = 0; i < iterations; i++) {
+                len = encodeRGB565(frame.data(), res.width, res.height, encoded.data());
+            }
+            double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() /
+                        iterations;
+            printf("%-8s %-6s %10zu %10zu %7.2f %10.1f %8.1f\n",
+                   pattern.name,
+                   res.name,
+                   frame.size(),
+                   len,
+                   (double) frame.size() / len,
+                   us,
+                   frame.size() / us);
+            if (len > rawCodecBound(pixels)) {
+                printf("encoded size above bound\n");
+                return 1;
+            }
+            if (dir) {
+                std::string base = std::string(dir) + "/" + pattern.name + "_" + res.name;
+                writeFile(base + ".rgb565", frame.data(), frame.size());
+                writeFile(base + ".r5", encoded.data(), len);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,160 @@
+// Host microbenchmark of the changed-tile coder in src/tile_delta.h: time per frame, bytes per
+// frame and changed tiles for every raw format and resolution on a still scene with sensor
+// noise that a moving block crosses.
+//
+//   make host-bench                      full run
+//   tile_delta_bench --quick             short run
+//   tile_delta_bench --quick --write DIR also write the QVGA frames of every format (.frames)
+//                                        and their datagrams, each after its length as a
+//                                        little-endian u16 (.packets), composed and checked
+//                                        by benchmark/utils/raw_tiles.py in the test suite
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "tile_delta.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Resolution {
+    const char* name;
+    uint16_t    width;
+    uint16_t    height;
+};
+
+static const Resolution resolutions[] = {{"QVGA", 320, 240}, {"VGA", 640, 480}, {"SVGA", 800, 600}};
+
+struct Format {
+    const char* name;
+    TileFormat  format;
+};
+
+static const Format formats[] = {
+    {"gray", TILE_GRAYSCALE}, {"yuv422", TILE_YUV422}, {"rgb565", TILE_RGB565}};
+
+// Defaults of src/raw_tiles.h
+static const TileDeltaConfig config = {16, 4, 50, 1400};
+
+// Textured gradient with noise, a bright block moves 4 pixels per frame along the middle
+static std::vector<uint8_t> sceneFrame(
+    const Resolution& res, TileFormat format, int index, std::mt19937& rng) {
+    std::uniform_int_distribution noise(-2, 2);
+    size_t                        pixels = (size_t) res.width * res.height;
+    std::vector<uint8_t>          frame(pixels * tileBytesPerPixel(format));
+    int                           size = res.width / 8;
+    int                           bx   = index * 4 % res.width;
+    int                           by   = (res.height - size) / 2;
+    for (int y = 0; y < res.height; y++) {
+        for (int x = 0; x < res.width; x++) {
+            int luma = 40 + 160 * (x + y) / (res.width + res.height) + (x / 8 + y / 8) % 3 * 10;
+            if (x >= bx && x < bx + size && y >= by && y < by + size) {
+                luma = 230;
+            }
+            luma += noise(rng);
+            luma         = luma < 0 ? 0 : (luma > 255 ? 255 : luma);
+            size_t pixel = (size_t) y * res.width + x;
+            if (format == TILE_GRAYSCALE) {
+                frame[pixel] = luma;
+            } else if (format == TILE_YUV422) {
+                frame[pixel * 2]     = luma;
+                frame[pixel * 2 + 1] = 128;
+            } else {
+                uint16_t value       = (luma >> 3) << 11 | (luma >> 2) << 5 | (luma >> 3);
+                frame[pixel * 2]     = value >> 8;
+                frame[pixel * 2 + 1] = value;
+            }
+        }
+    }
+    return frame;
+}
+
+int main(int argc, char** argv) {
+    bool        quick = false;
+    const char* dir   = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (strcmp(argv[i], "--write") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        }
+    }
+    int frames = quick ? 20 : 100;
+
+    std::mt19937 rng(42);
+    printf("%-7s %-5s %10s %10s %8s %9s %8s\n",
+           "format",
+           "res",
+           "frame B",
+           "tiles B",
+           "ratio",
+           "changed %",
+           "us");
+    for (const Resolution& res : resolutions) {
+        for (const Format& format : formats) {
+            size_t len = (size_t) res.width * res.height * tileBytesPerPixel(format.format);
+
+            std::vector<uint8_t> reference(len);
+            std::vector<uint8_t> changed(tileCount(res.width, res.height, config.tileSize));
+            std::vector<uint8_t> packet(config.packetSize);
+            TileDeltaState       state = {};
+            state.reference            = reference.data();
+            state.changed              = changed.data();
+
+            bool  write  = dir && strcmp(res.name, "QVGA") == 0;
+            FILE* input  = nullptr;
+            FILE* output = nullptr;
+            if (write) {
+                std::string base = std::string(dir) + "/" + format.name + "_" + res.name;
+                input            = fopen((base + ".frames").c_str(), "wb");
+                output           = fopen((base + ".packets").c_str(), "wb");
+            }
+
+            uint64_t bytes = 0, changedTiles = 0, tiles = 0;
+            double   us    = 0;
+            for (int i = 0; i < frames; i++) {
+                std::vector<uint8_t> frame = sceneFrame(res, format.format, i, rng);
+                auto                 start = Clock::now();
+                TileDeltaStats       stats = tileDeltaEncode(
+                    state,
+                    config,
+                    format.format,
+                    frame.data(),
+                    res.width,
+                    res.height,
+                    packet.data(),
+                    [output](const uint8_t* data, size_t size) {
+                        if (output) {
+                            uint8_t prefix[2] = {(uint8_t) size, (uint8_t) (size >> 8)};
+                            fwrite(prefix, 1, 2, output);
+                            fwrite(data, 1, size, output);
+                        }
+                    });
+                us += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+                bytes += stats.bytes;
+                changedTiles += stats.changed;
+                tiles += stats.tiles;
+                if (input) {
+                    fwrite(frame.data(), 1, frame.size(), input);
+                }
+            }
+            if (input) {
+                fclose(input);
+                fclose(output);
+            }
+
+            printf("%-7s %-5s %10zu %10.0f %8.3f %9.1f %8.1f\n",
+                   format.name,
+                   res.name,
+                   len,
+                   (double) bytes / frames,
+                   (double) bytes / frames / len,
+                   100.0 * changedTiles / tiles,
+                   us / frames);
+        }
+    }
+    return 0;
+}
@@ -9,7 +9,8 @@ from unittest.mock import patch
 import numpy as np
 import pytest
 
-from benchmark import ESPCamBenchmark
+from benchmark import ESPCamBenchmark, reports
+from benchmark import benchmark as benchmark_module
 
 
 @pytest.fixture()
@@ -165,3 +166,412 @@ def test_control_protocol(
         assert isinstance(result["latency"], list)
         assert isinstance(result["success_rate"], (int, float))
         assert isinstance(result["errors"], list)
+
+
+def test_compute_interference():
+    """Test that concurrent metrics are compared with solo baselines"""
+
+    def control_metrics(p50, success_rate):
+        percentiles = {"p50": p50, "p95": p50 * 2, "p99": p50 * 4}
+        return {
+            "success_rate": success_rate,
+            "latency_stats": {"percentiles": percentiles},
+        }
+
+    baseline = {
+        "video": {"avg_fps": 20.0, "bitrate_mbps": 4.0},
+        "control": control_metrics(5.0, 1.0),
+    }
+    concurrent = {
+        "video": {"avg_fps": 15.0, "bitrate_mbps": 3.0},
+        "control": control_metrics(20.0, 0.9),
+    }
+
+    result = benchmark_module.compute_interference(baseline, concurrent)
+    assert result["video"]["fps_ratio"] == pytest.approx(0.75)
+    assert result["video"]["bitrate_ratio"] == pytest.approx(0.75)
+    assert result["control"]["p50_ratio"] == pytest.approx(4.0)
+    assert result["control"]["p99_ratio"] == pytest.approx(4.0)
+    assert result["control"]["concurrent_success_rate"] == 0.9
+
+    # Missing baseline must not divide by zero
+    baseline["video"]["avg_fps"] = 0
+    assert (
+        benchmark_module.compute_interference(baseline, concurrent)["video"][
+            "fps_ratio"
+        ]
+        == 0
+    )
+
+
+def test_task_profile_report():
+    """Test that task profiles are compared per protocol pair"""
+
+    def entry(profile, fps, p50, p99, latency_p99):
+        metrics = {
+            "fps": {"value": fps},
+            "frame_time_p50_ms": {"value": p50},
+            "frame_time_p99_ms": {"value": p99},
+            "control_latency_p99_ms": {"value": latency_p99},
+        }
+        return {
+            "params": {
+                "video_protocol": "UDP",
+                "control_protocol": "WebSocket",
+                "task_profile": profile,
+            },
+            "results": {"summary": {"metrics": metrics}},
+        }
+
+    results = [
+        entry("loop", 10.0, 100.0, 180.0, 110.0),
+        entry("loop", 12.0, 90.0, 150.0, 90.0),
+        entry("split", 11.5, 95.0, 110.0, 12.0),
+        {"params": {"task_profile": "split"}, "error": "failed"},
+    ]
+    report = reports.task_profile_report(results)["UDP/WebSocket"]
+
+    assert report["profiles"]["loop"]["tests"] == 2
+    assert report["profiles"]["loop"]["fps"] == pytest.approx(11.0)
+    assert report["profiles"]["loop"]["jitter_ms"] == pytest.approx(70.0)
+    assert report["best_fps"] == "split"
+    assert report["best_control_latency"] == "split"
+
+
+def test_alloc_delta():
+    """Test that allocations during a test are checked against the budget"""
+
+    def snapshot(commands, command_allocs, frames, frame_allocs):
+        return {
+            "total": command_allocs + frame_allocs + 100,
+            "command": {"count": commands, "allocs": command_allocs},
+            "frame": {"count": frames, "allocs": frame_allocs},
+        }
+
+    # Allocations during boot and the first command are not part of the test
+    before = snapshot(1, 5, 10, 0)
+    after = snapshot(101, 5, 310, 30)
+    delta = reports.alloc_delta(before, after, {"command": 0, "frame": 0})
+
+    assert delta["command"] == {"count": 100, "allocs": 0, "mean": 0.0}
+    assert delta["frame"]["mean"] == pytest.approx(0.1)
+    assert delta["over_budget"] == ["frame"]
+    assert reports.alloc_delta(before, after, {"frame": 0.5})["over_budget"] == []
+
+
+def test_camera_delta_restarts_after_reinit():
+    """Test that capture statistics cover only the test"""
+
+    def snapshot(elapsed_ms, frames, mean_grab_ms, unconsumed):
+        return {
+            "fb_count": 3,
+            "fb_location": "psram",
+            "grab_mode": "latest",
+            "memory": {"dram_bytes": 1024, "psram_bytes": 184320},
+            "capture": {
+                "elapsed_ms": elapsed_ms,
+                "frames": frames,
+                "failures": 0,
+                "mean_grab_ms": mean_grab_ms,
+                "unconsumed": unconsumed,
+                "bad_frames": 0,
+            },
+        }
+
+    delta = reports.camera_delta(
+        snapshot(1000, 20, 10.0, 1), snapshot(3000, 80, 20.0, 4)
+    )
+    assert delta["fb_count"] == 3
+    assert delta["capture"]["frames"] == 60
+    assert delta["capture"]["fps"] == pytest.approx(30.0)
+    assert delta["capture"]["mean_grab_ms"] == pytest.approx(1400 / 60)
+    assert delta["capture"]["unconsumed"] == 3
+
+    # Counters restart when the camera is reinitialized
+    delta = reports.camera_delta(
+        snapshot(5000, 100, 10.0, 1), snapshot(500, 10, 5.0, 0)
+    )
+    assert delta["capture"]["frames"] == 10
+    assert delta["capture"]["fps"] == pytest.approx(20.0)
+
+
+def test_raw_codec_report_compares_plain_and_encoded():
+    """Test that encoded raw frames are compared with plain ones per resolution"""
+    before = {
+        "uptime_ms": 10000,
+        "raw_codec": {
+            "frames": 10,
+            "raw_bytes": 6144000,
+            "encoded_bytes": 4096000,
+            "encode_us": 40000,
+            "max_encode_us": 4500,
+        },
+    }
+    after = {
+        "uptime_ms": 20000,
+        "raw_codec": {
+            "frames": 60,
+            "raw_bytes": 36864000,
+            "encoded_bytes": 16384000,
+            "encode_us": 240000,
+            "max_encode_us": 5000,
+        },
+    }
+    codec = reports.raw_codec_delta(before, after)
+    assert codec["frames"] == 50
+    assert codec["ratio"] == pytest.approx(2.5)
+    assert codec["encode_us"] == pytest.approx(4000)
+    assert codec["fps"] == pytest.approx(5.0)
+
+    def entry(raw_codec, fps, result=None):
+        params = {"video_protocol": "UDP", "resolution": "VGA", "raw_mode": True}
+        if raw_codec:
+            params["raw_codec"] = True
+        return {
+            "params": params,
+            "results": {
+                "summary": {"metrics": {"fps": {"value": fps}}},
+                **(result or {}),
+            },
+        }
+
+    report = reports.raw_codec_report(
+        [entry(False, 2.0), entry(True, 5.0, {"raw_codec": codec})]
+    )
+    assert report["UDP/VGA"]["codec"]["ratio"] == pytest.approx(2.5)
+    assert report["UDP/VGA"]["fps_gain"] == pytest.approx(2.5)
+
+
+def test_raw_format_report_compares_with_full_size_rgb565():
+    """Test that raw formats and downscale factors are compared with RGB565"""
+
+    def frames(raw_format, scale, width, height, frame_bytes, downscale_us):
+        before = {"uptime_ms": 0, "raw_frames": {"frames": 0, "bytes": 0}}
+        after = {
+            "uptime_ms": 10000,
+            "raw_frames": {
+                "format": raw_format,
+                "scale": scale,
+                "width": width,
+                "height": height,
+                "frames": 100,
+                "bytes": frame_bytes * 100,
+                "downscale_us": downscale_us * 100,
+                "max_downscale_us": downscale_us,
+            },
+        }
+        return reports.raw_frame_delta(before, after)
+
+    gray = frames("GRAYSCALE", 4, 160, 120, 19200, 900)
+    assert gray["frame_bytes"] == 19200
+    assert gray["downscale_us"] == 900
+    assert gray["fps"] == pytest.approx(10.0)
+
+    def entry(fps, result, **params):
+        params.update({"video_protocol": "UDP", "resolution": "VGA", "raw_mode": True})
+        return {
+            "params": params,
+            "results": {
+                "summary": {"metrics": {"fps": {"value": fps}}},
+                "raw_frames": result,
+            },
+        }
+
+    report = reports.raw_format_report(
+        [
+            entry(2.0, frames("RGB565", 1, 640, 480, 614400, 0), raw_format="rgb565"),
+            entry(10.0, gray, raw_format="grayscale", raw_scale=4),
+        ]
+    )
+    row = report["UDP/VGA"]["grayscale/4"]
+    assert row["size"] == "160x120"
+    assert row["bytes_ratio"] == pytest.approx(1 / 32)
+    assert row["fps_ratio"] == pytest.approx(5.0)
+
+
+def test_jpeg_encoder_report_compares_sensor_and_software():
+    """Test that the software JPEG encoder is compared with the sensor per variant"""
+    before = {"uptime_ms": 10000, "soft_jpeg": {"frames": 0, "encode_us": 0}}
+    after = {
+        "uptime_ms": 20000,
+        "soft_jpeg": {
+            "core": 0,
+            "quality": 80,
+            "frames": 100,
+            "failures": 1,
+            "encode_us": 3000000,
+            "max_encode_us": 45000,
+            "starved": 4,
+            "backed_up": 20,
+        },
+    }
+    soft = reports.soft_jpeg_delta(before, after)
+    assert soft["encode_ms"] == pytest.approx(30.0)
+    assert soft["fps"] == pytest.approx(10.0)
+    assert soft["starved"] == 4
+
+    def entry(encoder, fps, quality, result=None):
+        params = {
+            "video_protocol": "HTTP",
+            "resolution": "VGA",
+            "quality": 12,
+            "jpeg_encoder": encoder,
+        }
+        return {
+            "params": params,
+            "results": {
+                "summary": {"metrics": {"fps": {"value": fps}}},
+                "jpeg": {"frame_bytes": 20000, "quality": quality},
+                **(result or {}),
+            },
+        }
+
+    report = reports.jpeg_encoder_report(
+        [
+            entry("hardware", 20.0, 81.0),
+            entry("software", 10.0, 80.0, {"soft_jpeg": soft}),
+        ]
+    )
+    variant = report["HTTP/VGA/12"]
+    assert variant["software"]["encode_ms"] == pytest.approx(30.0)
+    assert variant["hardware"]["estimated_quality"] == 81.0
+    assert variant["software_fps_ratio"] == pytest.approx(0.5)
+
+
+def test_motion_report_compares_fixed_and_adaptive_rate():
+    """Test that the motion-adaptive rate is compared with streaming every frame"""
+    before = {"uptime_ms": 0, "motion": {"frames": 0, "sent": 0, "analyze_us": 0}}
+    after = {
+        "uptime_ms": 30000,
+        "motion": {
+            "frames": 300,
+            "sent": 60,
+            "events": 2,
+            "failures": 0,
+            "analyze_us": 600000,
+            "max_analyze_us": 4000,
+            "interval_ms": 2000,
+        },
+    }
+    detector = reports.motion_delta(before, after)
+    assert detector["sent_ratio"] == pytest.approx(0.2)
+    assert detector["analyze_us"] == pytest.approx(2000)
+    assert detector["events"] == 2
+
+    def entry(bitrate, result=None, **params):
+        params.update({"video_protocol": "UDP", "resolution": "VGA", "quality": 12})
+        return {
+            "params": params,
+            "results": {
+                "summary": {
+                    "metrics": {
+                        "fps": {"value": 10.0 if not result else 2.0},
+                        "bitrate_mbps": {"value": bitrate},
+                    }
+                },
+                **(result or {}),
+            },
+        }
+
+    report = reports.motion_report(
+        [
+            entry(4.0),
+            entry(1.0, {"motion": detector}, motion_adaptive=True),
+            entry(3.0, raw_mode=True),
+        ]
+    )
+    assert list(report) == ["UDP/VGA/12/None"]
+    variant = report["UDP/VGA/12/None"]
+    assert variant["adaptive"]["sent_ratio"] == pytest.approx(0.2)
+    assert variant["bitrate_saved"] == pytest.approx(0.75)
+
+
+def test_raw_tile_report_compares_whole_frames_and_tiles():
+    """Test that raw frames sent as changed tiles are compared with whole frames"""
+    before = {"raw_tiles": {"frames": 0, "tiles": 0, "bytes": 0, "send_us": 0}}
+    after = {
+        "raw_tiles": {
+            "tile_size": 16,
+            "threshold": 4,
+            "refresh": 50,
+            "frames": 100,
+            "refreshes": 2,
+            "failures": 0,
+            "tiles": 120000,
+            "changed": 6000,
+            "bytes": 3072000,
+            "send_us": 500000,
+            "max_send_us": 20000,
+        }
+    }
+    tiles = reports.raw_tile_delta(before, after)
+    assert tiles["changed_ratio"] == pytest.approx(0.05)
+    assert tiles["frame_bytes"] == pytest.approx(30720)
+    assert tiles["send_us"] == pytest.approx(5000)
+
+    def entry(fps, result, **params):
+        params.update({"video_protocol": "UDP", "resolution": "VGA", "raw_mode": True})
+        return {
+            "params": params,
+            "results": {"summary": {"metrics": {"fps": {"value": fps}}}, **result},
+        }
+
+    report = reports.raw_tile_report(
+        [
+            entry(2.0, {"raw_frames": {"frame_bytes": 614400}}),
+            entry(12.0, {"raw_tiles": tiles}, raw_tiles=True),
+            entry(4.0, {"raw_frames": {"frame_bytes": 307200}}, raw_scale=2),
+        ]
+    )
+    assert list(report) == ["UDP/VGA/rgb565/1"]
+    variant = report["UDP/VGA/rgb565/1"]
+    assert variant["tiles"]["refreshes"] == 2
+    assert variant["bytes_ratio"] == pytest.approx(0.05)
+    assert variant["fps_gain"] == pytest.approx(6.0)
+
+
+def test_hot_path_report_compares_flash_and_iram():
+    """Test that hot path costs of a test are compared between flash and IRAM builds"""
+
+    def snapshot(iram, calls, cycles, i_stall, kilobytes):
+        return {
+            "iram": iram,
+            "stalls": True,
+            "cpu_mhz": 240,
+            "paths": {
+                "udp_packet": {
+                    "calls": calls,
+                    "cycles": cycles,
+                    "max_cycles": 4800,
+                    "i_stall": i_stall,
+                    "d_stall": 0,
+                    "bytes": kilobytes * 1024,
+                },
+                "control_parse": {
+                    "calls": 0,
+                    "cycles": 0,
+                    "max_cycles": 0,
+                    "i_stall": 0,
+                    "d_stall": 0,
+                    "bytes": 0,
+                },
+            },
+        }
+
+    empty = snapshot(False, 0, 0, 0, 0)
+    flash = reports.hot_path_delta(empty, snapshot(False, 100, 480000, 240000, 100))
+    iram = reports.hot_path_delta(empty, snapshot(True, 100, 240000, 0, 100))
+
+    assert list(flash["paths"]) == ["udp_packet"]  # paths without calls are left out
+    assert flash["paths"]["udp_packet"]["mean_us"] == pytest.approx(20.0)
+    assert flash["paths"]["udp_packet"]["us_per_kb"] == pytest.approx(20.0)
+    assert flash["paths"]["udp_packet"]["i_stall_share"] == pytest.approx(0.5)
+
+    params = {"video_protocol": "UDP", "resolution": "VGA", "quality": 12}
+    results = [
+        {"params": params, "results": {"hot_paths": flash}},
+        {"params": dict(params, hot_path_iram=True), "results": {"hot_paths": iram}},
+    ]
+    report = reports.hot_path_report(results)["UDP/None/VGA/12/None"]
+
+    assert report["speedup"]["udp_packet"] == pytest.approx(2.0)
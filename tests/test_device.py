@@ -0,0 +1,105 @@
+"""Tests for runtime device control."""
+
+from unittest.mock import MagicMock, patch
+
+import pytest
+
+from benchmark.utils import device
+
+
+def _response(payload):
+    """Create a mocked HTTP response"""
+    response = MagicMock()
+    response.json.return_value = payload
+    return response
+
+
+@patch("benchmark.utils.device.requests")
+def test_select_transport_waits_for_switch(mock_requests):
+    """Test that transport selection polls until the device reports the new transports"""
+    mock_requests.get.side_effect = [
+        _response({"video": "HTTP", "control": "HTTP", "pending": True}),
+        _response({"video": "RTSP", "control": "none", "pending": False}),
+    ]
+
+    device.select_transport("192.168.1.100", "RTSP", None)
+
+    mock_requests.post.assert_called_once()
+    assert mock_requests.post.call_args.kwargs["json"] == {
+        "video": "RTSP",
+        "control": "none",
+    }
+    assert mock_requests.get.call_count == 2
+
+
+@patch("benchmark.utils.device.time")
+@patch("benchmark.utils.device.requests")
+def test_select_transport_timeout(mock_requests, mock_time):
+    """Test that a device which never switches raises an error"""
+    mock_time.time.side_effect = [0, 0, 20]
+    mock_requests.get.return_value = _response(
+        {"video": "HTTP", "control": "HTTP", "pending": False}
+    )
+
+    with pytest.raises(RuntimeError):
+        device.select_transport("192.168.1.100", "UDP", "UDP", timeout=10)
+
+
+@patch("benchmark.utils.device.requests")
+def test_select_net_profile_waits_for_profile(mock_requests):
+    """Test that network profile selection polls until the profile is active"""
+    mock_requests.get.side_effect = [
+        _response({"profile": "default", "pending": True}),
+        _response({"profile": "latency", "pending": False}),
+    ]
+
+    device.select_net_profile("192.168.1.100", "latency")
+
+    assert mock_requests.post.call_args.args[0] == "http://192.168.1.100/network"
+    assert mock_requests.post.call_args.kwargs["json"] == {"profile": "latency"}
+    assert mock_requests.get.call_count == 2
+
+
+@patch("benchmark.utils.device.requests")
+def test_select_camera_reports_failed_reinit(mock_requests):
+    """Test that buffers the device could not allocate raise an error"""
+    mock_requests.get.side_effect = [
+        _response({"fb_count": 2, "fb_location": "psram", "pending": True}),
+        _response(
+            {
+                "fb_count": 2,
+                "fb_location": "psram",
+                "pending": False,
+                "error": "camera initialization failed, previous buffers restored",
+            }
+        ),
+    ]
+
+    with pytest.raises(RuntimeError, match="previous buffers restored"):
+        device.select_camera("192.168.1.100", fb_count=3, fb_location="dram")
+
+    assert mock_requests.post.call_args.args[0] == "http://192.168.1.100/camera"
+    assert mock_requests.post.call_args.kwargs["json"] == {
+        "fb_count": 3,
+        "fb_location": "dram",
+    }
+
+
+def test_stream_clients_keeps_last_state_of_each_viewer():
+    """Test that viewers keep their counters after they leave /metrics"""
+    samples = [
+        {"streams": [{"transport": "http", "id": 1, "delivered": 5, "skipped": 0}]},
+        {
+            "streams": [
+                {"transport": "http", "id": 1, "delivered": 9, "skipped": 3},
+                {"transport": "websocket", "id": 1, "delivered": 2, "skipped": 0},
+            ]
+        },
+        {"streams": []},
+    ]
+
+    clients = device.stream_clients(samples)
+
+    assert len(clients) == 2
+    assert clients[0] == {"transport": "http", "id": 1, "delivered": 9, "skipped": 3}
+    assert clients[1]["transport"] == "websocket"
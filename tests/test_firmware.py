@@ -0,0 +1,102 @@
+"""Tests for the content-addressed firmware cache."""
+
+from unittest.mock import patch
+
+import pytest
+
+from benchmark.utils import firmware
+
+
+@pytest.fixture
+def test_params():
+    """Default test parameters"""
+    return {
+        "video_protocol": "HTTP",
+        "control_protocol": "HTTP",
+        "resolution": "VGA",
+        "quality": 30,
+        "metrics": True,
+        "raw_mode": False,
+    }
+
+
+@pytest.fixture
+def cache(tmp_path):
+    """Firmware cache over a minimal fake project"""
+    project = tmp_path / "project"
+    (project / "src").mkdir(parents=True)
+    (project / "src" / "main.cpp").write_text("void setup() {}\n")
+    (project / "platformio.ini").write_text("[env:esp32cam]\n")
+    return firmware.FirmwareCache(
+        cache_dir=str(tmp_path / "cache"),
+        build_root=str(tmp_path / "build"),
+        jobs=2,
+        project_dir=str(project),
+    )
+
+
+def _fake_build(cmd, cwd=None, env=None, **_kwargs):
+    """Pretend to run PlatformIO by writing the expected images"""
+    if cmd[:2] == ["pio", "run"]:
+        out = firmware.Path(env["PLATFORMIO_BUILD_DIR"]) / cmd[-1]
+        out.mkdir(parents=True, exist_ok=True)
+        for _, name in firmware.FLASH_IMAGES:
+            (out / name).write_bytes(b"image")
+    return firmware.subprocess.CompletedProcess(cmd, 0, stdout="", stderr="")
+
+
+def test_variant_hash_depends_on_flags(cache, test_params):
+    """Test that the variant hash is stable and changes with build flags"""
+    first = cache.variant_hash(test_params)
+    assert first == cache.variant_hash(dict(test_params))
+    assert first != cache.variant_hash({**test_params, "quality": 40})
+
+
+def test_variant_hash_follows_env_file(cache, test_params, monkeypatch):
+    """Test that credentials from .env, which override the environment, change the hash"""
+    monkeypatch.setenv("WIFI_SSID", "lab")
+    first = cache.variant_hash(test_params)
+    (cache.project_dir / ".env").write_text(
+        'WIFI_SSID="office"\nWIFI_PASSWORD=secret\n'
+    )
+    second = cache.variant_hash(test_params)
+    assert second != first
+    assert firmware.wifi_credentials(cache.project_dir) == ("office", "secret")
+    monkeypatch.setenv("WIFI_SSID", "other")
+    assert cache.variant_hash(test_params) == second
+
+
+def test_protocols_share_firmware_variant(cache, test_params):
+    """Test that transports are runtime-selected and do not create variants"""
+    other = {**test_params, "video_protocol": "RTSP", "control_protocol": "UDP"}
+    assert cache.variant_hash(test_params) == cache.variant_hash(other)
+
+
+def test_build_all_builds_distinct_variants_once(cache, test_params):
+    """Test that duplicate flag sets are built once and then served from cache"""
+    combinations = [test_params, dict(test_params), {**test_params, "quality": 40}]
+    with patch.object(firmware.subprocess, "run", side_effect=_fake_build) as run:
+        assert cache.build_all(combinations) == {}
+        builds = [c for c in run.call_args_list if c.args[0][:2] == ["pio", "run"]]
+        assert len(builds) == 2
+
+        run.reset_mock()
+        assert cache.build_all(combinations) == {}
+        run.assert_not_called()
+
+    assert cache.is_cached(cache.variant_hash(test_params))
+
+
+def test_flash_skips_already_flashed_variant(cache, test_params):
+    """Test that cached images are flashed only when the device variant changes"""
+    with patch.object(firmware.subprocess, "run", side_effect=_fake_build) as run:
+        cache.flash(test_params, "/dev/ttyUSB0")
+        flashes = [c for c in run.call_args_list if "write_flash" in c.args[0]]
+        assert len(flashes) == 1
+        assert str(cache.image_dir(cache.variant_hash(test_params))) in " ".join(
+            flashes[0].args[0]
+        )
+
+        run.reset_mock()
+        cache.flash(test_params, "/dev/ttyUSB0")
+        run.assert_not_called()
@@ -0,0 +1,88 @@
+"""Tests for multi-device fleet support."""
+
+from unittest.mock import patch
+
+from benchmark.utils import fleet
+
+
+def test_shard_keeps_variants_together():
+    """Test that shards are balanced and a variant is flashed on one board"""
+    combinations = [{"variant": v, "i": i} for v in "aabbbcd" for i in range(2)]
+    shards = fleet.shard(combinations, 2, lambda p: p["variant"])
+
+    assert sorted(len(s) for s in shards) == [6, 8]
+    variants = [{p["variant"] for p in s} for s in shards]
+    assert not variants[0] & variants[1]
+
+
+def test_shard_splits_single_variant():
+    """Test that a single variant is split when there are more boards"""
+    combinations = [{"variant": "a", "i": i} for i in range(6)]
+    shards = fleet.shard(combinations, 3, lambda p: p["variant"])
+    assert [len(s) for s in shards] == [2, 2, 2]
+
+
+def test_discover_devices_merges_config_and_ports():
+    """Test that configured boards are kept and other serial ports are added"""
+    config = {
+        "devices": [{"port": "/dev/ttyUSB0", "ip": "10.0.0.2"}, {"ip": "10.0.0.3"}]
+    }
+    with patch.object(
+        fleet.serial, "find_esp_ports", return_value=["/dev/ttyUSB0", "/dev/ttyUSB1"]
+    ), patch.object(
+        fleet.device, "get_info", side_effect=lambda ip, _: {"device_id": f"id-{ip}"}
+    ), patch.object(
+        fleet.discovery, "listen", return_value={}
+    ):
+        devices = fleet.discover_devices(config)
+
+    assert [(d.port, d.ip) for d in devices] == [
+        ("/dev/ttyUSB0", "10.0.0.2"),
+        (None, "10.0.0.3"),
+        ("/dev/ttyUSB1", None),
+    ]
+    assert devices[0].device_id == "id-10.0.0.2"
+    assert devices[2].name == "/dev/ttyUSB1"
+
+
+def test_discover_devices_matches_beacons_to_serial_ports():
+    """Test that beacons give serial boards their IP and add network-only boards"""
+    beacons = {
+        "esp32cam-000001": {
+            "device_id": "esp32cam-000001",
+            "ip": "10.0.0.5",
+            "mac": "AA:BB:CC:00:00:01",
+        },
+        "esp32cam-000002": {
+            "device_id": "esp32cam-000002",
+            "ip": "10.0.0.6",
+            "mac": "AA:BB:CC:00:00:02",
+        },
+    }
+    info = {b["ip"]: b for b in beacons.values()}
+    with patch.object(
+        fleet.serial, "find_esp_ports", return_value=["/dev/ttyUSB0"]
+    ), patch.object(
+        fleet.serial, "read_mac", return_value="aa:bb:cc:00:00:02"
+    ), patch.object(
+        fleet.device, "get_info", side_effect=lambda ip, _: info[ip]
+    ), patch.object(
+        fleet.discovery, "listen", return_value=beacons
+    ):
+        devices = fleet.discover_devices({})
+
+    assert [(d.port, d.ip, d.device_id) for d in devices] == [
+        ("/dev/ttyUSB0", "10.0.0.6", "esp32cam-000002"),
+        (None, "10.0.0.5", "esp32cam-000001"),
+    ]
+
+
+def test_parse_beacon():
+    """Test that only board beacons are accepted and the sender IP fills in"""
+    beacon = fleet.discovery.parse_beacon(
+        b'{"type": "esp32cam", "device_id": "esp32cam-000001", "ip": "0.0.0.0"}',
+        "10.0.0.7",
+    )
+    assert beacon["ip"] == "10.0.0.7"
+    assert fleet.discovery.parse_beacon(b"discover", "10.0.0.7") is None
+    assert fleet.discovery.parse_beacon(b'{"type": "other"}', "10.0.0.7") is None
@@ -0,0 +1,223 @@
+"""Host builds of firmware primitives."""
+
+import shutil
+import subprocess
+from pathlib import Path
+
+import numpy as np
+import pytest
+
+from benchmark.utils import motion, raw_codec, raw_tiles
+
+ROOT = Path(__file__).resolve().parent.parent
+
+# Flags of the Makefile host-bench target, warnings fail the test
+CXXFLAGS = ["-std=c++17", "-O2", "-Wall", "-Wextra", "-Werror"]
+
+
+def _build_and_run(
+    tmp_path: Path, bench: str, *args: str
+) -> subprocess.CompletedProcess:
+    """Build tests/host/<bench>.cpp like `make host-bench` and run it with args"""
+    binary = tmp_path / bench
+    flags = CXXFLAGS + (["-pthread"] if bench == "queue_bench" else [])
+    build = subprocess.run(
+        [
+            "g++",
+            *flags,
+            f"-I{ROOT / 'src'}",
+            str(ROOT / "tests" / "host" / f"{bench}.cpp"),
+            "-o",
+            str(binary),
+        ],
+        capture_output=True,
+        text=True,
+        check=False,
+    )
+    assert build.returncode == 0, build.stderr
+    result = subprocess.run(
+        [str(binary), *args], capture_output=True, text=True, check=False
+    )
+    assert result.returncode == 0, result.stdout
+    return result
+
+
+@pytest.mark.skipif(shutil.which("g++") is None, reason="g++ not available")
+def test_queue_bench(tmp_path):
+    """Test that the queues pass the host benchmark without losing items"""
+    result = _build_and_run(tmp_path, "queue_bench", "--quick")
+    assert "mpsc stream" in result.stdout
+
+
+@pytest.mark.skipif(shutil.which("g++") is None, reason="g++ not available")
+def test_raw_codec_roundtrip(tmp_path):
+    """Test that frames encoded by the firmware codec decode to the same pixels"""
+    _build_and_run(tmp_path, "raw_codec_bench", "--quick", "--write", str(tmp_path))
+
+    encoded_frames = sorted(tmp_path.glob("*_QVGA.r5"))
+    assert len(encoded_frames) == 3
+    for encoded in encoded_frames:
+        data = encoded.read_bytes()
+        width, height, pixels = raw_codec.decode_rgb565(data)
+        assert (width, height) == (320, 240)
+        assert pixels == encoded.with_suffix(".rgb565").read_bytes()
+        # Pure noise may grow by the literal tags only
+        assert len(data) <= 8 + len(pixels) + len(pixels) // 126 + 1
+
+
+def _box_mean(samples: np.ndarray, factor: int) -> np.ndarray:
+    """Rounded mean of factor x factor blocks of a 2D array"""
+    height, width = samples.shape[0] // factor, samples.shape[1] // factor
+    blocks = samples[: height * factor, : width * factor].astype(np.uint32)
+    sums = blocks.reshape(height, factor, width, factor).sum(axis=(1, 3))
+    return (sums + factor * factor // 2) // (factor * factor)
+
+
+@pytest.mark.skipif(shutil.which("g++") is None, reason="g++ not available")
+def test_downscale_matches_box_mean(tmp_path):
+    """Test that the firmware downscaler averages blocks of every raw format"""
+    _build_and_run(tmp_path, "downscale_bench", "--quick", "--write", str(tmp_path))
+
+    gray = np.fromfile(tmp_path / "gray_VGA.gray", dtype=np.uint8).reshape(480, 640)
+    yuv = np.fromfile(tmp_path / "yuv422_VGA.yuv", dtype=np.uint8).reshape(480, 320, 4)
+    rgb = np.fromfile(tmp_path / "rgb565_VGA.rgb565", dtype=">u2").reshape(480, 640)
+    for factor in (2, 4, 8):
+        out = np.fromfile(tmp_path / f"gray_VGA.x{factor}", dtype=np.uint8)
+        assert np.array_equal(out.reshape(480 // factor, -1), _box_mean(gray, factor))
+
+        # Y of both pixels of a pair, U and V once per pair
+        out = np.fromfile(tmp_path / f"yuv422_VGA.x{factor}", dtype=np.uint8)
+        out = out.reshape(480 // factor, -1, 4)
+        luma = yuv[:, :, [0, 2]].reshape(480, 640)
+        assert np.array_equal(
+            out[:, :, [0, 2]].reshape(480 // factor, -1), _box_mean(luma, factor)
+        )
+        for channel in (1, 3):
+            assert np.array_equal(
+                out[:, :, channel], _box_mean(yuv[:, :, channel], factor)
+            )
+
+        out = np.fromfile(tmp_path / f"rgb565_VGA.x{factor}", dtype=">u2")
+        out = out.reshape(480 // factor, -1)
+        for shift, mask in ((11, 0x1F), (5, 0x3F), (0, 0x1F)):
+            channel = (rgb >> shift) & mask
+            assert np.array_equal((out >> shift) & mask, _box_mean(channel, factor))
+
+
+@pytest.mark.skipif(shutil.which("g++") is None, reason="g++ not available")
+def test_motion_replay_matches_firmware(tmp_path):
+    """Test that the Python port scores and sends frames like the firmware detector"""
+    frames = list(
+        motion.synthetic_corpus(
+            width=160, height=120, seconds=20.0, events=((3.0, 2.0), (12.0, 0.5))
+        )
+    )
+    corpus = tmp_path / "corpus.gray"
+    corpus.write_bytes(b"".join(frame.luma.tobytes() for frame in frames))
+    result = _build_and_run(
+        tmp_path,
+        "motion_bench",
+        "--replay",
+        str(corpus),
+        "160",
+        "120",
+        str(len(frames)),
+        "100",
+    )
+
+    replay = motion.evaluate_replay(frames)
+    firmware = [line.split() for line in result.stdout.splitlines()]
+    assert [int(score) for score, _ in firmware] == replay["scores"]
+    assert [send == "1" for _, send in firmware] == replay["sent_frames"]
+    assert replay["missed_events"] == 0
+    assert replay["false_triggers"] == 0
+    assert 0 < replay["sent"] < len(frames)
+
+
+@pytest.mark.skipif(shutil.which("g++") is None, reason="g++ not available")
+def test_tile_delta_matches_firmware(tmp_path):
+    """Test that the Python port sends the firmware datagrams and frames compose"""
+    _build_and_run(tmp_path, "tile_delta_bench", "--quick", "--write", str(tmp_path))
+
+    for name, fmt in (
+        ("gray", "grayscale"),
+        ("yuv422", "yuv422"),
+        ("rgb565", "rgb565"),
+    ):
+        frame_bytes = 320 * 240 * raw_tiles.bytes_per_pixel(fmt)
+        data = (tmp_path / f"{name}_QVGA.frames").read_bytes()
+        frames = [data[i : i + frame_bytes] for i in range(0, len(data), frame_bytes)]
+        stream = (tmp_path / f"{name}_QVGA.packets").read_bytes()
+        datagrams = []
+        pos = 0
+        while pos < len(stream):
+            size = int.from_bytes(stream[pos : pos + 2], "little")
+            datagrams.append(stream[pos + 2 : pos + 2 + size])
+            pos += 2 + size
+
+        encoder = raw_tiles.TileEncoder()
+        composer = raw_tiles.TileComposer()
+        sent = []
+        for number, frame in enumerate(frames):
+            encoded = encoder.encode(frame, 320, 240, fmt)
+            sent.extend(encoded.datagrams)
+            composed = None
+            for datagram in encoded.datagrams:
+                composed = composer.feed(datagram)
+            if number == 0:
+                assert encoded.full
+                assert composed == frame
+            else:
+                # The moving block changes a few tiles, noise none
+                assert not encoded.full
+                assert 0 < encoded.changed < encoded.tiles // 4
+                error = raw_tiles.max_tile_error(composed, frame, 320, 240, fmt)
+                assert error <= encoder.config.threshold
+        assert sent == datagrams
+
+
+def test_tile_composer_waits_for_refresh():
+    """Test that tiles before the first full refresh and lost datagrams are handled"""
+    config = raw_tiles.TileConfig(refresh_frames=4)
+    frames = list(
+        motion.synthetic_corpus(
+            width=96, height=64, seconds=1.0, events=((0.0, 1.0),), seed=3
+        )
+    )
+    encoder = raw_tiles.TileEncoder(config)
+    encoded = [
+        encoder.encode(raw_tiles.from_luma(f.luma, "rgb565"), 96, 64, "rgb565")
+        for f in frames
+    ]
+    assert [e.full for e in encoded[:5]] == [True, False, False, False, True]
+
+    # Joins after the first refresh: nothing until the next one
+    composer = raw_tiles.TileComposer()
+    outputs = [[composer.feed(d) for d in e.datagrams][-1] for e in encoded[1:5]]
+    assert outputs[:3] == [None, None, None]
+    assert outputs[3] == raw_tiles.from_luma(frames[4].luma, "rgb565")
+
+    # A lost datagram leaves its frame incomplete
+    assert len(encoded[5].datagrams) > 1
+    for datagram in encoded[5].datagrams[1:]:
+        composer.feed(datagram)
+    composer.feed(encoded[6].datagrams[0])
+    assert composer.incomplete_frames == 1
+
+    with pytest.raises(ValueError, match="Not a tile datagram"):
+        raw_tiles.parse_header(b"R5" + bytes(30))
+
+
+def test_tile_replay_saves_bytes():
+    """Test that a still scene with motion events sends a fraction of the frame bytes"""
+    frames = list(
+        motion.synthetic_corpus(
+            width=160, height=120, seconds=10.0, events=((3.0, 2.0),)
+        )
+    )
+    replay = raw_tiles.evaluate_replay(frames, fmt="yuv422", link_mbps=8.0)
+    assert replay["frames"] == len(frames)
+    assert replay["refreshes"] == 2
+    assert replay["tile_bytes"] < replay["frame_bytes"] / 4
+    assert replay["tile_fps"] > 4 * replay["frame_fps"]
+    assert replay["max_tile_error"] <= 4
@@ -0,0 +1,62 @@
+"""Tests for the decode-free MJPEG stream parser."""
+
+import cv2
+import numpy as np
+
+from benchmark.protocols import mjpeg
+
+BOUNDARY = "123456789000000000000987654321"
+
+
+def _part(payload: bytes) -> bytes:
+    """Build a multipart part as sent by the firmware"""
+    return (
+        f"\r\n--{BOUNDARY}\r\nContent-Type: image/jpeg\r\n"
+        f"Content-Length: {len(payload)}\r\n\r\n"
+    ).encode() + payload
+
+
+def _chunked(data: bytes, size: int) -> bytes:
+    """Encode data with HTTP chunked transfer encoding"""
+    out = b""
+    for i in range(0, len(data), size):
+        chunk = data[i : i + size]
+        out += f"{len(chunk):x}\r\n".encode() + chunk + b"\r\n"
+    return out
+
+
+def test_chunked_decoder_handles_split_input():
+    """Test that chunked framing split at arbitrary points is decoded"""
+    body = bytes(range(256)) * 4
+    wire = _chunked(body, 100) + b"0\r\n\r\n"
+    decoder = mjpeg.ChunkedDecoder()
+    decoded = b"".join(decoder.feed(wire[i : i + 7]) for i in range(0, len(wire), 7))
+    assert decoded == body
+    assert decoder.finished
+
+
+def test_multipart_parser_timestamps_and_validates_parts():
+    """Test that parts are split, timestamped on arrival and JPEG markers checked"""
+    good = b"\xff\xd8" + b"\x00" * 500 + b"\xff\xd9"
+    truncated = b"\xff\xd8" + b"\x00" * 100
+    stream = _part(good) + _part(truncated) + _part(good)
+
+    parser = mjpeg.MultipartParser(BOUNDARY)
+    parts = []
+    for i in range(0, len(stream), 64):
+        parts.extend(parser.feed(stream[i : i + 64], float(i)))
+
+    assert [p.data for p in parts] == [good, truncated, good]
+    assert [p.valid for p in parts] == [True, False, True]
+    assert all(p.start_time <= p.end_time for p in parts)
+    assert parts[0].start_time == 0.0
+    assert parts[1].start_time > parts[0].end_time - 64
+
+
+def test_estimate_quality_reads_quantization_tables():
+    """Test that the IJG quality of a frame is recovered from its DQT segment"""
+    image = np.random.default_rng(1).integers(0, 255, (64, 64, 3), dtype=np.uint8)
+    for quality in (30, 75):
+        _, frame = cv2.imencode(".jpg", image, [cv2.IMWRITE_JPEG_QUALITY, quality])
+        assert abs(mjpeg.estimate_quality(frame.tobytes()) - quality) < 1.5
+    assert mjpeg.estimate_quality(b"\xff\xd8\xff\xd9") is None
@@ -0,0 +1,83 @@
+"""Tests for OTA firmware deployment."""
+
+from unittest.mock import MagicMock, patch
+
+import pytest
+import requests
+
+from benchmark.utils import ota
+
+
+class FakeDevice:
+    """OTA endpoints of a board that drops the connection after some chunks."""
+
+    def __init__(self, drop_after=()):
+        self.image = bytearray()
+        self.session = None
+        self.requests = 0
+        self.drop_after = set(drop_after)
+        self.build_hash = "old"
+
+    def status(self):
+        return {
+            "active": self.session is not None,
+            "offset": len(self.image),
+            "build_hash": self.build_hash,
+        }
+
+    def response(self, code=200):
+        resp = MagicMock(status_code=code, text="")
+        resp.json.return_value = self.status()
+        return resp
+
+    def post(self, url, timeout=None, json=None, params=None, data=None, **_):
+        path = url.split("/", 3)[3]
+        if path == "ota/begin":
+            if self.session != json:
+                self.session = json
+                self.image = bytearray()
+            return self.response()
+        if path == "ota/chunk":
+            if self.session is None or params["offset"] != len(self.image):
+                return self.response(409)
+            self.image.extend(data)
+            self.requests += 1
+            if self.requests in self.drop_after:
+                # Chunk was written but the response got lost
+                raise requests.ConnectionError("connection reset")
+            return self.response()
+        self.build_hash = self.session["build_hash"]
+        self.session = None
+        return self.response()
+
+    def get_info(self, ip_address, timeout=None):
+        return {"device_id": "esp32cam-000001", "build_hash": self.build_hash}
+
+
+@pytest.fixture
+def image(tmp_path):
+    path = tmp_path / "firmware.bin"
+    path.write_bytes(bytes(range(256)) * 40)
+    return path
+
+
+def test_push_firmware_resumes_from_device_offset(image):
+    """Test that an interrupted upload continues where the device stopped"""
+    board = FakeDevice(drop_after={2, 3})
+    with patch.object(ota.requests, "post", side_effect=board.post), patch.object(
+        ota.device, "get_info", side_effect=board.get_info
+    ), patch.object(ota.time, "sleep"):
+        result = ota.push_firmware("10.0.0.2", image, "abc", chunk_size=1000)
+
+    assert bytes(board.image) == image.read_bytes()
+    assert result["resumes"] == 2
+    assert result["info"]["build_hash"] == "abc"
+
+
+def test_push_firmware_gives_up_after_retries(image):
+    """Test that a board that keeps failing raises OTAError"""
+    board = FakeDevice(drop_after=range(1, 100))
+    with patch.object(ota.requests, "post", side_effect=board.post), patch.object(
+        ota.time, "sleep"
+    ), pytest.raises(ota.OTAError):
+        ota.push_firmware("10.0.0.2", image, "abc", chunk_size=1000, retries=2)
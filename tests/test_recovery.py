@@ -0,0 +1,52 @@
+"""Tests for link recovery measurements."""
+
+import logging
+from unittest.mock import MagicMock, patch
+
+from benchmark.protocols import recovery
+
+
+def _response(status, etag=None):
+    """Create a mocked /capture response"""
+    response = MagicMock()
+    response.status_code = status
+    response.headers = {"ETag": etag} if etag else {}
+    response.content = b"frame"
+    return response
+
+
+@patch("benchmark.protocols.recovery.time.sleep")
+@patch("benchmark.protocols.recovery.device")
+@patch("benchmark.protocols.snapshot.requests")
+def test_reconnect_waits_for_frame_newer_than_before_drop(
+    mock_requests, mock_device, mock_sleep
+):
+    """Test that only a frame captured after the drop ends the measurement"""
+    mock_requests.get.side_effect = [
+        _response(200, '"41"'),  # newest frame before the drop
+        _response(304, '"41"'),  # link down, cached frame only
+        _response(200, '"42"'),
+    ]
+    mock_device.get_wifi.side_effect = [
+        {"disconnects": 1},
+        {"disconnects": 2, "last_outage_ms": 2300, "fast_connect": True},
+    ]
+    viewer = {"transport": "http", "id": 3}
+    mock_device.get_metrics.side_effect = [
+        {"streams": [viewer, {"transport": "websocket", "id": 1}]},
+        {"streams": [viewer]},
+    ]
+
+    result = recovery.test_reconnect(
+        "192.168.1.100", 2000, 0, 10, logging.getLogger("test")
+    )
+
+    mock_device.drop_wifi.assert_called_once_with("192.168.1.100", 2000)
+    after_drop = mock_requests.get.call_args_list[1]
+    assert after_drop.kwargs["headers"] == {"If-None-Match": '"41"'}
+    assert mock_requests.get.call_count == 3
+    assert result["disconnects"] == 1
+    assert result["outage_ms"] == 2300
+    assert result["viewers"] == 2
+    assert result["viewers_resumed"] == 1
+    assert result["recovery_s"] >= 0
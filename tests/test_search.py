@@ -0,0 +1,63 @@
+"""Tests for the adaptive Pareto-frontier search."""
+
+from benchmark import search
+
+
+def _space():
+    """Two ordinal axes and one categorical axis"""
+    return search.ParamSpace(
+        [
+            search.Axis("resolution", tuple(range(9)), True),
+            search.Axis("quality", tuple(range(9)), True),
+            search.Axis("video_protocol", ("HTTP", "UDP"), False),
+        ]
+    )
+
+
+def test_pareto_front():
+    """Test that dominated points are excluded from the frontier"""
+    objectives = [search.Objective("fps", True), search.Objective("latency", False)]
+    evaluated = {
+        (0,): {"fps": 20, "latency": 10},
+        (1,): {"fps": 10, "latency": 5},
+        (2,): {"fps": 10, "latency": 10},
+    }
+    assert search.pareto_front(evaluated, objectives) == [(0,), (1,)]
+
+
+def test_coarse_grid_and_neighbours():
+    """Test coarse sampling of ordinal axes and neighbourhoods"""
+    space = _space()
+    coarse = space.coarse(3)
+    assert len(coarse) == 3 * 3 * 2
+    assert {p[0] for p in coarse} == {0, 4, 8}
+    assert set(space.neighbours((4, 4, 0), [2, 2, 1])) == {
+        (2, 4, 0),
+        (6, 4, 0),
+        (4, 2, 0),
+        (4, 6, 0),
+        (4, 4, 1),
+    }
+
+
+def test_search_refines_near_frontier_within_budget():
+    """Test that the search stays within budget and finds the true frontier"""
+    objectives = [search.Objective("fps", True), search.Objective("bitrate", False)]
+
+    def evaluate(batch):
+        # UDP is strictly better, FPS and bitrate trade off along resolution
+        return [
+            {
+                "fps": p["resolution"] + (2 if p["video_protocol"] == "UDP" else 0),
+                "bitrate": p["resolution"] + p["quality"],
+            }
+            for p in batch
+        ]
+
+    pareto = search.ParetoSearch(_space(), evaluate, objectives, budget=60)
+    front = pareto.run()
+    assert pareto.runs <= 60
+    assert pareto.runs < 9 * 9 * 2
+    front_params = [pareto.space.params(p) for p in front]
+    assert all(p["video_protocol"] == "UDP" and p["quality"] == 0 for p in front_params)
+    assert {p["resolution"] for p in front_params} == set(range(9))
@@ -0,0 +1,40 @@
+"""Tests for snapshot polling."""
+
+from unittest.mock import MagicMock, patch
+
+from benchmark.protocols import snapshot
+
+
+def _response(status, etag=None, content=b""):
+    """Create a mocked HTTP response"""
+    response = MagicMock()
+    response.status_code = status
+    response.headers = {"ETag": etag} if etag else {}
+    response.content = content
+    return response
+
+
+@patch("benchmark.protocols.snapshot.requests")
+def test_poller_sends_etag_of_last_frame(mock_requests):
+    """Test that the poller revalidates with the ETag it received and counts 304s"""
+    mock_requests.get.side_effect = [
+        _response(200, '"7"', b"frame7"),
+        _response(304),
+        _response(200, '"9"', b"frame9"),
+    ]
+    poller = snapshot.SnapshotPoller("192.168.1.100", wait_ms=500)
+
+    assert poller.poll() == b"frame7"
+    assert poller.poll() is None
+    assert poller.poll() == b"frame9"
+
+    second_call = mock_requests.get.call_args_list[1]
+    assert second_call.kwargs["headers"] == {"If-None-Match": '"7"'}
+    assert second_call.kwargs["params"] == {"wait": 500}
+    assert poller.frames == [7, 9]
+    assert poller.counts == {"ok": 2, "not_modified": 1, "errors": 0}
+
+    metrics = snapshot.summarize([poller, poller], duration=2)
+    assert metrics["distinct_frames"] == 2
+    assert metrics["distinct_fps"] == 1
+    assert metrics["repeated_frames"] == 0
@@ -0,0 +1,60 @@
+"""Tests for repetition statistics and warmup detection."""
+
+import numpy as np
+
+from benchmark.utils import stats
+
+
+def test_detect_warmup_waits_for_fps_and_heap():
+    """Test that warmup lasts until both FPS and heap are stable"""
+    fps = [3, 8, 14, 20, 20, 21, 20, 19, 20, 20, 21, 20]
+    heap = [90000, 80000, 70000, 65000, 64000, 60000, 60000, 60100, 60000, 59900]
+    assert stats.detect_warmup(fps, window=5) == {"seconds": 3, "stable": True}
+    assert stats.detect_warmup(fps, heap, window=5)["seconds"] == 5
+
+    unstable = stats.detect_warmup([1, 20, 1, 20, 1, 20], window=5)
+    assert unstable == {"seconds": 0, "stable": False}
+
+
+def test_apply_warmup_excludes_leading_samples():
+    """Test that warmup seconds, frames and commands are left out of samples"""
+    run = {
+        "video": {
+            "frames_per_second": [
+                {"second": s, "frames": f, "dropped": 0} for s, f in ((1, 5), (2, 20))
+            ],
+            "frame_times_ms": [200.0] * 5 + [50.0] * 20,
+            "frame_offsets_s": [1 + i / 5 for i in range(5)]
+            + [2 + i / 20 for i in range(20)],
+        },
+        "control": {"latency": [30.0, 5.0], "latency_offsets_s": [1.5, 2.5]},
+    }
+    stats.apply_warmup(run, 1)
+    samples = stats.stable_samples(run)
+    assert samples["fps"] == [20]
+    assert samples["frame_time_ms"] == [50.0] * 20
+    assert samples["control_latency_ms"] == [5.0]
+
+
+def test_summary_converges_with_consistent_runs():
+    """Test confidence intervals and early-stop check over repeated runs"""
+    rng = np.random.default_rng(0)
+
+    def run(mean_fps):
+        return {
+            "video": {
+                "frames_per_second": [
+                    {"second": s + 1, "frames": f}
+                    for s, f in enumerate(rng.normal(mean_fps, 1, 20))
+                ]
+            }
+        }
+
+    consistent = stats.summarize_runs([run(20), run(20.2), run(19.9)])
+    fps = consistent["metrics"]["fps"]
+    assert fps["ci_low"] <= fps["value"] <= fps["ci_high"]
+    assert fps["run_cv"] < 0.05
+    assert stats.converged(consistent, {"fps": 0.05})
+
+    noisy = stats.summarize_runs([run(12), run(20)])
+    assert not stats.converged(noisy, {"fps": 0.05})
@@ -0,0 +1,67 @@
+"""Tests for the results store and cross-run comparison."""
+
+import numpy as np
+import pytest
+
+from benchmark.utils import store
+
+
+def _results(fps, latency):
+    """Minimal results of run_test_combination()"""
+    return {
+        "video": {
+            "frames_per_second": [
+                {"second": i + 1, "frames": f, "dropped": 0, "bytes": f * 20000}
+                for i, f in enumerate(fps)
+            ],
+            "frame_times_ms": [1000 / f for f in fps],
+        },
+        "control": {"latency": latency},
+    }
+
+
+@pytest.fixture
+def results_store(tmp_path):
+    """Store with two commits, the second one with slower control"""
+    rng = np.random.default_rng(1)
+    results_store = store.ResultsStore(str(tmp_path / "results.db"))
+    params = {"video_protocol": "HTTP", "control_protocol": "UDP", "quality": 30}
+    for commit, latency_ms in (("aaaa1111", 5.0), ("bbbb2222", 8.0)):
+        for _ in range(2):
+            results_store.add_run(
+                params,
+                _results(
+                    list(rng.normal(20, 1, 30).round()),
+                    list(rng.normal(latency_ms, 0.5, 300)),
+                ),
+                commit=commit,
+            )
+    yield results_store
+    results_store.close()
+
+
+def test_extract_samples_uses_per_second_bytes():
+    """Test that per-second bytes give a bitrate sample per second"""
+    samples = store.extract_samples(_results([10, 20], [1.0, 2.0]))
+    assert samples["fps"] == [10, 20]
+    assert len(samples["bitrate_mbps"]) == 2
+    assert samples["control_latency_ms"] == [1.0, 2.0]
+
+
+def test_compare_flags_latency_regression(results_store):
+    """Test that a latency increase is a regression and unchanged FPS is not"""
+    comparisons = results_store.compare("aaaa", "bbbb")
+    assert len(comparisons) == 1
+    assert comparisons[0]["base_runs"] == comparisons[0]["head_runs"] == 2
+
+    metrics = comparisons[0]["metrics"]
+    assert metrics["control_latency_p50_ms"]["status"] == "regression"
+    assert metrics["control_latency_p50_ms"]["ci_low"] > 0
+    assert metrics["fps"]["status"] == "unchanged"
+    assert "!! control_latency_p50_ms" in store.format_comparison(comparisons)
+
+
+def test_resolve_unknown_commit(results_store):
+    """Test that comparing against a commit without results fails clearly"""
+    with pytest.raises(ValueError, match="No stored results"):
+        results_store.compare("cccc", "bbbb")